@@ -70,6 +70,8 @@ PKG_ATTRS_UNINSTALL =  PKGS_TO_UNINSTALL + PKG_ATTRS
 PKG_TAGS_INSTALL =  PKGS_TO_INSTALL + PKG_TAGS
 PKG_TAGS_UNINSTALL =  PKGS_TO_UNINSTALL + PKG_TAGS
 GENERATE_IPS_INDEX = IMG_PARAMS + "/generate_ips_search_index"
+PKG_CACHE = IMG_PARAMS + "/pkg_cache"
+PKG_CACHE_SIZE = PKG_CACHE + "/size"
 ROOT_PASSWD = IMG_PARAMS + "/rootpass"
 ROOT_PASSWD_PLAINTEXT = ROOT_PASSWD + "/is_plaintext"
 BOOT_ARCHIVE_CONTENTS = IMG_PARAMS + "/boot_archive_contents"
@@ -168,6 +170,11 @@ DC_LOGGER_NAME = "dc_logger"
 # having a hard coded value for the path is not appropriate here.
 IMAGE_INFO_FILE = ".image_info"
 
+# Names of the content list and content manifest of the image, also
+# living in the "root" of the image. They are generated by gen_cd_content.
+IMAGE_CONTENT_FILE = ".livecd-cdrom-content"
+IMAGE_MANIFEST_FILE = ".livecd-cdrom-manifest"
+
 # Keywords in the .image_info file used by DC
 IMAGE_INFO_IMAGE_SIZE_KEYWORD = "IMAGE_SIZE="
 IMAGE_INFO_GRUB_TITLE_KEYWORD = "GRUB_TITLE="
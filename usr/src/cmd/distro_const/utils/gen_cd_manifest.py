@@ -0,0 +1,96 @@
+#!/usr/bin/python2.7
+#
+# CDDL HEADER START
+#
+# The contents of this file are subject to the terms of the
+# Common Development and Distribution License (the "License").
+# You may not use this file except in compliance with the License.
+#
+# You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+# or http://www.opensolaris.org/os/licensing.
+# See the License for the specific language governing permissions
+# and limitations under the License.
+#
+# When distributing Covered Code, include this CDDL HEADER in each
+# file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+# If applicable, add the following below this CDDL HEADER, with the
+# fields enclosed by brackets "[]" replaced with your own identifying
+# information: Portions Copyright [yyyy] [name of copyright owner]
+#
+# CDDL HEADER END
+#
+# Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+#
+
+""" gen_cd_manifest
+
+ Generate the image content manifest from the content list of the media
+ image. Invoked by gen_cd_content once the content list is complete.
+
+"""
+
+import os
+import sys
+import libtransfer
+from osol_install.distro_const.dc_defs import IMAGE_INFO_FILE, \
+    IMAGE_INFO_IMAGE_SIZE_KEYWORD, IMAGE_CONTENT_FILE, IMAGE_MANIFEST_FILE
+
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+def get_image_size(pkg_img_path):
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    """
+    Read size of the installed image from the .image_info file, so that
+    the installer finds it in the manifest as well.
+
+    Args:
+       pkg_img_path: package image area
+
+    Returns:
+       size of the image in KB, 0 if it is not known
+    """
+    try:
+        image_file = open(pkg_img_path + "/" + IMAGE_INFO_FILE, "r")
+    except IOError:
+        return 0
+
+    image_size = 0
+    for line in image_file:
+        if line.startswith(IMAGE_INFO_IMAGE_SIZE_KEYWORD):
+            try:
+                image_size = int(line[len(IMAGE_INFO_IMAGE_SIZE_KEYWORD):])
+            except ValueError:
+                pass
+            break
+    image_file.close()
+    return image_size
+
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+# Main
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+""" Generate the image content manifest.
+
+Args:
+  PKG_IMG_PATH: Package image area, the root of the media
+
+Every entry of the content list is recorded with its size, mode,
+ownership, hard link group and SHA-1 of its contents.
+
+"""
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+if (len(sys.argv) != 2): # Don't forget sys.argv[0] is the script itself.
+    raise Exception, (sys.argv[0] + ": Requires 1 arg:\n" +
+                                    "    pkg_image area.")
+
+PKG_IMG_PATH = sys.argv[1]
+
+STATUS = libtransfer.manifest_create(PKG_IMG_PATH,
+                                     PKG_IMG_PATH + "/" + IMAGE_CONTENT_FILE,
+                                     get_image_size(PKG_IMG_PATH),
+                                     PKG_IMG_PATH + "/" + IMAGE_MANIFEST_FILE)
+if STATUS != 0:
+    print >> sys.stderr, (sys.argv[0] + ": Error creating image content " +
+                          "manifest: " + os.strerror(STATUS))
+    sys.exit(1)
+
+sys.exit(0)
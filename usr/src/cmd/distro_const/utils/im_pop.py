@@ -45,7 +45,7 @@ from osol_install.distro_const.dc_defs import DEFAULT_MAIN_URL, \
     POST_INSTALL_ADD_AUTH_URL, POST_INSTALL_ADD_URL_TO_AUTHNAME, \
     POST_INSTALL_ADD_URL_TO_MIRROR_URL, STOP_ON_ERR, \
     ADD_AUTH_URL_TO_MIRROR_URL, IMAGE_INFO_FILE, \
-    IMAGE_INFO_IMAGE_SIZE_KEYWORD
+    IMAGE_INFO_IMAGE_SIZE_KEYWORD, PKG_CACHE, PKG_CACHE_SIZE
 
 from osol_install.transfer_defs import TM_ATTR_MECHANISM, \
     TM_PERFORM_IPS, TM_IPS_ACTION, TM_IPS_INIT, TM_IPS_PKG_URL, \
@@ -56,7 +56,7 @@ from osol_install.transfer_defs import TM_ATTR_MECHANISM, \
     TM_IPS_PKGS, TM_IPS_GENERATE_SEARCH_INDEX, \
     TM_IPS_UNSET_MIRROR, TM_IPS_PURGE_HIST, TM_IPS_SET_MIRROR, \
     TM_IPS_RETRIEVE, TM_IPS_UNINSTALL, TM_IPS_REPO_CONTENTS_VERIFY, \
-    TM_PYTHON_LOG_HANDLER
+    TM_IPS_CACHE_DIR, TM_IPS_CACHE_SIZE, TM_PYTHON_LOG_HANDLER
 
 # ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 def create_image_info(mntpt):
@@ -243,7 +243,8 @@ def ips_contents_verify(file_name, mntpt):
         (TM_PYTHON_LOG_HANDLER, DC_LOG)])
 
 # ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-def ips_pkg_op(file_name, mntpt, ips_pkg_op, generate_ips_index):
+def ips_pkg_op(file_name, mntpt, ips_pkg_op, generate_ips_index,
+               pkg_url=None, cache_dir=None, cache_size=None):
 # ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
     """Initiate a IPS pkg install/uninstall of the packages specified in
     the designated file.
@@ -254,19 +255,28 @@ def ips_pkg_op(file_name, mntpt, ips_pkg_op, generate_ips_index):
             ips_pkg_op: Install or uninstall
             generate_ips_index: true or false indicating whether to
                 generate the ips index or not. 
+            pkg_url: repository packages are installed from
+            cache_dir: local package cache to install packages through,
+                None for no cache
+            cache_size: size limit of the package cache in megabytes
 
     Returns:
             Return code from the tm_perform_transfer call.
 
     """
 
-    return tm.tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_IPS),
-                                   (TM_IPS_ACTION, ips_pkg_op),
-                                   (TM_IPS_PKGS, file_name),
-                                   (TM_IPS_INIT_MNTPT, mntpt),
-                                   (TM_IPS_GENERATE_SEARCH_INDEX,
-                                       generate_ips_index),
-                                   (TM_PYTHON_LOG_HANDLER, DC_LOG)])
+    tm_argslist = [(TM_ATTR_MECHANISM, TM_PERFORM_IPS),
+                   (TM_IPS_ACTION, ips_pkg_op),
+                   (TM_IPS_PKGS, file_name),
+                   (TM_IPS_INIT_MNTPT, mntpt),
+                   (TM_IPS_GENERATE_SEARCH_INDEX, generate_ips_index),
+                   (TM_PYTHON_LOG_HANDLER, DC_LOG)]
+    if cache_dir is not None and pkg_url is not None:
+        tm_argslist.extend([(TM_IPS_PKG_URL, pkg_url),
+                            (TM_IPS_CACHE_DIR, cache_dir)])
+        if cache_size is not None:
+            tm_argslist.extend([(TM_IPS_CACHE_SIZE, cache_size)])
+    return tm.tm_perform_transfer(tm_argslist)
 
 # ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 def ips_cleanup_authorities(auth_list, future_auth, mntpt):
@@ -521,8 +531,16 @@ if __name__ == "__main__":
     # And finally install the designated packages.
     print >> sys.stderr, "Installing the designated packages"
 
+    # Packages may be kept in local cache shared by builds
+    PKG_CACHE_DIR = dcu.get_manifest_value(MANIFEST_SERVER_OBJ, PKG_CACHE)
+    if PKG_CACHE_DIR is not None:
+        PKG_CACHE_DIR = PKG_CACHE_DIR.strip()
+        print >> sys.stderr, "Using package cache " + PKG_CACHE_DIR
+
     STATUS = ips_pkg_op(PKG_FILE_NAME, PKG_IMG_MNT_PT, TM_IPS_RETRIEVE,
-                        GEN_IPS_INDEX)
+                        GEN_IPS_INDEX, PKG_URL, PKG_CACHE_DIR,
+                        dcu.get_manifest_value(MANIFEST_SERVER_OBJ,
+                                               PKG_CACHE_SIZE))
 
     if STATUS and QUIT_ON_PKG_FAILURE == 'true':
         print >> sys.stderr, "Unable to retrieve all of the specified packages"
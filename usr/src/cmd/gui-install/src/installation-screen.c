@@ -281,9 +281,51 @@ installation_prev_file()
 		(gchar *)MainWindow.InstallationWindow.current_install_file->data);
 }
 
+/*
+ * While files are being transferred, append amount of transferred data
+ * and remaining time to the installation message. Returns newly
+ * allocated string or NULL if no transfer is running.
+ */
+static gchar *
+installation_transfer_message(const gchar *message)
+{
+	om_transfer_progress_t progress;
+	gchar *details, *text;
+	guint64 done, total;
+
+	if (message == NULL ||
+	    MainWindow.CurrentMileStone != OM_SOFTWARE_UPDATE)
+		return (NULL);
+
+	om_get_transfer_progress(&progress);
+	if (!progress.active || progress.bytes_total == 0)
+		return (NULL);
+
+	done = MIN(progress.bytes_done, progress.bytes_total) / (1024 * 1024);
+	total = progress.bytes_total / (1024 * 1024);
+	if (progress.eta == 0) {
+		details = g_strdup_printf(_("%llu of %llu MB transferred"),
+		    (unsigned long long)done, (unsigned long long)total);
+	} else if (progress.eta < 60) {
+		details = g_strdup_printf(
+		    _("%llu of %llu MB transferred, less than a minute left"),
+		    (unsigned long long)done, (unsigned long long)total);
+	} else {
+		details = g_strdup_printf(
+		    _("%llu of %llu MB transferred, about %u minutes left"),
+		    (unsigned long long)done, (unsigned long long)total,
+		    (progress.eta + 59) / 60);
+	}
+	text = g_strdup_printf("%s\n%s", message, details);
+	g_free(details);
+	return (text);
+}
+
 gboolean
 installation_next_step(gpointer data)
 {
+	gchar *message;
+
 	/*
 	 * returning FALSE destroys timeout.
 	 * Called by g_timeout_add, every 2 Seconds
@@ -323,9 +365,13 @@ installation_next_step(gpointer data)
 		return (FALSE);
 	}
 
+	message = installation_transfer_message(
+		MainWindow.InstallationWindow.current_install_message);
 	gtk_label_set_label(
 			GTK_LABEL(MainWindow.InstallationWindow.installationinfolabel),
+			message != NULL ? message :
 			(gchar *)MainWindow.InstallationWindow.current_install_message);
+	g_free(message);
 	gtk_progress_bar_set_fraction(
 		GTK_PROGRESS_BAR(MainWindow.InstallationWindow.installationprogressbar),
 		MainWindow.OverallPercentage/100.0);
@@ -0,0 +1,367 @@
+#!/usr/bin/python2.7
+
+#
+# CDDL HEADER START
+#
+# The contents of this file are subject to the terms of the
+# Common Development and Distribution License (the "License").
+# You may not use this file except in compliance with the License.
+#
+# You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+# or http://www.opensolaris.org/os/licensing.
+# See the License for the specific language governing permissions
+# and limitations under the License.
+#
+# When distributing Covered Code, include this CDDL HEADER in each
+# file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+# If applicable, add the following below this CDDL HEADER, with the
+# fields enclosed by brackets "[]" replaced with your own identifying
+# information: Portions Copyright [yyyy] [name of copyright owner]
+#
+# CDDL HEADER END
+#
+# Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+
+# =============================================================================
+# =============================================================================
+"""
+ls_trace_decode.py - Render binary trace of debug messages recorded by
+                     liblogsvc (LS_TRACE) as text or JSON
+
+"""
+# =============================================================================
+# =============================================================================
+
+import errno
+import getopt
+import json
+import re
+import struct
+import sys
+import time
+
+TRACE_MAGIC = 0x4c535452
+TRACE_VERSION = 1
+
+REC_ID = 1
+REC_FMT = 2
+REC_EVENT = 3
+
+# Debug levels as shown in the install log
+LEVELS = {1: "!", 2: "E", 3: "W", 4: "I"}
+
+# printf(3C) conversion specification
+CONVERSION = re.compile(r"%([-+ #0']*)(\*|\d+)?(?:\.(\*|\d*))?"
+                        r"(hh|h|ll|l|L|q|j|z|t)?([diouxXcsfFeEgGaAp%])")
+
+
+class TraceError(Exception):
+    """Trace file is damaged or isn't a trace file"""
+    pass
+
+
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+def render_conv(spec, conv, val):
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    """ Format one argument the way printf(3C) conversion would.
+
+    Args:
+      spec: conversion specification without the conversion character
+
+      conv: conversion character
+
+      val: argument
+
+    Returns: formatted argument
+
+    Raises: TypeError, ValueError if the argument doesn't match the
+      conversion
+
+    """
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    if conv == "p":
+        return (spec.replace("%", "%#", 1) + "x") % val
+    if conv == "s" and val is None:
+        val = "(null)"
+    elif conv == "u":
+        conv = "d"
+    elif conv in "aA":
+        conv = "e"
+    elif conv == "c":
+        val = chr(val & 0xff)
+    elif conv in "di" and isinstance(val, float):
+        conv = "f"
+    return (spec + conv) % val
+
+
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+def render(fmt, args):
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    """ Format arguments of an event the way printf(3C) would.
+
+    Args:
+      fmt: printf(3C) format string
+
+      args: list of arguments, in order of the conversions
+
+    Returns: formatted message
+
+    Raises: None
+
+    """
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    args = list(args)
+    out = []
+    pos = 0
+    for match in CONVERSION.finditer(fmt):
+        out.append(fmt[pos:match.start()])
+        pos = match.end()
+        (flags, width, prec, dummy, conv) = match.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        try:
+            if width == "*":
+                width = str(args.pop(0))
+            if prec == "*":
+                prec = str(args.pop(0))
+            val = args.pop(0)
+        except IndexError:
+            out.append(match.group())
+            continue
+
+        spec = "%" + flags.replace("'", "") + (width or "")
+        if prec is not None:
+            spec += "." + prec
+        # Argument of other type than the conversion expects, e.g. a
+        # string for %d, is shown as is next to the conversion
+        try:
+            out.append(render_conv(spec, conv, val))
+        except (TypeError, ValueError):
+            out.append("[%s: %r]" % (match.group(), val))
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+def read_events(trace):
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    """ Generate events recorded in a trace file.
+
+    Args:
+      trace: open trace file
+
+    Returns: generator of dictionaries with keys time (seconds since
+      the Epoch), id, level, format, args and message
+
+    Raises:
+      TraceError: if the file isn't a trace file. A truncated record at
+      the end of the file, left there when the installer died, is
+      silently ignored.
+
+    """
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    data = trace.read()
+    if len(data) < 32 or data[:8] != "LSTRACE\0":
+        raise TraceError("not a trace file")
+
+    # The trace is written in byte order of the machine which wrote it
+    for order in "<>":
+        if struct.unpack(order + "I", data[8:12])[0] == TRACE_MAGIC:
+            break
+    else:
+        raise TraceError("unknown byte order")
+    (version, hrstart, start) = struct.unpack(order + "Iqq", data[12:32])
+    if version != TRACE_VERSION:
+        raise TraceError("unsupported version %d" % version)
+
+    ids = {}
+    fmts = {0: "%s"}
+    off = 32
+    try:
+        while off < len(data):
+            rtype = ord(data[off])
+            if rtype == REC_ID:
+                (num, length) = struct.unpack_from(order + "HH", data, off + 1)
+                ids[num] = data[off + 5:off + 5 + length]
+                off += 5 + length
+            elif rtype == REC_FMT:
+                (num, length) = struct.unpack_from(order + "IH", data, off + 1)
+                fmts[num] = data[off + 7:off + 7 + length]
+                off += 7 + length
+            elif rtype == REC_EVENT:
+                (hrtime, idnum, level, fmtnum, length) = \
+                    struct.unpack_from(order + "qHbIH", data, off + 1)
+                end = off + 18 + length
+                if end > len(data):
+                    break
+                args = read_args(data[off + 18:end], order)
+                off = end
+                fmt = fmts.get(fmtnum, "")
+                yield {"time": start + (hrtime - hrstart) / 1e9,
+                       "id": ids.get(idnum, "?"),
+                       "level": LEVELS.get(level, "?"),
+                       "format": fmt,
+                       "args": args,
+                       "message": render(fmt, args)}
+            else:
+                raise TraceError("unknown record type %d at offset %d" %
+                                 (rtype, off))
+    except struct.error:
+        # truncated record
+        pass
+
+
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+def read_args(data, order):
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    """ Decode arguments of an event.
+
+    Args:
+      data: arguments as recorded
+
+      order: byte order of the trace, struct module notation
+
+    Returns: list of arguments
+
+    Raises:
+      struct.error: if the arguments are truncated
+
+    """
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    args = []
+    off = 0
+    while off < len(data):
+        tag = data[off]
+        if tag == "s":
+            length = struct.unpack_from(order + "H", data, off + 1)[0]
+            if length == 0xffff:
+                args.append(None)
+                length = 0
+            else:
+                args.append(data[off + 3:off + 3 + length])
+            off += 3 + length
+            continue
+        if tag == "i":
+            val = struct.unpack_from(order + "q", data, off + 1)[0]
+        elif tag in "up":
+            val = struct.unpack_from(order + "Q", data, off + 1)[0]
+        elif tag == "f":
+            val = struct.unpack_from(order + "d", data, off + 1)[0]
+        else:
+            raise struct.error("unknown argument type")
+        args.append(val)
+        off += 9
+    return args
+
+
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+def is_utf8(event):
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    """ Check that all strings of an event are valid UTF-8.
+
+    Args:
+      event: event as generated by read_events()
+
+    Returns: True if they are, False otherwise
+
+    Raises: None
+
+    """
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    try:
+        for val in [event["id"], event["format"], event["message"]] + \
+            [arg for arg in event["args"] if isinstance(arg, str)]:
+            val.decode("utf-8")
+    except UnicodeDecodeError:
+        return False
+    return True
+
+
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+def usage(msg_fd):
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    """Display commandline options and arguments.
+
+	Args: msg_fd: file descriptor to write message to.
+
+	Returns: None
+
+	Raises: None
+	"""
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    print >> msg_fd, "Usage:"
+    print >> msg_fd, "  %s [-j] <trace file>" % (sys.argv[0])
+    print >> msg_fd, "  %s [-h|-?]" % (sys.argv[0])
+    print >> msg_fd, "where:"
+    print >> msg_fd, "  -h or -?: print this message"
+    print >> msg_fd, "  -j: print one JSON object per event instead of text"
+    print >> msg_fd, ""
+
+
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+def main():
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+    """ Main
+
+    Args: None.  (Use sys.argv[] to get args)
+
+    Returns: N/A
+
+    Raises: None
+
+    """
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    as_json = False
+
+    try:
+        (opt_pairs, other_args) = getopt.getopt(sys.argv[1:], "hj?")
+    except getopt.GetoptError, err:
+        print >> sys.stderr, "ls_trace_decode: " + str(err)
+        usage(sys.stderr)
+        sys.exit(errno.EINVAL)
+
+    for (opt, optarg) in opt_pairs:
+        del optarg
+        if ((opt == "-h") or (opt == "-?")):
+            usage(sys.stdout)
+            sys.exit(0)
+        elif (opt == "-j"):
+            as_json = True
+
+    if (len(other_args) != 1):
+        usage(sys.stderr)
+        sys.exit(errno.EINVAL)
+
+    try:
+        trace = open(other_args[0], "rb")
+        for event in read_events(trace):
+            if as_json:
+                # Messages may contain anything, not just UTF-8
+                print json.dumps(event, encoding=("utf-8"
+                                 if is_utf8(event) else "latin-1"))
+            else:
+                # The same format as the install log
+                stamp = time.strftime("%b %d %H:%M:%S",
+                                      time.gmtime(event["time"]))
+                sys.stdout.write("<%s_%s %s> %s" % (event["id"],
+                                 event["level"], stamp, event["message"]))
+    except IOError, err:
+        if err.errno == errno.EPIPE:
+            sys.exit(0)
+        print >> sys.stderr, "ls_trace_decode: " + str(err)
+        sys.exit(err.errno)
+    except TraceError, err:
+        print >> sys.stderr, "ls_trace_decode: %s: %s" % (other_args[0],
+                                                          str(err))
+        sys.exit(errno.EINVAL)
+    sys.exit(0)
+
+
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+# Main
+# ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+if __name__ == "__main__":
+    main()
@@ -38,6 +38,7 @@ from osol_install.text_install.i18n import ljust_columns
 from osol_install.text_install.inner_window import InnerWindow
 from osol_install.text_install.window_area import WindowArea
 from osol_install.text_install.ti_install import perform_ti_install
+from osol_install.transfer_mod import tm_get_progress
 
 
 class InstallProgress(BaseScreen):
@@ -61,6 +62,11 @@ class InstallProgress(BaseScreen):
         # Format: (y, x, width)
         self.status_bar_loc = (6, 10, 50)
         
+        # Location on screen where amount of transferred data and
+        # remaining time are printed while files are being transferred
+        # Format: (y, x, max-width)
+        self.transfer_msg_loc = (8, 12, 50)
+        
         self.last_update = 0
         # Minimum elapsed time in seconds between screen updates
         self.update_frequency = 2
@@ -200,6 +206,7 @@ class InstallProgress(BaseScreen):
         '''
         self.set_status_message(message)
         self.set_status_percent(percent)
+        self.set_transfer_message()
         self.main_win.redrawwin()
         self.main_win.do_update()
     
@@ -211,6 +218,32 @@ class InstallProgress(BaseScreen):
                                  self.status_msg_loc[1],
                                  max_chars=self.status_msg_loc[2])
     
+    def set_transfer_message(self):
+        '''Show amount of data transferred and estimated remaining time
+        while the transfer module copies files, clear the message otherwise
+        
+        '''
+        progress = tm_get_progress()
+        message = ""
+        if progress.active and progress.bytes_total:
+            message = _("%(done)i of %(total)i MB transferred") % \
+                      {"done" : progress.bytes_done / (1024 * 1024),
+                       "total" : progress.bytes_total / (1024 * 1024)}
+            if progress.eta:
+                message += ", " + InstallProgress.remaining_text(progress.eta)
+        self.center_win.add_text(ljust_columns(message,
+                                               self.transfer_msg_loc[2]),
+                                 self.transfer_msg_loc[0],
+                                 self.transfer_msg_loc[1],
+                                 max_chars=self.transfer_msg_loc[2])
+    
+    @staticmethod
+    def remaining_text(eta):
+        '''Return estimated remaining time (in seconds) as text'''
+        if eta < 60:
+            return _("less than a minute left")
+        return _("about %i minutes left") % ((eta + 59) / 60)
+    
     def set_status_percent(self, percent):
         '''Set the completion percentage by updating the progress bar.
         Note that this is implemented as a 'one-way' change (updating to
@@ -35,7 +35,8 @@ import subprocess as sp
 import osol_install.tgt as tgt
 from osol_install.libzoneinfo import tz_isvalid
 from libbe_py import beUnmount
-from osol_install.transfer_mod import tm_perform_transfer, tm_abort_transfer
+from osol_install.transfer_mod import tm_perform_transfer, tm_abort_transfer, \
+    tm_reset_abort
 from osol_install.transfer_defs import TM_ATTR_MECHANISM, \
     TM_PERFORM_CPIO, TM_CPIO_ACTION, TM_CPIO_ENTIRE, TM_CPIO_SRC_MNTPT, \
     TM_CPIO_DST_MNTPT, TM_SUCCESS
@@ -495,6 +496,9 @@ def do_ti_install(install_profile, screen, update_status_func, quit_event,
     global INSTALL_STATUS
     INSTALL_STATUS = InstallStatus(screen, update_status_func, quit_event)
 
+    # abort of a previous install doesn't apply to this one
+    tm_reset_abort()
+
     if install_profile.install_to_pool:
         rootpool_name = install_profile.pool_name
     else:
@@ -23,8 +23,12 @@
  * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
  */
 
-#include <Python.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/errno.h>
 #include <libintl.h>
@@ -32,34 +36,66 @@
 #include "liberrsvc_priv.h"
 #include "liberrsvc_defs.h"
 
-#define	STD_ERR 2
-
-/* The name of the Python module containing the functions we will call */
-#define	ERRSVC_PY_MOD "osol_install.errsvc"
-
-/* The names of the Python functions we will call */
-#define	ERROR_INFO_CLASS "ErrorInfo"
-#define	CLEAR_ERROR_LIST_FUNC "clear_error_list"
-#define	SET_ERROR_DATA "set_error_data"
-#define	DUMP_ALL_ERRORS_FUNC "__dump_all_errors__"
-#define	GET_ERRORS_BY_MOD_ID "get_errors_by_mod_id"
-#define	GET_ALL_ERRORS "get_all_errors"
-#define	GET_ERRORS_BY_TYPE "get_errors_by_type"
-#define	GET_ERR_TYPE "get_error_type"
-#define	GET_MOD_ID "get_mod_id"
-#define	GET_ERR_DATA_BY_TYPE "get_error_data_by_type"
-
 /* Identifier for this library */
 #define	ERRSVC_ID "LIBERRSVC"
 
 /* Standard error messages */
-#define	ERR_PY_FUNC gettext("ERROR - Unable to call Python function")
-#define	ERR_PY_CALL gettext("ERROR - Python function call returned failure")
 #define	ERR_INVAL_PARAM gettext("ERROR - Invalid Parameter passed to function")
+#define	ERR_NO_MEM gettext("ERROR - Unable to allocate memory")
 #define	ERR_UNKNOWN gettext("UNKNOWN ERROR")
 
-static PyThreadState *mainThreadState = NULL;
-static char *empty_argv[1] = { "" };
+/* Number of error data element types, see err_elem_type */
+#define	ES_DATA_NTYPES		(ES_DATA_FAILED_STR + 1)
+
+#define	ES_DUMP_RULE		"---------------------------------"
+
+/*
+ * Errors and their data are carved out of a chain of arena chunks, so
+ * recording an error costs a pointer bump and all of it goes back in one
+ * sweep from es_free_errors().  Strings larger than a chunk get a chunk
+ * of their own.
+ */
+#define	ES_ARENA_CHUNK		4096
+#define	ES_ALIGN(n)		(((n) + 7) & ~(size_t)7)
+
+typedef struct es_chunk {
+	struct es_chunk	*ec_next;
+	size_t		ec_size;	/* usable bytes following the header */
+	size_t		ec_used;
+} es_chunk_t;
+
+#define	ES_CHUNK_HDR		ES_ALIGN(sizeof (es_chunk_t))
+
+/* initial size of the handle table, a power of two */
+#define	ES_HASH_MIN		64
+#define	ES_HASH(ep, size)	\
+	((((uintptr_t)(ep) >> 3) * 2654435761U) & ((size) - 1))
+
+/*
+ * One recorded error.  err_info_t handles given out to consumers point
+ * at one of these.
+ */
+typedef struct es_err {
+	struct es_err	*ee_next;
+	char		*ee_mod_id;
+	int		ee_type;
+	uint_t		ee_set;		/* bit per ES_DATA_* type set */
+	int		ee_num;		/* ES_DATA_ERR_NUM */
+	char		*ee_str[ES_DATA_NTYPES];
+} es_err_t;
+
+/*
+ * The error store.  All of it is protected by es_lock.  Errors are kept
+ * in creation order.  es_hash is an open addressing table of the errors
+ * in the store, used to check handles passed in by consumers.
+ */
+static pthread_mutex_t es_lock = PTHREAD_MUTEX_INITIALIZER;
+static es_chunk_t *es_arena = NULL;
+static es_err_t *es_head = NULL;
+static es_err_t *es_tail = NULL;
+static es_err_t **es_hash = NULL;
+static size_t es_hash_size = 0;
+static size_t es_nerrs = 0;
 
 int es_errno = 0;
 
@@ -113,267 +149,239 @@ _es_lib_assert(void)
 }
 
 /*
- * Function:  _es_py_assert
- *
- * Description: Check if the specified Python exception has occurred.
- * 		If it has, print an error message and abort.
+ * Function:    _es_alloc
  *
- * Note: If compiled with -DNDEBUG, a NOOP variant of this function
- *       is invoked, which does nothing.
+ * Description: Allocate memory for the error store from the arena.
+ *		Must be called with es_lock held.
  *
- * Parameters: exc - Python object containing the python error.
+ * Parameters:  size - Number of bytes required
  *
- * Return: None
+ * Return:
+ *	Pointer to zeroed memory on success
+ *	NULL on failure, with es_errno set
  *
  * Scope: Private
  */
-
-#ifdef NDEBUG
-#define	_es_py_assert(x)	((void)0)	/* NOOP */
-#else
-void
-_es_py_assert(PyObject *exc)
+static void *
+_es_alloc(size_t size)
 {
-	PyObject *pType;
-	PyObject *pValue;
-	PyObject *pTraceback;
-	PyObject *pString = NULL;
-	char *type_str = NULL;
-	char *val_str = NULL;
-
-	if (! PyErr_Occurred()) {
-		return;
-	}
+	es_chunk_t	*chunk = es_arena;
+	size_t		csize;
+	void		*ptr;
 
-	if (! PyErr_ExceptionMatches(exc)) {
-		return;
-	}
+	size = ES_ALIGN(size);
 
-	/* Fetching the error details also clears the error indicator */
-	PyErr_Fetch(&pType, &pValue, &pTraceback);
+	if (chunk == NULL || chunk->ec_size - chunk->ec_used < size) {
+		csize = size > ES_ARENA_CHUNK - ES_CHUNK_HDR ?
+		    size : ES_ARENA_CHUNK - ES_CHUNK_HDR;
 
-	if ((pType != NULL) &&
-	    ((pString = PyObject_Str(pType)) != NULL) &&
-	    (PyString_Check(pString))) {
-		type_str = PyString_AsString(pString);
-	}
+		chunk = malloc(ES_CHUNK_HDR + csize);
+		if (chunk == NULL) {
+			es_errno = ENOMEM;
+			return (NULL);
+		}
+		chunk->ec_size = csize;
+		chunk->ec_used = 0;
 
-	if ((pValue != NULL) &&
-	    ((pString = PyObject_Str(pValue)) != NULL) &&
-	    (PyString_Check(pString))) {
-		val_str = PyString_AsString(pString);
+		/*
+		 * An oversized request is handed out whole; keep the
+		 * current chunk at the head so its tail is still used.
+		 */
+		if (es_arena != NULL && size > ES_ARENA_CHUNK - ES_CHUNK_HDR) {
+			chunk->ec_next = es_arena->ec_next;
+			es_arena->ec_next = chunk;
+		} else {
+			chunk->ec_next = es_arena;
+			es_arena = chunk;
+		}
 	}
 
-	_log_error(gettext("ERROR: Python Exception "
-	    "Raised:\n\t%s\n\t%s\nAborting.\n"),
-	    type_str ? type_str : "UNKNOWN ERROR TYPE",
-	    val_str ? val_str : "UNKNOWN ERROR VALUE\n");
-
-	Py_XDECREF(pString);
-	Py_XDECREF(pTraceback);
-	Py_XDECREF(pValue);
-	Py_XDECREF(pType);
-
-	/*
-	 * TODO: When logging becomes available this should be logged to the
-	 * error log along with the traceback.
-	 */
-	fprintf(stderr, "\nPrinting out stack trace:\n");
-	printstack(STD_ERR);
+	ptr = (char *)chunk + ES_CHUNK_HDR + chunk->ec_used;
+	chunk->ec_used += size;
+	(void) memset(ptr, 0, size);
 
-	abort();
+	return (ptr);
 }
-#endif
 
 /*
- * Function:  _initialize
+ * Function:    _es_hash_reserve
  *
- * Description: Convenience function for initializing Python-C API
+ * Description: Make sure the handle table has room for one more
+ *		error, growing it if needed.  Must be called with es_lock
+ *		held.
  *
- * Parameters: None
+ * Parameters:  None
  *
- * Returns:
- *	B_TRUE on Success
- *	B_FALSE on Failure
+ * Return:
+ *	B_TRUE on success
+ *	B_FALSE on failure, with es_errno set
  *
  * Scope: Private
  */
-boolean_t
-_initialize()
+static boolean_t
+_es_hash_reserve(void)
 {
-	if (!Py_IsInitialized()) {
-		Py_Initialize();
+	es_err_t	**table;
+	size_t		size;
+	size_t		i;
+	size_t		h;
 
-		/*
-		 * sys.argv needs to be initialized, just in case other
-		 * modules access it.  It is not initialized automatically by
-		 * Py_Initialize().
-		 */
-		PySys_SetArgv(1, empty_argv); /* Init sys.argv[]. */
+	/* keep the table at most half full */
+	if ((es_nerrs + 1) * 2 <= es_hash_size) {
+		return (B_TRUE);
 	}
 
-	if (PyErr_Occurred()) {
+	size = es_hash_size == 0 ? ES_HASH_MIN : es_hash_size * 2;
+	table = calloc(size, sizeof (es_err_t *));
+	if (table == NULL) {
+		es_errno = ENOMEM;
 		return (B_FALSE);
 	}
 
+	for (i = 0; i < es_hash_size; i++) {
+		if (es_hash[i] == NULL) {
+			continue;
+		}
+		h = ES_HASH(es_hash[i], size);
+		while (table[h] != NULL) {
+			h = (h + 1) & (size - 1);
+		}
+		table[h] = es_hash[i];
+	}
+
+	free(es_hash);
+	es_hash = table;
+	es_hash_size = size;
+
 	return (B_TRUE);
 }
 
 /*
- * Function:  _load_module
+ * Function:    _es_lookup
  *
- * Description: Convenience function for loading Python module
+ * Description: Map a handle given out by es_create_err_info() back to
+ *		the error it refers to.  The handle is looked up in the
+ *		handle table and never dereferenced, so one left over from
+ *		before es_free_errors() is rejected rather than read from
+ *		freed memory.  Must be called with es_lock held.
  *
- * Parameters: mode_name - The name of the Python module being loaded.
+ * Parameters:  err - the handle
  *
- * Returns:
- *	NULL on failure
- *	Pointer to PyObject on success
+ * Return:
+ *	The error on success
+ *	NULL if the handle is not valid, with es_errno set to EINVAL
  *
  * Scope: Private
  */
-static PyObject	*
-_load_module(char *mod_name)
+static es_err_t *
+_es_lookup(err_info_t *err)
 {
-	PyObject	*pModule = NULL;
-	PyObject	*pName;
-
-	es_errno = 0;
-
-	/* Make the name object and import the Python module */
-	if ((pName = PyString_FromString(mod_name)) != NULL) {
-		pModule = PyImport_Import(pName);
-		Py_DECREF(pName);
-	}
-
-	if (pModule == NULL) {
-		_log_error(gettext("\t[%s] ERROR - Import of [%s] failed\n"),
-		    ERRSVC_ID, mod_name);
-		es_errno = EINVAL;
+	size_t		h;
+
+	if (err != NULL && es_hash != NULL) {
+		h = ES_HASH(err, es_hash_size);
+		while (es_hash[h] != NULL) {
+			if ((err_info_t *)es_hash[h] == err) {
+				return (es_hash[h]);
+			}
+			h = (h + 1) & (es_hash_size - 1);
+		}
 	}
 
-	return (pModule);
+	es_errno = EINVAL;
+	return (NULL);
 }
 
 /*
- * Function:  _start_threads
+ * Function:    _es_select
  *
- * Description: Convenience function for initializing threads for Python-C API
+ * Description: Build an err_info_list_t of the errors matching
+ *		the given module id and/or error type.
  *
- * Parameters: None
+ * Parameters:  mod_id - module id to match, or NULL for any
+ *		err_type - error type to match, or -1 for any
  *
- * Returns:
- *	Pointer to PyThreadState
- *	Null on failure
+ * Return:
+ *	The new list, in creation order, on success
+ *	NULL if nothing matched or on failure. es_errno distinguishes
+ *	the two.
  *
  * Scope: Private
  */
-static PyThreadState *
-_start_threads()
+static err_info_list_t *
+_es_select(char *mod_id, int err_type)
 {
-	PyThreadState	*myThreadState;
+	err_info_list_t	*new_list = NULL;
+	err_info_list_t	**tailp = &new_list;
+	err_info_list_t	*new_item;
+	es_err_t	*ep;
 
-	PyEval_InitThreads();
-	mainThreadState = PyThreadState_Get();
-	myThreadState = PyThreadState_New(mainThreadState->interp);
-	PyThreadState_Swap(myThreadState);
+	es_errno = 0;
 
-	return (myThreadState);
-}
+	(void) pthread_mutex_lock(&es_lock);
+	for (ep = es_head; ep != NULL; ep = ep->ee_next) {
+		if (mod_id != NULL && strcmp(ep->ee_mod_id, mod_id) != 0) {
+			continue;
+		}
+		if (err_type != -1 && ep->ee_type != err_type) {
+			continue;
+		}
 
-/*
- * Function: _stop_threads
- *
- * Description: Convenience function for clearing threads for Python-C API
- *
- * Parameters: None
- *
- * Returns:
- *	void
- *
- * Scope: Private
- */
-void
-_stop_threads(PyThreadState *myThreadState)
-{
-	PyThreadState_Swap(mainThreadState);
-	PyThreadState_Clear(myThreadState);
-	PyThreadState_Delete(myThreadState);
+		new_item = malloc(sizeof (err_info_list_t));
+		if (new_item == NULL) {
+			es_errno = ENOMEM;
+			_log_error(gettext("\t[%s] ERROR - Unable to "
+			    "allocate memory for new list.\n"), ERRSVC_ID);
+			break;
+		}
+		new_item->ei_err_info = (err_info_t *)ep;
+		new_item->ei_next = NULL;
+
+		*tailp = new_item;
+		tailp = &new_item->ei_next;
+	}
+	(void) pthread_mutex_unlock(&es_lock);
+
+	if (es_errno != 0) {
+		es_free_err_info_list(new_list);
+		new_list = NULL;
+	}
+
+	return (new_list);
 }
 
 /*
- * Function: _convert_pylist_to_err_info_list
+ * Function:    _es_valid_data
  *
- * Description: Convenience function for converting a python list to
- *		an err_info_list_t linked list.
+ * Description: Check that an error data element type is known and is
+ *		of the expected kind.
  *
- * Parameters: None
+ * Parameters:  type - The error data element type
+ *		is_int - B_TRUE if an integer value is being stored or
+ *			 retrieved, B_FALSE for a string
  *
- * Returns:
- *	A pointer to the new list on Success.
- *	NULL on failure
+ * Return:
+ *	B_TRUE if the type may be used that way
+ *	B_FALSE otherwise, with es_errno set to EINVAL
  *
  * Scope: Private
  */
-err_info_list_t *
-_convert_pylist_to_err_info_list(PyObject *pRet)
+static boolean_t
+_es_valid_data(int type, boolean_t is_int)
 {
-	err_info_list_t *new_list = NULL;
-	err_info_list_t *new_list_tail = NULL;
-	PyObject *item;
-	int i;
-	int len = 0;
-
-	errno = 0;
-
-	/* Check that there is something to convert first */
-	if (pRet == NULL || !PySequence_Check(pRet)) {
-		return (NULL);
-	}
-
-	len = (int)PySequence_Length(pRet);
-
-	for (i = 0; i < len; i++) {
-		err_info_list_t *new_item;
-
-		item = PySequence_GetItem(pRet, i);
-
-		new_item = (err_info_list_t *)malloc(sizeof (err_info_list_t));
-		es_errno = errno;
-		if (new_item == NULL) {
-			_log_error(gettext("\t[%s] ERROR - Unable to "
-			    "allocate memory for new list.\n"),
-			    ERRSVC_ID);
-			_es_lib_assert();
-			break;
-		}
-
-		/* Update new list item */
-		new_item->ei_err_info = (err_info_t *)item;
-		new_item->ei_next = NULL;
-
-		/* Insert to the list */
-		if (new_list == NULL) {
-			/* First element in the new list */
-			new_list = new_item;
-		} else if (new_list_tail != NULL) {
-			new_list_tail->ei_next = new_item;
-		} else {
-			/* Shouldn't happen */
-			_log_error(gettext("\t[%s] ERROR - Unable to insert "
-			    "item into new linked list.\n"), ERRSVC_ID);
-			break;
-		}
-
-		/* Update tail pointer to be new item */
-		new_list_tail = new_item;
+	if (type < 0 || type >= ES_DATA_NTYPES) {
+		_log_error(gettext("\t[%s] %s (Invalid error data type "
+		    "[%d])\n"), ERRSVC_ID, ERR_INVAL_PARAM, type);
+		es_errno = EINVAL;
+		return (B_FALSE);
 	}
 
-	if (PyErr_Occurred()) {
-		PyErr_Print();
+	if ((type == ES_DATA_ERR_NUM) != is_int) {
+		es_errno = EINVAL;
+		return (B_FALSE);
 	}
 
-	return (new_list);
+	return (B_TRUE);
 }
 
 /* ******************************************** */
@@ -424,14 +432,14 @@ es_get_failure_reason_str(void)
 /*
  * Function: es_create_err_info
  *
- * Description: The C interface to create a Python ErrorInfo object.
+ * Description: Record a new error in the error service.
  *
  * Parameters:	mod_id  - the string identifier for the module which
  *			  is setting the info for this error
  *		err_type - The error type
  *
  * Returns:
- *	ErrInfo Object on Success (cast to err_info_t)
+ *	A handle to the new error on Success
  *	NULL on failure
  *
  * Scope: Public
@@ -439,94 +447,68 @@ es_get_failure_reason_str(void)
 err_info_t *
 es_create_err_info(char *mod_id, int err_type)
 {
-	PyThreadState	*myThreadState;
-	PyObject	*pParamModId = NULL;
-	PyObject	*pParamErrType = NULL;
-	PyObject	*pModule = NULL;
-	PyObject	*pFunc = NULL;
-	PyObject	*pRet = NULL;
-
-	errno = 0;
-	es_errno = 0;
-
-	if (_initialize() != B_TRUE) {
-		return (NULL);
-	}
+	es_err_t	*ep;
+	size_t		len;
+	size_t		h;
 
-	myThreadState = _start_threads();
+	es_errno = 0;
 
-	/*
-	 * Prepare the params.
-	 * We have 2 parameters to pass into Python, a
-	 * string and an int.
-	 */
 	if (mod_id == NULL || strcmp(mod_id, "") == 0) {
-		_log_error(gettext("\t[%s] %s [%s] (Invalid mod_id "
-		    "parameter)\n"), ERRSVC_ID, ERR_PY_FUNC, ERROR_INFO_CLASS);
+		_log_error(gettext("\t[%s] %s (Invalid mod_id parameter)\n"),
+		    ERRSVC_ID, ERR_INVAL_PARAM);
 		es_errno = EINVAL;
-		goto cleanup;
+		return (NULL);
 	}
 
-	pParamModId = PyString_FromString(mod_id);
-	if (pParamModId == NULL) {
-		_log_error(gettext("\t[%s] %s [%s] (Cannot create PyString)\n"),
-		    ERRSVC_ID, ERR_PY_FUNC, ERROR_INFO_CLASS);
+	if (err_type < ES_ERR || err_type > ES_REPAIRED_ERR) {
+		_log_error(gettext("\t[%s] %s (Invalid err_type parameter "
+		    "[%d])\n"), ERRSVC_ID, ERR_INVAL_PARAM, err_type);
 		es_errno = EINVAL;
-		goto cleanup;
+		return (NULL);
 	}
 
-	pParamErrType = PyInt_FromLong((long)err_type);
+	len = strlen(mod_id) + 1;
 
-	pModule = _load_module(ERRSVC_PY_MOD);
-	if (pModule == NULL) {
-		_log_error(gettext("\t[%s] %s [%s] (Cannot load Python "
-		    "module)\n"), ERRSVC_ID, ERR_PY_FUNC, ERROR_INFO_CLASS);
-		goto cleanup;
+	(void) pthread_mutex_lock(&es_lock);
+	ep = NULL;
+	if (_es_hash_reserve()) {
+		ep = _es_alloc(sizeof (es_err_t) + len);
 	}
+	if (ep != NULL) {
+		h = ES_HASH(ep, es_hash_size);
+		while (es_hash[h] != NULL) {
+			h = (h + 1) & (es_hash_size - 1);
+		}
+		es_hash[h] = ep;
+		es_nerrs++;
 
-	pFunc = PyObject_GetAttrString(pModule, ERROR_INFO_CLASS);
-	if (pFunc == NULL || ! PyCallable_Check(pFunc)) {
-		_log_error(gettext("\t[%s] %s [%s] (Cannot call Python "
-		    "function)\n"), ERRSVC_ID, ERR_PY_FUNC, ERROR_INFO_CLASS);
-
-		es_errno = EINVAL;
-		goto cleanup;
-	}
+		ep->ee_mod_id = (char *)(ep + 1);
+		(void) memcpy(ep->ee_mod_id, mod_id, len);
+		ep->ee_type = err_type;
 
-	/* Call Python class instantiation function ErrorInfo() */
-	pRet = PyObject_CallFunctionObjArgs(pFunc, pParamModId,
-	    pParamErrType, NULL);
-	if (pRet == NULL) {
-		/*
-		 * ErrorInfo() can raise a ValueError exception,
-		 * so check if that happened.
-		 */
-		es_errno = EINVAL;
-		_es_py_assert(PyExc_ValueError);
+		if (es_tail == NULL) {
+			es_head = ep;
+		} else {
+			es_tail->ee_next = ep;
+		}
+		es_tail = ep;
 	}
+	(void) pthread_mutex_unlock(&es_lock);
 
-
-	/* Cleanup code, shared by both the success and failure path */
-cleanup:
-	if (PyErr_Occurred()) {
-		PyErr_Print();
+	if (ep == NULL) {
+		_log_error(gettext("\t[%s] %s (error info)\n"),
+		    ERRSVC_ID, ERR_NO_MEM);
 	}
 
-	Py_XDECREF(pFunc);
-	Py_XDECREF(pModule);
-	Py_XDECREF(pParamModId);
-	Py_XDECREF(pParamErrType);
-
-	_stop_threads(myThreadState);
-
-	return ((err_info_t *)pRet);
+	return ((err_info_t *)ep);
 }
 
 /*
  * Function: es_free_err_info_list
  *
  * Description: Frees a linked list of err_info_list_t, such as that returned
- *		by the es_get_*() set of functions.
+ *		by the es_get_*() set of functions. The errors themselves
+ *		remain in the error service.
  *
  * Parameters:	list - The list of err_info_t's.
  *
@@ -539,12 +521,9 @@ void
 es_free_err_info_list(err_info_list_t *list)
 {
 	err_info_list_t *next;
-	PyObject *err;
 
 	while (list != NULL) {
 		next = list->ei_next;
-		err = (PyObject *)(list->ei_err_info);
-		Py_XDECREF(err);
 		free(list);
 		list = next;
 	}
@@ -553,9 +532,11 @@ es_free_err_info_list(err_info_list_t *list)
 /*
  * Function: es_free_errors
  *
- * Description: The C interface to Python function clear_error_list. This
- *		function free's all the errors created and set and all
- *		assosiated memory
+ * Description: Discards all the errors created and set and all
+ *		assosiated memory. err_info_t handles obtained before
+ *		the call are rejected with EINVAL afterwards, though one
+ *		whose memory has since been reused for a new error refers
+ *		to that error, so they should not be kept.
  *
  * Parameters:
  *	None
@@ -568,75 +549,31 @@ es_free_err_info_list(err_info_list_t *list)
 void
 es_free_errors(void)
 {
-	PyThreadState *myThreadState;
-	PyObject *pModule = NULL;
-	PyObject *pFunc = NULL;
-	PyObject *pRet = NULL;
-	PyObject *err;
-	err_info_list_t *list;
-	err_info_list_t *next;
-
-	/*
-	 * Before calling Python, decrement the references on each error.
-	 * (Each error will have 1 outstanding reference from its initial
-	 * creation.)
-	 * In order to do that, we must call es_get_all_errors, which in
-	 * turn will increment the references and allocate some memory.
-	 * So, we also call es_free_err_into_list to tidy up.
-	 */
-	next = list = es_get_all_errors();
-	while (next != NULL) {
-		err = (PyObject *)(next->ei_err_info);
-		Py_XDECREF(err);
-		next = next->ei_next;
-	}
-	es_free_err_info_list(list);
-
-
-	if (_initialize() != B_TRUE) {
-		return;
-	}
-
-	myThreadState = _start_threads();
-
-	pModule = _load_module(ERRSVC_PY_MOD);
-
-	if (pModule != NULL) {
-		pFunc = PyObject_GetAttrString(pModule, CLEAR_ERROR_LIST_FUNC);
-	}
-
-	if (pFunc == NULL || ! PyCallable_Check(pFunc)) {
-		_log_error(gettext("\t[%s] %s [%s] (function)\n"),
-		    ERRSVC_ID, ERR_PY_FUNC, CLEAR_ERROR_LIST_FUNC);
-	} else {
-		/* Call Python function clear_error_list */
-		pRet = PyObject_CallFunctionObjArgs(pFunc, NULL);
-
-		if (pRet == NULL) {
-			_log_error(gettext("\t[%s] %s [%s] (Call)\n"),
-			    ERRSVC_ID, ERR_PY_FUNC, CLEAR_ERROR_LIST_FUNC);
-		}
-	}
-
-	if (PyErr_Occurred()) {
-		PyErr_Print();
+	es_chunk_t *chunk;
+	es_chunk_t *next;
+
+	(void) pthread_mutex_lock(&es_lock);
+	chunk = es_arena;
+	es_arena = NULL;
+	es_head = es_tail = NULL;
+	free(es_hash);
+	es_hash = NULL;
+	es_hash_size = es_nerrs = 0;
+	(void) pthread_mutex_unlock(&es_lock);
+
+	for (; chunk != NULL; chunk = next) {
+		next = chunk->ec_next;
+		free(chunk);
 	}
-
-	Py_XDECREF(pFunc);
-	Py_XDECREF(pModule);
-
-	_stop_threads(myThreadState);
 }
 
 /*
  * Function: es_set_err_data_int
  *
- * Description: The C interface to Python class method
- *		ErrorInfo.set_error_data() for setting integer data.
+ * Description: Set integer data for an error.
  *
  * Parameters:
- *	err - an instance of Python class ErrorInfo, eg as returned
- *	      from es_create_err_info().
+ *	err - an error handle, eg as returned from es_create_err_info().
  * 	type - The error data element type
  *	val - The value to be stored for this element type.
  *
@@ -649,90 +586,37 @@ es_free_errors(void)
 boolean_t
 es_set_err_data_int(err_info_t *err, int type, int val)
 {
-	PyThreadState *myThreadState;
-	PyObject *pMethod = NULL;
-	PyObject *pRet = NULL;
-	PyObject *pParamType = NULL;
-	PyObject *pParamVal = NULL;
-	boolean_t retval = B_FALSE;
+	es_err_t	*ep;
 
 	es_errno = 0;
 
-	if (_initialize() != B_TRUE) {
-		return (retval);
-	}
-
-	myThreadState = _start_threads();
-
-	/*
-	 * Prepare the params.
-	 * We have 2 parameters to pass into Python,
-	 * two ints (pParamType and pParamVal).
-	 */
-	pParamType = PyInt_FromLong((long)type);
-	pParamVal = PyInt_FromLong((long)val);
-
-	/*
-	 * Check that the passed-in 'err' is a Python instance
-	 * and that it has an attribute for the method we want
-	 * to call
-	 */
-	if (err == NULL ||
-	    ! PyObject_HasAttrString((PyObject *)err, SET_ERROR_DATA)) {
-		_log_error(gettext("\t[%s] %s [%s] (invalid error object)\n"),
-		    ERRSVC_ID, ERR_PY_FUNC, SET_ERROR_DATA);
-		es_errno = EINVAL;
-		goto cleanup;
-	}
-
-	pMethod = PyString_FromString(SET_ERROR_DATA);
-	if (pMethod == NULL) {
-		_log_error(gettext("\t[%s] %s [%s] (cannot create PyString)\n"),
-		    ERRSVC_ID, ERR_PY_FUNC, SET_ERROR_DATA);
-		goto cleanup;
+	if (!_es_valid_data(type, B_TRUE)) {
+		return (B_FALSE);
 	}
 
-	/* Call Python class method ErrorInfo.set_error_data */
-	pRet = PyObject_CallMethodObjArgs((PyObject *)err, pMethod,
-	    pParamType, pParamVal, NULL);
-	if (pRet == NULL) {
-		/*
-		 * set_error_data() can raise ValueError or RuntimeError
-		 * exceptions.  Assert that ValueError did not occur,
-		 * but just return B_FALSE for RuntimeError.
-		 */
-		es_errno = EINVAL;
-		_es_py_assert(PyExc_ValueError);
-		goto cleanup;
+	(void) pthread_mutex_lock(&es_lock);
+	if ((ep = _es_lookup(err)) != NULL) {
+		ep->ee_num = val;
+		ep->ee_set |= 1 << type;
 	}
+	(void) pthread_mutex_unlock(&es_lock);
 
-	retval = B_TRUE;
-
-	/* Cleanup code, shared by both the success and failure path */
-cleanup:
-	if (PyErr_Occurred()) {
-		PyErr_Print();
+	if (ep == NULL) {
+		_log_error(gettext("\t[%s] %s (invalid error object)\n"),
+		    ERRSVC_ID, ERR_INVAL_PARAM);
+		return (B_FALSE);
 	}
 
-	Py_XDECREF(pRet);
-	Py_XDECREF(pParamVal);
-	Py_XDECREF(pParamType);
-	Py_XDECREF(pMethod);
-
-	_stop_threads(myThreadState);
-
-	return (retval);
+	return (B_TRUE);
 }
 
 /*
  * Function: es_set_err_data_str
  *
- * Description: The C interface to Python class method
- *		ErrorInfo.set_error_data() for setting integer data.
+ * Description: Set string data for an error.
  *
  * Parameters:
- *	err - an instance of Python class ErrorInfo, eg as returned
- *	      from es_create_err_info().
+ *	err - an error handle, eg as returned from es_create_err_info().
  * 	type - The error data element type
  *	str - The string to be stored for this element type.
  *	      This can be an interpreted string similar to that used
@@ -747,124 +631,73 @@ cleanup:
 boolean_t
 es_set_err_data_str(err_info_t *err, int type, char *str, ...)
 {
-	PyThreadState *myThreadState;
-	PyObject *pMethod = NULL;
-	PyObject *pRet = NULL;
-	PyObject *pParamType = NULL;
-	PyObject *pParamVal = NULL;
-	boolean_t retval = B_FALSE;
-	va_list ap;
-	char *buf = NULL;
-	int error = 0;
+	es_err_t	*ep;
+	char		buf[256];
+	char		*val = NULL;
+	va_list		ap;
+	int		len;
 
 	es_errno = 0;
-	errno = 0;
-
-	if (_initialize() != B_TRUE) {
-		return (retval);
-	}
-
-	myThreadState = _start_threads();
-
-	/*
-	 * Prepare the params.
-	 * We have 2 parameters to pass into Python,
-	 * an int (pParamType) and a string (pParamVal).
-	 * The string can include formatting characters which are
-	 * expanded from the optional varargs.
-	 */
-	pParamType = PyInt_FromLong((long)type);
 
 	if (str == NULL) {
-		_log_error(gettext("\t[%s] %s [%s] (NULL string)\n"),
-		    ERRSVC_ID, ERR_INVAL_PARAM, SET_ERROR_DATA);
+		_log_error(gettext("\t[%s] %s (NULL string)\n"),
+		    ERRSVC_ID, ERR_INVAL_PARAM);
 		es_errno = EINVAL;
-		goto cleanup;
-	}
-
-	va_start(ap, str);
-	(void) vasprintf(&buf, str, ap);
-	error = errno;
-	va_end(ap);
-
-	if (buf == NULL) {
-		_log_error(gettext("\t[%s] %s [%s] (varargs)\n"),
-		    ERRSVC_ID, ERR_PY_FUNC, SET_ERROR_DATA);
-
-		_es_lib_assert();
-		goto cleanup;
+		return (B_FALSE);
 	}
 
-	pParamVal = PyString_FromString(buf);
-	if (pParamVal == NULL) {
-		_log_error(gettext("\t[%s] %s [%s] (Cannot create PyString)\n"),
-		    ERRSVC_ID, ERR_PY_FUNC, SET_ERROR_DATA);
-		es_errno = EINVAL;
-		goto cleanup;
+	if (!_es_valid_data(type, B_FALSE)) {
+		return (B_FALSE);
 	}
 
 	/*
-	 * Check that the passed-in 'err' is a Python instance
-	 * and that it has an attribute for the method we want
-	 * to call
+	 * Most strings fit the local buffer, in which case they are
+	 * formatted before taking the lock and just copied in.
 	 */
-	if (err == NULL ||
-	    ! PyObject_HasAttrString((PyObject *)err, SET_ERROR_DATA)) {
-		_log_error(gettext("\t[%s] %s [%s] (invalid error object)\n"),
-		    ERRSVC_ID, ERR_INVAL_PARAM, SET_ERROR_DATA);
-		es_errno = EINVAL;
-		goto cleanup;
-	}
+	va_start(ap, str);
+	len = vsnprintf(buf, sizeof (buf), str, ap);
+	va_end(ap);
 
-	pMethod = PyString_FromString(SET_ERROR_DATA);
-	if (pMethod == NULL) {
-		_log_error(gettext("\t[%s] %s[%s] (String)\n"),
-		    ERRSVC_ID, ERR_INVAL_PARAM, SET_ERROR_DATA);
+	if (len < 0) {
+		_log_error(gettext("\t[%s] %s (varargs)\n"),
+		    ERRSVC_ID, ERR_INVAL_PARAM);
 		es_errno = EINVAL;
-		goto cleanup;
+		return (B_FALSE);
 	}
 
-	/* Call Python class method ErrorInfo.set_error_data */
-	pRet = PyObject_CallMethodObjArgs((PyObject *)err, pMethod,
-	    pParamType, pParamVal, NULL);
-	if (pRet == NULL) {
-		/*
-		 * set_error_data() can raise ValueError or RuntimeError
-		 * exceptions.  Assert that ValueError did not occur,
-		 * but just return B_FALSE for RuntimeError.
-		 */
-		es_errno = EINVAL;
-		_es_py_assert(PyExc_ValueError);
-		goto cleanup;
+	(void) pthread_mutex_lock(&es_lock);
+	if ((ep = _es_lookup(err)) != NULL &&
+	    (val = _es_alloc(len + 1)) != NULL) {
+		if ((size_t)len < sizeof (buf)) {
+			(void) memcpy(val, buf, len + 1);
+		} else {
+			va_start(ap, str);
+			(void) vsnprintf(val, len + 1, str, ap);
+			va_end(ap);
+		}
+		ep->ee_str[type] = val;
+		ep->ee_set |= 1 << type;
 	}
+	(void) pthread_mutex_unlock(&es_lock);
 
-	retval = B_TRUE;
-
-	/* Cleanup code, shared by both the success and failure path */
-cleanup:
-	if (PyErr_Occurred()) {
-		PyErr_Print();
+	if (ep == NULL) {
+		_log_error(gettext("\t[%s] %s (invalid error object)\n"),
+		    ERRSVC_ID, ERR_INVAL_PARAM);
+		return (B_FALSE);
 	}
-
-	Py_XDECREF(pRet);
-	Py_XDECREF(pParamVal);
-	Py_XDECREF(pParamType);
-	Py_XDECREF(pMethod);
-	if (buf != NULL) {
-		free(buf);
+	if (val == NULL) {
+		_es_lib_assert();
+		return (B_FALSE);
 	}
 
-	_stop_threads(myThreadState);
-
-	return (retval);
+	return (B_TRUE);
 }
 
 /*
  * Function: es_get_errors_by_modid
  *
  * Description:
- *	The C interface to Python module method get_errors_by_modid()
- *	for getting a list of errors based on module id.
+ *	Get a list of errors based on module id.
  *
  * Parameters:
  *	mod_id - string that represents the module id provided when
@@ -882,75 +715,21 @@ cleanup:
 err_info_list_t *
 es_get_errors_by_modid(char *mod_id)
 {
-	PyThreadState *myThreadState;
-	PyObject *pParamModId = NULL;
-	PyObject *pModule = NULL;
-	PyObject *pFunc = NULL;
-	PyObject *pRet = NULL;
-	err_info_list_t *return_list = NULL;
-
-	if (_initialize() != B_TRUE) {
-		return (NULL);
-	}
-
-	myThreadState = _start_threads();
-
-	/*
-	 * Prepare the params.
-	 * We have 1 parameters to pass into Python, a
-	 * string.
-	 */
-	pParamModId = PyString_FromString(mod_id);
-	if (pParamModId == NULL) {
-		_log_error(gettext("[%s] %s [%s] (String)\n"),
-		    ERRSVC_ID, ERR_INVAL_PARAM, GET_ERRORS_BY_MOD_ID);
-	}
-
-	if (pParamModId != NULL) {
-		pModule = _load_module(ERRSVC_PY_MOD);
-	}
-
-	if (pModule != NULL) {
-		pFunc = PyObject_GetAttrString(pModule, GET_ERRORS_BY_MOD_ID);
-	}
-
-	if (pFunc == NULL || ! PyCallable_Check(pFunc)) {
-		_log_error(gettext("[%s] %s [%s] (function)\n"),
-		    ERRSVC_ID, ERR_PY_FUNC, GET_ERRORS_BY_MOD_ID);
+	if (mod_id == NULL) {
+		_log_error(gettext("[%s] %s (mod_id)\n"),
+		    ERRSVC_ID, ERR_INVAL_PARAM);
 		es_errno = EINVAL;
-	} else {
-		/* Call Python function get_errors_by_modid */
-		pRet = PyObject_CallFunctionObjArgs(pFunc, pParamModId, NULL);
-		if (pRet == NULL) {
-			_log_error(gettext("[%s] %s [%s] (Call)\n"),
-			    ERRSVC_ID, ERR_PY_CALL, GET_ERRORS_BY_MOD_ID);
-			_es_py_assert(PyExc_ValueError);
-		}
-	}
-
-	if (PyErr_Occurred()) {
-		PyErr_Print();
+		return (NULL);
 	}
 
-	/* Convert returned Python List to a linked list of err_info_list_t */
-	return_list = _convert_pylist_to_err_info_list(pRet);
-
-	Py_XDECREF(pRet);
-	Py_XDECREF(pFunc);
-	Py_XDECREF(pModule);
-	Py_XDECREF(pParamModId);
-
-	_stop_threads(myThreadState);
-
-	return (return_list);
+	return (_es_select(mod_id, -1));
 }
 
 /*
  * Function: es_get_all_errors
  *
  * Description:
- *	The C interface to Python module method get_all_errors()
- *	for getting a list of all errors known to the error service.
+ *	Get a list of all errors known to the error service.
  *
  * Parameters:
  *	None
@@ -968,116 +747,56 @@ es_get_errors_by_modid(char *mod_id)
 err_info_list_t *
 es_get_all_errors()
 {
-	PyThreadState *myThreadState;
-	PyObject *pModule = NULL;
-	PyObject *pFunc = NULL;
-	PyObject *pRet = NULL;
-	err_info_list_t *return_list = NULL;
-
-	if (_initialize() != B_TRUE) {
-		return (NULL);
-	}
-
-	myThreadState = _start_threads();
-
-	pModule = _load_module(ERRSVC_PY_MOD);
-
-	if (pModule != NULL) {
-		pFunc = PyObject_GetAttrString(pModule, GET_ALL_ERRORS);
-	}
-
-	if (pFunc == NULL || ! PyCallable_Check(pFunc)) {
-		_log_error(gettext("[%s] %s [%s] (function)\n"),
-		    ERRSVC_ID, ERR_PY_FUNC, GET_ALL_ERRORS);
-	} else {
-		/* Call Python function get_all_errors */
-		pRet = PyObject_CallFunctionObjArgs(pFunc, NULL);
-
-		if (pRet == NULL) {
-			_log_error(gettext("[%s] %s [%s] (Call)\n"),
-			    ERRSVC_ID, ERR_PY_FUNC, GET_ALL_ERRORS);
-			es_errno = EINVAL;
-			_es_py_assert(PyExc_ValueError);
-		}
-	}
-
-	if (PyErr_Occurred()) {
-		PyErr_Print();
-	}
-
-	/* Convert returned Python List to a linked list of err_info_list_t */
-	return_list = _convert_pylist_to_err_info_list(pRet);
-
-	Py_XDECREF(pRet);
-	Py_XDECREF(pFunc);
-	Py_XDECREF(pModule);
-
-	_stop_threads(myThreadState);
-
-	return (return_list);
+	return (_es_select(NULL, -1));
 }
 
 /*
  * TODO: Move this function to the private function block
- * The C interface to Python function __dump_all_errors__.
+ * Dump a human readable version of all errors known to stdout.
  * (mainly for testing purposes)
  */
 boolean_t
 es__dump_all_errors__(void)
 {
-	PyThreadState *myThreadState;
-	PyObject *pModule = NULL;
-	PyObject *pFunc = NULL;
-	PyObject *pRet = NULL;
-	boolean_t retval = B_FALSE;
-
-	if (_initialize() != B_TRUE) {
-		return (retval);
-	}
-
-	myThreadState = _start_threads();
-
-	pModule = _load_module(ERRSVC_PY_MOD);
-
-	if (pModule != NULL) {
-		pFunc = PyObject_GetAttrString(pModule, DUMP_ALL_ERRORS_FUNC);
-	}
-
-	if (pFunc == NULL || ! PyCallable_Check(pFunc)) {
-		_log_error(gettext("[%s] %s [%s] (function)\n"),
-		    ERRSVC_ID, ERR_PY_FUNC, DUMP_ALL_ERRORS_FUNC);
-		es_errno = EINVAL;
-	} else {
-		/* Call Python function __dump_all_errors__ */
-		pRet = PyObject_CallFunctionObjArgs(pFunc, NULL);
-
-		if (pRet == NULL) {
-			_log_error(gettext("[%s] %s [%s] (Call)\n"),
-			    ERRSVC_ID, ERR_PY_CALL, DUMP_ALL_ERRORS_FUNC);
-			_es_py_assert(PyExc_ValueError);
-		} else {
-			retval = B_TRUE;
+	es_err_t	*ep;
+	int		type;
+
+	(void) pthread_mutex_lock(&es_lock);
+	if (es_head == NULL) {
+		(void) printf("No Errors\n");
+	}
+	for (ep = es_head; ep != NULL; ep = ep->ee_next) {
+		(void) printf("==================================\n");
+		(void) printf("Mod Id    = %s\n", ep->ee_mod_id);
+		(void) printf("Err Type  = %d\n", ep->ee_type);
+		(void) printf("Err Data  = \n");
+		for (type = 0; type < ES_DATA_NTYPES; type++) {
+			if (!(ep->ee_set & (1 << type))) {
+				continue;
+			}
+			(void) printf("    %s\n", ES_DUMP_RULE);
+			(void) printf("    elem_type  = %d\n", type);
+			if (type == ES_DATA_ERR_NUM) {
+				(void) printf("    error_value  = %d\n",
+				    ep->ee_num);
+			} else {
+				(void) printf("    error_value  = %s\n",
+				    ep->ee_str[type]);
+			}
+			(void) printf("    %s\n", ES_DUMP_RULE);
 		}
+		(void) printf("==================================\n");
 	}
+	(void) pthread_mutex_unlock(&es_lock);
+	(void) fflush(stdout);
 
-	if (PyErr_Occurred()) {
-		PyErr_Print();
-	}
-
-	Py_XDECREF(pRet);
-	Py_XDECREF(pFunc);
-	Py_XDECREF(pModule);
-
-	_stop_threads(myThreadState);
-
-	return (retval);
+	return (B_TRUE);
 }
 
 /*
  * Function:    es_get_errors_by_type
  *
- * Description: The C interface to Python module function
- *              get_errors_by_type. Returns a list of errors that
+ * Description: Returns a list of errors that
  *              have the given error_type. The list of errors should
  *              be freed using es_free_err_info_list when finished.
  *
@@ -1089,90 +808,37 @@ es__dump_all_errors__(void)
  *              On success, an err_info_list_t list of errors that are
  *              associated with the given error type.
  *
- *              On failure, returns NULL and sets the list_is_empty flag
- *		to true.
- *		The list_is_empty flag is used in order to distinguish
- *		between whether we returned NULL because no list
- *		existed or because there was a problem.
+ *              Otherwise returns NULL. The list_is_empty flag is set
+ *		to true if that is because no errors matched, to
+ *		distinguish this from a failure.
  * Scope: Public
  */
 err_info_list_t *
 es_get_errors_by_type(int err_type, boolean_t *list_is_empty)
 {
-	PyObject 	*pModule = NULL;
-	PyObject	*pFunc = NULL;
-	PyObject	*pRet = NULL;
-	PyThreadState	*myThreadState;
-	PyObject	*pParamErrType = NULL;
-	err_info_list_t	*return_list = NULL;
+	err_info_list_t	*return_list;
 
 	*list_is_empty = B_FALSE;
 
-	if (_initialize() != B_TRUE) {
-		return (return_list);
-	}
-
-	myThreadState = _start_threads();
-
-	pParamErrType = PyInt_FromLong((long)err_type);
-	pModule = _load_module(ERRSVC_PY_MOD);
-
-	if (pModule == NULL) {
-		goto cleanup;
-	}
-
-	/* Retrieve the attribute from the module */
-	pFunc = PyObject_GetAttrString(pModule, GET_ERRORS_BY_TYPE);
-
-	if (pFunc == NULL || ! PyCallable_Check(pFunc)) {
-		_log_error(gettext("[%s] %s [%s] (function)\n"),
-		    ERRSVC_ID, ERR_INVAL_PARAM, GET_ERRORS_BY_MOD_ID);
+	if (err_type < ES_ERR || err_type > ES_REPAIRED_ERR) {
+		_log_error(gettext("[%s] %s (err_type)\n"),
+		    ERRSVC_ID, ERR_INVAL_PARAM);
 		es_errno = EINVAL;
-		goto cleanup;
+		return (NULL);
 	}
 
-	/* Make the function call with the error type provided */
-	pRet = PyObject_CallFunctionObjArgs(pFunc, pParamErrType, NULL);
-
-	if (pRet != NULL) {
-		/*
-		 * Convert returned Python List to a linked list of
-		 * err_info_list_t
-		 */
-		return_list = _convert_pylist_to_err_info_list(pRet);
-	} else if (PyErr_Occurred()) {
-		_log_error(gettext("[%s] %s [%s] (Call)\n"),
-		    ERRSVC_ID, ERR_PY_CALL, GET_ERRORS_BY_TYPE);
-		es_errno = EINVAL;
-	} else {
-		/*
-		 * Fall through and cleanup
-		 */
+	return_list = _es_select(NULL, err_type);
+	if (return_list == NULL && es_errno == 0) {
 		*list_is_empty = B_TRUE;
 	}
 
-	/* Cleanup code, shared by both the success and failure path */
-cleanup:
-
-	if (PyErr_Occurred()) {
-		PyErr_Print();
-	}
-
-	Py_XDECREF(pRet);
-	Py_XDECREF(pFunc);
-	Py_XDECREF(pModule);
-	Py_XDECREF(pParamErrType);
-
-	_stop_threads(myThreadState);
-
 	return (return_list);
 }
 
 /*
  * Function:	es_get_err_type(err_info_t err)
  *
- * Description:	The C interface to Python class method ErrorInfo.get_error_type.
- * 		Queries the error information and returns the error type.
+ * Description:	Queries the error information and returns the error type.
  *
  * Parameters:  err_info_t - A structure containing information for
  *			     an error.
@@ -1188,61 +854,18 @@ cleanup:
 int
 es_get_err_type(err_info_t *err)
 {
-	PyObject	*pMethod = NULL;
-	PyObject	*pRet = NULL;
-	PyThreadState	*myThreadState;
+	es_err_t	*ep;
 	int		retvalue = -1;
-	long		py_retval;
 
 	es_errno = 0;
 
 	if (err == NULL)
 		return (retvalue);
 
-	if (_initialize() != B_TRUE)
-		return (retvalue);
-
-	myThreadState = _start_threads();
-
-	if (! PyObject_HasAttrString((PyObject *)err, GET_ERR_TYPE)) {
-		_log_error(gettext("[%s] %s [%s] (attribute)\n"),
-		    ERRSVC_ID, ERR_INVAL_PARAM, GET_ERR_TYPE);
-		es_errno = EINVAL;
-		goto cleanup;
-	}
-
-	/* Load the python module containing the module functions */
-	pMethod = PyString_FromString(GET_ERR_TYPE);
-	if (pMethod == NULL) {
-		_log_error(gettext("[%s] %s [%s] (String)\n"),
-		    ERRSVC_ID, ERR_PY_FUNC, GET_ERR_TYPE);
-		goto cleanup;
-	}
-
-	/* Make the Call to the Python method */
-	pRet = PyObject_CallMethodObjArgs((PyObject *)err, pMethod, NULL);
-
-	if (pRet == NULL || !PyInt_Check(pRet)) {
-		_log_error(gettext("[%s] %s [%s] (Call)\n"),
-		    ERRSVC_ID, ERR_PY_CALL, GET_ERR_TYPE);
-		goto cleanup;
-	}
-
-	/* Convert the Python integer object back into a C int */
-	py_retval = PyInt_AsLong(pRet);
-	if (py_retval != -1 && !PyErr_Occurred())
-		retvalue = (int)py_retval;
-
-	/* Cleanup that is shared by both the success and failure paths */
-cleanup:
-	if (PyErr_Occurred()) {
-		PyErr_Print();
-	}
-
-	Py_XDECREF(pRet);
-	Py_XDECREF(pMethod);
-
-	_stop_threads(myThreadState);
+	(void) pthread_mutex_lock(&es_lock);
+	if ((ep = _es_lookup(err)) != NULL)
+		retvalue = ep->ee_type;
+	(void) pthread_mutex_unlock(&es_lock);
 
 	return (retvalue);
 }
@@ -1250,15 +873,15 @@ cleanup:
 /*
  * Function:    es_get_err_mod_id
  *
- * Description:	The C interface to Python class method ErrorInfo.get_mod_id.
- *		Queries the error information and returns the
+ * Description:	Queries the error information and returns the
  *		returns the mod id string.
  *
  * Parameters:  err - A structure containing information for
  *		      an error.
  *
  * Return:
- *		On success, returns a module id string.
+ *		On success, returns a module id string. The consumer
+ *		must free the memory with free() when finished.
  *
  *		On failure, returns NULL
  * Scope:
@@ -1267,63 +890,24 @@ cleanup:
 char *
 es_get_err_mod_id(err_info_t *err)
 {
-	PyObject	*pMethod = NULL;
-	PyObject	*pRet = NULL;
-	PyThreadState	*myThreadState;
+	es_err_t	*ep;
 	char		*retval = NULL;
 
 	es_errno = 0;
-	errno = 0;
 
 	if (err == NULL)
 		return (retval);
 
-	if (_initialize() != B_TRUE)
-		return (NULL);
-
-	myThreadState = _start_threads();
-
-	if (!PyObject_HasAttrString((PyObject *)err, GET_MOD_ID)) {
-		_log_error(gettext("[%s] %s [%s] (attribute)\n"),
-		    ERRSVC_ID, ERR_INVAL_PARAM, GET_MOD_ID);
-		es_errno = EINVAL;
-		goto cleanup;
-	}
-	pMethod = PyString_FromString(GET_MOD_ID);
-	if (pMethod == NULL) {
-		_log_error(gettext("[%s] %s [%s] (String)\n"),
-		    ERRSVC_ID, ERR_PY_FUNC, GET_MOD_ID);
-		goto cleanup;
-	}
-
-	/* Make the call to the Python method */
-	pRet = PyObject_CallMethodObjArgs((PyObject *)err, pMethod, NULL);
-
-	/* Check to see if the Python call failed to return a string */
-	if (PyString_Check(pRet)) {
-		int err_num = 0;
-		retval = strdup(PyString_AsString(pRet));
-		err_num = errno;
-		if (retval == NULL) {
-			es_errno = err_num;
-			_es_lib_assert();
-		}
-	} else {
-		_es_py_assert(PyExc_ValueError);
-	}
-
-
-	/* Cleanup that is shared by both the success and failure path */
-cleanup:
-
-	if (PyErr_Occurred()) {
-		PyErr_Print();
+	(void) pthread_mutex_lock(&es_lock);
+	if ((ep = _es_lookup(err)) != NULL) {
+		retval = strdup(ep->ee_mod_id);
+		if (retval == NULL)
+			es_errno = ENOMEM;
 	}
+	(void) pthread_mutex_unlock(&es_lock);
 
-	Py_XDECREF(pRet);
-	Py_XDECREF(pMethod);
-
-	_stop_threads(myThreadState);
+	if (ep != NULL && retval == NULL)
+		_es_lib_assert();
 
 	return (retval);
 }
@@ -1331,10 +915,8 @@ cleanup:
 /*
  * Function:    es_get_err_data_int_by_type
  *
- * Description: The C interface to the Python class method
- *              ErrorInfo.get_error_data_by_type. Queries the error
- *              information and returns the error integer based on the
- *              element type.
+ * Description: Queries the error information and returns the error
+ *              integer based on the element type.
  *
  * Parameters:  err             - A structure containing information for
  *				  an error.
@@ -1347,18 +929,15 @@ cleanup:
  *                              On success, populates err_int with an error
  *				integer number and returns B_TRUE.
  *
- *                              On failure, returns B_FALSE.
+ *                              On failure, or if no such data has been
+ *				set, returns B_FALSE.
  * Scope:
  *	Public
  */
 boolean_t
 es_get_err_data_int_by_type(err_info_t *err, int elem_type, int *err_int)
 {
-	PyThreadState	*myThreadState;
-	PyObject	*pMethod = NULL;
-	PyObject	*pElemType = NULL;
-	PyObject	*pErrInt = NULL;
-	int		pRetVal;
+	es_err_t	*ep;
 	boolean_t	retval = B_FALSE;
 
 	es_errno = 0;
@@ -1368,61 +947,16 @@ es_get_err_data_int_by_type(err_info_t *err, int elem_type, int *err_int)
 		return (retval);
 	}
 
-	if (_initialize() != B_TRUE)
+	if (!_es_valid_data(elem_type, B_TRUE))
 		return (retval);
 
-	myThreadState = _start_threads();
-
-	pElemType = PyInt_FromLong((long)elem_type);
-
-	if (!PyObject_HasAttrString((PyObject *)err, GET_ERR_DATA_BY_TYPE)) {
-		_log_error(gettext("[%s] %s [%s] (attribute)\n"), ERRSVC_ID,
-		    ERR_INVAL_PARAM, GET_ERR_DATA_BY_TYPE);
-		es_errno = EINVAL;
-		goto cleanup;
-	}
-	pMethod = PyString_FromString(GET_ERR_DATA_BY_TYPE);
-	if (pMethod == NULL) {
-			_log_error(gettext("[%s] %s [%s] (String)\n"),
-			    ERRSVC_ID, ERR_PY_FUNC, GET_ERR_DATA_BY_TYPE);
-		es_errno = EINVAL;
-		goto cleanup;
-	}
-
-	/* Make the Call to the Python method */
-	pErrInt = PyObject_CallMethodObjArgs((PyObject *)err, pMethod,
-	    pElemType, NULL);
-
-	/* Check to see if the Python call failed to return an integer */
-	if (pErrInt == NULL) {
-		_log_error(gettext("[%s] %s [%s] (Call)\n"),
-		    ERRSVC_ID, ERR_PY_CALL, GET_ERR_DATA_BY_TYPE);
-		es_errno = EINVAL;
-		_es_py_assert(PyExc_ValueError);
-		goto cleanup;
-	}
-	if (PyInt_Check(pErrInt)) {
-
-		/* Convert the Python integer object back into a C int */
-		pRetVal = PyInt_AsLong(pErrInt);
-		if (!PyErr_Occurred()) {
-			*err_int = (int)pRetVal;
-			retval = B_TRUE;
-		}
-	}
-
-	/* Cleanup that is shared by both the success and failure paths */
-cleanup:
-
-	if (PyErr_Occurred()) {
-		PyErr_Print();
+	(void) pthread_mutex_lock(&es_lock);
+	if ((ep = _es_lookup(err)) != NULL &&
+	    (ep->ee_set & (1 << elem_type))) {
+		*err_int = ep->ee_num;
+		retval = B_TRUE;
 	}
-
-	Py_XDECREF(pElemType);
-	Py_XDECREF(pErrInt);
-	Py_XDECREF(pMethod);
-
-	_stop_threads(myThreadState);
+	(void) pthread_mutex_unlock(&es_lock);
 
 	return (retval);
 }
@@ -1430,10 +964,8 @@ cleanup:
 /*
  * Function:    es_get_err_data_str_by_type
  *
- * Description:	The C interface to Python class method
- *		ErrorInfo.get_error_data_by_type.
- *		Queries the error information and returns the error
- *		data number based on the element type.
+ * Description:	Queries the error information and returns the error
+ *		data string based on the element type.
  *
  * Parameters:	err             -A structure containing information for
  *                               an error.
@@ -1444,7 +976,7 @@ cleanup:
  *		The consumer must free the memory with free() when finished.
  *		Returns B_TRUE.
  *
- *		On failure, returns B_FALSE.
+ *		On failure, or if no such data has been set, returns B_FALSE.
  *
  * Scope:
  *	Public
@@ -1452,81 +984,29 @@ cleanup:
 boolean_t
 es_get_err_data_str_by_type(err_info_t *err, int elem_type, char **err_str)
 {
-	PyThreadState	*myThreadState;
-	PyObject	*pMethod = NULL;
-	PyObject	*pElemType = NULL;
-	PyObject	*pErrStr = NULL;
+	es_err_t	*ep;
 	boolean_t	retval = B_FALSE;
-	int		err_num = 0;
 
-	errno = 0;
 	es_errno = 0;
 
-
 	if (err == NULL) {
 		es_errno = EINVAL;
 		return (retval);
 	}
 
-	if (_initialize() != B_TRUE)
+	if (!_es_valid_data(elem_type, B_FALSE))
 		return (retval);
 
-	myThreadState = _start_threads();
-
-	pElemType = PyInt_FromLong((long)elem_type);
-
-	if (! PyObject_HasAttrString((PyObject *)err, GET_ERR_DATA_BY_TYPE)) {
-		_log_error(gettext("[%s] %s [%s] (attribute)\n"), ERRSVC_ID,
-		    ERR_INVAL_PARAM, GET_ERR_DATA_BY_TYPE);
-		es_errno = EINVAL;
-		goto cleanup;
-	}
-	pMethod = PyString_FromString(GET_ERR_DATA_BY_TYPE);
-	if (pMethod == NULL) {
-		_log_error(gettext("[%s] %s [%s] (String)\n"),
-		    ERRSVC_ID, ERR_PY_FUNC, GET_ERR_DATA_BY_TYPE);
-		es_errno = EINVAL;
-		goto cleanup;
-	}
-
-	/* Make the call to the Python method */
-	pErrStr = PyObject_CallMethodObjArgs((PyObject *)err, pMethod,
-	    pElemType, NULL);
-
-	/* Check to see if the Python call failed to return a string */
-	if (pErrStr == NULL) {
-		_log_error(gettext("[%s] %s [%s] (Call)\n"), ERRSVC_ID,
-		    ERR_PY_CALL, GET_ERR_DATA_BY_TYPE);
-		es_errno = EINVAL;
-		_es_py_assert(PyExc_ValueError);
-		goto cleanup;
-	}
-
-	if (PyString_Check(pErrStr)) {
-		/*
-		 * if pErrStr is not NULL but it also not a String
-		 * (eg it's None) then do nothing and return B_FALSE
-		 */
-		*err_str = strdup(PyString_AsString(pErrStr));
-		err_num = errno;
-		if (err_str != NULL)
+	(void) pthread_mutex_lock(&es_lock);
+	if ((ep = _es_lookup(err)) != NULL &&
+	    (ep->ee_set & (1 << elem_type))) {
+		*err_str = strdup(ep->ee_str[elem_type]);
+		if (*err_str != NULL)
 			retval = B_TRUE;
 		else
-			es_errno = err_num;
+			es_errno = ENOMEM;
 	}
-
-	/* Cleanup that is shared by both the success and failure path */
-cleanup:
-
-	if (PyErr_Occurred()) {
-		PyErr_Print();
-	}
-
-	Py_XDECREF(pElemType);
-	Py_XDECREF(pErrStr);
-	Py_XDECREF(pMethod);
-
-	_stop_threads(myThreadState);
+	(void) pthread_mutex_unlock(&es_lock);
 
 	return (retval);
 }
@@ -26,13 +26,9 @@
 
 #include <stdio.h>
 #include <string.h>
-#include <Python.h>
 
 #include "../liberrsvc.h"
 
-#define	REFCOUNT(o) (((PyObject *)o)->ob_refcnt)
-
-
 /*
  * Test 6: es_free_err_info_list
  */
@@ -42,10 +38,7 @@ test6(void)
 	boolean_t	retval = B_FALSE;
 	err_info_t	*rv1 = NULL;
 	err_info_t	*rv2 = NULL;
-	int		start_refcnt_1;
 	err_info_list_t *list;
-	err_info_list_t *item;
-	int		count;
 
 	printf("\nTest 6: es_free_err_info_list\n");
 	rv1 = es_create_err_info("TD", ES_ERR);
@@ -59,40 +52,30 @@ test6(void)
 	}
 
 	if (rv2 != NULL) {
-		/*
-		 * The reference count returned is typically 1 higher than
-		 * expected, due to iternal Python issues.
-		 * For testing purposes, we will just confirm that the
-		 * ref. count is correctly adjusted relative to the
-		 * starting value.
-		 */
-		start_refcnt_1 = REFCOUNT(rv1);
-
-		count = 0;
-
 		list = es_get_all_errors();
 
 		/*
-		 * Confirm that calling es_get_all_errors increments by 1 the
-		 * reference count of an ErrorInfo object in the returned list.
+		 * Confirm that es_get_all_errors returns the errors in
+		 * the order they were created.
 		 */
-		if (REFCOUNT(rv1) != (start_refcnt_1 + 1)) {
+		if (list == NULL || list->ei_err_info != rv1 ||
+		    list->ei_next == NULL ||
+		    list->ei_next->ei_err_info != rv2 ||
+		    list->ei_next->ei_next != NULL) {
 			printf("test FAILED\n");
-			printf("ref count = [%d], should be [%d]\n",
-			    REFCOUNT(rv1), (start_refcnt_1 + 1));
+			printf("list does not hold the errors created\n");
 			es_free_err_info_list(list);
 		} else {
 			es_free_err_info_list(list);
 
 			/*
 			 * Confirm that calling es_free_err_info_list
-			 * decrements by 1 the ref count for an ErrorInfo
-			 * object in the freed list.
+			 * leaves the errors in the freed list intact.
 			 */
-			if (REFCOUNT(rv1) != start_refcnt_1) {
+			if (es_get_err_type(rv1) != ES_ERR ||
+			    es_get_err_type(rv2) != ES_CLEANUP_ERR) {
 				printf("test FAILED\n");
-				printf("ref count = [%d], should be [%d]\n",
-				    REFCOUNT(rv1), start_refcnt_1);
+				printf("error freed along with the list\n");
 			} else {
 				printf("test PASSED\n");
 				retval = B_TRUE;
@@ -26,12 +26,27 @@
 
 #include <stdio.h>
 #include <string.h>
-#include <Python.h>
 
 #include "../liberrsvc.h"
 
-#define	REFCOUNT(o) (((PyObject *)o)->ob_refcnt)
+/*
+ * Count the errors currently known to the error service.
+ */
+static int
+count_errors(void)
+{
+	err_info_list_t *list = NULL;
+	err_info_list_t *item = NULL;
+	int		count = 0;
+
+	list = es_get_all_errors();
+	for (item = list; item != NULL; item = item->ei_next) {
+		count++;
+	}
+	es_free_err_info_list(list);
 
+	return (count);
+}
 
 /*
  * Test 5: es_free_errors
@@ -42,9 +57,6 @@ test5(void)
 	boolean_t	retval = B_FALSE;
 	err_info_t	*rv1 = NULL;
 	err_info_t	*rv2 = NULL;
-	int		start_refcnt_1;
-	err_info_list_t *list = NULL;
-	err_info_list_t *item = NULL;
 	int		count = 0;
 
 	printf("\nTest 5: es_free_errors\n");
@@ -59,67 +71,25 @@ test5(void)
 	}
 
 	if (rv2 != NULL) {
-		/*
-		 * The reference count returned is typically 1 higher than
-		 * expected, due to iternal Python issues.
-		 * For testing purposes, we will just confirm that the
-		 * ref. count is correctly adjusted relative to the
-		 * starting value.
-		 */
-		start_refcnt_1 = REFCOUNT(rv1);
-
-		count = 0;
-
-		list = es_get_all_errors();
-		if (REFCOUNT(rv1) != (start_refcnt_1 + 1)) {
+		count = count_errors();
+		if (count != 2) {
 			printf("test FAILED\n");
-			printf("ref count = [%d], should be [%d]\n",
-			    REFCOUNT(rv1), (start_refcnt_1 + 1));
-			es_free_err_info_list(list);
+			printf("count = [%d], should be [%d]\n", count, 2);
 		} else {
-			es_free_err_info_list(list);
-
-			if (REFCOUNT(rv1) != start_refcnt_1) {
+			es_free_errors();
+
+			/*
+			 * Confirm that after calling es_free_errors
+			 * there are no errors in the global list.
+			 */
+			count = count_errors();
+			if (count != 0) {
 				printf("test FAILED\n");
-				printf("ref count = [%d], should be [%d]\n",
-				    REFCOUNT(rv1), start_refcnt_1);
+				printf("count = [%d], should be [%d]\n",
+				    count, 0);
 			} else {
-				es_free_errors();
-
-				/*
-				 * Confirm that calling es_free_errors
-				 * decrements to 0 the reference count of
-				 * an ErrorInfo object.
-				 */
-				if (REFCOUNT(rv1) != 0) {
-					printf("test FAILED\n");
-					printf("ref count = [%d], should be "
-					    "[%d]\n", REFCOUNT(rv1), 0);
-				} else {
-					/*
-					 * Confirm that after calling
-					 * es_free_errors there are no
-					 * ErrorInfo objects in the global
-					 * list.
-					 */
-					count = 0;
-					list = es_get_all_errors();
-					item = list;
-
-					while (item != NULL) {
-						count++;
-						item = item->ei_next;
-					}
-
-					if (count != 0) {
-						printf("test FAILED\n");
-					} else {
-						printf("test PASSED\n");
-						retval = B_TRUE;
-					}
-
-					es_free_err_info_list(list);
-				}
+				printf("test PASSED\n");
+				retval = B_TRUE;
 			}
 		}
 	}
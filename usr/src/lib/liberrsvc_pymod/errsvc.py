@@ -21,7 +21,14 @@
 
 # Copyright 2010 Sun Microsystems, Inc.  All rights reserved.
 # Use is subject to license terms.
-''' CUD Error Handler Library and Object Types '''
+''' CUD Error Handler Library and Object Types
+
+The errors themselves are kept by the native error service in liberrsvc,
+so errors recorded from C and from Python share one store.  This module
+is a thin binding over it.
+'''
+
+import sys
 
 import liberrsvc
 
@@ -36,9 +43,13 @@ STRING_DATA_TYPES = [liberrsvc.ES_DATA_OP_STR, \
     liberrsvc.ES_DATA_FAILED_AT, \
     liberrsvc.ES_DATA_FAILED_STR]
 
-# Declare the list to store the errors.
-# @type _ERRORS list
-_ERRORS = []
+# Bumped each time the error list is cleared.  ErrorInfo objects from an
+# earlier generation no longer refer to an error in the error service.
+# liberrsvc itself rejects handles to errors it has freed, whoever
+# cleared them; this only adds a clear message, and catches an old handle
+# whose memory has been reused for a new error, for clears made here.
+# @type _GENERATION int
+_GENERATION = 0
 
 class ErrorInfo(object):
     """
@@ -59,10 +70,33 @@ class ErrorInfo(object):
             raise ValueError, "Invalid mod_id parameter: [%s]" % mod_id
         self._mod_id = mod_id
         self._error_type = error_type
-        # use a simple dictionary for the data
-        self.error_data = {}
-        # append this object to the internal list of errors
-        _ERRORS.append(self)
+        self._generation = _GENERATION
+        # record the error with the error service
+        self._handle = liberrsvc.es_create_err_info(mod_id, error_type)
+        if (self._handle is None):
+            raise RuntimeError, "Unable to create ErrorInfo: [%s]" % \
+                  liberrsvc.es_get_failure_reason_str()
+
+    @classmethod
+    def _from_handle(cls, handle):
+        """ Wrap an error already known to the error service """
+        err = cls.__new__(cls)
+        err._handle = handle
+        err._generation = _GENERATION
+        err._mod_id = liberrsvc.es_get_err_mod_id(handle)
+        err._error_type = liberrsvc.es_get_err_type(handle)
+        return err
+
+    def _get_handle(self):
+        """
+        Return the handle to this error in the error service.
+        Raises:
+          RuntimeError if the error list was cleared since it was created
+        """
+        if (self._generation != _GENERATION):
+            raise RuntimeError, "ErrorInfo no longer in the error " \
+                  "service: [%s]" % self._mod_id
+        return self._handle
 
     def get_mod_id(self):
         """ Return the module id string """
@@ -74,8 +108,7 @@ class ErrorInfo(object):
 
     def set_error_data(self, error_data_type, error_value):
         """
-        Add some error data to the ErrorInfo, by putting it in the
-        error_data dictionary.
+        Add some error data to the ErrorInfo.
         The error_value param must be of the correct object type
         relating to error_data_type.
         Raises:
@@ -88,34 +121,46 @@ class ErrorInfo(object):
                 raise RuntimeError, \
                       "Invalid integer for ErrorInfo data: [%s]" % \
                       error_value
+            ret = liberrsvc.es_set_err_data_int(self._get_handle(),
+                error_data_type, error_value)
         elif (error_data_type in STRING_DATA_TYPES):
             if (not isinstance(error_value, str)):
                 raise RuntimeError, \
                       "Invalid string for ErrorInfo data: [%s]" % \
                       error_value
+            ret = liberrsvc.es_py_set_err_data_str(self._get_handle(),
+                error_data_type, error_value)
         else:
             raise ValueError, "Invalid error_data_type parameter: [%s]" % \
                   error_data_type
 
-        self.error_data[error_data_type] = error_value
+        return ret
 
     def get_error_data_by_type(self, error_data_type):
         """ Get the error data value for the given data type """
-        if (error_data_type in self.error_data):
-            return self.error_data[error_data_type]
-        else:
-            return None
+        return liberrsvc.es_py_get_err_data(self._get_handle(),
+            error_data_type)
+
+    def get_error_data(self):
+        """ Return a dictionary of the error data set, keyed by type """
+        error_data = {}
+        for key in INTEGER_DATA_TYPES + STRING_DATA_TYPES:
+            value = self.get_error_data_by_type(key)
+            if (value is not None):
+                error_data[key] = value
+        return error_data
 
     def __str__(self):
         """Provide a human-readable version of this object."""
+        error_data = self.error_data
         ret_str =  "==================================\n"
         ret_str += "Mod Id    = %s\n" % self._mod_id
         ret_str += "Err Type  = %d\n" % self._error_type
         ret_str += "Err Data  = \n"
-        for key in self.error_data.keys():
+        for key in error_data.keys():
             ret_str +=  "    ---------------------------------\n"
             ret_str += "    elem_type  = %s\n" % key
-            ret_str += "    error_value  = %s\n" % self.error_data[key]
+            ret_str += "    error_value  = %s\n" % error_data[key]
             ret_str += "    ---------------------------------\n"
         ret_str += "==================================\n"
         return ret_str
@@ -127,53 +172,62 @@ class ErrorInfo(object):
     # get_error_type()
     error_type = property(get_error_type)
 
-# The best way to implement a Singleton in Python is to simply use the
-# module it self, with function definitions, since it's the only way to
-# absolutely ensure that there is 1, and only 1, instance if the data.
+    # error_data is a read-only property whose getter function is
+    # get_error_data()
+    error_data = property(get_error_data)
+
+# The error service itself is a singleton kept by liberrsvc; these
+# module functions are the Python interface to it.
+
+def _to_error_list(err_list):
+    """
+    Convert an err_info_list_t returned by liberrsvc to a list of
+    ErrorInfo objects, and free it.
+    """
+    errors = []
+    item = err_list
+    while (item is not None):
+        errors.append(ErrorInfo._from_handle(item.ei_err_info))
+        item = item.ei_next
+    if (err_list is not None):
+        liberrsvc.es_free_err_info_list(err_list)
+    return errors
 
 def get_all_errors():
     """
     Get a list of all the ErrorInfo objs currently known to the error service.
     """
-    return _ERRORS
+    return _to_error_list(liberrsvc.es_get_all_errors())
 
 def clear_error_list():
     """
     Clear the current list of errors in the error service.
     """
     # pylint: disable-msg=W0603
-    global _ERRORS
-    _ERRORS = []
+    global _GENERATION
+    liberrsvc.es_free_errors()
+    _GENERATION += 1
 
 def get_errors_by_type(error_type):
     """
     Returns a list of ErrorInfo objects that have the given error_type
     """
-    new_list = []
-    for elem in _ERRORS:
-        if (elem.error_type == error_type):
-            new_list.append(elem)
-    return new_list
+    if (error_type not in VALID_ERROR_TYPES):
+        return []
+    return _to_error_list(liberrsvc.es_get_errors_by_type(error_type))
 
 def get_errors_by_mod_id(mod_id):
     """
     Returns a list of ErrorInfo objects that have the given module id.
     """
-    new_list = []
-    for elem in _ERRORS:
-        if (elem.mod_id == mod_id):
-            new_list.append(elem)
-    return new_list
+    if (not isinstance(mod_id, str)):
+        return []
+    return _to_error_list(liberrsvc.es_get_errors_by_modid(mod_id))
 
 def __dump_all_errors__():
     """ Dump to stdout a human readable version of all errors known """
-    errs = get_all_errors()
-    # @type errs list
-    if (errs):
-        for err in errs:
-            print err
-    else:
-        print "No Errors"
+    sys.stdout.flush()
+    liberrsvc.es__dump_all_errors__()
 
 if __name__ == "__main__":
     # Create some ErrorInfo, and dump it.
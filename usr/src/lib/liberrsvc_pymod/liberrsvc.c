@@ -24,4 +24,75 @@
  * Use is subject to license terms.
  */
 
-#include "../liberrsvc/liberrsvc_defs.h"
+/*
+ * Helpers for the Python binding to the error service that do not map
+ * directly onto the C interface. See liberrsvc.i.
+ */
+
+#include <Python.h>
+#include <stdlib.h>
+#include "../liberrsvc/liberrsvc.h"
+
+/*
+ * Function: es_py_set_err_data_str
+ *
+ * Description: Set string data for an error. Unlike es_set_err_data_str()
+ *		the string is stored as given, never used as a format.
+ *
+ * Parameters:
+ *	err - an error handle, as returned from es_create_err_info().
+ *	type - The error data element type
+ *	str - The string to be stored for this element type.
+ *
+ * Returns:
+ *	B_TRUE on Success
+ *	B_FALSE on Failure
+ *
+ * Scope: Public
+ */
+boolean_t
+es_py_set_err_data_str(err_info_t *err, int type, char *str)
+{
+	if (str == NULL) {
+		return (B_FALSE);
+	}
+
+	return (es_set_err_data_str(err, type, "%s", str));
+}
+
+/*
+ * Function: es_py_get_err_data
+ *
+ * Description: Return the data of the given type set for an error as
+ *		a Python int or string.
+ *
+ * Parameters:
+ *	err - an error handle, as returned from es_create_err_info().
+ *	type - The error data element type
+ *
+ * Returns:
+ *	A new reference to the value on Success
+ *	None if no data of that type has been set
+ *
+ * Scope: Public
+ */
+PyObject *
+es_py_get_err_data(err_info_t *err, int type)
+{
+	PyObject	*pRet;
+	char		*str = NULL;
+	int		val;
+
+	if (type == ES_DATA_ERR_NUM) {
+		if (es_get_err_data_int_by_type(err, type, &val)) {
+			return (PyInt_FromLong((long)val));
+		}
+	} else if (es_get_err_data_str_by_type(err, type, &str)) {
+		pRet = PyString_FromString(str);
+		free(str);
+		return (pRet);
+	}
+
+	Py_INCREF(Py_None);
+	return (Py_None);
+}
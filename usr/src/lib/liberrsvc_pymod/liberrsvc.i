@@ -1,7 +1,33 @@
 // liberrsvc.i
 %module liberrsvc
 %{
-#include "../liberrsvc/liberrsvc_defs.h"
+#include "../liberrsvc/liberrsvc.h"
+#include "../liberrsvc/liberrsvc_priv.h"
+
+extern boolean_t es_py_set_err_data_str(err_info_t *, int, char *);
+extern PyObject *es_py_get_err_data(err_info_t *, int);
 %}
 
+// boolean_t comes from <sys/types.h>, which SWIG does not read
+typedef int boolean_t;
+
+// The list_is_empty flag of es_get_errors_by_type() is of no use to Python
+%typemap(in, numinputs=0) boolean_t * (boolean_t tmp) {
+	$1 = &tmp;
+}
+
+// The caller frees the module id returned
+%newobject es_get_err_mod_id;
+
+// Strings from Python are never used as a format, and error data is read
+// back as a Python object, so these go through the helpers in liberrsvc.c
+%ignore es_set_err_data_str;
+%ignore es_get_err_data_int_by_type;
+%ignore es_get_err_data_str_by_type;
+
 %include "../liberrsvc/liberrsvc_defs.h"
+%include "../liberrsvc/liberrsvc.h"
+
+boolean_t es__dump_all_errors__(void);
+boolean_t es_py_set_err_data_str(err_info_t *, int, char *);
+PyObject *es_py_get_err_data(err_info_t *, int);
@@ -150,6 +150,24 @@ class error_info(unittest.TestCase):
         err_value = self.test_error.get_error_data_by_type(self.err_data_type)
 
         self.assertEqual(err_value, self.error_value)
+
+    def test_error_data_verbatim(self):
+        '''Testing: string error data is not used as a format.'''
+
+        value = '100% of %s failed'
+        self.test_error.set_error_data(self.err_data_type, value)
+        err_value = self.test_error.get_error_data_by_type(self.err_data_type)
+
+        self.assertEqual(err_value, value)
+
+    def test_cleared_error(self):
+        '''Testing: ErrorInfo is unusable after clear_error_list().'''
+
+        errsvc.clear_error_list()
+
+        self.assertEqual(self.test_error.get_mod_id(), self.mod_id)
+        self.assertRaises(RuntimeError, self.test_error.set_error_data,
+                          self.err_data_type, self.error_value)
  
 
 if __name__ == "__main__":
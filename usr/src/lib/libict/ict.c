@@ -192,10 +192,6 @@ static void
 ict_debug_print(ls_dbglvl_t dbg_lvl, char *fmt, ...)
 {
 	va_list	ap;
-	char	buf[MAXPATHLEN + 1] = "";
-
-	va_start(ap, fmt);
-	(void) vsprintf(buf, fmt, ap);
 
 	/*
 	 * When dbg_lvl is error this will force the message to start
@@ -205,7 +201,8 @@ ict_debug_print(ls_dbglvl_t dbg_lvl, char *fmt, ...)
 		(void) ls_write_dbg_message("", ICT_DBGLVL_INFO, "");
 	}
 
-	(void) ls_write_dbg_message("ICT", dbg_lvl, buf);
+	va_start(ap, fmt);
+	ls_write_dbg_vmessage("ICT", dbg_lvl, fmt, ap);
 	va_end(ap);
 } /* END ict_debug_print() */
 
@@ -30,6 +30,8 @@
  * This header file is for users of the Debugging/Logging library
  */
 
+#include <sys/time.h>
+#include <stdarg.h>
 #include <libnvpair.h>
 
 #ifdef __cplusplus
@@ -44,6 +46,8 @@ typedef enum {
 	LS_E_SUCCESS = 0,	/* command succeeded */
 	LS_E_NOMEM,		/* memory allocation failed */
 	LS_E_LOG_TRANSFER_FAILED,	/* couldn't transfer log file */
+	LS_E_TRACE_FAILED,	/* couldn't create trace file */
+	LS_E_TIMELINE_FAILED,	/* couldn't write install timeline */
 	LS_E_INVAL = -1		/* input parameter invalid */
 } ls_errno_t;
 
@@ -126,6 +130,24 @@ void ls_register_dbg_method(ls_dbg_method_t func);
 /* timestamp */
 #define	LS_ATTR_TIMESTAMP	"ls_timestamp"
 
+/*
+ * asynchronous posting - messages are queued and posted in batches
+ * by a separate thread, see ls_flush()
+ */
+#define	LS_ATTR_ASYNC		"ls_async"
+
+/*
+ * binary trace file - debug messages are recorded unformatted into
+ * the file, see ls_trace_dbg_method() and ls_trace_decode(1)
+ */
+#define	LS_ATTR_TRACE_FILE	"ls_trace_file"
+
+/*
+ * install timeline file - spans recorded by ls_span_end() are written
+ * there in Chrome trace event format, see ls_timeline_write()
+ */
+#define	LS_ATTR_TIMELINE_FILE	"ls_timeline_file"
+
 /* destination log file path */
 #define	LS_LOGFILE_DST_PATH	"/var/sadm/system/logs/"
 
@@ -139,6 +161,32 @@ void ls_write_log_message(const char *id, const char *fmt, ...);
 void ls_write_dbg_message(const char *id, ls_dbglvl_t level,
     const char *fmt, ...);
 
+/*
+ * post debug message given by format and argument list, for wrappers of
+ * ls_write_dbg_message() - the format is recorded once in binary trace
+ */
+void ls_write_dbg_vmessage(const char *id, ls_dbglvl_t level,
+    const char *fmt, va_list ap);
+
+/* wait until messages queued in asynchronous mode are posted */
+void ls_flush(void);
+
+/* debugging method recording messages into binary trace file */
+void ls_trace_dbg_method(const char *id, ls_dbglvl_t level, char *msg);
+
+/* mark beginning of install timeline span */
+hrtime_t ls_span_begin(void);
+
+/* record install timeline span started by ls_span_begin() */
+void ls_span_end(hrtime_t start, const char *cat, const char *name,
+    const char *detail);
+
+/* write install timeline, NULL path for the configured file */
+ls_errno_t ls_timeline_write(const char *path);
+
+/* log time spent in install timeline spans */
+void ls_timeline_summary(const char *id);
+
 /*
  * log to either stdout, stderr, or both, logfile
  */
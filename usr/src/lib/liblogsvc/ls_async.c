@@ -0,0 +1,398 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * Asynchronous posting of messages
+ *
+ * In asynchronous mode (LS_ATTR_ASYNC, LS_ASYNC environment variable)
+ * ls_dbg_method_default() only queues the message with its time stamp.
+ * Flusher thread formats queued messages and posts them in batches, so
+ * that threads logging a lot don't wait for write(2) of every message.
+ *
+ * Messages are queued in a bounded ring of fixed size slots shared by
+ * any number of posting threads and the flusher. A posting thread
+ * claims a slot by advancing ls_ring_head with compare-and-swap and
+ * publishes the message by setting sequence number of the slot, so
+ * posting threads don't take any lock. The flusher hands the slot back
+ * by setting its sequence number for the next round of the ring. Only
+ * if the ring is full, the posting thread waits for the flusher.
+ *
+ * Errors, ls_flush(), ls_transfer() and exit(3C) wait until all queued
+ * messages are posted.
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <atomic.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include <ls_api.h>
+#include "ls_private.h"
+
+/* number of slots in the ring, has to be power of 2 */
+#define	LS_RING_SLOTS		512
+
+/* how often the flusher posts queued messages (ms) */
+#define	LS_FLUSH_INTERVAL	200
+
+/* how long to wait for the flusher before waking it up again (ms) */
+#define	LS_FLUSH_WAIT		10
+
+/* size of buffer for batch of formatted messages */
+#define	LS_BATCH_SIZE		(64 * 1024)
+
+typedef struct ls_slot {
+	volatile uint64_t	seq;	/* ring position + 1 once published */
+	ls_dbglvl_t		level;
+	time_t			tstamp;
+	char			id[LS_ID_MAXLEN + 1];
+	char			msg[LS_MESSAGE_MAXLEN + LS_ID_MAXLEN + 1];
+} ls_slot_t;
+
+/* private variables */
+
+/* ring of queued messages */
+static ls_slot_t		*ls_ring = NULL;
+
+/* next ring position to be claimed by posting thread */
+static volatile uint64_t	ls_ring_head = 0;
+
+/* next ring position to be posted by the flusher */
+static volatile uint64_t	ls_ring_tail = 0;
+
+/* asynchronous mode is on */
+static volatile boolean_t	ls_async_running = B_FALSE;
+
+/* flusher should post queued messages and exit */
+static boolean_t		ls_async_stop = B_FALSE;
+
+/* flusher should post queued messages right away */
+static boolean_t		ls_flush_req = B_FALSE;
+
+static pthread_t		ls_flusher;
+static pthread_mutex_t		ls_async_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* wakes up the flusher */
+static pthread_cond_t		ls_flush_cv = PTHREAD_COND_INITIALIZER;
+
+/* broadcast by the flusher after queued messages were posted */
+static pthread_cond_t		ls_posted_cv = PTHREAD_COND_INITIALIZER;
+
+/* ------------------------ local functions --------------------------- */
+
+/*
+ * Function:	ls_async_wakeup
+ * Description:	Wake up the flusher to post queued messages right away.
+ *		Called with ls_async_lock held.
+ *
+ * Parameters:	-
+ *
+ * Return:
+ */
+static void
+ls_async_wakeup(void)
+{
+	ls_flush_req = B_TRUE;
+	(void) pthread_cond_signal(&ls_flush_cv);
+}
+
+
+/*
+ * Function:	ls_async_wait
+ * Description:	Wait until the flusher posts all messages queued
+ *		before given ring position
+ *
+ * Parameters:	pos - ring position
+ *
+ * Return:
+ */
+static void
+ls_async_wait(uint64_t pos)
+{
+	timestruc_t	wait;
+
+	wait.tv_sec = 0;
+	wait.tv_nsec = LS_FLUSH_WAIT * (NANOSEC / MILLISEC);
+
+	(void) pthread_mutex_lock(&ls_async_lock);
+
+	/*
+	 * The slot at the tail may be claimed, but not published yet,
+	 * wake up the flusher again until it gets past it
+	 */
+	while (ls_async_running && (int64_t)(ls_ring_tail - pos) < 0) {
+		ls_async_wakeup();
+		(void) pthread_cond_reltimedwait_np(&ls_posted_cv,
+		    &ls_async_lock, &wait);
+	}
+
+	(void) pthread_mutex_unlock(&ls_async_lock);
+}
+
+
+/*
+ * Function:	ls_async_drain
+ * Description:	Format and post all published messages, batching them
+ *		into as few writes as possible. Called by the flusher only.
+ *
+ * Parameters:	-
+ *
+ * Return:
+ */
+static void
+ls_async_drain(void)
+{
+	static char	batch[LS_BATCH_SIZE];
+	char		buf[LS_MESSAGE_MAXLEN + LS_ID_MAXLEN + 1];
+	size_t		len = 0, n;
+	FILE		*console = NULL, *post_console;
+	ls_slot_t	*slot;
+
+	for (;;) {
+		slot = &ls_ring[ls_ring_tail & (LS_RING_SLOTS - 1)];
+		if (slot->seq != ls_ring_tail + 1)
+			break;
+		membar_consumer();
+
+		post_console = ls_format_message(buf, sizeof (buf), slot->id,
+		    slot->level, slot->tstamp, slot->msg);
+
+		/* hand the slot back for the next round of the ring */
+		membar_exit();
+		slot->seq = ls_ring_tail + LS_RING_SLOTS;
+		ls_ring_tail++;
+
+		n = strlen(buf);
+		if (len > 0 &&
+		    (post_console != console || len + n > sizeof (batch))) {
+			ls_post_message(console, batch, len);
+			len = 0;
+		}
+		console = post_console;
+		(void) memcpy(batch + len, buf, n);
+		len += n;
+	}
+
+	if (len > 0)
+		ls_post_message(console, batch, len);
+}
+
+
+/*
+ * Function:	ls_async_flusher
+ * Description:	Flusher thread. Posts queued messages every
+ *		LS_FLUSH_INTERVAL ms or when woken up.
+ *
+ * Parameters:	arg - unused
+ *
+ * Return:	NULL
+ */
+/* ARGSUSED */
+static void *
+ls_async_flusher(void *arg)
+{
+	timestruc_t	interval;
+	boolean_t	stop;
+
+	interval.tv_sec = 0;
+	interval.tv_nsec = LS_FLUSH_INTERVAL * (NANOSEC / MILLISEC);
+
+	do {
+		(void) pthread_mutex_lock(&ls_async_lock);
+		if (!ls_flush_req && !ls_async_stop)
+			(void) pthread_cond_reltimedwait_np(&ls_flush_cv,
+			    &ls_async_lock, &interval);
+		ls_flush_req = B_FALSE;
+		stop = ls_async_stop;
+		(void) pthread_mutex_unlock(&ls_async_lock);
+
+		ls_async_drain();
+
+		(void) pthread_mutex_lock(&ls_async_lock);
+		(void) pthread_cond_broadcast(&ls_posted_cv);
+		(void) pthread_mutex_unlock(&ls_async_lock);
+	} while (!stop);
+
+	return (NULL);
+}
+
+
+/*
+ * Function:	ls_async_exit
+ * Description:	Post queued messages and stop the flusher at exit.
+ *		Messages posted from now on are posted synchronously.
+ *
+ * Parameters:	-
+ *
+ * Return:
+ */
+static void
+ls_async_exit(void)
+{
+	(void) pthread_mutex_lock(&ls_async_lock);
+	if (!ls_async_running) {
+		(void) pthread_mutex_unlock(&ls_async_lock);
+		return;
+	}
+	ls_async_running = B_FALSE;
+	ls_async_stop = B_TRUE;
+	(void) pthread_cond_signal(&ls_flush_cv);
+	(void) pthread_mutex_unlock(&ls_async_lock);
+
+	(void) pthread_join(ls_flusher, NULL);
+}
+
+/* ----------------------- private functions -------------------------- */
+
+/*
+ * Function:	ls_async_start
+ * Description:	Switch to asynchronous mode - allocate the ring and
+ *		start the flusher thread. Does nothing if already running.
+ *
+ * Parameters:	-
+ *
+ * Return:	LS_E_SUCCESS - asynchronous mode is on
+ *		LS_E_NOMEM - couldn't allocate the ring or start the thread
+ */
+ls_errno_t
+ls_async_start(void)
+{
+	static boolean_t	exit_registered = B_FALSE;
+	int			i;
+
+	(void) pthread_mutex_lock(&ls_async_lock);
+	if (ls_async_running) {
+		(void) pthread_mutex_unlock(&ls_async_lock);
+		return (LS_E_SUCCESS);
+	}
+
+	if (ls_ring == NULL &&
+	    (ls_ring = calloc(LS_RING_SLOTS, sizeof (ls_slot_t))) == NULL) {
+		(void) pthread_mutex_unlock(&ls_async_lock);
+		return (LS_E_NOMEM);
+	}
+
+	for (i = 0; i < LS_RING_SLOTS; i++)
+		ls_ring[i].seq = i;
+	ls_ring_head = ls_ring_tail = 0;
+	ls_async_stop = B_FALSE;
+	ls_flush_req = B_FALSE;
+
+	if (pthread_create(&ls_flusher, NULL, ls_async_flusher, NULL) != 0) {
+		(void) pthread_mutex_unlock(&ls_async_lock);
+		return (LS_E_NOMEM);
+	}
+
+	if (!exit_registered && atexit(ls_async_exit) == 0)
+		exit_registered = B_TRUE;
+
+	membar_producer();
+	ls_async_running = B_TRUE;
+	(void) pthread_mutex_unlock(&ls_async_lock);
+
+	return (LS_E_SUCCESS);
+}
+
+
+/*
+ * Function:	ls_async_post
+ * Description:	Queue message for the flusher
+ *
+ * Parameters:	id - module identification
+ *		level - debug message level or LS_POST_LOG_FLAG
+ *		msg - message
+ *
+ * Return:	B_TRUE - message was queued
+ *		B_FALSE - asynchronous mode is off, post message directly
+ */
+boolean_t
+ls_async_post(const char *id, ls_dbglvl_t level, const char *msg)
+{
+	ls_slot_t	*slot;
+	uint64_t	pos, seq;
+
+	if (!ls_async_running)
+		return (B_FALSE);
+
+	/* claim a slot */
+
+	pos = ls_ring_head;
+	for (;;) {
+		slot = &ls_ring[pos & (LS_RING_SLOTS - 1)];
+		seq = slot->seq;
+		membar_consumer();
+
+		if (seq == pos) {
+			if (atomic_cas_64(&ls_ring_head, pos, pos + 1) == pos)
+				break;
+		} else if ((int64_t)(seq - pos) < 0) {
+			/* ring is full, let the flusher make room */
+			ls_async_wait(pos - LS_RING_SLOTS + 1);
+			if (!ls_async_running)
+				return (B_FALSE);
+		}
+		pos = ls_ring_head;
+	}
+
+	/* fill it in and publish it */
+
+	slot->level = level;
+	slot->tstamp = time(NULL);
+	(void) strlcpy(slot->id, id, sizeof (slot->id));
+	(void) strlcpy(slot->msg, msg, sizeof (slot->msg));
+	membar_producer();
+	slot->seq = pos + 1;
+
+	/* don't wait for the interval if the ring is filling up */
+
+	if (((pos + 1) & (LS_RING_SLOTS / 2 - 1)) == 0) {
+		(void) pthread_mutex_lock(&ls_async_lock);
+		ls_async_wakeup();
+		(void) pthread_mutex_unlock(&ls_async_lock);
+	}
+
+	return (B_TRUE);
+}
+
+
+/*
+ * Function:	ls_async_flush
+ * Description:	Wait until all queued messages are posted
+ *
+ * Parameters:	-
+ *
+ * Return:
+ */
+void
+ls_async_flush(void)
+{
+	if (ls_async_running)
+		ls_async_wait(ls_ring_head);
+}
@@ -39,6 +39,7 @@
 #include <wait.h>
 
 #include <ls_api.h>
+#include "ls_private.h"
 
 /* configuration environment variables */
 
@@ -54,6 +55,15 @@
 /* timestamp */
 #define	LS_ENV_TIMESTAMP	"LS_TIMESTAMP"
 
+/* asynchronous posting of messages */
+#define	LS_ENV_ASYNC		"LS_ASYNC"
+
+/* binary trace file */
+#define	LS_ENV_TRACE		"LS_TRACE"
+
+/* install timeline file */
+#define	LS_ENV_TIMELINE		"LS_TIMELINE"
+
 /* default log file name */
 #define	LS_LOGFILE_DEFAULT_NAME	"install_log"
 
@@ -69,12 +79,6 @@
 /* default debugging level */
 #define	LS_DBGLVL_DEFAULT	LS_DBGLVL_ERR
 
-/*
- * flag indicating, if default debugging/logging function
- * should post log message
- */
-#define	LS_POST_LOG_FLAG	-1
-
 /* validate destination */
 #define	ls_destination_valid(d)	\
 	((d >= LS_DEST_NONE) && (d <= LS_DEST_BOTH))
@@ -124,17 +128,15 @@ static boolean_t	ls_timestamp = B_TRUE;
 /* ------------------------ local functions --------------------------- */
 
 /*
- * idm_debug_print()
+ * ls_debug_print()
  */
 static void
 ls_debug_print(ls_dbglvl_t dbg_lvl, const char *fmt, ...)
 {
 	va_list	ap;
-	char	buf[MAXPATHLEN + 1];
 
 	va_start(ap, fmt);
-	(void) vsprintf(buf, fmt, ap);
-	(void) ls_write_dbg_message("LS", dbg_lvl, buf);
+	ls_write_dbg_vmessage("LS", dbg_lvl, fmt, ap);
 	va_end(ap);
 }
 
@@ -244,44 +246,36 @@ ls_getenv_num(char *envname)
 
 
 /*
- * Function:	ls_dbg_method_default
- * Description:
- *
- * Parameters:	id - module identification
- *		level - debug message level
- *		msg - debugging message
- *
- *
- * Return:
+ * Function:	ls_format_message
+ * Description:	Formats message for posting - prefixes it with module
+ *		identification, debug level and time stamp in UTC format
+ *
+ * Parameters:	buf - buffer for formatted message
+ *		size - size of the buffer
+ *		id - module identification
+ *		level - debug message level or LS_POST_LOG_FLAG
+ *		tstamp - time the message was posted
+ *		msg - message
+ *
+ * Return:	console the message is to be posted to
  */
-static void
-ls_dbg_method_default(const char *id, ls_dbglvl_t level, char *msg)
+FILE *
+ls_format_message(char *buf, size_t size, const char *id, ls_dbglvl_t level,
+    time_t tstamp, const char *msg)
 {
-	FILE 		*post_console;
-	char		buf[LS_MESSAGE_MAXLEN + LS_ID_MAXLEN + 1];
-	static int	fl_init_console_done = 0;
-	time_t		tstamp;
 	char		asc_tstamp[30];
-	struct tm	*tm_tstamp;
+	struct tm	tm_tstamp;
 	char		*s = NULL;
 	char		*e = NULL;
 
-	if (msg == NULL)
-		return;
-
-	/*
-	 * set variables according to required action (debug or log)
-	 * and format debug or log message appropriately
-	 */
-
 	/*
 	 * prepare time stamp in UTC format
 	 */
 
 	if (ls_timestamp) {
-		if ((tstamp = time(NULL)) != (time_t)-1 &&
-		    (tm_tstamp = gmtime(&tstamp)) != NULL &&
-		    asctime_r(tm_tstamp, asc_tstamp, sizeof (asc_tstamp)) !=
+		if (tstamp != (time_t)-1 &&
+		    gmtime_r(&tstamp, &tm_tstamp) != NULL &&
+		    asctime_r(&tm_tstamp, asc_tstamp, sizeof (asc_tstamp)) !=
 		    NULL) {
 			/*
 			 * drop weekday and year information
@@ -299,18 +293,15 @@ ls_dbg_method_default(const char *id, ls_dbglvl_t level, char *msg)
 	}
 
 	if (level == LS_POST_LOG_FLAG) {
-		post_console = ls_log_console;
-
 		if (ls_timestamp)
-			(void) snprintf(buf, sizeof (buf), "<%s %s> %s",
-			    id, s, msg);
+			(void) snprintf(buf, size, "<%s %s> %s", id, s, msg);
 		else
-			(void) snprintf(buf, sizeof (buf), "<%s> %s", id, msg);
+			(void) snprintf(buf, size, "<%s> %s", id, msg);
+
+		return (ls_log_console);
 	} else {
 		char		*lvl_str;
 
-		post_console = ls_dbg_console;
-
 		switch (level) {
 			case LS_DBGLVL_EMERG:
 				lvl_str = "!";
@@ -334,12 +325,32 @@ ls_dbg_method_default(const char *id, ls_dbglvl_t level, char *msg)
 		}
 
 		if (ls_timestamp) {
-			(void) snprintf(buf, sizeof (buf), "<%s_%s %s> %s", id,
+			(void) snprintf(buf, size, "<%s_%s %s> %s", id,
 			    lvl_str, s, msg);
 		} else
-			(void) snprintf(buf, sizeof (buf), "<%s_%s> %s", id,
+			(void) snprintf(buf, size, "<%s_%s> %s", id,
 			    lvl_str, msg);
+
+		return (ls_dbg_console);
 	}
+}
+
+
+/*
+ * Function:	ls_post_message
+ * Description:	Posts formatted messages to the console and/or the log
+ *		file, according to the destination
+ *
+ * Parameters:	post_console - console to post the messages to
+ *		buf - formatted messages
+ *		len - length of the messages
+ *
+ * Return:
+ */
+void
+ls_post_message(FILE *post_console, const char *buf, size_t len)
+{
+	static int	fl_init_console_done = 0;
 
 	/* post to console */
 
@@ -355,7 +366,7 @@ ls_dbg_method_default(const char *id, ls_dbglvl_t level, char *msg)
 			(void) setbuf(ls_dbg_console, NULL);
 		}
 
-		(void) fputs(buf, post_console);
+		(void) fwrite(buf, 1, len, post_console);
 	}
 
 	/* post to file */
@@ -370,8 +381,45 @@ ls_dbg_method_default(const char *id, ls_dbglvl_t level, char *msg)
 		}
 
 		if (ls_log_file != NULL)
-			(void) fputs(buf, ls_log_file);
+			(void) fwrite(buf, 1, len, ls_log_file);
+	}
+}
+
+
+/*
+ * Function:	ls_dbg_method_default
+ * Description:	Formats and posts message. In asynchronous mode only
+ *		queues the message for the flusher thread, see ls_async.c.
+ *
+ * Parameters:	id - module identification
+ *		level - debug message level
+ *		msg - debugging message
+ *
+ *
+ * Return:
+ */
+static void
+ls_dbg_method_default(const char *id, ls_dbglvl_t level, char *msg)
+{
+	FILE 		*post_console;
+	char		buf[LS_MESSAGE_MAXLEN + LS_ID_MAXLEN + 1];
+
+	if (msg == NULL)
+		return;
+
+	if (ls_async_post(id, level, msg)) {
+		/*
+		 * Errors are posted right away, the process
+		 * may not live long enough for the flusher
+		 */
+		if (level != LS_POST_LOG_FLAG && level <= LS_DBGLVL_ERR)
+			ls_async_flush();
+		return;
 	}
+
+	post_console = ls_format_message(buf, sizeof (buf), id, level,
+	    time(NULL), msg);
+	ls_post_message(post_console, buf, strlen(buf));
 }
 
 
@@ -414,6 +462,11 @@ ls_init(nvlist_t *params)
 	char		*str;
 	int16_t		dest, lvl;
 	boolean_t	stamp;
+	boolean_t	async = B_FALSE;
+	int		async_env;
+	char		*trace_file = NULL;
+	char		*timeline_file = NULL;
+	ls_errno_t	ret;
 	ls_dbglvl_t	ls_env_dbglvl;
 	char		*ls_env_dbglvl_str;
 
@@ -446,6 +499,21 @@ ls_init(nvlist_t *params)
 		    &stamp) == 0)
 			ls_timestamp = stamp;
 
+		/* asynchronous posting */
+
+		(void) nvlist_lookup_boolean_value(params, LS_ATTR_ASYNC,
+		    &async);
+
+		/* binary trace file */
+
+		(void) nvlist_lookup_string(params, LS_ATTR_TRACE_FILE,
+		    &trace_file);
+
+		/* install timeline file */
+
+		(void) nvlist_lookup_string(params, LS_ATTR_TIMELINE_FILE,
+		    &timeline_file);
+
 		/* debug level */
 
 		if ((nvlist_lookup_int16(params, LS_ATTR_DBG_LVL, &lvl) == 0) &&
@@ -477,6 +545,34 @@ ls_init(nvlist_t *params)
 	if ((stamp = ls_getenv_num(LS_ENV_TIMESTAMP)) != LS_E_INVAL)
 		ls_timestamp = stamp == 0 ? B_FALSE : B_TRUE;
 
+	/* asynchronous posting - once started, it stays on until exit */
+
+	if ((async_env = ls_getenv_num(LS_ENV_ASYNC)) != LS_E_INVAL)
+		async = async_env == 0 ? B_FALSE : B_TRUE;
+
+	if (async && ls_async_start() != LS_E_SUCCESS)
+		return (LS_E_NOMEM);
+
+	/* debug messages are recorded into binary trace file */
+
+	if ((str = ls_getenv_string(LS_ENV_TRACE)) != NULL)
+		trace_file = str;
+
+	if (trace_file != NULL) {
+		if ((ret = ls_trace_open(trace_file)) != LS_E_SUCCESS)
+			return (ret);
+		ls_register_dbg_method(ls_trace_dbg_method);
+	}
+
+	/* install timeline file */
+
+	if ((str = ls_getenv_string(LS_ENV_TIMELINE)) != NULL)
+		timeline_file = str;
+
+	if (timeline_file != NULL &&
+	    ls_timeline_set_file(timeline_file) != LS_E_SUCCESS)
+		return (LS_E_NOMEM);
+
 	/* set debug level */
 
 	/* if environment variable supplied and valid, set debugging level */
@@ -511,14 +607,20 @@ ls_init(nvlist_t *params)
 ls_errno_t
 ls_transfer(char *src_mountpoint, char *dst_mountpoint)
 {
-	char	cmd[MAXPATHLEN];
-	DIR	*dirp;
-	int	ret;
-	char	*fname;
+	char		cmd[MAXPATHLEN];
+	DIR		*dirp;
+	int		ret;
+	char		*fname;
+	const char	*trace;
+	const char	*timeline;
 
 	if ((src_mountpoint == NULL) || (dst_mountpoint == NULL))
 		return (LS_E_LOG_TRANSFER_FAILED);
 
+	/* make sure the log file is complete */
+
+	ls_flush();
+
 	/*
 	 * Check whether the target directory exists. If not create it
 	 */
@@ -574,6 +676,43 @@ ls_transfer(char *src_mountpoint, char *dst_mountpoint)
 		return (LS_E_LOG_TRANSFER_FAILED);
 	}
 
+	/*
+	 * copy trace file as well, if debug messages are recorded there
+	 */
+
+	if ((trace = ls_trace_file()) != NULL) {
+		(void) snprintf(cmd, sizeof (cmd),
+		    "/bin/cp %s%s %s%s", src_mountpoint, trace,
+		    dst_mountpoint, LS_LOGFILE_DST_PATH);
+
+		if (ls_system(cmd) != 0) {
+			ls_debug_print(LS_DBGLVL_ERR,
+			    "Transfer of trace file failed\n");
+
+			return (LS_E_LOG_TRANSFER_FAILED);
+		}
+	}
+
+	/*
+	 * and install timeline recorded so far. It is optional, so
+	 * failing to write or copy it doesn't fail the transfer.
+	 */
+
+	timeline = ls_timeline_file();
+	if (ls_timeline_write(NULL) == LS_E_SUCCESS) {
+		(void) snprintf(cmd, sizeof (cmd),
+		    "/bin/cp %s%s %s%s", src_mountpoint, timeline,
+		    dst_mountpoint, LS_LOGFILE_DST_PATH);
+
+		if (ls_system(cmd) != 0) {
+			ls_debug_print(LS_DBGLVL_WARN,
+			    "Transfer of install timeline failed\n");
+		}
+	} else {
+		ls_debug_print(LS_DBGLVL_WARN,
+		    "Couldn't write install timeline %s\n", timeline);
+	}
+
 	return (LS_E_SUCCESS);
 }
 
@@ -697,18 +836,61 @@ void
 ls_write_dbg_message(const char *id, ls_dbglvl_t level, const char *fmt, ...)
 {
 	va_list	ap;
+
+	va_start(ap, fmt);
+	ls_write_dbg_vmessage(id, level, fmt, ap);
+	va_end(ap);
+}
+
+/*
+ * Function:	ls_write_dbg_vmessage
+ * Description:	Write debug message given by format and argument list,
+ *		see ls_write_dbg_message(). Debug print functions of
+ *		modules pass their format and arguments through, so that
+ *		the binary trace records each format string only once.
+ *
+ * Parameters:	id - module identification
+ *		level - debug level
+ *		fmt - debugging message format
+ *		ap - arguments
+ *
+ * Return:
+ */
+void
+ls_write_dbg_vmessage(const char *id, ls_dbglvl_t level, const char *fmt,
+    va_list ap)
+{
 	char	buf[LS_MESSAGE_MAXLEN + LS_ID_MAXLEN + 1];
 
 	/* only post message, if current debugging level allows it */
 
 	if (level <= ls_get_dbg_level()) {
-		va_start(ap, fmt);
-		(void) vsnprintf(buf, sizeof (buf), fmt, ap);
-		ls_dbg_method(id, level, buf);
-		va_end(ap);
+		/* trace records format and arguments, don't format them */
+		if (ls_dbg_method == ls_trace_dbg_method) {
+			ls_trace_vevent(id, level, fmt, ap);
+		} else {
+			(void) vsnprintf(buf, sizeof (buf), fmt, ap);
+			ls_dbg_method(id, level, buf);
+		}
 	}
 }
 
+/*
+ * Function:	ls_flush
+ * Description:	Wait until messages queued in asynchronous mode are
+ *		posted and write out buffered trace records.
+ *
+ * Parameters:	-
+ *
+ * Return:
+ */
+void
+ls_flush(void)
+{
+	ls_async_flush();
+	ls_trace_flush();
+}
+
 /*
  * Function:	ls_log_std
  * Description:	Write formatted log message and/or stdout, stderr
@@ -0,0 +1,73 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+#ifndef _LS_PRIVATE_H
+#define	_LS_PRIVATE_H
+
+/*
+ * Private interfaces shared by the parts of the logging service
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+#include <ls_api.h>
+
+/*
+ * flag indicating, if default debugging/logging function
+ * should post log message
+ */
+#define	LS_POST_LOG_FLAG	-1
+
+/* formatting and posting of messages - ls_main.c */
+FILE *ls_format_message(char *buf, size_t size, const char *id,
+    ls_dbglvl_t level, time_t tstamp, const char *msg);
+void ls_post_message(FILE *post_console, const char *buf, size_t len);
+
+/* asynchronous posting of messages - ls_async.c */
+ls_errno_t ls_async_start(void);
+boolean_t ls_async_post(const char *id, ls_dbglvl_t level, const char *msg);
+void ls_async_flush(void);
+
+/* binary trace of debug messages - ls_trace.c */
+ls_errno_t ls_trace_open(const char *path);
+void ls_trace_vevent(const char *id, ls_dbglvl_t level, const char *fmt,
+    va_list ap);
+void ls_trace_flush(void);
+const char *ls_trace_file(void);
+
+/* install timeline - ls_timeline.c */
+ls_errno_t ls_timeline_set_file(const char *path);
+const char *ls_timeline_file(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LS_PRIVATE_H */
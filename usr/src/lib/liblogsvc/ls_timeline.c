@@ -0,0 +1,417 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * Install timeline
+ *
+ * Libraries taking part in the installation mark the steps they carry
+ * out as spans - ls_span_begin() takes a high resolution time stamp and
+ * ls_span_end() records the span with its category, name and optional
+ * detail (e.g. command being run). Spans are kept in memory, so marking
+ * a step costs two gethrtime() calls and a short critical section.
+ *
+ * ls_timeline_write() writes the spans in the trace event format of
+ * Chrome (chrome://tracing, Perfetto and others read it) - a JSON object
+ * with "traceEvents" array of complete ("ph":"X") events, time stamps
+ * and durations in microseconds since the first span. Spans of one
+ * thread nest by time, so each thread shows up as a separate track.
+ * ls_timeline_summary() logs where the time went, per span name.
+ */
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <ls_api.h>
+#include "ls_private.h"
+
+/* timeline file used if none is configured */
+#define	LS_TIMELINE_DEFAULT	"/tmp/install_timeline.json"
+
+/* max number of spans kept, later ones are dropped */
+#define	LS_TIMELINE_MAXSPANS	65536
+
+/* initial size of span table */
+#define	LS_TIMELINE_INITSPANS	256
+
+/* max number of span names listed by ls_timeline_summary() */
+#define	LS_TIMELINE_SUMMARY_MAX	20
+
+/* recorded span - category, name and detail share one allocation */
+typedef struct ls_span {
+	hrtime_t	start;
+	hrtime_t	dur;
+	uint_t		tid;
+	char		*cat;
+	char		*name;
+	char		*detail;	/* NULL if not provided */
+} ls_span_t;
+
+/* time spent in spans of one name - see ls_timeline_summary() */
+typedef struct ls_span_sum {
+	const char	*cat;
+	const char	*name;
+	uint_t		count;
+	hrtime_t	total;
+	hrtime_t	max;
+} ls_span_sum_t;
+
+/* private variables */
+
+static pthread_mutex_t	ls_timeline_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* timeline file */
+static char		*ls_timeline_filename = LS_TIMELINE_DEFAULT;
+
+/* recorded spans */
+static ls_span_t	*ls_spans = NULL;
+static uint_t		ls_nspans = 0;
+static uint_t		ls_maxspans = 0;
+static uint_t		ls_dropped = 0;
+
+/* time stamps are relative to the first span started */
+static hrtime_t		ls_timeline_base = 0;
+
+/*
+ * Function:	ls_timeline_json_str
+ * Description:	Write string to the timeline file as JSON string
+ *
+ * Parameters:	fp - timeline file
+ *		s - string
+ *
+ * Return:
+ */
+static void
+ls_timeline_json_str(FILE *fp, const char *s)
+{
+	const unsigned char	*p;
+
+	(void) putc('"', fp);
+
+	for (p = (const unsigned char *)s; *p != '\0'; p++) {
+		if (*p == '"' || *p == '\\')
+			(void) fprintf(fp, "\\%c", *p);
+		else if (*p < 0x20)
+			(void) fprintf(fp, "\\u%04x", *p);
+		else
+			(void) putc(*p, fp);
+	}
+
+	(void) putc('"', fp);
+}
+
+/*
+ * Function:	ls_span_sum_cmp
+ * Description:	qsort() comparator ordering span sums by total time,
+ *		longest first
+ *
+ * Parameters:	a, b - span sums
+ *
+ * Return:	<0, 0, >0 as qsort() expects
+ */
+static int
+ls_span_sum_cmp(const void *a, const void *b)
+{
+	const ls_span_sum_t	*sa = a;
+	const ls_span_sum_t	*sb = b;
+
+	if (sa->total == sb->total)
+		return (0);
+
+	return (sa->total > sb->total ? -1 : 1);
+}
+
+/*
+ * Function:	ls_timeline_set_file
+ * Description:	Set the file ls_timeline_write() writes spans to by default
+ *
+ * Parameters:	path - timeline file
+ *
+ * Return:	LS_E_SUCCESS - file set
+ *		LS_E_NOMEM - couldn't allocate memory
+ */
+ls_errno_t
+ls_timeline_set_file(const char *path)
+{
+	char	*filename;
+
+	if ((filename = strdup(path)) == NULL)
+		return (LS_E_NOMEM);
+
+	(void) pthread_mutex_lock(&ls_timeline_lock);
+	if (ls_timeline_filename != LS_TIMELINE_DEFAULT)
+		free(ls_timeline_filename);
+	ls_timeline_filename = filename;
+	(void) pthread_mutex_unlock(&ls_timeline_lock);
+
+	return (LS_E_SUCCESS);
+}
+
+/*
+ * Function:	ls_timeline_file
+ * Description:	Return the file ls_timeline_write() writes spans to
+ *		by default
+ *
+ * Parameters:	-
+ *
+ * Return:	path of the timeline file
+ */
+const char *
+ls_timeline_file(void)
+{
+	return (ls_timeline_filename);
+}
+
+/*
+ * Function:	ls_span_begin
+ * Description:	Mark the beginning of a span
+ *
+ * Parameters:	-
+ *
+ * Return:	time stamp to be passed to ls_span_end()
+ */
+hrtime_t
+ls_span_begin(void)
+{
+	return (gethrtime());
+}
+
+/*
+ * Function:	ls_span_end
+ * Description:	Record a span which began at the given time and ends now
+ *
+ * Parameters:	start - time stamp returned by ls_span_begin()
+ *		cat - category, usually the library the span belongs to
+ *		name - name of the step carried out
+ *		detail - additional information, e.g. command run, or NULL
+ *
+ * Return:
+ */
+void
+ls_span_end(hrtime_t start, const char *cat, const char *name,
+    const char *detail)
+{
+	hrtime_t	end = gethrtime();
+	ls_span_t	*sp;
+	ls_span_t	*spans;
+	size_t		catlen, namelen, detlen;
+	char		*buf;
+	uint_t		max;
+
+	if (cat == NULL || name == NULL)
+		return;
+
+	catlen = strlen(cat) + 1;
+	namelen = strlen(name) + 1;
+	detlen = detail != NULL ? strlen(detail) + 1 : 0;
+
+	if ((buf = malloc(catlen + namelen + detlen)) == NULL)
+		return;
+
+	(void) pthread_mutex_lock(&ls_timeline_lock);
+
+	if (ls_nspans == ls_maxspans) {
+		max = ls_maxspans == 0 ? LS_TIMELINE_INITSPANS :
+		    MIN(2 * ls_maxspans, LS_TIMELINE_MAXSPANS);
+
+		if (max == ls_maxspans || (spans = realloc(ls_spans,
+		    max * sizeof (ls_span_t))) == NULL) {
+			ls_dropped++;
+			(void) pthread_mutex_unlock(&ls_timeline_lock);
+			free(buf);
+			return;
+		}
+		ls_spans = spans;
+		ls_maxspans = max;
+	}
+
+	if (ls_nspans == 0 || start < ls_timeline_base)
+		ls_timeline_base = start;
+
+	sp = &ls_spans[ls_nspans++];
+	sp->start = start;
+	sp->dur = end - start;
+	sp->tid = (uint_t)pthread_self();
+	sp->cat = buf;
+	sp->name = buf + catlen;
+	sp->detail = detail != NULL ? buf + catlen + namelen : NULL;
+	(void) memcpy(sp->cat, cat, catlen);
+	(void) memcpy(sp->name, name, namelen);
+	if (detail != NULL)
+		(void) memcpy(sp->detail, detail, detlen);
+
+	(void) pthread_mutex_unlock(&ls_timeline_lock);
+}
+
+/*
+ * Function:	ls_timeline_write
+ * Description:	Write spans recorded so far to the timeline file in
+ *		Chrome trace event format. An existing file is removed
+ *		first and the new one created exclusively, so that a link
+ *		planted in /tmp can't redirect the writes.
+ *
+ * Parameters:	path - file to write, NULL for the configured one
+ *
+ * Return:	LS_E_SUCCESS - timeline written
+ *		LS_E_TIMELINE_FAILED - couldn't write timeline file
+ */
+ls_errno_t
+ls_timeline_write(const char *path)
+{
+	FILE		*fp;
+	ls_span_t	*sp;
+	uint_t		i;
+	int		fd;
+	int		ret;
+
+	(void) pthread_mutex_lock(&ls_timeline_lock);
+
+	if (path == NULL)
+		path = ls_timeline_filename;
+
+	(void) unlink(path);
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW,
+	    0644)) < 0) {
+		(void) pthread_mutex_unlock(&ls_timeline_lock);
+		return (LS_E_TIMELINE_FAILED);
+	}
+
+	if ((fp = fdopen(fd, "w")) == NULL) {
+		(void) close(fd);
+		(void) pthread_mutex_unlock(&ls_timeline_lock);
+		return (LS_E_TIMELINE_FAILED);
+	}
+
+	(void) fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"otherData\":"
+	    "{\"spans\":%u,\"dropped\":%u},\"traceEvents\":[\n"
+	    "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+	    "\"args\":{\"name\":\"install\"}}", ls_nspans, ls_dropped,
+	    (int)getpid());
+
+	for (i = 0; i < ls_nspans; i++) {
+		sp = &ls_spans[i];
+
+		(void) fprintf(fp, ",\n{\"name\":");
+		ls_timeline_json_str(fp, sp->name);
+		(void) fprintf(fp, ",\"cat\":");
+		ls_timeline_json_str(fp, sp->cat);
+		(void) fprintf(fp, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+		    "\"pid\":%d,\"tid\":%u",
+		    (double)(sp->start - ls_timeline_base) / 1000,
+		    (double)sp->dur / 1000, (int)getpid(), sp->tid);
+		if (sp->detail != NULL) {
+			(void) fprintf(fp, ",\"args\":{\"detail\":");
+			ls_timeline_json_str(fp, sp->detail);
+			(void) putc('}', fp);
+		}
+		(void) putc('}', fp);
+	}
+
+	(void) fprintf(fp, "\n]}\n");
+
+	(void) pthread_mutex_unlock(&ls_timeline_lock);
+
+	ret = ferror(fp);
+	if (fclose(fp) != 0 || ret != 0)
+		return (LS_E_TIMELINE_FAILED);
+
+	return (LS_E_SUCCESS);
+}
+
+/*
+ * Function:	ls_timeline_summary
+ * Description:	Log how much time was spent in spans recorded so far,
+ *		summed up per category and name, longest first
+ *
+ * Parameters:	id - module identification used for log messages
+ *
+ * Return:
+ */
+void
+ls_timeline_summary(const char *id)
+{
+	ls_span_sum_t	*sums;
+	ls_span_t	*sp;
+	uint_t		nspans, dropped;
+	uint_t		nsums = 0;
+	uint_t		i, j;
+
+	(void) pthread_mutex_lock(&ls_timeline_lock);
+
+	if (ls_nspans == 0 ||
+	    (sums = malloc(ls_nspans * sizeof (ls_span_sum_t))) == NULL) {
+		(void) pthread_mutex_unlock(&ls_timeline_lock);
+		return;
+	}
+
+	/* there are at most a few dozens of distinct names */
+	for (i = 0; i < ls_nspans; i++) {
+		sp = &ls_spans[i];
+
+		for (j = 0; j < nsums; j++) {
+			if (strcmp(sums[j].name, sp->name) == 0 &&
+			    strcmp(sums[j].cat, sp->cat) == 0)
+				break;
+		}
+		if (j == nsums) {
+			sums[j].cat = sp->cat;
+			sums[j].name = sp->name;
+			sums[j].count = 0;
+			sums[j].total = 0;
+			sums[j].max = 0;
+			nsums++;
+		}
+		sums[j].count++;
+		sums[j].total += sp->dur;
+		sums[j].max = MAX(sums[j].max, sp->dur);
+	}
+
+	nspans = ls_nspans;
+	dropped = ls_dropped;
+
+	/* recorded spans are never released, names stay valid */
+	(void) pthread_mutex_unlock(&ls_timeline_lock);
+
+	qsort(sums, nsums, sizeof (ls_span_sum_t), ls_span_sum_cmp);
+
+	ls_write_log_message(id, "Install timeline: %u spans recorded, "
+	    "%u dropped, see %s\n", nspans, dropped, ls_timeline_file());
+
+	for (i = 0; i < MIN(nsums, LS_TIMELINE_SUMMARY_MAX); i++) {
+		ls_write_log_message(id, "  %-10s %-32s %5u x %9.3f s "
+		    "(max %.3f s)\n", sums[i].cat, sums[i].name,
+		    sums[i].count, (double)sums[i].total / NANOSEC,
+		    (double)sums[i].max / NANOSEC);
+	}
+
+	free(sums);
+}
@@ -0,0 +1,781 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * Binary trace of debug messages
+ *
+ * In trace mode (LS_ATTR_TRACE_FILE, LS_TRACE environment variable)
+ * ls_trace_dbg_method() is registered as the debug method and
+ * ls_write_dbg_message() and ls_write_dbg_vmessage() hand format and
+ * arguments of the message to ls_trace_vevent() instead of formatting
+ * it. Each message is recorded as an event with high resolution time
+ * stamp, module, level, number of its format string and raw arguments.
+ * Formatting is left to the ls_trace_decode tool.
+ *
+ * Trace file layout, all numbers are in byte order of the writer:
+ *
+ *	header	"LSTRACE\0", uint32 LS_TRACE_MAGIC, uint32 version,
+ *		int64 hrtime and int64 time(2) when the trace started
+ *	record	uint8 type followed by
+ *		LS_TREC_ID	uint16 number, uint16 length, module id
+ *		LS_TREC_FMT	uint32 number, uint16 length, format string
+ *		LS_TREC_EVENT	int64 hrtime, uint16 module, int8 level,
+ *				uint32 format, uint16 length of arguments,
+ *				arguments
+ *
+ * Module ids and format strings are defined by a record before their
+ * first use. Format number 0 is "%s", used for messages which come
+ * formatted. Each argument is a tag byte followed by its value:
+ *
+ *	'i'	int64 - signed integer conversions and %c
+ *	'u'	uint64 - unsigned integer conversions
+ *	'f'	double - floating point conversions
+ *	'p'	uint64 - %p
+ *	's'	uint16 length and the bytes - %s, length 0xffff for NULL
+ */
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <ls_api.h>
+#include "ls_private.h"
+
+/* trace file used if the method is registered without LS_TRACE */
+#define	LS_TRACE_DEFAULT	"/tmp/install_trace"
+
+#define	LS_TRACE_MAGIC		0x4c535452
+#define	LS_TRACE_VERSION	1
+
+/* record types */
+#define	LS_TREC_ID		1
+#define	LS_TREC_FMT		2
+#define	LS_TREC_EVENT		3
+
+/* size of buffer for records not written yet */
+#define	LS_TRACE_BUFSIZE	(64 * 1024)
+
+/* max size of event record */
+#define	LS_TRACE_EVENT_MAX	(4 * LS_MESSAGE_MAXLEN)
+
+/* max number of arguments of one message */
+#define	LS_TRACE_MAXARGS	32
+
+/* number of cached format strings */
+#define	LS_TRACE_FMT_SLOTS	1024
+
+/* max number of modules */
+#define	LS_TRACE_MAXIDS		64
+
+/* argument types */
+typedef enum {
+	LS_TA_INT,
+	LS_TA_LONG,
+	LS_TA_LLONG,
+	LS_TA_UINT,
+	LS_TA_ULONG,
+	LS_TA_ULLONG,
+	LS_TA_DOUBLE,
+	LS_TA_LDOUBLE,
+	LS_TA_STR,
+	LS_TA_PTR
+} ls_targ_t;
+
+/* format string seen before */
+typedef struct ls_tfmt {
+	const char	*ptr;		/* format as passed by the caller */
+	char		*text;		/* its copy */
+	uint32_t	num;
+	int		nargs;		/* -1 if it can't be recorded raw */
+	uint8_t		args[LS_TRACE_MAXARGS];
+} ls_tfmt_t;
+
+/* private variables */
+
+static pthread_mutex_t	ls_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* trace file */
+static char		*ls_trace_filename = NULL;
+static int		ls_trace_fd = -1;
+
+/* records not written yet */
+static char		ls_trace_buf[LS_TRACE_BUFSIZE];
+static size_t		ls_trace_len = 0;
+
+/* format strings, the cache is indexed by their address */
+static ls_tfmt_t	ls_trace_fmts[LS_TRACE_FMT_SLOTS];
+static uint32_t		ls_trace_nfmts = 1;
+
+/* module ids */
+static char		*ls_trace_ids[LS_TRACE_MAXIDS];
+static uint16_t		ls_trace_nids = 0;
+
+/* ------------------------ local functions --------------------------- */
+
+/*
+ * Function:	ls_trace_write
+ * Description:	Write records in the buffer to the trace file.
+ *		Called with ls_trace_lock held.
+ *
+ * Parameters:	-
+ *
+ * Return:
+ */
+static void
+ls_trace_write(void)
+{
+	size_t	off = 0;
+	ssize_t	n;
+
+	while (off < ls_trace_len) {
+		n = write(ls_trace_fd, ls_trace_buf + off, ls_trace_len - off);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		off += n;
+	}
+	ls_trace_len = 0;
+}
+
+
+/*
+ * Function:	ls_trace_append
+ * Description:	Append record to the buffer. Called with ls_trace_lock
+ *		held.
+ *
+ * Parameters:	rec - the record
+ *		len - its length
+ *
+ * Return:
+ */
+static void
+ls_trace_append(const void *rec, size_t len)
+{
+	if (ls_trace_len + len > sizeof (ls_trace_buf))
+		ls_trace_write();
+
+	(void) memcpy(ls_trace_buf + ls_trace_len, rec, len);
+	ls_trace_len += len;
+}
+
+
+/*
+ * Function:	ls_trace_free_ids
+ * Description:	Forget module ids defined so far. Called with
+ *		ls_trace_lock held.
+ *
+ * Parameters:	-
+ *
+ * Return:
+ */
+static void
+ls_trace_free_ids(void)
+{
+	uint16_t	i;
+
+	for (i = 0; i < ls_trace_nids; i++) {
+		free(ls_trace_ids[i]);
+		ls_trace_ids[i] = NULL;
+	}
+	ls_trace_nids = 0;
+}
+
+
+/*
+ * Function:	ls_trace_exit
+ * Description:	Write out buffered records at exit
+ *
+ * Parameters:	-
+ *
+ * Return:
+ */
+static void
+ls_trace_exit(void)
+{
+	ls_trace_flush();
+
+	(void) pthread_mutex_lock(&ls_trace_lock);
+	ls_trace_free_ids();
+	(void) pthread_mutex_unlock(&ls_trace_lock);
+}
+
+
+/*
+ * Function:	ls_trace_open_locked
+ * Description:	Create trace file and write its header. An existing
+ *		file is removed first and the new one created exclusively,
+ *		so that a link planted in /tmp can't redirect the writes.
+ *		Called with ls_trace_lock held.
+ *
+ * Parameters:	path - trace file
+ *
+ * Return:	LS_E_SUCCESS - trace file created
+ *		LS_E_NOMEM - memory allocation failed
+ *		LS_E_TRACE_FAILED - couldn't create trace file
+ */
+static ls_errno_t
+ls_trace_open_locked(const char *path)
+{
+	static boolean_t	exit_registered = B_FALSE;
+	char			hdr[32];
+	uint32_t		u32;
+	int64_t			i64;
+	char			*filename;
+	int			fd;
+
+	if ((filename = strdup(path)) == NULL)
+		return (LS_E_NOMEM);
+
+	(void) unlink(path);
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW,
+	    0644)) < 0) {
+		free(filename);
+		return (LS_E_TRACE_FAILED);
+	}
+	(void) fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	/* switch to the new file */
+
+	if (ls_trace_fd >= 0) {
+		ls_trace_write();
+		(void) close(ls_trace_fd);
+	}
+	free(ls_trace_filename);
+	ls_trace_filename = filename;
+	ls_trace_fd = fd;
+
+	/* definitions are repeated in the new file */
+
+	for (u32 = 0; u32 < LS_TRACE_FMT_SLOTS; u32++)
+		ls_trace_fmts[u32].ptr = NULL;
+	ls_trace_free_ids();
+
+	(void) memcpy(hdr, "LSTRACE", 8);
+	u32 = LS_TRACE_MAGIC;
+	(void) memcpy(hdr + 8, &u32, 4);
+	u32 = LS_TRACE_VERSION;
+	(void) memcpy(hdr + 12, &u32, 4);
+	i64 = gethrtime();
+	(void) memcpy(hdr + 16, &i64, 8);
+	i64 = time(NULL);
+	(void) memcpy(hdr + 24, &i64, 8);
+	ls_trace_append(hdr, sizeof (hdr));
+	ls_trace_write();
+
+	if (!exit_registered && atexit(ls_trace_exit) == 0)
+		exit_registered = B_TRUE;
+
+	return (LS_E_SUCCESS);
+}
+
+
+/*
+ * Function:	ls_trace_id
+ * Description:	Return number of module id, define it if it's new.
+ *		The id is copied, callers like the Python binding pass
+ *		buffers which don't outlive the call. Called with
+ *		ls_trace_lock held.
+ *
+ * Parameters:	id - module identification
+ *
+ * Return:	number of the module id
+ */
+static uint16_t
+ls_trace_id(const char *id)
+{
+	char		rec[1 + 2 + 2 + LS_ID_MAXLEN];
+	uint16_t	i, len;
+
+	for (i = 0; i < ls_trace_nids; i++) {
+		if (ls_trace_ids[i] != NULL &&
+		    strncmp(ls_trace_ids[i], id, LS_ID_MAXLEN) == 0)
+			return (i);
+	}
+
+	/*
+	 * If there are too many, reuse the last one. If the copy can't
+	 * be made, the id is defined again next time.
+	 */
+
+	if (ls_trace_nids == LS_TRACE_MAXIDS)
+		i = LS_TRACE_MAXIDS - 1;
+	else
+		i = ls_trace_nids++;
+	free(ls_trace_ids[i]);
+	ls_trace_ids[i] = strndup(id, LS_ID_MAXLEN);
+
+	len = strnlen(id, LS_ID_MAXLEN);
+	rec[0] = LS_TREC_ID;
+	(void) memcpy(rec + 1, &i, 2);
+	(void) memcpy(rec + 3, &len, 2);
+	(void) memcpy(rec + 5, id, len);
+	ls_trace_append(rec, 5 + len);
+
+	return (i);
+}
+
+
+/*
+ * Function:	ls_trace_parse
+ * Description:	Find out types of arguments of printf(3C) format
+ *
+ * Parameters:	fmt - the format
+ *		args - array of LS_TRACE_MAXARGS argument types
+ *
+ * Return:	number of arguments, -1 if the format contains conversion
+ *		which can't be recorded
+ */
+static int
+ls_trace_parse(const char *fmt, uint8_t *args)
+{
+	const char	*p = fmt;
+	int		n = 0, lng, i;
+
+	while ((p = strchr(p, '%')) != NULL) {
+		p++;
+		if (*p == '%') {
+			p++;
+			continue;
+		}
+
+		/* flags, width and precision */
+
+		p += strspn(p, "-+ #0'");
+		for (i = 0; i < 2; i++) {
+			if (*p == '*') {
+				if (n == LS_TRACE_MAXARGS)
+					return (-1);
+				args[n++] = LS_TA_INT;
+				p++;
+			} else
+				p += strspn(p, "0123456789");
+			if (i == 0 && *p == '.')
+				p++;
+			else
+				break;
+		}
+
+		/* length modifier */
+
+		lng = 0;
+		switch (*p) {
+		case 'h':
+			p += (p[1] == 'h') ? 2 : 1;
+			break;
+		case 'l':
+			lng = (p[1] == 'l') ? 2 : 1;
+			p += lng;
+			break;
+		case 'j':
+		case 'q':
+			lng = 2;
+			p++;
+			break;
+		case 'z':
+		case 't':
+			lng = 1;
+			p++;
+			break;
+		case 'L':
+			lng = 3;
+			p++;
+			break;
+		}
+
+		if (n == LS_TRACE_MAXARGS)
+			return (-1);
+
+		switch (*p) {
+		case 'd':
+		case 'i':
+			args[n++] = lng == 0 ? LS_TA_INT :
+			    (lng == 1 ? LS_TA_LONG : LS_TA_LLONG);
+			break;
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+			args[n++] = lng == 0 ? LS_TA_UINT :
+			    (lng == 1 ? LS_TA_ULONG : LS_TA_ULLONG);
+			break;
+		case 'c':
+			if (lng != 0)
+				return (-1);
+			args[n++] = LS_TA_INT;
+			break;
+		case 'e':
+		case 'E':
+		case 'f':
+		case 'F':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			args[n++] = lng == 3 ? LS_TA_LDOUBLE : LS_TA_DOUBLE;
+			break;
+		case 's':
+			if (lng != 0)
+				return (-1);
+			args[n++] = LS_TA_STR;
+			break;
+		case 'p':
+			args[n++] = LS_TA_PTR;
+			break;
+		default:
+			/* %n, wide characters, positional arguments */
+			return (-1);
+		}
+		p++;
+	}
+
+	return (n);
+}
+
+
+/*
+ * Function:	ls_trace_fmt
+ * Description:	Look up format string, define it if it's new.
+ *		Called with ls_trace_lock held.
+ *
+ * Parameters:	fmt - format string
+ *
+ * Return:	the format, NULL if memory allocation failed
+ */
+static ls_tfmt_t *
+ls_trace_fmt(const char *fmt)
+{
+	ls_tfmt_t	*f;
+	char		rec[1 + 4 + 2];
+	uint16_t	len;
+
+	f = &ls_trace_fmts[((uintptr_t)fmt >> 3) % LS_TRACE_FMT_SLOTS];
+
+	/* callers may pass the same buffer with different formats */
+
+	if (f->ptr == fmt && strcmp(f->text, fmt) == 0)
+		return (f);
+
+	free(f->text);
+	f->ptr = NULL;
+	len = strnlen(fmt, LS_MESSAGE_MAXLEN);
+	if ((f->text = strndup(fmt, len)) == NULL)
+		return (NULL);
+	f->ptr = fmt;
+	f->num = ls_trace_nfmts++;
+	f->nargs = ls_trace_parse(f->text, f->args);
+
+	rec[0] = LS_TREC_FMT;
+	(void) memcpy(rec + 1, &f->num, 4);
+	(void) memcpy(rec + 5, &len, 2);
+	ls_trace_append(rec, sizeof (rec));
+	ls_trace_append(f->text, len);
+
+	return (f);
+}
+
+
+/*
+ * Function:	ls_trace_arg_str
+ * Description:	Put string argument into event record
+ *
+ * Parameters:	p - where to put it
+ *		end - end of the record
+ *		s - the string
+ *
+ * Return:	end of the argument
+ */
+static char *
+ls_trace_arg_str(char *p, char *end, const char *s)
+{
+	uint16_t	len;
+	ptrdiff_t	room = MAX(end - p - 3, 0);
+
+	*p++ = 's';
+	if (s == NULL) {
+		len = 0xffff;
+		(void) memcpy(p, &len, 2);
+		return (p + 2);
+	}
+	len = strnlen(s, MIN(LS_MESSAGE_MAXLEN, room));
+	(void) memcpy(p, &len, 2);
+	(void) memcpy(p + 2, s, len);
+	return (p + 2 + len);
+}
+
+
+/*
+ * Function:	ls_trace_record
+ * Description:	Record event. Arguments are taken from app according to
+ *		the format, or msg is recorded with format "%s".
+ *		Called with ls_trace_lock held.
+ *
+ * Parameters:	id - module identification
+ *		level - debug level
+ *		f - format, NULL for msg
+ *		app - arguments
+ *		msg - formatted message
+ *
+ * Return:
+ */
+static void
+ls_trace_record(const char *id, ls_dbglvl_t level, ls_tfmt_t *f,
+    va_list *app, const char *msg)
+{
+	char		rec[LS_TRACE_EVENT_MAX];
+	char		*p, *end = rec + sizeof (rec);
+	int64_t		i64;
+	uint64_t	u64;
+	double		d;
+	uint32_t	num = 0;
+	uint16_t	idnum, len;
+	int		i;
+
+	idnum = ls_trace_id(id);
+	if (f != NULL)
+		num = f->num;
+
+	rec[0] = LS_TREC_EVENT;
+	i64 = gethrtime();
+	(void) memcpy(rec + 1, &i64, 8);
+	(void) memcpy(rec + 9, &idnum, 2);
+	rec[11] = (char)level;
+	(void) memcpy(rec + 12, &num, 4);
+	p = rec + 18;
+
+	if (f == NULL) {
+		p = ls_trace_arg_str(p, end, msg);
+	} else {
+		/* every argument but string takes 9 bytes */
+		for (i = 0; i < f->nargs; i++) {
+			switch (f->args[i]) {
+			case LS_TA_INT:
+				*p = 'i';
+				i64 = va_arg(*app, int);
+				break;
+			case LS_TA_LONG:
+				*p = 'i';
+				i64 = va_arg(*app, long);
+				break;
+			case LS_TA_LLONG:
+				*p = 'i';
+				i64 = va_arg(*app, long long);
+				break;
+			case LS_TA_UINT:
+				*p = 'u';
+				i64 = va_arg(*app, unsigned int);
+				break;
+			case LS_TA_ULONG:
+				*p = 'u';
+				i64 = va_arg(*app, unsigned long);
+				break;
+			case LS_TA_ULLONG:
+				*p = 'u';
+				u64 = va_arg(*app, unsigned long long);
+				(void) memcpy(&i64, &u64, 8);
+				break;
+			case LS_TA_DOUBLE:
+				*p = 'f';
+				d = va_arg(*app, double);
+				(void) memcpy(&i64, &d, 8);
+				break;
+			case LS_TA_LDOUBLE:
+				*p = 'f';
+				d = (double)va_arg(*app, long double);
+				(void) memcpy(&i64, &d, 8);
+				break;
+			case LS_TA_PTR:
+				*p = 'p';
+				i64 = (uintptr_t)va_arg(*app, void *);
+				break;
+			case LS_TA_STR:
+				p = ls_trace_arg_str(p, end - 9 *
+				    (f->nargs - i - 1), va_arg(*app, char *));
+				continue;
+			}
+			(void) memcpy(p + 1, &i64, 8);
+			p += 9;
+		}
+	}
+
+	len = p - (rec + 18);
+	(void) memcpy(rec + 16, &len, 2);
+	ls_trace_append(rec, p - rec);
+
+	/* the process may not live long enough to write out errors */
+
+	if (level <= LS_DBGLVL_ERR)
+		ls_trace_write();
+}
+
+
+/*
+ * Function:	ls_trace_begin
+ * Description:	Take ls_trace_lock and make sure the trace file is open
+ *
+ * Parameters:	-
+ *
+ * Return:	B_TRUE - lock taken, event can be recorded
+ *		B_FALSE - trace file couldn't be created
+ */
+static boolean_t
+ls_trace_begin(void)
+{
+	(void) pthread_mutex_lock(&ls_trace_lock);
+	if (ls_trace_fd < 0 &&
+	    ls_trace_open_locked(LS_TRACE_DEFAULT) != LS_E_SUCCESS) {
+		(void) pthread_mutex_unlock(&ls_trace_lock);
+		return (B_FALSE);
+	}
+	return (B_TRUE);
+}
+
+/* ----------------------- private functions -------------------------- */
+
+/*
+ * Function:	ls_trace_open
+ * Description:	Start recording debug messages into trace file
+ *
+ * Parameters:	path - trace file, created or truncated
+ *
+ * Return:	LS_E_SUCCESS - trace file created
+ *		LS_E_NOMEM - memory allocation failed
+ *		LS_E_TRACE_FAILED - couldn't create trace file
+ */
+ls_errno_t
+ls_trace_open(const char *path)
+{
+	ls_errno_t	ret;
+
+	(void) pthread_mutex_lock(&ls_trace_lock);
+	ret = ls_trace_open_locked(path);
+	(void) pthread_mutex_unlock(&ls_trace_lock);
+
+	return (ret);
+}
+
+
+/*
+ * Function:	ls_trace_vevent
+ * Description:	Record debug message given by format and arguments,
+ *		without formatting it if possible
+ *
+ * Parameters:	id - module identification
+ *		level - debug level
+ *		fmt - debugging message format
+ *		ap - arguments
+ *
+ * Return:
+ */
+void
+ls_trace_vevent(const char *id, ls_dbglvl_t level, const char *fmt,
+    va_list ap)
+{
+	char		buf[LS_MESSAGE_MAXLEN + LS_ID_MAXLEN + 1];
+	ls_tfmt_t	*f;
+	va_list		aq;
+
+	if (!ls_trace_begin())
+		return;
+
+	if ((f = ls_trace_fmt(fmt)) != NULL && f->nargs >= 0) {
+		va_copy(aq, ap);
+		ls_trace_record(id, level, f, &aq, NULL);
+		va_end(aq);
+	} else {
+		(void) vsnprintf(buf, sizeof (buf), fmt, ap);
+		ls_trace_record(id, level, NULL, NULL, buf);
+	}
+
+	(void) pthread_mutex_unlock(&ls_trace_lock);
+}
+
+
+/*
+ * Function:	ls_trace_flush
+ * Description:	Write out buffered records
+ *
+ * Parameters:	-
+ *
+ * Return:
+ */
+void
+ls_trace_flush(void)
+{
+	(void) pthread_mutex_lock(&ls_trace_lock);
+	if (ls_trace_fd >= 0)
+		ls_trace_write();
+	(void) pthread_mutex_unlock(&ls_trace_lock);
+}
+
+
+/*
+ * Function:	ls_trace_file
+ * Description:	Return name of the trace file
+ *
+ * Parameters:	-
+ *
+ * Return:	trace file, NULL if not tracing
+ */
+const char *
+ls_trace_file(void)
+{
+	return (ls_trace_fd >= 0 ? ls_trace_filename : NULL);
+}
+
+/* ----------------------- public functions --------------------------- */
+
+/*
+ * Function:	ls_trace_dbg_method
+ * Description:	Debug method recording messages into binary trace file,
+ *		see ls_register_dbg_method(). Messages coming through
+ *		ls_write_dbg_[v]message() are recorded without formatting,
+ *		the ones passed here directly are recorded as text.
+ *
+ * Parameters:	id - module identification
+ *		level - debug message level
+ *		msg - debugging message
+ *
+ * Return:
+ */
+void
+ls_trace_dbg_method(const char *id, ls_dbglvl_t level, char *msg)
+{
+	if (msg == NULL || !ls_trace_begin())
+		return;
+
+	ls_trace_record(id, level, NULL, NULL, msg);
+	(void) pthread_mutex_unlock(&ls_trace_lock);
+}
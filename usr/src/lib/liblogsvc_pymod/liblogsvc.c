@@ -34,6 +34,8 @@
 static PyObject *write_log_message(PyObject *, PyObject *);
 static PyObject *write_dbg_message(PyObject *, PyObject *);
 static PyObject *init_logsvc(PyObject *, PyObject *);
+static PyObject *span_begin(PyObject *, PyObject *);
+static PyObject *span_end(PyObject *, PyObject *);
 void initliblogsvc();
 
 /* Private python initialization structure */
@@ -45,6 +47,10 @@ static struct PyMethodDef liblogsvcMethods[] = {
 	    "Write to debg logfile"},
 	{"init_log", init_logsvc, METH_VARARGS,
 	    "Initialize logging"},
+	{"span_begin", span_begin, METH_NOARGS,
+	    "Mark beginning of install timeline span"},
+	{"span_end", span_end, METH_VARARGS,
+	    "Record install timeline span"},
 	{NULL, NULL, 0, NULL}
 };
 
@@ -94,7 +100,8 @@ write_dbg_message(PyObject *self, PyObject *args)
 
 	if (level <= ls_get_dbg_level()) {
 		(void) strlcpy(buf, msg, sizeof (buf));
-		ls_write_dbg_message(id, level, buf);
+		/* message is formatted, don't let "%" be taken for format */
+		ls_write_dbg_message(id, level, "%s", buf);
 	}
 	return (Py_BuildValue("i", 1));
 }
@@ -123,6 +130,41 @@ init_logsvc(PyObject *self, PyObject *args)
 	return (Py_BuildValue("i", 1));
 }
 
+/*
+ * span_begin - Python-callable wrapper for ls_span_begin
+ * parameters: none
+ * returns time stamp to be passed to span_end()
+ * declared static - callable only by Python through table
+ */
+static PyObject *
+span_begin(PyObject *self, PyObject *args)
+{
+	return (Py_BuildValue("L", (PY_LONG_LONG)ls_span_begin()));
+}
+
+/*
+ * span_end - Python-callable wrapper for ls_span_end
+ * parameters:
+ *      start - time stamp returned by span_begin()
+ *      cat - category of the span
+ *      name - name of the span
+ *      detail - optional additional information
+ * returns 0 if argument parsing error, 1 otherwise
+ * declared static - callable only by Python through table
+ */
+static PyObject *
+span_end(PyObject *self, PyObject *args)
+{
+	PY_LONG_LONG	start;
+	char		*cat, *name;
+	char		*detail = NULL;
+
+	if (!PyArg_ParseTuple(args, "Lss|z", &start, &cat, &name, &detail))
+		return (Py_BuildValue("i", 0));
+	ls_span_end((hrtime_t)start, cat, name, detail);
+	return (Py_BuildValue("i", 1));
+}
+
 void
 initliblogsvc()
 {
@@ -62,11 +62,16 @@ om_initiate_target_discovery(om_callback_t cb)
 	pthread_t	discovery_thread;
 	callback_args_t *cb_args;
 	int		ret;
+	hrtime_t	start;
 
 	/*
 	 * call the TD module discover to find the disks on the system
 	 */
-	if (start_td_disk_discover(&disks_total) != OM_SUCCESS) {
+	start = ls_span_begin();
+	ret = start_td_disk_discover(&disks_total);
+	ls_span_end(start, "discovery", "start_td_disk_discover", NULL);
+
+	if (ret != OM_SUCCESS) {
 		om_set_error(OM_TD_DISCOVERY_FAILED);
 		return (OM_FAILURE);
 	}
@@ -151,6 +156,7 @@ handle_disk_discovery(void *args)
 	static int		status = 0;
 	om_callback_t		cb;
 	int			num_disks;
+	hrtime_t		start;
 
 	cp = (callback_args_t *)args;
 
@@ -165,14 +171,25 @@ handle_disk_discovery(void *args)
 		if (system_disks != NULL || solaris_instances != NULL) {
 			om_free_target_data(0);
 		}
+		start = ls_span_begin();
 		system_disks = get_td_disk_info_discover(&num_disks, cb);
+		ls_span_end(start, "discovery", "disks", NULL);
 		/*
 		 * if we don't get any disks, return failure
 		 */
 		if (system_disks != NULL) {
+			start = ls_span_begin();
 			get_td_disk_parts_discover(system_disks, cb);
+			ls_span_end(start, "discovery", "partitions", NULL);
+
+			start = ls_span_begin();
 			get_td_disk_slices_discover(system_disks, cb);
+			ls_span_end(start, "discovery", "slices", NULL);
+
+			start = ls_span_begin();
 			solaris_instances = get_td_solaris_instances(cb);
+			ls_span_end(start, "discovery", "solaris_instances",
+			    NULL);
 		}
 	}
 
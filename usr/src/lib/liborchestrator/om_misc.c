@@ -237,12 +237,9 @@ void
 om_debug_print(ls_dbglvl_t dbg_lvl, char *fmt, ...)
 {
 	va_list	ap;
-	char	buf[MAXPATHLEN + 1] = "";
 
 	va_start(ap, fmt);
-	/*LINTED*/
-	(void) vsprintf(buf, fmt, ap);
-	(void) ls_write_dbg_message("OM", dbg_lvl, buf);
+	ls_write_dbg_vmessage("OM", dbg_lvl, fmt, ap);
 	va_end(ap);
 }
 
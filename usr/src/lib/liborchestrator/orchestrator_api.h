@@ -73,6 +73,19 @@ typedef struct om_callback_info {
 
 typedef void (*om_callback_t)(om_callback_info_t *, uintptr_t);
 
+/*
+ * progress of the file transfer during OM_SOFTWARE_UPDATE milestone,
+ * see om_get_transfer_progress()
+ */
+typedef struct om_transfer_progress {
+	boolean_t	active;		/* file transfer in progress */
+	uint64_t	bytes_done;	/* bytes transferred so far */
+	uint64_t	bytes_total;	/* expected total, 0 if unknown */
+	uint64_t	files_done;	/* files transferred so far */
+	uint64_t	throughput;	/* bytes per second, 0 if unknown */
+	uint32_t	eta;		/* seconds remaining, 0 if unknown */
+} om_transfer_progress_t;
+
 typedef enum {
 	OM_DTYPE_UNKNOWN = 0,
 	OM_DTYPE_ATA,
@@ -519,6 +532,7 @@ uint64_t	om_get_recommended_size(char *media, char *distro);
 uint32_t	om_get_max_usable_disk_size(void);
 boolean_t	om_is_automated_installation(void);
 int		om_unmount_target_be(void);
+void		om_get_transfer_progress(om_transfer_progress_t *progress);
 
 
 uid_t		om_get_user_uid(void);
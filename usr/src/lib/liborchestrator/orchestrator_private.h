@@ -118,6 +118,12 @@ extern "C" {
 #define	TMP_INITDEFSYSLOC	"/tmp/.init.defSysLoc"
 #define	TMP_DEFSYSLOC		"/tmp/.defSysLoc"
 
+/*
+ * target discovery results kept between installer runs, in directory
+ * writable only by root
+ */
+#define	TMP_TD_SNAPSHOT		"/var/run/.td_snapshot"
+
 /*
  * Definitions for ZFS pool
  */
@@ -146,6 +152,20 @@ extern "C" {
 #define	IMAGE_INFO_COMPRESSION_TYPE	"COMPRESSION_TYPE"
 #define	IMAGE_INFO_LINE_MAXLN		1000
 
+/*
+ * image content manifest, see TM_manifest_open(). If present, image size
+ * is taken from it rather than from image information file.
+ */
+#define	IMAGE_MANIFEST_FILE_NAME	"/.cdrom/.livecd-cdrom-manifest"
+
+/*
+ * "zfs send" stream of the image, created by distro_const. It is received
+ * into root dataset of the new boot environment instead of copying the
+ * running system if TM_PERFORM_ZFS_RECV transfer is requested.
+ */
+#define	IMAGE_ZFS_STREAM_FILE_NAME	"/.cdrom/solaris.zstream"
+#define	IMAGE_ZFS_STREAM_DATASET	ROOTPOOL_NAME "/ROOT/" INIT_BE_NAME
+
 /* If following file exists, we are in Automated Installer environment */
 #define	AUTOMATED_INSTALLER_MARK	"/.autoinstall"
 
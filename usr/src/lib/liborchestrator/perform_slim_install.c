@@ -32,6 +32,7 @@
 #include <sys/param.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/time.h>
 #include <dirent.h>
 #include <sys/wait.h>
 #include <crypt.h>
@@ -90,6 +91,9 @@ boolean_t		create_swap_and_dump = B_FALSE;
 boolean_t		create_swap_slice = B_FALSE;
 static	pthread_t	ti_thread;
 static	int		ti_ret;
+/* start and end of target instantiation, see log_install_timings() */
+static	hrtime_t	ti_start;
+static	hrtime_t	ti_end;
 static	om_breakpoint_t	om_breakpoint = OM_no_breakpoint;
 int32_t requested_swap_size = -1;
 int32_t requested_dump_size = -1;
@@ -105,6 +109,8 @@ static	int		l_zfs_shared_fs_num = ZFS_SHARED_FS_NUM - 1;
 
 static om_callback_t	om_cb;
 static char		zfs_device[MAXDEVSIZE];
+/* root pool and BE come with block image, see om_perform_transfer_block() */
+static boolean_t	block_transfer = B_FALSE;
 static char		swap_device[MAXDEVSIZE];
 static char		*zfs_fs_names[ZFS_FS_NUM] = {"/"};
 static char		zfs_shared_user_login[MAXPATHLEN] = "";
@@ -147,12 +153,23 @@ static int	prepare_zfs_root_pool_attrs(nvlist_t **attrs, char *disk_name,
 static int	prepare_zfs_volume_attrs(nvlist_t **attrs,
     uint64_t available_disk_space, boolean_t create_min_swap_only);
 static int	prepare_be_attrs(nvlist_t **attrs);
+static int	prepare_layout_attrs(nvlist_t **attrs, nvlist_t **targets,
+    uint_t num_targets);
+static int	mount_target_be(char *target, char *what);
+static int	om_perform_transfer_block(nvlist_t *nvl, char *target,
+    tm_callback_t prog);
+static int	om_perform_transfer_zfs(nvlist_t *nvl, char *target,
+    tm_callback_t prog);
 static int	obtain_image_info(image_info_t *info);
 static char	*get_dataset_property(char *dataset_name, char *property);
+static uint64_t	get_pool_guid(char *device);
 static uint64_t	get_available_disk_space(void);
 static uint64_t get_recommended_size_for_software(void);
 static uint32_t	get_mem_size(void);
 static void	log_bld_info(char *, char *);
+static int	wait_for_ti(void);
+static void	log_install_timings(hrtime_t xfer_start, hrtime_t xfer_end,
+    hrtime_t install_end);
 static uint64_t	calc_swap_size(uint64_t available_swap_space);
 static uint64_t	calc_dump_size(uint64_t available_dump_space);
 
@@ -251,11 +268,16 @@ om_perform_install(nvlist_t *uchoices, om_callback_t cb)
 	uint8_t		type;
 	char		*ti_test = getenv("TI_SLIM_TEST");
 	char		*nv_string;
+	uint32_t	mechanism;
 	int		ret = 0;
 
 	if (uchoices == NULL) {
 		om_set_error(OM_BAD_INPUT);
 	}
+
+	/* abort of a previous install doesn't apply to this one */
+	TM_reset_abort();
+
 	if (!ti_test) {
 
 	/*
@@ -583,21 +605,34 @@ om_perform_install(nvlist_t *uchoices, om_callback_t cb)
 		    " Installer exiting.\n");
 		exit(0);
 	}
+	if (nvlist_lookup_nvlist_array(uchoices, OM_ATTR_TRANSFER,
+	    &transfer_attr, &transfer_attr_num) != 0) {
+		transfer_attr = NULL;
+	}
+
+	/*
+	 * Block image brings its own root pool and BE, TI only
+	 * creates partitions and slices for it then
+	 */
+	block_transfer = (transfer_attr != NULL &&
+	    nvlist_lookup_uint32(transfer_attr[0], TM_ATTR_MECHANISM,
+	    &mechanism) == 0 && mechanism == TM_PERFORM_BLOCK);
+
 	/*
 	 * Start a thread to call TI module for fdisk & vtoc targets.
+	 * The transfer may start reading its source before TI finishes,
+	 * it waits for the target by means of TM_set_target_state().
 	 */
 
+	TM_set_target_state(TM_TARGET_PENDING);
+	ti_start = gethrtime();
 	ti_ret = pthread_create(&ti_thread, NULL, do_ti, target_attrs);
 	if (ti_ret != 0) {
+		TM_set_target_state(TM_TARGET_FAILED);
 		om_set_error(OM_ERROR_THREAD_CREATE);
 		return (OM_FAILURE);
 	}
 
-	if (nvlist_lookup_nvlist_array(uchoices, OM_ATTR_TRANSFER,
-	    &transfer_attr, &transfer_attr_num) != 0) {
-		transfer_attr = NULL;
-	}
-
 	/*
 	 * Start the install.
 	 */
@@ -615,6 +650,204 @@ install_return:
 	return (status);
 }
 
+/*
+ * mount_target_be
+ * Mounts BE INIT_BE_NAME and shared filesystems of the root pool on
+ * alternate root, the way TI does for newly created BE, after the
+ * transfer brought or replaced their contents.
+ * Input:	target - alternate root
+ *		what - source of the BE, for messages
+ * Return:	OM_SUCCESS
+ *		OM_FAILURE
+ */
+static int
+mount_target_be(char *target, char *what)
+{
+	char		cmd[MAXPATHLEN];
+	nvlist_t	*be_attrs;
+	int		i, ret;
+
+	if (nvlist_alloc(&be_attrs, NV_UNIQUE_NAME, 0) != 0) {
+		om_set_error(OM_NO_SPACE);
+		return (OM_FAILURE);
+	}
+
+	if (nvlist_add_string(be_attrs, BE_ATTR_ORIG_BE_NAME,
+	    INIT_BE_NAME) != 0 ||
+	    nvlist_add_string(be_attrs, BE_ATTR_MOUNTPOINT, target) != 0 ||
+	    nvlist_add_uint16(be_attrs, BE_ATTR_MOUNT_FLAGS, 0) != 0) {
+		om_log_print("Couldn't add BE attributes to nv list.\n");
+		nvlist_free(be_attrs);
+		return (OM_FAILURE);
+	}
+
+	ret = be_mount(be_attrs);
+	nvlist_free(be_attrs);
+	if (ret != BE_SUCCESS) {
+		om_log_print("Couldn't mount BE from %s,"
+		    " be_mount() failed with return code %d\n", what, ret);
+		return (OM_FAILURE);
+	}
+
+	/*
+	 * Mount shared filesystems on alternate root, the image needn't
+	 * contain all of them
+	 */
+
+	for (i = 0; i < l_zfs_shared_fs_num; i++) {
+		(void) snprintf(cmd, sizeof (cmd),
+		    "/usr/sbin/zfs set mountpoint=%s%s %s%s && "
+		    "/usr/sbin/zfs mount %s%s", target,
+		    zfs_shared_fs_names[i], ROOTPOOL_NAME,
+		    zfs_shared_fs_names[i], ROOTPOOL_NAME,
+		    zfs_shared_fs_names[i]);
+
+		om_log_print("%s\n", cmd);
+		ret = td_safe_system(cmd, B_TRUE);
+		if (ret == -1 || WEXITSTATUS(ret) != 0) {
+			om_debug_print(OM_DBGLVL_WARN,
+			    "Couldn't mount %s%s, err=%d\n", ROOTPOOL_NAME,
+			    zfs_shared_fs_names[i], ret);
+		}
+	}
+
+	return (OM_SUCCESS);
+}
+
+/*
+ * om_perform_transfer_block
+ * Writes block image of root pool slice, prepared on identical hardware,
+ * onto the slice set aside by TI. Then imports the root pool from the image
+ * and mounts its BE and shared filesystems on alternate root, the way TI
+ * does for newly created BE, so that the rest of the install can proceed.
+ * The image has to contain root pool ROOTPOOL_NAME with BE INIT_BE_NAME.
+ * Input:	nvl - transfer attributes, TM_BLOCK_TARGET defaults to
+ *		the raw device of the root pool slice
+ *		target - alternate root
+ *		prog - progress callback
+ * Return:	OM_SUCCESS
+ *		OM_FAILURE
+ */
+static int
+om_perform_transfer_block(nvlist_t *nvl, char *target, tm_callback_t prog)
+{
+	char		cmd[MAXPATHLEN], device[MAXPATHLEN];
+	char		*value;
+	uint64_t	guid;
+	int		ret;
+
+	if (nvlist_lookup_string(nvl, TM_BLOCK_TARGET, &value) != 0) {
+		(void) snprintf(device, sizeof (device), "/dev/rdsk/%s",
+		    zfs_device);
+		if (nvlist_add_string(nvl, TM_BLOCK_TARGET, device) != 0) {
+			om_set_error(OM_NO_SPACE);
+			return (OM_FAILURE);
+		}
+	} else {
+		(void) strlcpy(device, value, sizeof (device));
+	}
+
+	ret = TM_perform_transfer(nvl, prog);
+	if (ret != TM_SUCCESS) {
+		om_log_print(NSI_TRANSFER_FAILED, ret);
+		return (OM_FAILURE);
+	}
+
+	/*
+	 * Import the pool without mounting anything, mountpoints in
+	 * the image are those of the installed system. It is imported
+	 * by guid taken from the written labels, another pool of the
+	 * same name may be visible to the system.
+	 */
+
+	if ((guid = get_pool_guid(device)) == 0) {
+		om_log_print("Couldn't find root pool in block image\n");
+		return (OM_FAILURE);
+	}
+	(void) snprintf(cmd, sizeof (cmd),
+	    "/usr/sbin/zpool import -f -N %llu", (u_longlong_t)guid);
+	om_log_print("%s\n", cmd);
+	ret = td_safe_system(cmd, B_TRUE);
+	if (ret == -1 || WEXITSTATUS(ret) != 0) {
+		om_log_print("Couldn't import root pool from block image\n");
+		return (OM_FAILURE);
+	}
+
+	/*
+	 * Snapshot of the installation is taken at the end of install,
+	 * drop the one which may come with the image
+	 */
+
+	(void) snprintf(cmd, sizeof (cmd), "/usr/sbin/zfs destroy %s/ROOT/%s%s",
+	    ROOTPOOL_NAME, INIT_BE_NAME, INSTALL_SNAPSHOT_NAME);
+	(void) td_safe_system(cmd, B_TRUE);
+
+	return (mount_target_be(target, "block image"));
+}
+
+/*
+ * om_perform_transfer_zfs
+ * Receives "zfs send" stream of the image into root dataset of the BE
+ * created by TI, replacing its contents. This is only done if the caller
+ * asks for TM_PERFORM_ZFS_RECV transfer mechanism explicitly. The stream
+ * carries the image area as mastered by distro_const rather than the
+ * running live system, so there are no files of the live media to skip
+ * or clobber as with the copy of the running system.
+ * The BE and its shared filesystems are unmounted for the receive and
+ * mounted on alternate root again afterwards, so that the rest of the
+ * install works with the received contents.
+ * Input:	nvl - transfer attributes, TM_ZFS_STREAM and TM_ZFS_DATASET
+ *		default to the stream on the media and root dataset of the BE
+ *		target - alternate root
+ *		prog - progress callback
+ * Return:	OM_SUCCESS
+ *		OM_FAILURE
+ */
+static int
+om_perform_transfer_zfs(nvlist_t *nvl, char *target, tm_callback_t prog)
+{
+	char		cmd[MAXPATHLEN];
+	char		*value;
+	int		i, ret;
+
+	if ((nvlist_lookup_string(nvl, TM_ZFS_STREAM, &value) != 0 &&
+	    nvlist_add_string(nvl, TM_ZFS_STREAM,
+	    IMAGE_ZFS_STREAM_FILE_NAME) != 0) ||
+	    (nvlist_lookup_string(nvl, TM_ZFS_DATASET, &value) != 0 &&
+	    nvlist_add_string(nvl, TM_ZFS_DATASET,
+	    IMAGE_ZFS_STREAM_DATASET) != 0)) {
+		om_set_error(OM_NO_SPACE);
+		return (OM_FAILURE);
+	}
+
+	/* make sure we are not in alternate root */
+	(void) chdir("/root");
+
+	for (i = l_zfs_shared_fs_num - 1; i >= 0; i--) {
+		(void) snprintf(cmd, sizeof (cmd),
+		    "/usr/sbin/zfs unmount %s%s",
+		    ROOTPOOL_NAME, zfs_shared_fs_names[i]);
+
+		om_log_print("%s\n", cmd);
+		ret = td_safe_system(cmd, B_TRUE);
+		if (ret == -1 || WEXITSTATUS(ret) != 0) {
+			om_log_print("Couldn't unmount %s%s\n",
+			    ROOTPOOL_NAME, zfs_shared_fs_names[i]);
+			return (OM_FAILURE);
+		}
+	}
+	if (om_unmount_target_be() != OM_SUCCESS)
+		return (OM_FAILURE);
+
+	ret = TM_perform_transfer(nvl, prog);
+	if (ret != TM_SUCCESS) {
+		om_log_print(NSI_TRANSFER_FAILED, ret);
+		return (OM_FAILURE);
+	}
+
+	return (mount_target_be(target, "image stream"));
+}
+
 /*
  * perform transfer based on an ordered attribute list of initializers
  * followed by the transfer action itself
@@ -1135,6 +1368,9 @@ do_ti(void *args)
 	uintptr_t		app_data = 0;
 	char			*disk_name;
 	nvlist_t		*ti_ex_attrs = NULL;
+	nvlist_t		*ti_layout[2];
+	uint_t			ti_layout_num = 0;
+	uint32_t		ti_failed_type;
 	uint64_t		available_disk_space;
 	uint64_t		recommended_size;
 	uint8_t			install_slice_id;
@@ -1231,6 +1467,22 @@ do_ti(void *args)
 	cb_data.percentage_done = 40;
 	om_cb(&cb_data, app_data);
 
+	/*
+	 * Root pool is written onto the slice together with the block
+	 * image. Its swap volume, if any, is already set up in the image.
+	 */
+
+	if (block_transfer) {
+		(void) snprintf(zfs_device, sizeof (zfs_device), "%ss%d",
+		    disk_name, install_slice_id);
+		if (!create_swap_slice)
+			swap_device[0] = '\0';
+
+		om_log_print("Root pool will be written to %s with block "
+		    "image\n", zfs_device);
+		goto ti_error;
+	}
+
 	/*
 	 * Create ZFS root pool.
 	 */
@@ -1346,20 +1598,10 @@ do_ti(void *args)
 				goto ti_error;
 			}
 
-			/* call TI for creating ZFS volumes */
-
-			ti_status = ti_create_target(ti_ex_attrs, NULL);
+			/* ZFS volumes are created together with BE below */
 
-			nvlist_free(ti_ex_attrs);
+			ti_layout[ti_layout_num++] = ti_ex_attrs;
 			ti_ex_attrs = NULL;
-
-			if (ti_status != TI_E_SUCCESS) {
-				om_log_print(
-				    "Could not create ZFS volume target\n");
-				om_set_error(OM_CANT_CREATE_ZVOL);
-				status = -1;
-				goto ti_error;
-			}
 		}
 	} else if (calc_required_swap_size() != 0 && !create_swap_slice) {
 		/*
@@ -1384,21 +1626,10 @@ do_ti(void *args)
 			goto ti_error;
 		}
 
-		om_log_print("creating ZFS volume for swap\n");
-
-		/* call TI for creating ZFS volumes */
+		/* ZFS volume is created together with BE below */
 
-		ti_status = ti_create_target(ti_ex_attrs, NULL);
-
-		nvlist_free(ti_ex_attrs);
+		ti_layout[ti_layout_num++] = ti_ex_attrs;
 		ti_ex_attrs = NULL;
-
-		if (ti_status != TI_E_SUCCESS) {
-			om_log_print("Could not create ZFS volume target\n");
-			om_set_error(OM_CANT_CREATE_ZVOL);
-			status = -1;
-			goto ti_error;
-		}
 	} else if (!create_swap_slice) {
 		om_log_print("There is not enough disk space available for "
 		    "swap and dump, they won't be created\n");
@@ -1419,8 +1650,33 @@ do_ti(void *args)
 	 * Create BE
 	 */
 
-	if (prepare_be_attrs(&ti_ex_attrs) != OM_SUCCESS) {
+	ti_layout[ti_layout_num] = NULL;
+
+	if (prepare_be_attrs(&ti_layout[ti_layout_num]) != OM_SUCCESS) {
 		om_log_print("Could not prepare BE attribute set\n");
+		if (ti_layout[ti_layout_num] != NULL) {
+			nvlist_free(ti_layout[ti_layout_num]);
+		}
+		status = -1;
+		goto ti_error;
+	}
+	ti_layout_num++;
+
+	/*
+	 * Swap and dump ZFS volumes and BE only depend on the root pool,
+	 * which was created above. The volumes are created directly
+	 * under the pool (<pool>/swap, <pool>/dump) and the BE with
+	 * its file systems under <pool>/ROOT and the shared file system
+	 * datasets, so neither creates or mounts a dataset the other one
+	 * needs. Their sizes were computed from the pool before. TI creates
+	 * targets of one layout concurrently only if they are handled by
+	 * different TI modules, each with its own libzfs handle, so the
+	 * volumes and the BE can be created at the same time.
+	 */
+
+	if (prepare_layout_attrs(&ti_ex_attrs, ti_layout, ti_layout_num) !=
+	    OM_SUCCESS) {
+		om_log_print("Could not prepare layout attribute set\n");
 		if (ti_ex_attrs != NULL) {
 			nvlist_free(ti_ex_attrs);
 		}
@@ -1428,13 +1684,24 @@ do_ti(void *args)
 		goto ti_error;
 	}
 
+	om_log_print("creating ZFS volumes and BE\n");
+
 	ti_status = ti_create_target(ti_ex_attrs, NULL);
 
+	if (nvlist_lookup_uint32(ti_ex_attrs, TI_ATTR_LAYOUT_FAILED_TYPE,
+	    &ti_failed_type) != 0)
+		ti_failed_type = TI_TARGET_TYPE_BE;
+
 	nvlist_free(ti_ex_attrs);
 	ti_ex_attrs = NULL;
 
 	if (ti_status != TI_E_SUCCESS) {
-		om_log_print("Could not create BE target\n");
+		if (ti_failed_type == TI_TARGET_TYPE_ZFS_VOLUME) {
+			om_log_print("Could not create ZFS volume target\n");
+			om_set_error(OM_CANT_CREATE_ZVOL);
+		} else {
+			om_log_print("Could not create BE target\n");
+		}
 		status = -1;
 		goto ti_error;
 	}
@@ -1444,6 +1711,9 @@ do_ti(void *args)
 
 ti_error:
 
+	while (ti_layout_num > 0)
+		nvlist_free(ti_layout[--ti_layout_num]);
+
 	cb_data.num_milestones = 3;
 	cb_data.callback_type = OM_INSTALL_TYPE;
 
@@ -1458,12 +1728,24 @@ ti_error:
 
 	om_cb(&cb_data, app_data);
 
+	ti_end = gethrtime();
+	ls_span_end(ti_start, "install", "target_instantiation", NULL);
+
+	/*
+	 * Check the breakpoint before the target is published, the
+	 * transfer must not start writing into it when the installer is
+	 * about to exit
+	 */
 	if (om_breakpoint == OM_breakpoint_after_TI) {
 		om_log_std(LS_STDERR,
 		    "Breakpoint requested after Target Instantiation."
 		    " Installer exiting.\n");
 		exit(0);
 	}
+
+	/* let the transfer waiting for the target proceed */
+	TM_set_target_state(status == 0 ? TM_TARGET_READY : TM_TARGET_FAILED);
+
 	pthread_exit((void *)status);
 	/* LINTED [no return statement] */
 }
@@ -1487,13 +1769,20 @@ do_transfer(void *args)
 	int				i, status;
 	int				transfer_mode = OM_CPIO_TRANSFER;
 	int				value;
-	void				*exit_val;
+	boolean_t			pipelined, zfs_transfer = B_FALSE;
+	hrtime_t			xfer_start, xfer_end, span;
 	char				buf[20], arc[MAXPATHLEN];
 
-	(void) pthread_join(ti_thread, &exit_val);
+	tcb_args = (struct transfer_callback *)args;
 
-	ti_ret += (int)exit_val;
-	if (ti_ret != 0) {
+	/*
+	 * The default copy transfer doesn't need the target before it
+	 * starts writing to it. It reads its source ahead while TI is
+	 * still running and waits for the target then (TM_WAIT_TARGET).
+	 * Other transfers are started after TI.
+	 */
+	pipelined = (tcb_args->transfer_attr == NULL);
+	if (!pipelined && wait_for_ti() != 0) {
 		om_set_error(OM_TARGET_INSTANTIATION_FAILED);
 		notify_error_status(OM_TARGET_INSTANTIATION_FAILED);
 		status = -1;
@@ -1501,8 +1790,8 @@ do_transfer(void *args)
 	}
 
 	om_log_print("Transfer process initiated\n");
+	xfer_start = gethrtime();
 
-	tcb_args = (struct transfer_callback *)args;
 	transfer_attr = tcb_args->transfer_attr;
 	transfer_attr_num = tcb_args->transfer_attr_num;
 
@@ -1522,7 +1811,9 @@ do_transfer(void *args)
 	 * Determine the mode of operation (IPS or CPIO) and
 	 * set up the transfer appropriately
 	 *
-	 * If the mode is not specified, CPIO is assumed as the default
+	 * If the mode is not specified, CPIO is assumed as the default.
+	 * ZFS stream of the image on the media is only received if
+	 * TM_PERFORM_ZFS_RECV is asked for.
 	 */
 	if (transfer_attr != NULL) {
 		if (nvlist_lookup_uint32(transfer_attr[0], TM_ATTR_MECHANISM,
@@ -1537,6 +1828,7 @@ do_transfer(void *args)
 		}
 		if (value == TM_PERFORM_IPS)
 			transfer_mode = OM_IPS_TRANSFER;
+		zfs_transfer = (value == TM_PERFORM_ZFS_RECV);
 	} else {
 		transfer_attr_num = 1;
 		transfer_attr = malloc(sizeof (nvlist_t *) * transfer_attr_num);
@@ -1584,7 +1876,9 @@ do_transfer(void *args)
 		}
 
 		if (nvlist_add_string(*transfer_attr, TM_CPIO_DST_MNTPT,
-		    tcb_args->target) != 0) {
+		    tcb_args->target) != 0 ||
+		    nvlist_add_string(*transfer_attr, TM_WAIT_TARGET,
+		    "true") != 0) {
 			for (i = 0; i < transfer_attr_num; i++)
 				nvlist_free(transfer_attr[i]);
 			free(transfer_attr);
@@ -1607,6 +1901,34 @@ do_transfer(void *args)
 		 * If IPS transfer phase failed, notify the caller and exit
 		 */
 
+		if (status != OM_SUCCESS) {
+			notify_error_status(OM_TRANSFER_FAILED);
+			pthread_exit((void *)&status);
+		}
+	} else if (zfs_transfer) {
+		om_log_print("ZFS stream transfer mechanism selected\n");
+
+		status = om_perform_transfer_zfs(*transfer_attr,
+		    tcb_args->target, handle_TM_callback);
+
+		for (i = 0; i < transfer_attr_num; i++)
+			nvlist_free(transfer_attr[i]);
+		free(transfer_attr);
+
+		if (status != OM_SUCCESS) {
+			notify_error_status(OM_TRANSFER_FAILED);
+			pthread_exit((void *)&status);
+		}
+	} else if (block_transfer) {
+		om_log_print("Block image transfer mechanism selected\n");
+
+		status = om_perform_transfer_block(*transfer_attr,
+		    tcb_args->target, handle_TM_callback);
+
+		for (i = 0; i < transfer_attr_num; i++)
+			nvlist_free(transfer_attr[i]);
+		free(transfer_attr);
+
 		if (status != OM_SUCCESS) {
 			notify_error_status(OM_TRANSFER_FAILED);
 			pthread_exit((void *)&status);
@@ -1626,6 +1948,16 @@ do_transfer(void *args)
 			nvlist_free(transfer_attr[i]);
 		free(transfer_attr);
 
+		/*
+		 * The transfer fails as well if TI did, report the cause
+		 */
+		if (pipelined && wait_for_ti() != 0) {
+			om_set_error(OM_TARGET_INSTANTIATION_FAILED);
+			notify_error_status(OM_TARGET_INSTANTIATION_FAILED);
+			status = -1;
+			pthread_exit((void *)&status);
+		}
+
 		/*
 		 * If CPIO transfer phase failed, notify the caller and exit
 		 */
@@ -1641,11 +1973,14 @@ do_transfer(void *args)
 	 * Customize the installed image.
 	 */
 
+	xfer_end = gethrtime();
+	ls_span_end(xfer_start, "install", "transfer", NULL);
 	status = 0;
 	/*
 	 * Set the language locale.
 	 */
 	if (def_locale != NULL) {
+		span = ls_span_begin();
 		if (ict_set_lang_locale(tcb_args->target,
 		    def_locale, transfer_mode) != ICT_SUCCESS) {
 			om_log_print("Failed to set locale: "
@@ -1653,6 +1988,7 @@ do_transfer(void *args)
 			    ICT_STR_ERROR(ict_errno));
 			status = -1;
 		}
+		ls_span_end(span, "ict", "ict_set_lang_locale", def_locale);
 	}
 
 	/*
@@ -1665,6 +2001,7 @@ do_transfer(void *args)
 
 	if (!om_is_automated_installation()) {
 		/* Configure user directory */
+		span = ls_span_begin();
 		if (ict_configure_user_directory(INSTALLED_ROOT_DIR,
 		    tcb_args->lname) != ICT_SUCCESS) {
 			om_log_print("Couldn't configure user directory\n"
@@ -1672,8 +2009,11 @@ do_transfer(void *args)
 			    ICT_STR_ERROR(ict_errno));
 			status = -1;
 		}
+		ls_span_end(span, "ict", "ict_configure_user_directory",
+		    NULL);
 
 		/* Create personal initialization files */
+		span = ls_span_begin();
 		if (ict_set_user_profile(tcb_args->target, tcb_args->lname) !=
 		    ICT_SUCCESS) {
 			om_log_print("Couldn't set the user environment\n"
@@ -1681,6 +2021,7 @@ do_transfer(void *args)
 			    tcb_args->lname, ICT_STR_ERROR(ict_errno));
 			status = -1;
 		}
+		ls_span_end(span, "ict", "ict_set_user_profile", NULL);
 	}
 
 	/*
@@ -1692,6 +2033,7 @@ do_transfer(void *args)
 		setup_etc_vfstab_for_swap(tcb_args->target);
 	}
 
+	span = ls_span_begin();
 	if (ict_set_host_node_name(tcb_args->target, tcb_args->hostname)
 	    != ICT_SUCCESS) {
 		om_log_print("Couldn't set the host and node name\n"
@@ -1699,19 +2041,25 @@ do_transfer(void *args)
 		    ICT_STR_ERROR(ict_errno));
 		status = -1;
 	}
+	ls_span_end(span, "ict", "ict_set_host_node_name", NULL);
 
+	span = ls_span_begin();
 	activate_be(INIT_BE_NAME);
+	ls_span_end(span, "ict", "activate_be", INIT_BE_NAME);
 
+	span = ls_span_begin();
 	if (ict_installboot(tcb_args->target, ROOTPOOL_NAME) 
 	    != ICT_SUCCESS) {
 		om_log_print("installboot failed\n%s\n",
 		    ICT_STR_ERROR(ict_errno));
 		status = -1;
 	}
+	ls_span_end(span, "ict", "ict_installboot", ROOTPOOL_NAME);
 
 	/*
 	 * run_install_finish_script performs a group of ICT
 	 */
+	span = ls_span_begin();
 	if (run_install_finish_script(tcb_args->target,
 	    tcb_args->uname, tcb_args->lname,
 	    tcb_args->upasswd, tcb_args->rpasswd) == OM_FAILURE) {
@@ -1719,10 +2067,12 @@ do_transfer(void *args)
 		    "failures\n");
 		status = -1;
 	}
+	ls_span_end(span, "ict", "run_install_finish_script", NULL);
 
 	/*
 	 * Take a snapshot of the installation.
 	 */
+	span = ls_span_begin();
 	if (ict_snapshot(INIT_BE_NAME, INSTALL_SNAPSHOT) !=
 	    ICT_SUCCESS) {
 		om_log_print("Failed to generate snapshot\n"
@@ -1731,6 +2081,7 @@ do_transfer(void *args)
 		    ICT_STR_ERROR(ict_errno));
 		status = -1;
 	}
+	ls_span_end(span, "ict", "ict_snapshot", INSTALL_SNAPSHOT);
 
 	/*
 	 * mark ZFS root pool 'ready' - it was successfully populated
@@ -1738,6 +2089,7 @@ do_transfer(void *args)
 	 */
 
 	om_log_print("Marking root pool as 'ready'\n");
+	span = ls_span_begin();
 	if (ict_mark_root_pool_ready(ROOTPOOL_NAME) != ICT_SUCCESS) {
 		om_log_print("%s\n", ICT_STR_ERROR(ict_errno));
 		status = -1;
@@ -1746,6 +2098,7 @@ do_transfer(void *args)
 		    "Root pool %s was marked as 'ready'\n",
 		    ROOTPOOL_NAME);
 	}
+	ls_span_end(span, "ict", "ict_mark_root_pool_ready", ROOTPOOL_NAME);
 
 	/*
 	 * Log the build version we're running on.
@@ -1761,6 +2114,19 @@ do_transfer(void *args)
 	    transfer_mode) != OM_SUCCESS)
 		status = -1;
 
+	ls_span_end(xfer_end, "install", "configuration", NULL);
+	log_install_timings(xfer_start, xfer_end, gethrtime());
+
+	/*
+	 * Rewrite the timeline with the spans recorded since the logs
+	 * were transferred and summarize where the time went. Only the
+	 * copy in /tmp is updated. The one on the target was copied by
+	 * ict_transfer_logs() and is left ending there on purpose, as
+	 * the target may already be unmounted.
+	 */
+	(void) ls_timeline_write(NULL);
+	ls_timeline_summary("OM");
+
 	/*
 	 * Notify the caller that install is completed
 	 */
@@ -1786,7 +2152,21 @@ do_transfer(void *args)
 static void
 handle_TM_callback(const int percent, const char *message)
 {
-	om_callback_info_t cb_data;
+	om_callback_info_t	cb_data;
+	tm_progress_t		prog;
+
+	/*
+	 * Record how fast the transfer goes, the GUI polls
+	 * om_get_transfer_progress() for remaining time itself
+	 */
+	TM_get_progress(&prog);
+	if (prog.active)
+		om_debug_print(OM_DBGLVL_INFO, "Transfer: %d%%, %llu of %llu "
+		    "MB, %llu files, %llu KB/s, %u s remaining\n", percent,
+		    (u_longlong_t)(prog.bytes_done / ONE_MB_TO_BYTE),
+		    (u_longlong_t)(prog.bytes_total / ONE_MB_TO_BYTE),
+		    (u_longlong_t)prog.files_done,
+		    (u_longlong_t)(prog.throughput / 1024), prog.eta);
 
 	cb_data.num_milestones = 3;
 	cb_data.curr_milestone = OM_SOFTWARE_UPDATE;
@@ -1796,6 +2176,30 @@ handle_TM_callback(const int percent, const char *message)
 	om_cb(&cb_data, 0);
 }
 
+/*
+ * om_get_transfer_progress
+ * This function returns progress of the file transfer, so that the
+ * caller can present transferred amount and remaining time between
+ * OM_SOFTWARE_UPDATE callbacks.
+ * Input:	None
+ * Output:	progress - snapshot of transfer progress, active is B_FALSE
+ *		if no file transfer is running
+ * Return:	None
+ */
+void
+om_get_transfer_progress(om_transfer_progress_t *progress)
+{
+	tm_progress_t	prog;
+
+	TM_get_progress(&prog);
+	progress->active = prog.active;
+	progress->bytes_done = prog.bytes_done;
+	progress->bytes_total = prog.bytes_total;
+	progress->files_done = prog.files_done;
+	progress->throughput = prog.throughput;
+	progress->eta = prog.eta;
+}
+
 
 /*
  * Parsing function to get the percentage value from the string.
@@ -2065,6 +2469,7 @@ reset_zfs_mount_property(char *target, int transfer_mode)
 {
 	char 		cmd[MAXPATHLEN];
 	int		i, ret;
+	hrtime_t	span;
 
 	if (target == NULL) {
 		return (OM_FAILURE);
@@ -2118,7 +2523,11 @@ reset_zfs_mount_property(char *target, int transfer_mode)
 	 * Transfer log files to the destination.
 	 */
 
-	if (ict_transfer_logs("/", target, transfer_mode) != ICT_SUCCESS) {
+	span = ls_span_begin();
+	ret = ict_transfer_logs("/", target, transfer_mode);
+	ls_span_end(span, "ict", "ict_transfer_logs", NULL);
+
+	if (ret != ICT_SUCCESS) {
 		om_log_print("Failed to transfer install log file\n"
 		    "%s\n", ICT_STR_ERROR(ict_errno));
 
@@ -2628,6 +3037,47 @@ prepare_be_attrs(nvlist_t **attrs)
 	return (OM_SUCCESS);
 }
 
+/*
+ * prepare_layout_attrs
+ * Creates nvlist set of attributes describing layout of targets,
+ * which TI creates concurrently where they don't depend on each other
+ * Input:	nvlist_t **attrs - attributes describing the target
+ *		nvlist_t **targets - attributes of the targets in layout
+ *		uint_t num_targets - number of targets in layout
+ *
+ * Output:
+ * Return:	OM_SUCCESS
+ *		OM_FAILURE
+ * Notes:
+ */
+static int
+prepare_layout_attrs(nvlist_t **attrs, nvlist_t **targets,
+    uint_t num_targets)
+{
+	if (nvlist_alloc(attrs, TI_TARGET_NVLIST_TYPE, 0) != 0) {
+		om_log_print("Could not create target nvlist.\n");
+
+		return (OM_FAILURE);
+	}
+
+	if (nvlist_add_uint32(*attrs, TI_ATTR_TARGET_TYPE,
+	    TI_TARGET_TYPE_LAYOUT) != 0) {
+		om_log_print("Couldn't add TI_ATTR_TARGET_TYPE to "
+		    "nvlist\n");
+
+		return (OM_FAILURE);
+	}
+
+	if (nvlist_add_nvlist_array(*attrs, TI_ATTR_LAYOUT_TARGETS,
+	    targets, num_targets) != 0) {
+		om_log_print("Couldn't set layout targets attr\n");
+
+		return (OM_FAILURE);
+	}
+
+	return (OM_SUCCESS);
+}
+
 
 /*
  * obtain_image_info
@@ -2635,6 +3085,8 @@ prepare_be_attrs(nvlist_t **attrs)
  * [1] total size of installed bits
  * [2] compression ratio, if ZFS compression is turned on
  * [3] compression type
+ * Total size is taken from image content manifest if the media has one,
+ * so that it is available with single mapping of the manifest.
  * Input:	image_info_t * info - pointer to structure, which will
  *		be populated with image information
  *
@@ -2649,6 +3101,7 @@ obtain_image_info(image_info_t *info)
 {
 	FILE		*info_file;
 	char		line[IMAGE_INFO_LINE_MAXLN];
+	tm_manifest_t	manifest;
 	boolean_t	got_size = B_FALSE;
 	boolean_t	got_cratio = B_FALSE;
 	boolean_t	got_ctype = B_FALSE;
@@ -2661,6 +3114,29 @@ obtain_image_info(image_info_t *info)
 		return (OM_SUCCESS);
 	}
 
+	/*
+	 * image content manifest records image size, if generated
+	 * from image which had it
+	 */
+
+	if (TM_manifest_open(IMAGE_MANIFEST_FILE_NAME, &manifest) == 0) {
+		om_debug_print(OM_DBGLVL_INFO,
+		    "Image manifest: %llu entries, %llu bytes of media "
+		    "content, image size %llu KiB\n",
+		    (u_longlong_t)manifest.hdr->nentries,
+		    (u_longlong_t)manifest.hdr->content_size,
+		    (u_longlong_t)manifest.hdr->image_size);
+
+		if (manifest.hdr->image_size != 0) {
+			/* convert kiB -> MiB */
+
+			image_info.image_size =
+			    manifest.hdr->image_size/ONE_MB_TO_KB;
+			got_size = B_TRUE;
+		}
+		TM_manifest_close(&manifest);
+	}
+
 	/*
 	 * open image info file, parse it
 	 * and populate data structure
@@ -2671,6 +3147,10 @@ obtain_image_info(image_info_t *info)
 		om_debug_print(OM_DBGLVL_WARN,
 		    "Couldn't open image info file " IMAGE_INFO_FILE_NAME "\n");
 
+		if (got_size) {
+			info->initialized = B_TRUE;
+			return (OM_SUCCESS);
+		}
 		return (OM_FAILURE);
 	}
 
@@ -2708,7 +3188,8 @@ obtain_image_info(image_info_t *info)
 		 * known/requested
 		 */
 
-		if (strcmp(par_name, IMAGE_INFO_TOTAL_SIZE) == 0) {
+		if (!got_size &&
+		    strcmp(par_name, IMAGE_INFO_TOTAL_SIZE) == 0) {
 			uint64_t	size;
 
 			errno = 0;
@@ -2849,6 +3330,46 @@ get_dataset_property(char *dataset_name, char *property)
 }
 
 
+/*
+ * get_pool_guid
+ *
+ * Obtains guid of the pool whose labels are on given device
+ * Return:	0  - couldn't obtain pool guid
+ *		>0 - pool guid
+ * Notes:
+ */
+
+static uint64_t
+get_pool_guid(char *device)
+{
+	FILE		*p;
+	char		cmd[MAXPATHLEN];
+	char		line[MAXPATHLEN];
+	char		*s;
+	uint64_t	guid = 0;
+
+	(void) snprintf(cmd, sizeof (cmd), "/usr/sbin/zdb -l %s", device);
+
+	om_log_print("%s\n", cmd);
+
+	if ((p = popen(cmd, "r")) == NULL) {
+		om_log_print("Couldn't read pool labels\n");
+		return (0);
+	}
+
+	/* "pool_guid: <guid>", or "pool_guid=<guid>" with older zdb */
+	while (guid == 0 && fgets(line, sizeof (line), p) != NULL) {
+		if ((s = strstr(line, "pool_guid")) == NULL)
+			continue;
+		s += strlen("pool_guid");
+		s += strspn(s, ":= \t");
+		guid = strtoull(s, NULL, 10);
+	}
+
+	(void) pclose(p);
+	return (guid);
+}
+
 /*
  * get_available_disk_space
  *
@@ -3019,3 +3540,61 @@ log_bld_info(char *mountpnt, char *comment)
 	om_log_print("Warning: Unable to retrieve build version "
 	    "information for image root %s\n", mountpnt);
 }
+
+/*
+ * wait_for_ti
+ * Description:
+ *		Wait for the TI thread started by om_perform_install()
+ *		to finish.
+ * Arguments:
+ *		None.
+ * Return:
+ *		0 if the target was instantiated, non-zero otherwise.
+ * Scope:
+ *		Private
+ */
+static int
+wait_for_ti(void)
+{
+	void	*exit_val;
+
+	(void) pthread_join(ti_thread, &exit_val);
+
+	ti_ret += (int)exit_val;
+	return (ti_ret);
+}
+
+/*
+ * log_install_timings
+ * Description:
+ *		log how long target instantiation, transfer and
+ *		configuration of the installed image took, and how much
+ *		of the transfer ran while the target was being instantiated.
+ * Arguments:
+ *		xfer_start - when the transfer started
+ *		xfer_end - when the transfer finished
+ *		install_end - when the installed image was configured
+ * Return:
+ *		None.
+ * Scope:
+ *		Private
+ */
+static void
+log_install_timings(hrtime_t xfer_start, hrtime_t xfer_end,
+    hrtime_t install_end)
+{
+	hrtime_t	overlap;
+
+	overlap = MIN(ti_end, xfer_end) - xfer_start;
+	if (overlap < 0)
+		overlap = 0;
+
+	om_log_print("Install phase timings: target instantiation %.1f s, "
+	    "transfer %.1f s (%.1f s overlapped with target instantiation), "
+	    "configuration %.1f s, total %.1f s\n",
+	    (double)(ti_end - ti_start) / NANOSEC,
+	    (double)(xfer_end - xfer_start) / NANOSEC,
+	    (double)overlap / NANOSEC,
+	    (double)(install_end - xfer_end) / NANOSEC,
+	    (double)(install_end - ti_start) / NANOSEC);
+}
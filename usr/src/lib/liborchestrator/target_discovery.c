@@ -56,6 +56,18 @@ start_td_disk_discover(int *ndisks)
 	td_errno_t	ret;
 	int		num;
 
+	/*
+	 * probe disks, partitions and slices in parallel - on systems
+	 * with many LUNs, serial probing dominates discovery time
+	 */
+	(void) td_set_discovery_threads(TD_DISCOVERY_THREADS_DEFAULT);
+	/*
+	 * reuse results of previous discovery for disks which did not
+	 * change since - the installer may be restarted several times
+	 */
+	if (td_set_cache_file(TMP_TD_SNAPSHOT) != TD_E_SUCCESS)
+		om_debug_print(OM_DBGLVL_WARN,
+		    "Discovery snapshot can't be used\n");
 	ret = td_discover(TD_OT_DISK, &num);
 	if (ret) {
 		/*
@@ -395,10 +407,10 @@ disk_target_t *
 enumerate_next_disk()
 {
 	nvlist_t	*attr_list;
+	td_attr_info_t	info;
 	td_errno_t	ret;
 	char		*str;
 	uint32_t	bsize;
-	uint32_t	value;
 	uint32_t	nsect;
 	uint32_t	nheads;
 	uint64_t	nblocks;
@@ -415,11 +427,13 @@ enumerate_next_disk()
 	}
 
 	/*
-	 * Get the list of attributes available for this disk
+	 * Get the list of attributes available for this disk. The list
+	 * is owned by TD and stays valid until the discovery is released.
 	 */
-	attr_list = td_attributes_get(TD_OT_DISK);
+	attr_list = td_attributes_view(TD_OT_DISK);
 
-	if (attr_list == NULL) {
+	if (attr_list == NULL ||
+	    td_attributes_info(TD_OT_DISK, &info) != TD_E_SUCCESS) {
 		return (NULL);
 	}
 
@@ -427,14 +441,7 @@ enumerate_next_disk()
 	 * if the device type is not FIXED, ignore the entry
 	 * we don't want to count cdrom, floopy etc.
 	 */
-	if (nvlist_lookup_uint32(attr_list, TD_DISK_ATTR_MTYPE,
-	    &value) == OM_SUCCESS) {
-		if (value != TD_MT_FIXED) {
-			nvlist_free(attr_list);
-			return (NULL);
-		}
-	} else {
-		nvlist_free(attr_list);
+	if (info.tai_tag != TD_MT_FIXED) {
 		return (NULL);
 	}
 
@@ -443,7 +450,6 @@ enumerate_next_disk()
 	 */
 	dt = (disk_target_t *)calloc(1, sizeof (disk_target_t));
 	if (dt == NULL) {
-		nvlist_free(attr_list);
 		return (NULL);
 	}
 
@@ -527,17 +533,12 @@ enumerate_next_disk()
 	/*
 	 * Get the disk label
 	 */
-	if (nvlist_lookup_uint32(attr_list, TD_DISK_ATTR_LABEL,
-	    &value) == OM_SUCCESS) {
-		if (value & TD_DISK_LABEL_VTOC) {
-			dt->dinfo.label = OM_LABEL_VTOC;
-		} else if (value & TD_DISK_LABEL_GPT) {
-			dt->dinfo.label = OM_LABEL_GPT;
-		} else if (value & TD_DISK_LABEL_FDISK) {
-			dt->dinfo.label = OM_LABEL_FDISK;
-		} else {
-			dt->dinfo.label = OM_LABEL_UNKNOWN;
-		}
+	if (info.tai_flags & TD_DISK_LABEL_VTOC) {
+		dt->dinfo.label = OM_LABEL_VTOC;
+	} else if (info.tai_flags & TD_DISK_LABEL_GPT) {
+		dt->dinfo.label = OM_LABEL_GPT;
+	} else if (info.tai_flags & TD_DISK_LABEL_FDISK) {
+		dt->dinfo.label = OM_LABEL_FDISK;
 	} else {
 		dt->dinfo.label = OM_LABEL_UNKNOWN;
 	}
@@ -545,15 +546,8 @@ enumerate_next_disk()
 	/*
 	 * Calculate the total size of the disk
 	 */
-	if (nvlist_lookup_uint32(attr_list,
-	    TD_DISK_ATTR_BLOCKSIZE, &bsize) != OM_SUCCESS) {
-		bsize = 0;
-	}
-
-	if (nvlist_lookup_uint64(attr_list,
-	    TD_DISK_ATTR_SIZE, &nblocks) != OM_SUCCESS) {
-		nblocks = 0;
-	}
+	bsize = info.tai_blocksize;
+	nblocks = info.tai_size;
 
 	if (bsize == 0 || nblocks == 0) {
 		om_log_print("Ignoring %s because of bad Geometry\n",
@@ -648,12 +642,10 @@ enumerate_next_disk()
 		goto end_return;
 	}
 	/*
-	 * we are done. Free the nvpair list and return the disk
+	 * we are done. The nvpair list is owned by TD, return the disk
 	 */
-	nvlist_free(attr_list);
 	return (dt);
 end_return:
-	nvlist_free(attr_list);
 	free(dt->dinfo.serial_number);
 	free(dt->dinfo.vendor);
 	free(dt->dinfo.disk_name);
@@ -691,7 +683,7 @@ om_debug_print(OM_DBGLVL_INFO, "log_partition_map - after sorting\n");
 disk_parts_t *
 enumerate_partitions(char *disk_name)
 {
-	nvlist_t	**attr_list, **save_attr_list;
+	nvlist_t	**attr_list;
 	int		i;
 	int		num, bad;
 	uint8_t		part, part_id;
@@ -712,20 +704,14 @@ enumerate_partitions(char *disk_name)
 	}
 
 	/*
-	 * Get all the partitions of this disk
+	 * Get all the partitions of this disk. Attribute lists are owned
+	 * by TD and stay valid until the discovery is released.
 	 */
-	attr_list = td_discover_partition_by_disk(disk_name, &num);
+	attr_list = td_get_partitions_by_disk(disk_name, &num);
 	if (num <= 0) {
-		if (attr_list != NULL) {
-			td_attribute_list_free(attr_list);
-		}
 		return (NULL);
 	}
 
-	/*
-	 * save the attr list so that it can be freed later.
-	 */
-	save_attr_list = attr_list;
 	/*
 	 * We found some partitions, allocate space
 	 */
@@ -867,11 +853,6 @@ enumerate_partitions(char *disk_name)
 			    dp->pinfo[part].partition_size_sec = 0;
 		}
 	}
-	/*
-	 * We are finished with attr_list. Free the resources
-	 */
-	td_attribute_list_free(save_attr_list);
-
 	/*
 	 * Sort the disk partitions based on offset value.
 	 * This will be useful for functions that validate the partitions
@@ -881,7 +862,6 @@ enumerate_partitions(char *disk_name)
 	log_partition_map(dp->pinfo);
 	return (dp);
 enp_return:
-	td_attribute_list_free(save_attr_list);
 	local_free_part_info(dp);
 	return (NULL);
 }
@@ -908,7 +888,7 @@ disk_slices_t *
 enumerate_slices(char *disk_name)
 {
 	disk_slices_t	*ds;
-	nvlist_t	**attr_list, **save_attr_list;
+	nvlist_t	**attr_list;
 	int		i;
 	int		num, bad;
 	char		*str;
@@ -925,13 +905,10 @@ enumerate_slices(char *disk_name)
 
 	ds = NULL;
 	/*
-	 * Get all the partitions of this disk
+	 * Get all the slices of this disk. Attribute lists are owned
+	 * by TD and stay valid until the discovery is released.
 	 */
-	attr_list = td_discover_slice_by_disk(disk_name, &num);
-	/*
-	 * Save the attr_list since it will be advanced through the loop
-	 */
-	save_attr_list = attr_list;
+	attr_list = td_get_slices_by_disk(disk_name, &num);
 	if (num > 0) {
 		/*
 		 * Found some slices. Allocate space
@@ -1033,16 +1010,11 @@ enumerate_slices(char *disk_name)
 				ds->sinfo[i].tag = 0;
 			}
 		}
-		/*
-		 * We are finished with attr_list. Free the resources
-		 */
-		td_attribute_list_free(save_attr_list);
 	}
 	return (ds);
 ens_return:
 	free(ds->disk_name);
 	free(ds);
-	td_attribute_list_free(save_attr_list);
 	return (NULL);
 }
 
@@ -1076,9 +1048,11 @@ enumerate_next_instance()
 	}
 
 	/*
-	 * Get the list of attributes available for this disk
+	 * Get the list of attributes available for this instance. The
+	 * list is owned by TD and stays valid until the discovery is
+	 * released.
 	 */
-	attr_list = td_attributes_get(TD_OT_OS);
+	attr_list = td_attributes_view(TD_OT_OS);
 
 	if (attr_list == NULL) {
 		return (NULL);
@@ -1089,7 +1063,6 @@ enumerate_next_instance()
 	 */
 	ut = (upgrade_info_t *)calloc(1, sizeof (upgrade_info_t));
 	if (ut == NULL) {
-		nvlist_free(attr_list);
 		return (NULL);
 	}
 
@@ -1191,12 +1164,10 @@ enumerate_next_instance()
 		}
 	}
 	/*
-	 * we are done. Free the nvpair list and return the disk
+	 * we are done. The nvpair list is owned by TD, return the instance
 	 */
-	nvlist_free(attr_list);
 	return (ut);
 eni_return:
-	nvlist_free(attr_list);
 	free(ut->solaris_release);
 	free(ut->instance.uinfo.disk_name);
 	free(ut);
@@ -36,7 +36,7 @@ static TgtDisk		*TgtDisk_Create(nvlist_t *, TgtGeometry *);
 static TgtPartition	*TgtPartition_Create(nvlist_t *, TgtGeometry *);
 static TgtSlice		*TgtSlice_Create(nvlist_t *, TgtGeometry *);
 
-static PyObject		*TgtDisk_enumerate(int);
+static PyObject		*TgtDisk_enumerate(void);
 #ifndef	sparc
 static PyObject		*TgtPartition_enumerate(TgtDisk *);
 #endif
@@ -84,7 +84,7 @@ discover_target_data(void)
 	}
 
 
-	list = TgtDisk_enumerate(ndisk);
+	list = TgtDisk_enumerate();
 	if (list == NULL && PyErr_Occurred() != NULL)
 		return (NULL);
 
@@ -216,37 +216,43 @@ PyDoc_STRVAR(discover_target_data_doc,
 /*
  * Function:	TgtDisk_enumerate
  * Description:	enumerate target disks available.
- * Parameters:
- * 	ndisk	number of disks (although some may not be valid).
+ * Parameters:	None
  * Returns:	PyObject pointer that is a list of disks. Or NULL
  *		in case of error (exception set for Python).
  * Scope:	Private
  *
  * N.B.: libtd.so does not distinguish between disk and geometry,
  *       we do. So this reads up both at the same time.
+ *
+ * Disks are walked with a private libtd iterator, so discovery from
+ * other Python threads does not disturb the enumeration.
  */
 static PyObject*
-TgtDisk_enumerate(int ndisk)
+TgtDisk_enumerate(void)
 {
 	PyObject *result = NULL; /* our list */
-	int idx, rc;
+	td_iter_t *iter = NULL;
+	int rc;
 
 	if ((result = PyList_New(0)) == NULL)
 		return (PyErr_NoMemory());
 
-	for (idx = 0; idx < ndisk; idx++) {
+	/* attributes of all disks are read here */
+	Py_BEGIN_ALLOW_THREADS
+	rc = td_iter_open(TD_OT_DISK, &iter);
+	Py_END_ALLOW_THREADS
+	if (rc != TD_E_SUCCESS) {
+		Py_DECREF(result);
+		raise_td_errcode();
+		return (NULL);
+	}
+
+	while (td_iter_next(iter) == TD_E_SUCCESS) {
 		TgtGeometry *geo = NULL;
 		TgtDisk *disk = NULL;
 		nvlist_t *attr = NULL;
 
-		rc = td_get_next(TD_OT_DISK); /* doesn't go to disk */
-		if (rc != TD_E_SUCCESS) {
-			continue; /* bad disk */
-		}
-
-		Py_BEGIN_ALLOW_THREADS
-		attr = td_attributes_get(TD_OT_DISK);
-		Py_END_ALLOW_THREADS
+		attr = td_iter_attributes_get(iter); /* doesn't go to disk */
 		if (attr == NULL) {
 			continue; /* bad disk */
 		}
@@ -274,9 +280,11 @@ TgtDisk_enumerate(int ndisk)
 		}
 	}
 
+	td_iter_close(iter);
 	return (result);
 
 TgtDisk_enumerate_CLEANUP:
+	td_iter_close(iter);
 	Py_XDECREF(result);
 	return (NULL);
 }
@@ -69,6 +69,9 @@ typedef enum {
 
 #define	TD_IOCTL_TIMEOUT 10 /* seconds to timeout blocking ioctls */
 
+/* suggested size of attribute discovery worker pool */
+#define	TD_DISCOVERY_THREADS_DEFAULT	8
+
 /* nv attribute names for disk */
 
 #define	TD_DISK_ATTR_NAME	"ddm_disk_name"
@@ -261,19 +264,55 @@ typedef enum {
 	TD_OPER_EQUALS
 } td_operator_t;
 
+/* change of single disk for td_rediscover_device() */
+typedef enum {
+	TD_REDISCOVER_ADD,
+	TD_REDISCOVER_REMOVE,
+	TD_REDISCOVER_REFRESH
+} td_rediscover_op_t;
+
+/* private enumeration of discovered objects, see td_iter_open() */
+typedef struct td_iter td_iter_t;
+
+/*
+ * frequently used numeric attributes of disk, partition or slice,
+ * see td_attr_info_fill() for meaning of tag and flags
+ */
+typedef struct td_attr_info {
+	uint64_t	tai_size;	/* size in blocks */
+	uint64_t	tai_start;	/* first block - partition, slice */
+	uint32_t	tai_blocksize;	/* block size in bytes - disk */
+	uint32_t	tai_tag;	/* media type, partition type, tag */
+	uint32_t	tai_flags;	/* labels, boot id, slice flags */
+} td_attr_info_t;
+
 /* function prototypes */
 
 td_errno_t td_discover(td_object_type_t, int *);
 
 td_errno_t td_target_search(nvlist_t *);
+td_errno_t td_rediscover_device(const char *, td_rediscover_op_t);
 
 td_errno_t td_discovery_release(void);
+td_errno_t td_set_discovery_threads(int);
+td_errno_t td_set_cache_file(const char *);
 nvlist_t **td_discover_partition_by_disk(const char *, int *);
 nvlist_t **td_discover_slice_by_disk(const char *, int *);
+nvlist_t **td_get_partitions_by_disk(const char *, int *);
+nvlist_t **td_get_slices_by_disk(const char *, int *);
 
 td_errno_t td_get_next(td_object_type_t);
 td_errno_t td_reset(td_object_type_t);
 
+td_errno_t td_iter_open(td_object_type_t, td_iter_t **);
+td_errno_t td_iter_next(td_iter_t *);
+td_errno_t td_iter_reset(td_iter_t *);
+int td_iter_count(td_iter_t *);
+nvlist_t *td_iter_attributes_get(td_iter_t *);
+nvlist_t *td_iter_attributes_view(td_iter_t *);
+td_errno_t td_iter_attributes_info(td_iter_t *, td_attr_info_t *);
+void td_iter_close(td_iter_t *);
+
 boolean_t td_is_slice(const char *);
 
 #define	TD_ERRNO td_get_errno()
@@ -281,6 +320,9 @@ boolean_t td_is_slice(const char *);
 td_errno_t td_get_errno(void);
 
 nvlist_t *td_attributes_get(td_object_type_t);
+nvlist_t *td_attributes_view(td_object_type_t);
+td_errno_t td_attributes_info(td_object_type_t, td_attr_info_t *);
+void td_attr_info_fill(td_object_type_t, nvlist_t *, td_attr_info_t *);
 void td_list_free(nvlist_t *);
 void td_attribute_list_free(nvlist_t **);
 nvlist_t **td_xref(td_object_type_t, const char *, const char *,
@@ -0,0 +1,612 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * td_cache.c keeps a persistent snapshot of Target Discovery results.
+ *
+ * Discovered attributes of disks, partitions, slices and Solaris instances
+ * are grouped by disk and stored in a versioned file as packed nvlist.
+ * Each disk is stored with a fingerprint made of its device ID, capacity
+ * and a checksum of its labels (MBR/EFI and VTOC). When the snapshot is
+ * loaded again, objects of a disk are taken from the snapshot only if the
+ * fingerprint of the disk did not change - all other disks are probed.
+ *
+ * Snapshot layout:
+ *	struct td_cache_hdr
+ *	packed nvlist (XDR encoding)
+ *		"disks" - nvlist of disk entries keyed by disk name
+ *			"fingerprint"	- string
+ *			"probed"	- uint32, bitmap of object types stored
+ *			"attributes"	- nvlist, disk attributes
+ *			"partitions"	- nvlist of attributes keyed by name
+ *			"slices"	- nvlist of attributes keyed by name
+ *			"os"		- nvlist of attributes keyed by slice
+ *
+ * The snapshot is trusted only if it is a regular file owned by the
+ * effective user (root when installing) and not writable by group or
+ * others. It is written to a file created by mkstemp(3C) next to it and
+ * renamed over it, so that existing files or symbolic links planted
+ * in place of the temporary file are never written through.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stropts.h>
+#include <devid.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/param.h>
+#include <sys/dkio.h>
+#include <sys/vtoc.h>
+#include <libnvpair.h>
+
+#include <td_lib.h> /* TD internal definitions */
+#include <td_dd.h> /* disk module */
+#include <td_api.h> /* TD user definitions */
+
+#define	TD_CACHE_MAGIC		0x54444353	/* "TDCS" */
+#define	TD_CACHE_VERSION	1
+
+/* leading part of disk read for checksum - covers MBR and EFI label */
+#define	TD_CACHE_LABEL_SIZE	(64 * 1024)
+
+/* nv names used in snapshot */
+#define	TDC_DISKS		"disks"
+#define	TDC_FPRINT		"fingerprint"
+#define	TDC_PROBED		"probed"
+#define	TDC_ATTRS		"attributes"
+#define	TDC_PARTS		"partitions"
+#define	TDC_SLICES		"slices"
+#define	TDC_OS			"os"
+
+/* fingerprint states memoized for current discovery */
+#define	TDC_STATE_VALID		1
+#define	TDC_STATE_STALE		2
+
+#define	TDC_PROBED_BIT(ot)	(1U << (ot))
+
+/* snapshot file header */
+struct td_cache_hdr {
+	uint32_t tch_magic;	/* TD_CACHE_MAGIC */
+	uint32_t tch_version;	/* TD_CACHE_VERSION */
+	uint64_t tch_size;	/* size of packed nvlist following header */
+};
+
+static char *cache_path = NULL;		/* snapshot file */
+static nvlist_t *cache_snap = NULL;	/* loaded snapshot */
+static nvlist_t *cache_disks = NULL;	/* disks of loaded snapshot */
+static nvlist_t *cache_state = NULL;	/* fingerprint states by disk */
+static nvlist_t *cache_fprint = NULL;	/* current fingerprints by disk */
+static nvlist_t *cache_os = NULL;	/* OS instances found, by slice */
+
+static nvlist_t *cache_disk_entry(const char *);
+
+/*
+ * running fletcher checksum of buffer
+ */
+static void
+cache_cksum(const void *buf, size_t size, uint64_t *ck)
+{
+	const uint32_t *ip = buf;
+	const uint32_t *ipend = ip + size / sizeof (uint32_t);
+	uint64_t a = ck[0], b = ck[1];
+
+	for (; ip < ipend; ip++) {
+		a += *ip;
+		b += a;
+	}
+	ck[0] = a;
+	ck[1] = b;
+}
+
+/*
+ * compute fingerprint of disk
+ * returns B_FALSE if disk can't be accessed
+ */
+static boolean_t
+cache_compute_fingerprint(const char *disk, char *fprint, size_t len)
+{
+	ddi_devid_t devid;
+	char *devidstr = NULL;
+	struct dk_minfo minfo;
+	struct extvtoc vtoc;
+	uint64_t ck[2] = {0, 0};
+	uint64_t capacity = 0;
+	char *buf;
+	ssize_t n;
+	int fd;
+
+	if ((fd = ddm_open_disk(disk)) < 0)
+		return (B_FALSE);
+
+	if (devid_get(fd, &devid) == 0) {
+		devidstr = devid_str_encode(devid, NULL);
+		devid_free(devid);
+	}
+	if (ioctl(fd, DKIOCGMEDIAINFO, &minfo) == 0)
+		capacity = minfo.dki_capacity * minfo.dki_lbsize;
+
+	/* checksum of MBR and EFI label */
+	if ((buf = memalign(DEV_BSIZE, TD_CACHE_LABEL_SIZE)) == NULL) {
+		(void) close(fd);
+		devid_str_free(devidstr);
+		return (B_FALSE);
+	}
+	n = pread(fd, buf, TD_CACHE_LABEL_SIZE, 0);
+	if (n > 0)
+		cache_cksum(buf, n, ck);
+	free(buf);
+
+	/* VTOC of Solaris partition is not at the start of disk on x86 */
+	if (ioctl(fd, DKIOCGEXTVTOC, &vtoc) == 0)
+		cache_cksum(&vtoc, sizeof (vtoc), ck);
+	(void) close(fd);
+
+	(void) snprintf(fprint, len, "%s:%llx:%llx%016llx",
+	    devidstr == NULL ? "-" : devidstr, (u_longlong_t)capacity,
+	    (u_longlong_t)ck[1], (u_longlong_t)ck[0]);
+	if (devidstr != NULL)
+		devid_str_free(devidstr);
+	return (B_TRUE);
+}
+
+/*
+ * fetch fingerprint of disk, computed once per discovery
+ */
+static char *
+cache_fingerprint(const char *disk)
+{
+	char fprint[MAXPATHLEN];
+	char *pfprint;
+
+	if (cache_fprint == NULL &&
+	    nvlist_alloc(&cache_fprint, NV_UNIQUE_NAME, 0) != 0)
+		return (NULL);
+	if (nvlist_lookup_string(cache_fprint, disk, &pfprint) == 0)
+		return (pfprint);
+	if (!cache_compute_fingerprint(disk, fprint, sizeof (fprint)) ||
+	    nvlist_add_string(cache_fprint, disk, fprint) != 0 ||
+	    nvlist_lookup_string(cache_fprint, disk, &pfprint) != 0)
+		return (NULL);
+	return (pfprint);
+}
+
+/* release state kept for one discovery */
+static void
+cache_reset_state(void)
+{
+	nvlist_free(cache_state);
+	nvlist_free(cache_fprint);
+	nvlist_free(cache_os);
+	cache_state = cache_fprint = cache_os = NULL;
+}
+
+/*
+ * td_cache_reset()
+ *	Forget fingerprints and changed/unchanged verdicts of disks
+ *	memoized during discovery, so that the next discovery checks
+ *	every disk again, whether or not the snapshot could be saved
+ */
+void
+td_cache_reset(void)
+{
+	cache_reset_state();
+}
+
+/*
+ * read and validate snapshot file
+ * returns NULL if file does not exist or is not usable, or if it could
+ * have been modified by anybody else than its creator
+ */
+static nvlist_t *
+cache_read(const char *path)
+{
+	struct td_cache_hdr hdr;
+	struct stat st;
+	nvlist_t *snap = NULL;
+	char *packed;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY | O_NOFOLLOW)) < 0) {
+		if (errno != ENOENT)
+			td_debug_print(LS_DBGLVL_WARN,
+			    "can't open discovery snapshot %s: %s\n",
+			    path, strerror(errno));
+		return (NULL);
+	}
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+	    st.st_uid != geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+		td_debug_print(LS_DBGLVL_WARN,
+		    "discovery snapshot %s is not trusted - ignored\n", path);
+		(void) close(fd);
+		return (NULL);
+	}
+	if (read(fd, &hdr, sizeof (hdr)) != sizeof (hdr) ||
+	    hdr.tch_magic != TD_CACHE_MAGIC ||
+	    hdr.tch_version != TD_CACHE_VERSION ||
+	    hdr.tch_size != st.st_size - sizeof (hdr)) {
+		td_debug_print(LS_DBGLVL_WARN,
+		    "discovery snapshot %s is not valid - ignored\n", path);
+		(void) close(fd);
+		return (NULL);
+	}
+	if ((packed = malloc(hdr.tch_size)) == NULL) {
+		(void) close(fd);
+		return (NULL);
+	}
+	if (read(fd, packed, hdr.tch_size) != hdr.tch_size ||
+	    nvlist_unpack(packed, hdr.tch_size, &snap, 0) != 0) {
+		td_debug_print(LS_DBGLVL_WARN,
+		    "discovery snapshot %s can't be read - ignored\n", path);
+		snap = NULL;
+	}
+	free(packed);
+	(void) close(fd);
+	return (snap);
+}
+
+/*
+ * td_cache_open()
+ *	Enables discovery snapshot kept in given file and loads
+ *	results of previous discovery from it, if present
+ * Return:	TD_E_SUCCESS - snapshot enabled, possibly empty
+ *		TD_E_MEMORY
+ */
+td_errno_t
+td_cache_open(const char *path)
+{
+	td_cache_close();
+	if ((cache_path = strdup(path)) == NULL)
+		return (TD_E_MEMORY);
+
+	cache_snap = cache_read(path);
+	if (cache_snap != NULL &&
+	    nvlist_lookup_nvlist(cache_snap, TDC_DISKS, &cache_disks) != 0) {
+		nvlist_free(cache_snap);
+		cache_snap = NULL;
+	}
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO, "discovery snapshot %s %s\n",
+		    path, cache_snap == NULL ? "empty" : "loaded");
+	return (TD_E_SUCCESS);
+}
+
+/*
+ * td_cache_close()
+ *	Disables discovery snapshot and releases loaded data
+ */
+void
+td_cache_close(void)
+{
+	cache_reset_state();
+	nvlist_free(cache_snap);
+	cache_snap = NULL;
+	cache_disks = NULL;
+	free(cache_path);
+	cache_path = NULL;
+}
+
+boolean_t
+td_cache_enabled(void)
+{
+	return (cache_path != NULL);
+}
+
+/*
+ * fetch snapshot entry of disk, only if disk did not change since
+ * snapshot was taken
+ */
+static nvlist_t *
+cache_disk_entry(const char *disk)
+{
+	nvlist_t *entry;
+	uint32_t state;
+	char *fprint, *cfprint;
+
+	if (cache_disks == NULL ||
+	    nvlist_lookup_nvlist(cache_disks, disk, &entry) != 0)
+		return (NULL);
+	if (cache_state == NULL &&
+	    nvlist_alloc(&cache_state, NV_UNIQUE_NAME, 0) != 0)
+		return (NULL);
+	if (nvlist_lookup_uint32(cache_state, disk, &state) != 0) {
+		state = TDC_STATE_STALE;
+		if (nvlist_lookup_string(entry, TDC_FPRINT, &cfprint) == 0 &&
+		    (fprint = cache_fingerprint(disk)) != NULL &&
+		    streq(fprint, cfprint))
+			state = TDC_STATE_VALID;
+		if (TLI)
+			td_debug_print(LS_DBGLVL_INFO,
+			    "disk %s %s since last discovery\n", disk,
+			    state == TDC_STATE_VALID ? "unchanged" : "changed");
+		(void) nvlist_add_uint32(cache_state, disk, state);
+	}
+	return (state == TDC_STATE_VALID ? entry : NULL);
+}
+
+/* test if objects of given type were stored for unchanged disk */
+static nvlist_t *
+cache_disk_entry_probed(const char *disk, td_object_type_t ot)
+{
+	nvlist_t *entry;
+	uint32_t probed;
+
+	if ((entry = cache_disk_entry(disk)) == NULL ||
+	    nvlist_lookup_uint32(entry, TDC_PROBED, &probed) != 0 ||
+	    (probed & TDC_PROBED_BIT(ot)) == 0)
+		return (NULL);
+	return (entry);
+}
+
+/*
+ * td_cache_get_attrs()
+ *	Fetch attributes of disk, partition or slice from snapshot
+ * Parameters:
+ *	ot	- object type
+ *	disk	- name of disk the object belongs to
+ *	name	- name of object
+ * Return:	copy of attributes, NULL if disk changed or object is not
+ *		in snapshot
+ */
+nvlist_t *
+td_cache_get_attrs(td_object_type_t ot, const char *disk, const char *name)
+{
+	nvlist_t *entry, *objs, *attr, *rattr;
+
+	if ((entry = cache_disk_entry_probed(disk, ot)) == NULL)
+		return (NULL);
+	switch (ot) {
+	case TD_OT_DISK:
+		if (nvlist_lookup_nvlist(entry, TDC_ATTRS, &attr) != 0)
+			return (NULL);
+		break;
+	case TD_OT_PARTITION:
+	case TD_OT_SLICE:
+		if (nvlist_lookup_nvlist(entry, ot == TD_OT_PARTITION ?
+		    TDC_PARTS : TDC_SLICES, &objs) != 0 ||
+		    nvlist_lookup_nvlist(objs, name, &attr) != 0)
+			return (NULL);
+		break;
+	default:
+		return (NULL);
+	}
+	if (nvlist_dup(attr, &rattr, 0) != 0)
+		return (NULL);
+	return (rattr);
+}
+
+/*
+ * td_cache_os_valid()
+ *	Test if Solaris instances on disk are known from snapshot
+ */
+boolean_t
+td_cache_os_valid(const char *disk)
+{
+	return (cache_disk_entry_probed(disk, TD_OT_OS) != NULL);
+}
+
+/*
+ * td_cache_note_os()
+ *	Remember Solaris instance found on slice for next snapshot
+ */
+void
+td_cache_note_os(const char *slice, nvlist_t *attr)
+{
+	if (cache_path == NULL)
+		return;
+	if (cache_os == NULL &&
+	    nvlist_alloc(&cache_os, NV_UNIQUE_NAME, 0) != 0)
+		return;
+	(void) nvlist_add_nvlist(cache_os, slice, attr);
+}
+
+/*
+ * td_cache_restore_os()
+ *	Add Solaris instances on unchanged disks from snapshot to the list
+ *	of discovered objects
+ * Return:	number of instances added
+ */
+int
+td_cache_restore_os(void)
+{
+	nvpair_t *dp = NULL, *op;
+	nvlist_t *entry, *objs, *attr, *onvl;
+	int nos = 0;
+
+	if (cache_disks == NULL)
+		return (0);
+	while ((dp = nvlist_next_nvpair(cache_disks, dp)) != NULL) {
+		if (!td_cache_os_valid(nvpair_name(dp)) ||
+		    nvpair_value_nvlist(dp, &entry) != 0 ||
+		    nvlist_lookup_nvlist(entry, TDC_OS, &objs) != 0)
+			continue;
+		for (op = NULL; (op = nvlist_next_nvpair(objs, op)) != NULL; ) {
+			if (nvpair_value_nvlist(op, &attr) != 0 ||
+			    nvlist_dup(attr, &onvl, 0) != 0)
+				continue;
+			if (add_td_discovered_obj(TD_OT_OS, onvl) !=
+			    TD_E_SUCCESS) {
+				nvlist_free(onvl);
+				continue;
+			}
+			td_cache_note_os(nvpair_name(op), onvl);
+			nos++;
+		}
+	}
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO,
+		    "%d Solaris instances taken from snapshot\n", nos);
+	return (nos);
+}
+
+/*
+ * td_cache_add_disk()
+ *	Add disk to snapshot being built
+ * Parameters:
+ *	snap	- nvlist of disks being built
+ *	disk	- disk name
+ *	attr	- disk attributes
+ *	parts	- partitions keyed by name or NULL if not discovered
+ *	slices	- slices keyed by name or NULL if not discovered
+ *	os	- B_TRUE if Solaris instances were discovered
+ */
+td_errno_t
+td_cache_add_disk(nvlist_t *snap, const char *disk, nvlist_t *attr,
+    nvlist_t *parts, nvlist_t *slices, boolean_t os)
+{
+	nvlist_t *entry, *osl = NULL;
+	nvpair_t *op = NULL;
+	char parent[MAXPATHLEN];
+	uint32_t probed = TDC_PROBED_BIT(TD_OT_DISK);
+	char *fprint;
+	int ret = 0;
+
+	/* disks which can't be fingerprinted are always probed */
+	if ((fprint = cache_fingerprint(disk)) == NULL)
+		return (TD_E_SUCCESS);
+	if (nvlist_alloc(&entry, NV_UNIQUE_NAME, 0) != 0)
+		return (TD_E_MEMORY);
+
+	/* collect Solaris instances on slices of this disk */
+	if (os) {
+		probed |= TDC_PROBED_BIT(TD_OT_OS);
+		while (cache_os != NULL &&
+		    (op = nvlist_next_nvpair(cache_os, op)) != NULL) {
+			nvlist_t *onvl;
+
+			if (!td_parent_disk_name(nvpair_name(op), 's', parent,
+			    sizeof (parent)) || !streq(parent, disk) ||
+			    nvpair_value_nvlist(op, &onvl) != 0)
+				continue;
+			if (osl == NULL &&
+			    (ret = nvlist_alloc(&osl, NV_UNIQUE_NAME, 0)) != 0)
+				break;
+			if ((ret = nvlist_add_nvlist(osl, nvpair_name(op),
+			    onvl)) != 0)
+				break;
+		}
+	}
+	if (parts != NULL)
+		probed |= TDC_PROBED_BIT(TD_OT_PARTITION);
+	if (slices != NULL)
+		probed |= TDC_PROBED_BIT(TD_OT_SLICE);
+
+	if (ret != 0 ||
+	    nvlist_add_string(entry, TDC_FPRINT, fprint) != 0 ||
+	    nvlist_add_uint32(entry, TDC_PROBED, probed) != 0 ||
+	    nvlist_add_nvlist(entry, TDC_ATTRS, attr) != 0 ||
+	    (parts != NULL &&
+	    nvlist_add_nvlist(entry, TDC_PARTS, parts) != 0) ||
+	    (slices != NULL &&
+	    nvlist_add_nvlist(entry, TDC_SLICES, slices) != 0) ||
+	    (osl != NULL && nvlist_add_nvlist(entry, TDC_OS, osl) != 0) ||
+	    nvlist_add_nvlist(snap, disk, entry) != 0) {
+		nvlist_free(osl);
+		nvlist_free(entry);
+		return (TD_E_MEMORY);
+	}
+	nvlist_free(osl);
+	nvlist_free(entry);
+	return (TD_E_SUCCESS);
+}
+
+/*
+ * td_cache_save()
+ *	Write snapshot of disks to snapshot file. The file is replaced
+ *	atomically, so concurrent readers see either old or new snapshot.
+ *	Written snapshot becomes the loaded one for subsequent discovery.
+ * Parameters:
+ *	snap	- nvlist of disks built by td_cache_add_disk(), consumed
+ */
+td_errno_t
+td_cache_save(nvlist_t *snap)
+{
+	struct td_cache_hdr hdr;
+	char tmppath[MAXPATHLEN];
+	nvlist_t *top = NULL;
+	char *packed = NULL;
+	size_t size = 0;
+	td_errno_t err = TD_E_SUCCESS;
+	int fd;
+
+	if (cache_path == NULL) {
+		nvlist_free(snap);
+		return (TD_E_SUCCESS);
+	}
+	if (nvlist_alloc(&top, NV_UNIQUE_NAME, 0) != 0 ||
+	    nvlist_add_nvlist(top, TDC_DISKS, snap) != 0 ||
+	    nvlist_pack(top, &packed, &size, NV_ENCODE_XDR, 0) != 0) {
+		nvlist_free(top);
+		nvlist_free(snap);
+		return (TD_E_MEMORY);
+	}
+	nvlist_free(snap);
+
+	hdr.tch_magic = TD_CACHE_MAGIC;
+	hdr.tch_version = TD_CACHE_VERSION;
+	hdr.tch_size = size;
+
+	/* mkstemp() creates the file exclusively, with mode 0600 */
+	(void) snprintf(tmppath, sizeof (tmppath), "%s.XXXXXX", cache_path);
+	if ((fd = mkstemp(tmppath)) < 0) {
+		td_debug_print(LS_DBGLVL_WARN,
+		    "can't create discovery snapshot %s: %s\n",
+		    tmppath, strerror(errno));
+		free(packed);
+		nvlist_free(top);
+		return (TD_E_NO_DEVICE);
+	}
+	if (write(fd, &hdr, sizeof (hdr)) != sizeof (hdr) ||
+	    write(fd, packed, size) != size || fsync(fd) != 0) {
+		td_debug_print(LS_DBGLVL_WARN,
+		    "can't write discovery snapshot %s: %s\n",
+		    tmppath, strerror(errno));
+		err = TD_E_NO_DEVICE;
+	}
+	(void) close(fd);
+	free(packed);
+	if (err == TD_E_SUCCESS && rename(tmppath, cache_path) != 0)
+		err = TD_E_NO_DEVICE;
+	if (err != TD_E_SUCCESS) {
+		(void) unlink(tmppath);
+		nvlist_free(top);
+		return (err);
+	}
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO,
+		    "discovery snapshot %s saved, %llu bytes\n", cache_path,
+		    (u_longlong_t)size);
+
+	/* fingerprints are recomputed for next discovery */
+	cache_reset_state();
+	nvlist_free(cache_snap);
+	cache_snap = top;
+	if (nvlist_lookup_nvlist(cache_snap, TDC_DISKS, &cache_disks) != 0)
+		cache_disks = NULL;
+	return (TD_E_SUCCESS);
+}
@@ -142,12 +142,16 @@ static char *ddm_slice_inuse_conv_tbl[][2] = {
  */
 static dm_descriptor_t	*ddm_drive_desc = NULL;
 
+/* filtered array of drives created from ddm_drive_desc */
+static ddm_handle_t	*ddm_drive_list = NULL;
+
 
 /* ------------------------ local functions declarations -------------- */
 
 static char *
 ddm_get_device_path_from_ctd_name(char *ctd_name, char strip_symbol,
 	boolean_t strip_devices);
+static boolean_t ddm_drive_is_target(dm_descriptor_t d);
 
 /* ------------------------ local functions --------------------------- */
 
@@ -1267,30 +1271,48 @@ ddm_filter_disks(dm_descriptor_t *drives)
 	}
 
 	for (i = df_num = 0; drives[i] != NULL; i++) {
-		/* omit floppy disks */
+		if (ddm_drive_is_target(drives[i]))
+			df[df_num++] = drives[i];
+	}
 
-		if (ddm_drive_is_floppy(drives[i]))
-			continue;
+	df[df_num] = NULL;
+	return (df);
+}
 
-		/* omit zvolumes */
+/*
+ * ddm_drive_is_target()
+ *	Checks if drive is applicable as install target media
+ *
+ * Parameters:
+ *	dm_descriptor_t d
+ * Return:
+ *	boolean_t
+ * Status:
+ *	private
+ */
+static boolean_t
+ddm_drive_is_target(dm_descriptor_t d)
+{
+	/* omit floppy disks */
 
-		if (ddm_drive_is_zvol(drives[i]))
-			continue;
+	if (ddm_drive_is_floppy(d))
+		return (B_FALSE);
 
-		/* omit CD/DVD drives */
+	/* omit zvolumes */
 
-		if (ddm_drive_is_cdrom(drives[i]))
-			continue;
+	if (ddm_drive_is_zvol(d))
+		return (B_FALSE);
 
-		/* omit install media mounted on /.cdrom */
-		if (ddm_drive_is_install_media(drives[i]))
-			continue;
+	/* omit CD/DVD drives */
 
-		df[df_num++] = drives[i];
-	}
+	if (ddm_drive_is_cdrom(d))
+		return (B_FALSE);
 
-	df[df_num] = NULL;
-	return (df);
+	/* omit install media mounted on /.cdrom */
+	if (ddm_drive_is_install_media(d))
+		return (B_FALSE);
+
+	return (B_TRUE);
 }
 
 /*
@@ -1524,9 +1546,68 @@ ddm_get_disks(void)
 		    "Couldn't filter the disks\n");
 	}
 
+	ddm_drive_list = df;
 	return (df);
 }
 
+/*
+ * ddm_get_disk_by_name()
+ *	Discovery of single disk, e.g. after it was hot-plugged
+ *
+ * Parameters:
+ *	name - disk name in cXtXdX format
+ * Return:
+ *	ddm_handle_t * - list containing handle of the drive, NULL if there
+ *	is no such drive or it is not applicable as install target.
+ *	The list is independent of the one returned by ddm_get_disks()
+ *	and is freed by ddm_free_handle_list()
+ * Status:
+ *	public
+ */
+ddm_handle_t *
+ddm_get_disk_by_name(const char *name)
+{
+	dm_descriptor_t	alias;
+	dm_descriptor_t	*drives;
+	int		errn;
+
+	DDM_DEBUG(DDM_DBGLVL_NOTICE, "-> ddm_get_disk_by_name(%s)\n", name);
+
+	alias = dm_get_descriptor_by_name(DM_ALIAS, (char *)name, &errn);
+
+	if (errn != 0) {
+		DDM_DEBUG(DDM_DBGLVL_INFO,
+		    "ddm_get_disk_by_name(): No alias %s, err=%d\n",
+		    name, errn);
+
+		return (NULL);
+	}
+
+	drives = dm_get_associated_descriptors(alias, DM_DRIVE, &errn);
+	dm_free_descriptor(alias);
+
+	if ((drives == NULL) || (errn != 0) || (drives[0] == 0)) {
+		DDM_DEBUG(DDM_DBGLVL_ERROR,
+		    "ddm_get_disk_by_name(): No drive for %s, err=%d\n",
+		    name, errn);
+
+		if (drives != NULL)
+			dm_free_descriptors(drives);
+		return (NULL);
+	}
+
+	if (!ddm_drive_is_target(drives[0])) {
+		DDM_DEBUG(DDM_DBGLVL_INFO,
+		    "ddm_get_disk_by_name(): %s is not install target\n",
+		    name);
+
+		dm_free_descriptors(drives);
+		return (NULL);
+	}
+
+	return ((ddm_handle_t *)drives);
+}
+
 /*
  * ddm_get_disks_attributes()
  * 	Get attributes for particular disk
@@ -2325,6 +2406,64 @@ ddm_get_slice_inuse_stats(char *name, nvlist_t *nv_dst)
 	return (0);
 }
 
+/*
+ * ddm_get_name()
+ *	Gets ctd name of disk, partition or slice from handle without
+ *	discovering its attributes
+ * Parameters:	h	handle of drive, partition or slice
+ *
+ * Return:	name (cXtXdX, cXtXdXpX, cXtXdXsX) allocated on heap,
+ *		which is to be freed by caller, or NULL
+ */
+char *
+ddm_get_name(ddm_handle_t h)
+{
+	char	*name, *bname, *ret;
+	int	errn;
+
+	if (dm_get_type((dm_descriptor_t)h) == DM_DRIVE)
+		return (ddm_drive_get_name(h));
+
+	name = dm_get_name((dm_descriptor_t)h, &errn);
+
+	if (errn != 0 || name == NULL) {
+		DDM_DEBUG(DDM_DBGLVL_INFO,
+		    "ddm_get_name(): Can't get name, err=%d\n", errn);
+
+		return (NULL);
+	}
+
+	/* strip /dev/[r]dsk/ prefix - report only ctd basename */
+
+	bname = basename(name);
+	ret = (bname == NULL ? NULL : strdup(bname));
+	dm_free_name(name);
+	return (ret);
+}
+
+/*
+ * ddm_open_disk()
+ *	Opens raw device of whole disk for reading - p0 on x86, backup
+ *	slice otherwise
+ * Parameters:	name	ctd name of disk
+ *
+ * Return:	file descriptor to be closed by caller, or -1
+ */
+int
+ddm_open_disk(const char *name)
+{
+	static const char *suffix[] = {"p0", "s2", NULL};
+	char devpath[MAXPATHLEN];
+	int i, fd = -1;
+
+	for (i = 0; suffix[i] != NULL && fd < 0; i++) {
+		(void) snprintf(devpath, sizeof (devpath), "/dev/rdsk/%s%s",
+		    name, suffix[i]);
+		fd = open(devpath, O_RDONLY | O_NDELAY);
+	}
+	return (fd);
+}
+
 /*
  * ddm_free_handle_list()
  * Frees list of handles returned by
@@ -2353,13 +2492,14 @@ ddm_free_handle_list(ddm_handle_t *h)
 	 * drive descriptors.
 	 */
 
-	if (dm_get_type(h[0]) == DM_DRIVE) {
+	if (h == ddm_drive_list) {
 		free(h);
 
 		if (ddm_drive_desc != NULL)
 			dm_free_descriptors(ddm_drive_desc);
 
 		ddm_drive_desc = NULL;
+		ddm_drive_list = NULL;
 	} else {
 		dm_free_descriptors(h);
 	}
@@ -2383,10 +2523,8 @@ void
 ddm_debug_print(ls_dbglvl_t dbg_lvl, const char *fmt, ...)
 {
 	va_list	ap;
-	char	buf[MAXPATHLEN + 1];
 
 	va_start(ap, fmt);
-	(void) vsprintf(buf, fmt, ap);
-	(void) ls_write_dbg_message("TDDM", dbg_lvl, buf);
+	ls_write_dbg_vmessage("TDDM", dbg_lvl, fmt, ap);
 	va_end(ap);
 }
@@ -81,11 +81,14 @@ typedef enum ddm_err_t {
 
 /* function prototypes */
 extern ddm_handle_t	*ddm_get_disks(void);
+extern ddm_handle_t	*ddm_get_disk_by_name(const char *name);
 extern nvlist_t		*ddm_get_disk_attributes(ddm_handle_t d);
 extern ddm_handle_t	*ddm_get_partitions(ddm_handle_t d);
 extern nvlist_t		*ddm_get_partition_attributes(ddm_handle_t p);
 extern ddm_handle_t	*ddm_get_slices(ddm_handle_t h);
 extern nvlist_t		*ddm_get_slice_attributes(ddm_handle_t s);
+extern char		*ddm_get_name(ddm_handle_t h);
+extern int		ddm_open_disk(const char *name);
 extern void		ddm_free_handle_list(ddm_handle_t *h);
 extern void		ddm_free_attr_list(nvlist_t *attrs);
 extern int		ddm_get_slice_inuse_stats(char *, nvlist_t *);
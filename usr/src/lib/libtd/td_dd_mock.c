@@ -0,0 +1,354 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * Module:	td_dd_mock.c
+ * Group:
+ * Description:	Synthetic replacement for the Target Discovery disk module
+ *		(td_dd.c). Instead of probing devices through libdiskmgt,
+ *		it reports a configurable number of disks, each with the
+ *		same number of fdisk partitions and VTOC slices, and can
+ *		simulate device probe latency. Raw devices of disks can be
+ *		backed by regular files, for the discovery snapshot
+ *		fingerprint. Linked only into the discovery benchmark,
+ *		never into libtd itself.
+ */
+
+#include <assert.h>
+#include <atomic.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/vtoc.h>
+
+#include <td_dd.h>
+#include <ls_api.h>
+
+/*
+ * handle layout: object type in the top byte, disk index in the middle,
+ * object index on the disk in the low 16 bits. Handles are never 0,
+ * since 0 terminates handle lists
+ */
+#define	MOCK_OT_DISK		1ULL
+#define	MOCK_OT_PART		2ULL
+#define	MOCK_OT_SLICE		3ULL
+
+#define	MOCK_HANDLE(ot, d, i)	(((ot) << 56) | ((uint64_t)(d) << 16) | (i))
+#define	MOCK_HANDLE_OT(h)	((h) >> 56)
+#define	MOCK_HANDLE_DISK(h)	(((h) >> 16) & 0xffffffffffULL)
+#define	MOCK_HANDLE_IDX(h)	((h) & 0xffffULL)
+
+#define	MOCK_DISK_BLOCKS	(uint64_t)(64ULL * 1024 * 1024 * 2) /* 64G */
+#define	MOCK_NHEADS		255
+#define	MOCK_NSECTORS		63
+
+static int mock_ndisks = 0;
+static int mock_nparts = 0;
+static int mock_nslices = 0;
+static useconds_t mock_latency = 0;
+static const char *mock_devdir = NULL;
+static uint_t mock_nprobes = 0;
+
+/*
+ * ddm_mock_init()
+ *	Configures synthetic disk topology
+ * Parameters:
+ *	ndisks	- number of disks reported by ddm_get_disks()
+ *	nparts	- fdisk partitions per disk (at most FD_NUMPART)
+ *	nslices	- VTOC slices per disk (at most NDKMAP)
+ *	latency	- simulated probe time of one attribute lookup in usec
+ */
+void
+ddm_mock_init(int ndisks, int nparts, int nslices, useconds_t latency)
+{
+	mock_ndisks = ndisks;
+	mock_nparts = MIN(nparts, 4);
+	mock_nslices = MIN(nslices, NDKMAP);
+	mock_latency = latency;
+}
+
+/*
+ * ddm_mock_set_devdir()
+ *	Backs raw device of each disk by a regular file named after
+ *	the disk in given directory. Disks without a file, or all disks
+ *	if dir is NULL, can't be opened.
+ */
+void
+ddm_mock_set_devdir(const char *dir)
+{
+	mock_devdir = dir;
+}
+
+/*
+ * ddm_mock_disk_probes()
+ *	Returns number of disk attribute probes so far
+ */
+uint_t
+ddm_mock_disk_probes(void)
+{
+	return (mock_nprobes);
+}
+
+static void
+mock_disk_name(uint64_t d, char *buf, size_t len)
+{
+	(void) snprintf(buf, len, "c%llut%llud0",
+	    (u_longlong_t)(d / 1024), (u_longlong_t)(d % 1024));
+}
+
+/*
+ * allocate handle list of given type
+ * if d is DDM_DISCOVER_ALL, objects of all disks are listed
+ */
+static ddm_handle_t *
+mock_handle_list(uint64_t ot, ddm_handle_t d, int nper)
+{
+	ddm_handle_t	*h, *ph;
+	uint64_t	first, last, di;
+	int		i;
+
+	if (d == DDM_DISCOVER_ALL) {
+		first = 0;
+		last = mock_ndisks;
+	} else {
+		first = MOCK_HANDLE_DISK(d);
+		last = first + 1;
+	}
+	h = calloc((last - first) * nper + 1, sizeof (ddm_handle_t));
+	if (h == NULL)
+		return (NULL);
+	for (ph = h, di = first; di < last; di++)
+		for (i = 0; i < nper; i++)
+			*ph++ = MOCK_HANDLE(ot, di, i);
+	*ph = 0;
+	return (h);
+}
+
+ddm_handle_t *
+ddm_get_disks(void)
+{
+	if (mock_ndisks == 0)
+		return (NULL);
+	return (mock_handle_list(MOCK_OT_DISK, DDM_DISCOVER_ALL, 1));
+}
+
+ddm_handle_t *
+ddm_get_disk_by_name(const char *name)
+{
+	u_longlong_t	c, t;
+	ddm_handle_t	*h;
+
+	if (sscanf(name, "c%llut%llud0", &c, &t) != 2 || t >= 1024 ||
+	    c * 1024 + t >= mock_ndisks)
+		return (NULL);
+	if ((h = calloc(2, sizeof (ddm_handle_t))) == NULL)
+		return (NULL);
+	h[0] = MOCK_HANDLE(MOCK_OT_DISK, c * 1024 + t, 0);
+	return (h);
+}
+
+ddm_handle_t *
+ddm_get_partitions(ddm_handle_t d)
+{
+	if (mock_nparts == 0)
+		return (NULL);
+	return (mock_handle_list(MOCK_OT_PART, d, mock_nparts));
+}
+
+ddm_handle_t *
+ddm_get_slices(ddm_handle_t d)
+{
+	if (mock_nslices == 0)
+		return (NULL);
+	return (mock_handle_list(MOCK_OT_SLICE, d, mock_nslices));
+}
+
+nvlist_t *
+ddm_get_disk_attributes(ddm_handle_t d)
+{
+	nvlist_t	*attr;
+	char		name[MAXNAMELEN];
+
+	assert(MOCK_HANDLE_OT(d) == MOCK_OT_DISK);
+
+	atomic_inc_uint(&mock_nprobes);
+	if (mock_latency != 0)
+		(void) usleep(mock_latency);
+	if (nvlist_alloc(&attr, DDM_NVATTRS, 0) != 0)
+		return (NULL);
+	mock_disk_name(MOCK_HANDLE_DISK(d), name, sizeof (name));
+	if (nvlist_add_string(attr, TD_DISK_ATTR_NAME, name) != 0 ||
+	    nvlist_add_string(attr, TD_DISK_ATTR_CTYPE, "scsi") != 0 ||
+	    nvlist_add_string(attr, TD_DISK_ATTR_VENDOR, "MOCK") != 0 ||
+	    nvlist_add_uint32(attr, TD_DISK_ATTR_MTYPE, TD_MT_FIXED) != 0 ||
+	    nvlist_add_uint32(attr, TD_DISK_ATTR_BLOCKSIZE, 512) != 0 ||
+	    nvlist_add_uint64(attr, TD_DISK_ATTR_SIZE, MOCK_DISK_BLOCKS) != 0 ||
+	    nvlist_add_uint32(attr, TD_DISK_ATTR_NHEADS, MOCK_NHEADS) != 0 ||
+	    nvlist_add_uint32(attr, TD_DISK_ATTR_NSECTORS,
+	    MOCK_NSECTORS) != 0 ||
+	    nvlist_add_uint32(attr, TD_DISK_ATTR_LABEL,
+	    TD_DISK_LABEL_VTOC | TD_DISK_LABEL_FDISK) != 0) {
+		nvlist_free(attr);
+		return (NULL);
+	}
+	return (attr);
+}
+
+nvlist_t *
+ddm_get_partition_attributes(ddm_handle_t p)
+{
+	nvlist_t	*attr;
+	char		dname[MAXNAMELEN], name[MAXNAMELEN];
+	uint32_t	psize = MOCK_DISK_BLOCKS / 4;
+	uint32_t	idx = MOCK_HANDLE_IDX(p);
+
+	assert(MOCK_HANDLE_OT(p) == MOCK_OT_PART);
+
+	if (mock_latency != 0)
+		(void) usleep(mock_latency);
+	if (nvlist_alloc(&attr, DDM_NVATTRS, 0) != 0)
+		return (NULL);
+	mock_disk_name(MOCK_HANDLE_DISK(p), dname, sizeof (dname));
+	(void) snprintf(name, sizeof (name), "%sp%u", dname, idx + 1);
+	if (nvlist_add_string(attr, TD_PART_ATTR_NAME, name) != 0 ||
+	    nvlist_add_uint32(attr, TD_PART_ATTR_BOOTID,
+	    idx == 0 ? 0x80 : 0) != 0 ||
+	    nvlist_add_uint32(attr, TD_PART_ATTR_TYPE, 0xbf) != 0 ||
+	    nvlist_add_uint32(attr, TD_PART_ATTR_START,
+	    MOCK_NSECTORS + idx * psize) != 0 ||
+	    nvlist_add_uint32(attr, TD_PART_ATTR_SIZE, psize) != 0) {
+		nvlist_free(attr);
+		return (NULL);
+	}
+	return (attr);
+}
+
+nvlist_t *
+ddm_get_slice_attributes(ddm_handle_t s)
+{
+	nvlist_t	*attr;
+	char		dname[MAXNAMELEN], name[MAXNAMELEN];
+	uint64_t	ssize = MOCK_DISK_BLOCKS / NDKMAP;
+	uint32_t	idx = MOCK_HANDLE_IDX(s);
+
+	assert(MOCK_HANDLE_OT(s) == MOCK_OT_SLICE);
+
+	if (mock_latency != 0)
+		(void) usleep(mock_latency);
+	if (nvlist_alloc(&attr, DDM_NVATTRS, 0) != 0)
+		return (NULL);
+	mock_disk_name(MOCK_HANDLE_DISK(s), dname, sizeof (dname));
+	(void) snprintf(name, sizeof (name), "%ss%u", dname, idx);
+	if (nvlist_add_string(attr, TD_SLICE_ATTR_NAME, name) != 0 ||
+	    nvlist_add_uint32(attr, TD_SLICE_ATTR_INDEX, idx) != 0 ||
+	    nvlist_add_uint32(attr, TD_SLICE_ATTR_TAG,
+	    idx == 2 ? V_BACKUP : V_UNASSIGNED) != 0 ||
+	    nvlist_add_uint32(attr, TD_SLICE_ATTR_FLAG, 0) != 0 ||
+	    nvlist_add_uint64(attr, TD_SLICE_ATTR_START, idx * ssize) != 0 ||
+	    nvlist_add_uint64(attr, TD_SLICE_ATTR_SIZE, ssize) != 0) {
+		nvlist_free(attr);
+		return (NULL);
+	}
+	return (attr);
+}
+
+char *
+ddm_get_name(ddm_handle_t h)
+{
+	char	dname[MAXNAMELEN], name[MAXNAMELEN];
+
+	mock_disk_name(MOCK_HANDLE_DISK(h), dname, sizeof (dname));
+	switch (MOCK_HANDLE_OT(h)) {
+	case MOCK_OT_PART:
+		(void) snprintf(name, sizeof (name), "%sp%llu", dname,
+		    (u_longlong_t)MOCK_HANDLE_IDX(h) + 1);
+		break;
+	case MOCK_OT_SLICE:
+		(void) snprintf(name, sizeof (name), "%ss%llu", dname,
+		    (u_longlong_t)MOCK_HANDLE_IDX(h));
+		break;
+	default:
+		(void) strlcpy(name, dname, sizeof (name));
+		break;
+	}
+	return (strdup(name));
+}
+
+int
+ddm_open_disk(const char *name)
+{
+	char	path[MAXPATHLEN];
+
+	if (mock_devdir == NULL)
+		return (-1);
+	(void) snprintf(path, sizeof (path), "%s/%s", mock_devdir, name);
+	return (open(path, O_RDONLY));
+}
+
+/* ARGSUSED */
+int
+ddm_get_slice_inuse_stats(char *name, nvlist_t *nv_dst)
+{
+	return (0);
+}
+
+int
+ddm_is_slice_name(char *str)
+{
+	char *p = strrchr(str, 's');
+
+	return (p != NULL && p[1] != '\0');
+}
+
+void
+ddm_free_handle_list(ddm_handle_t *h)
+{
+	assert(h != NULL);
+
+	free(h);
+}
+
+void
+ddm_free_attr_list(nvlist_t *attrs)
+{
+	assert(attrs != NULL);
+
+	nvlist_free(attrs);
+}
+
+void
+ddm_debug_print(ls_dbglvl_t dbg_lvl, const char *fmt, ...)
+{
+	va_list	ap;
+
+	va_start(ap, fmt);
+	ls_write_dbg_vmessage("TDDM", dbg_lvl, fmt, ap);
+	va_end(ap);
+}
@@ -77,10 +77,35 @@ void	td_debug_print(ls_dbglvl_t, const char *, ...);
 char	*td_get_rootdir(void);
 boolean_t td_is_fstyp(const char *, char *);
 td_errno_t add_td_discovered_obj(td_object_type_t objtype, nvlist_t *onvl);
+boolean_t td_parent_disk_name(const char *, char, char *, size_t);
+
+/* td_cache.c */
+td_errno_t	td_cache_open(const char *);
+void	td_cache_close(void);
+boolean_t	td_cache_enabled(void);
+nvlist_t	*td_cache_get_attrs(td_object_type_t, const char *, const char *);
+boolean_t	td_cache_os_valid(const char *);
+void	td_cache_note_os(const char *, nvlist_t *);
+int	td_cache_restore_os(void);
+td_errno_t	td_cache_add_disk(nvlist_t *, const char *, nvlist_t *,
+	    nvlist_t *, nvlist_t *, boolean_t);
+td_errno_t	td_cache_save(nvlist_t *);
+void	td_cache_reset(void);
 
 /* td_version.c */
 boolean_t	td_get_release(const char *, char *, int, char *, int);
 boolean_t	td_get_build_id(const char *, char *, size_t);
+boolean_t	td_parse_build_id(char *, char *, size_t);
+
+/* td_ufs.c */
+typedef enum {
+	TD_UFS_UNKNOWN,		/* must be mounted to tell */
+	TD_UFS_NOT_UFS,		/* no UFS file system */
+	TD_UFS_NO_ROOT,		/* UFS without /etc/vfstab */
+	TD_UFS_ROOT		/* UFS with /etc/vfstab */
+} td_ufs_probe_t;
+
+td_ufs_probe_t	td_ufs_probe_root(const char *, char *, size_t);
 
 /* td_mountall.c */
 int	mount_zones(void);
@@ -47,6 +47,8 @@
 #include <ustat.h>
 #include <sys/wait.h>
 #include <libintl.h>
+#include <pthread.h>
+#include <atomic.h>
 
 #include <instzones_api.h>
 
@@ -57,6 +59,7 @@
 
 #include <ls_api.h>	/* logging service */
 #include <assert.h>
+#include <ctype.h>
 
 /* mount var on separate slice return codes */
 #define	MNTRC_MOUNT_SUCCEEDS 1
@@ -68,6 +71,9 @@
 
 #define	ATTR_LIST_TERMINATOR ((nvlist_t *)-1)
 
+/* upper bound for attribute discovery worker pool */
+#define	TD_MAX_DISCOVERY_THREADS	64
+
 /* template temporary directory names for mkdtemp() */
 #define	TEMPLATEROOT	"/tmp/td_rootXXXXXX"
 #define	TEMPLATEVAR	TEMPLATEROOT "/var"
@@ -77,6 +83,14 @@ struct td_obj {
 	ddm_handle_t handle;		/* disk module handle */
 	nvlist_t *attrib;		/* attribute list for disk */
 	boolean_t discovery_done;	/* discovery performed for object */
+	td_attr_info_t info;		/* numeric attributes from attrib */
+	boolean_t info_done;		/* info extracted from attrib */
+};
+
+/* handle list from lower-level module, kept while objects refer to it */
+struct td_hlist {
+	ddm_handle_t *pddm;		/* disk module handle list */
+	struct td_hlist *next;		/* next list */
 };
 
 /* class for TD objects */
@@ -88,6 +102,8 @@ struct td_class {
 	ddm_handle_t *pddm;		/* disk module handle */
 	boolean_t issorted;		/* object list has been sorted */
 	int (*compare_routine)(const void *, const void *); /* sorting */
+	struct td_hlist *pddmx;		/* handle lists of rediscovered disks */
+	boolean_t rediscovered;		/* object list differs from pddm */
 };
 
 /* sort comparison routines for objects */
@@ -98,19 +114,87 @@ static int compare_os_objs(const void *p1, const void *p2);
 
 /* object type declarations */
 static struct td_class objlist[] = {
-	{TD_OT_DISK, 0, NULL, NULL, NULL, B_FALSE, compare_disk_objs},
-	{TD_OT_PARTITION, 0, NULL, NULL, NULL, B_FALSE, compare_partition_objs},
-	{TD_OT_SLICE, 0, NULL, NULL, NULL, B_FALSE, compare_slice_objs},
-	{TD_OT_OS, 0, NULL, NULL, NULL, B_FALSE, compare_os_objs}
+	{TD_OT_DISK, 0, NULL, NULL, NULL, B_FALSE, compare_disk_objs,
+	    NULL, B_FALSE},
+	{TD_OT_PARTITION, 0, NULL, NULL, NULL, B_FALSE, compare_partition_objs,
+	    NULL, B_FALSE},
+	{TD_OT_SLICE, 0, NULL, NULL, NULL, B_FALSE, compare_slice_objs,
+	    NULL, B_FALSE},
+	{TD_OT_OS, 0, NULL, NULL, NULL, B_FALSE, compare_os_objs,
+	    NULL, B_FALSE}
 };
 #define	is_valid_td_object_type(ot) \
 	((ot) >= 0 && (ot) < sizeof (objlist) / sizeof (objlist[0]))
 
-static int td_errno = 0;
+/*
+ * immutable copy of attributes of discovered objects of one type,
+ * shared by iterators - freed when last reference is dropped
+ */
+struct td_objset {
+	uint_t refcnt;			/* iterators + current set */
+	int nobjs;			/* number of objects */
+	nvlist_t **attrs;		/* attributes of objects */
+	td_attr_info_t *infos;		/* numeric attributes of objects */
+};
+
+/* enumeration of object set by one consumer */
+struct td_iter {
+	struct td_objset *set;		/* object set being enumerated */
+	int cur;			/* current object, -1 before first */
+};
+
+/* current object sets, built on first td_iter_open() after discovery */
+static struct td_objset *td_objsets[sizeof (objlist) / sizeof (objlist[0])];
+
+/* index of partitions and slices grouped by parent disk name */
+struct td_index_ent {
+	char *disk;			/* disk name - owned by disk attributes */
+	nvlist_t **child[2];		/* partitions, slices on the disk */
+	int nchild[2];			/* number of partitions, slices */
+	struct td_index_ent *next;	/* next entry in hash chain */
+};
+
+struct td_index {
+	struct td_index_ent *ents;	/* one entry per named disk */
+	struct td_index_ent **hash;	/* hash table of entries */
+	uint_t nbuckets;		/* size of hash table - power of 2 */
+	nvlist_t **pool[2];		/* storage for all child lists */
+};
+
+static struct td_index td_idx;
+
+/* index of child lists for partitions and slices */
+#define	TD_INDEX_CHILD(ot)	((ot) == TD_OT_PARTITION ? 0 : 1)
+
+/* slice which may hold Solaris instance, prepared by os_discover() */
+struct td_os_cand {
+	nvlist_t *nvl;			/* slice attributes */
+	char *slicenm;			/* slice name - owned by nvl */
+	uint32_t tag;			/* VTOC partition tag */
+	boolean_t mounted;		/* mounted on running system */
+	td_ufs_probe_t probe;		/* result of raw file system probe */
+	char etcrelease[BUFSIZ];	/* first line of /etc/release */
+	char mntpnt[sizeof (TEMPLATEROOT)]; /* private mount point */
+	int mntrc;			/* result of td_fsck_mount() */
+};
+
+/* shared state of candidate preparation worker pool */
+struct td_os_pool {
+	struct td_os_cand *cands;	/* candidates being prepared */
+	int ncands;			/* number of candidates */
+	int next;			/* index of next candidate to claim */
+	pthread_mutex_t lock;		/* protects next */
+};
+
+static pthread_key_t td_errno_key; /* TD errno of calling thread */
+static pthread_mutex_t td_discovery_lock; /* recursive - serializes discovery */
+static pthread_once_t td_mt_once = PTHREAD_ONCE_INIT;
 static char CLUSTER_tmp_path[MAXPATHLEN] = "";
 static char clustertoc_tmp_path[MAXPATHLEN] = "";
 static char rootdir[BUFSIZ] = "";
 static char mntrc_text[32];
+static int td_discovery_threads = 1; /* serial attribute discovery */
+static boolean_t td_os_discovered = B_FALSE; /* for discovery snapshot */
 
 /* disk module handle lists shorthand */
 #define	PDDMDISKS (objlist[TD_OT_DISK].pddm)
@@ -136,8 +220,21 @@ static char mntrc_text[32];
 
 static td_errno_t set_td_errno(int);
 static void clear_td_errno();
-static td_errno_t os_discover(void);
-static struct td_obj *search_disks(const char *);
+static void td_mt_init(void);
+static void td_lock_discovery(void);
+static void td_unlock_discovery(void);
+static td_errno_t discover_objs(td_object_type_t, int *);
+static td_errno_t rediscover_device(const char *, td_rediscover_op_t);
+static struct td_objset *td_objset_build(td_object_type_t);
+static void td_objset_rele(struct td_objset *);
+static void td_objset_invalidate(td_object_type_t);
+static td_errno_t os_discover(ddm_handle_t *);
+static struct td_os_cand *os_candidates(FILE *, ddm_handle_t *, boolean_t,
+    int *);
+static void os_prepare_candidate(struct td_os_cand *);
+static void *os_prepare_worker(void *);
+static void os_prepare_candidates(struct td_os_cand *, int);
+static void os_release_candidate(struct td_os_cand *);
 static char *td_get_default_inst(void);
 static boolean_t string_array_add(const char *, char ***);
 static char *clustertoc_read_path(int, const char *);
@@ -146,13 +243,28 @@ static char *td_get_value(const char *, char);
 static boolean_t bootenv_exists(const char *);
 static struct td_obj *disk_random_slice(nvlist_t *);
 static void disks_discover_all_attrs(void);
+static void objs_discover_all_attrs(td_object_type_t);
+static void objs_fill_from_cache(td_object_type_t);
+static nvlist_t *cache_group_by_disk(td_object_type_t);
+static void td_cache_snapshot(void);
+static void *objs_discover_attrs_worker(void *);
+static nvlist_t *ddm_get_obj_attributes(td_object_type_t, ddm_handle_t);
 static void sort_objs(td_object_type_t);
 static int td_fsck_mount(char *, char *, boolean_t, char *, char *, char *,
     nvlist_t **);
 static nvlist_t *dup_attr_set_errno(struct td_obj *);
+static struct td_obj *td_current_obj(td_object_type_t);
 static void free_td_obj_list(td_object_type_t);
+static boolean_t td_obj_disk_name(td_object_type_t, struct td_obj *, char *,
+    size_t);
+static int td_remove_disk_objs(td_object_type_t, const char *);
+static td_errno_t td_append_objs(td_object_type_t, ddm_handle_t *);
 static nvlist_t **td_discover_object_by_disk(td_object_type_t,
     const char *, int *);
+static nvlist_t **td_get_object_by_disk(td_object_type_t,
+    const char *, int *);
+static struct td_index_ent *td_index_lookup(td_object_type_t, const char *);
+static void td_index_invalidate(td_object_type_t);
 static boolean_t is_wrong_metacluster(char *);
 static struct td_obj *search_disks_for_slices(char *);
 static void td_debug_cat_file(ls_dbglvl_t, char *);
@@ -173,11 +285,9 @@ void
 td_debug_print(ls_dbglvl_t dbg_lvl, const char *fmt, ...)
 {
 	va_list	ap;
-	char	buf[256]; /* one output line */
 
 	va_start(ap, fmt);
-	(void) vsnprintf(buf, sizeof (buf), fmt, ap);
-	(void) ls_write_dbg_message("TDMG", dbg_lvl, buf);
+	ls_write_dbg_vmessage("TDMG", dbg_lvl, fmt, ap);
 	va_end(ap);
 }
 
@@ -195,6 +305,24 @@ td_debug_print(ls_dbglvl_t dbg_lvl, const char *fmt, ...)
  */
 td_errno_t
 td_discover(td_object_type_t otype, int *number_found)
+{
+	td_errno_t ret;
+
+	td_lock_discovery();
+	ret = discover_objs(otype, number_found);
+	/* iterators opened from now on see new results */
+	if (is_valid_td_object_type(otype))
+		td_objset_invalidate(otype);
+	td_unlock_discovery();
+	return (ret);
+}
+
+/*
+ * discover objects of specific type - body of td_discover()
+ * called with discovery lock held
+ */
+static td_errno_t
+discover_objs(td_object_type_t otype, int *number_found)
 {
 	ddm_handle_t *pddm; /* temporaries */
 	struct td_obj *ptdobj;
@@ -205,6 +333,14 @@ td_discover(td_object_type_t otype, int *number_found)
 	if (number_found != NULL)
 		*number_found = 0;
 
+	/* objects were changed by td_rediscover_device() - start over */
+	if (is_valid_td_object_type(otype) && objlist[otype].rediscovered)
+		free_td_obj_list(otype);
+
+	/* object array is rebuilt - drop index referring to it */
+	if (otype != TD_OT_OS)
+		td_index_invalidate(otype);
+
 	switch (otype) {
 	case TD_OT_DISK: /* get disks */
 		if (PDDMDISKS == NULL) {
@@ -239,11 +375,18 @@ td_discover(td_object_type_t otype, int *number_found)
 			ptdobj->handle = *pddm;
 			ptdobj->attrib = NULL;
 			ptdobj->discovery_done = B_FALSE;
+			ptdobj->info_done = B_FALSE;
 		}
 		/* mark end of array */
 		ptdobj->handle = NULL;
 		ptdobj->attrib = NULL;
 		CURDISK = NULL;
+		/* take attributes of unchanged disks from snapshot */
+		if (td_cache_enabled())
+			objs_fill_from_cache(TD_OT_DISK);
+		/* with worker pool configured, fetch attributes up front */
+		if (td_discovery_threads > 1)
+			objs_discover_all_attrs(TD_OT_DISK);
 		break;
 	case TD_OT_PARTITION:
 		if (PDDMPARTS == NULL) {
@@ -280,11 +423,18 @@ td_discover(td_object_type_t otype, int *number_found)
 			ptdobj->handle = *pddm;
 			ptdobj->attrib = NULL;
 			ptdobj->discovery_done = B_FALSE;
+			ptdobj->info_done = B_FALSE;
 		}
 		/* mark end of array */
 		ptdobj->handle = NULL;
 		ptdobj->attrib = NULL;
 		CURPART = NULL;
+		/* take attributes of unchanged disks from snapshot */
+		if (td_cache_enabled())
+			objs_fill_from_cache(TD_OT_PARTITION);
+		/* with worker pool configured, fetch attributes up front */
+		if (td_discovery_threads > 1)
+			objs_discover_all_attrs(TD_OT_PARTITION);
 		break;
 	case TD_OT_SLICE:
 		if (PDDMSLICES == NULL) {
@@ -316,26 +466,23 @@ td_discover(td_object_type_t otype, int *number_found)
 			ptdobj->handle = *pddm;
 			ptdobj->attrib = NULL;
 			ptdobj->discovery_done = B_FALSE;
+			ptdobj->info_done = B_FALSE;
 		}
 		/* mark end of array */
 		ptdobj->handle = NULL;
 		ptdobj->attrib = NULL;
 		CURSLICE = NULL;
+		/* take attributes of unchanged disks from snapshot */
+		if (td_cache_enabled())
+			objs_fill_from_cache(TD_OT_SLICE);
+		/* with worker pool configured, fetch attributes up front */
+		if (td_discovery_threads > 1)
+			objs_discover_all_attrs(TD_OT_SLICE);
 		break;
 	case TD_OT_OS: /* get OS instances */
-		if (PDDMSLICES == NULL) {
-			PDDMSLICES = ddm_get_slices(NULL); /* get all slices */
-			if (PDDMSLICES == NULL)
-				return (set_td_errno(TD_E_END));
-		}
-		NSLICES = 0;
-		pddm = PDDMSLICES;
-		while (*pddm != NULL) { /* count slices */
-			pddm++;
-			NSLICES++;
-		}
 		NOS = 0; /* reset master count */
-		ret = os_discover();
+		ret = os_discover(NULL); /* all slices */
+		td_os_discovered = (ret == TD_E_SUCCESS);
 		if (number_found != NULL)
 			*number_found = NOS;
 		CUROS = NULL; /* reset current to first */
@@ -369,6 +516,7 @@ td_get_next(td_object_type_t otype)
 	if (!is_valid_td_object_type(otype))
 		return (set_td_errno(TD_E_NO_OBJECT));
 
+	td_lock_discovery();
 	if (objlist[otype].objcur == NULL)
 		objlist[otype].objcur = objlist[otype].objarr;
 	else
@@ -377,8 +525,10 @@ td_get_next(td_object_type_t otype)
 	if (objlist[otype].objcur == NULL ||
 	    objlist[otype].objcur->handle == NULL) {
 		objlist[otype].objcur = NULL;
+		td_unlock_discovery();
 		return (set_td_errno(TD_E_END));
 	}
+	td_unlock_discovery();
 	return (TD_E_SUCCESS);
 }
 
@@ -405,7 +555,9 @@ td_reset(td_object_type_t otype)
 	if (!is_valid_td_object_type(otype))
 		return (set_td_errno(TD_E_NO_OBJECT));
 
+	td_lock_discovery();
 	objlist[otype].objcur = NULL;
+	td_unlock_discovery();
 	return (TD_E_SUCCESS);
 }
 
@@ -429,7 +581,90 @@ td_reset(td_object_type_t otype)
 nvlist_t *
 td_attributes_get(td_object_type_t otype)
 {
+	struct td_obj *pobj;
+	nvlist_t *attr = NULL;
+
+	clear_td_errno();
+	td_lock_discovery();
+	if ((pobj = td_current_obj(otype)) != NULL && pobj->attrib != NULL)
+		attr = dup_attr_set_errno(pobj);
+	td_unlock_discovery();
+	return (attr);
+}
+
+/*
+ * fetch attributes for currently enumerated object of specified type
+ * without copying them
+ * interface to TD user
+ * parameters:
+ *	otype	indicate object type for which to fetch objects
+ * returns attributes owned by TD, NULL as td_attributes_get()
+ *
+ * The list must not be modified or freed. It is valid until discovery
+ * of the object type is repeated, the object's disk is rediscovered or
+ * discovered data is released.
+ */
+nvlist_t *
+td_attributes_view(td_object_type_t otype)
+{
+	struct td_obj *pobj;
+	nvlist_t *attr = NULL;
+
+	clear_td_errno();
+	td_lock_discovery();
+	if ((pobj = td_current_obj(otype)) != NULL)
+		attr = pobj->attrib;
+	td_unlock_discovery();
+	return (attr);
+}
+
+/*
+ * fetch frequently used numeric attributes of currently enumerated
+ * object of specified type
+ * interface to TD user
+ * parameters:
+ *	otype	disk, partition or slice
+ *	info	filled with attribute values, 0 for missing attributes
+ * returns TD_ERRNO
+ *
+ * The values are extracted from attributes once and kept with the
+ * object, so repeated calls don't look attributes up again.
+ */
+td_errno_t
+td_attributes_info(td_object_type_t otype, td_attr_info_t *info)
+{
+	struct td_obj *pobj;
+
 	clear_td_errno();
+	if (otype == TD_OT_OS || info == NULL)
+		return (set_td_errno(TD_E_INVALID_ARG));
+	td_lock_discovery();
+	if ((pobj = td_current_obj(otype)) == NULL) {
+		td_unlock_discovery();
+		return (TD_ERRNO);
+	}
+	if (pobj->attrib == NULL) {
+		td_unlock_discovery();
+		return (set_td_errno(TD_E_NOT_FOUND));
+	}
+	if (!pobj->info_done) {
+		td_attr_info_fill(otype, pobj->attrib, &pobj->info);
+		pobj->info_done = B_TRUE;
+	}
+	*info = pobj->info;
+	td_unlock_discovery();
+	return (TD_E_SUCCESS);
+}
+
+/*
+ * find current object of specified type, discovering its attributes
+ * if not done
+ * returns NULL and sets TD_ERRNO if there is no current object,
+ *	the object with NULL attributes if they can't be discovered
+ */
+static struct td_obj *
+td_current_obj(td_object_type_t otype)
+{
 	switch (otype) {
 	case TD_OT_DISK:
 		if (CURDISK == NULL || CURDISK->handle == 0) {
@@ -438,40 +673,32 @@ td_attributes_get(td_object_type_t otype)
 		}
 		/* if cached, return cached value */
 		if (CURDISK->discovery_done)
-			return (dup_attr_set_errno(CURDISK));
+			return (CURDISK);
 		/* get disk attributes */
 		CURDISK->attrib = ddm_get_disk_attributes(CURDISK->handle);
 		CURDISK->discovery_done = B_TRUE;
-		if (CURDISK->attrib == NULL) {
-			/* no attributes returned from disk module */
-			return (NULL);
-		}
-		return (dup_attr_set_errno(CURDISK));
+		return (CURDISK);
 	case TD_OT_PARTITION:
 		if (CURPART == NULL || CURPART->handle == NULL) {
 			(void) set_td_errno(TD_E_END);
 			return (NULL);
 		}
 		if (CURPART->discovery_done)
-			return (dup_attr_set_errno(CURPART));
+			return (CURPART);
 		/* discover attributes */
 		CURPART->attrib = ddm_get_partition_attributes(CURPART->handle);
 		CURPART->discovery_done = B_TRUE;
-		if (CURPART->attrib == NULL) {
-			if (TLI)
-				td_debug_print(LS_DBGLVL_INFO,
-				    "Partition attribute not found\n");
-
-			return (NULL);
-		}
-		return (dup_attr_set_errno(CURPART));
+		if (CURPART->attrib == NULL && TLI)
+			td_debug_print(LS_DBGLVL_INFO,
+			    "Partition attribute not found\n");
+		return (CURPART);
 	case TD_OT_SLICE:
 		if (CURSLICE == NULL || CURSLICE->handle == NULL) {
 			(void) set_td_errno(TD_E_END);
 			return (NULL);
 		}
 		if (CURSLICE->discovery_done)
-			return (dup_attr_set_errno(CURSLICE));
+			return (CURSLICE);
 		/* discover attributes */
 		CURSLICE->attrib = ddm_get_slice_attributes(CURSLICE->handle);
 		CURSLICE->discovery_done = B_TRUE;
@@ -479,7 +706,7 @@ td_attributes_get(td_object_type_t otype)
 			if (TLI)
 				td_debug_print(LS_DBGLVL_INFO,
 				    "slice attribute not found\n");
-			return (NULL);
+			return (CURSLICE);
 		}
 		/* xref slice with disks to discard slices on read-only media */
 		if (disk_random_slice(CURSLICE->attrib) == NULL) {
@@ -490,9 +717,8 @@ td_attributes_get(td_object_type_t otype)
 				td_debug_print(LS_DBGLVL_INFO,
 				    ">>>slice discovery>>>"
 				    "slice has no disk entry\n");
-			return (NULL);
 		}
-		return (dup_attr_set_errno(CURSLICE));
+		return (CURSLICE);
 	case TD_OT_OS:
 		/*
 		 * Solaris instances are handled differently in that attributes
@@ -502,13 +728,10 @@ td_attributes_get(td_object_type_t otype)
 			(void) set_td_errno(TD_E_END);
 			return (NULL);
 		}
-		if (CUROS->attrib == NULL) {
-			if (TLI)
-				td_debug_print(LS_DBGLVL_INFO,
-				    "OS attribute not found\n");
-			return (NULL);
-		}
-		return (dup_attr_set_errno(CUROS));
+		if (CUROS->attrib == NULL && TLI)
+			td_debug_print(LS_DBGLVL_INFO,
+			    "OS attribute not found\n");
+		return (CUROS);
 	default:
 		break;
 	}
@@ -644,7 +867,8 @@ td_discover_disk_by_btype(const char *btype, int *pcount)
  * Objects with no attribute lists will have NULL attribute list pointers.
  * Use pcount to determine the list length.
  *
- * To search disk list, uses binary search bsearch(3C) with qsort(3C)
+ * To search disk list, uses hash index of partitions and slices grouped
+ * by disk, built once per discovery
  */
 nvlist_t **
 td_discover_partition_by_disk(const char *disk, int *pcount)
@@ -658,6 +882,33 @@ td_discover_slice_by_disk(const char *disk, int *pcount)
 	return (td_discover_object_by_disk(TD_OT_SLICE, disk, pcount));
 }
 
+/*
+ * fetch all partitions or slices on the specified disk without copying
+ * interface to TD user
+ * parameters:
+ *	disk	name of disk in format cXtXdX or cXdX
+ *	pcount	if non-NULL, loaded with number of elements in returned
+ *		attribute array.
+ * returns an array of name-value pair lists of attributes owned by TD.
+ *	The array and lists stay valid until objects of that type are
+ *	discovered again or td_discovery_release() is called. They must not
+ *	be modified or freed by the caller.
+ *
+ * Lookup uses an index of partitions and slices grouped by disk name,
+ * which is built once per discovery.
+ */
+nvlist_t **
+td_get_partitions_by_disk(const char *disk, int *pcount)
+{
+	return (td_get_object_by_disk(TD_OT_PARTITION, disk, pcount));
+}
+
+nvlist_t **
+td_get_slices_by_disk(const char *disk, int *pcount)
+{
+	return (td_get_object_by_disk(TD_OT_SLICE, disk, pcount));
+}
+
 /*
  * td_target_search(attribute list)
  *
@@ -672,6 +923,9 @@ td_errno_t
 td_target_search(nvlist_t *attrs)
 {
 	uint32_t target_type;
+	td_errno_t ret;
+	char *devnam, *ctd;
+	char disk[MAXPATHLEN];
 
 	if (nvlist_lookup_uint32(attrs, TD_ATTR_TARGET_TYPE, &target_type)
 	    != 0) {
@@ -684,7 +938,22 @@ td_target_search(nvlist_t *attrs)
 		/*
 		 * configure iSCSI target disk with given parameters
 		 */
-		return (iscsi_static_config(attrs));
+		ret = iscsi_static_config(attrs);
+		/*
+		 * if disks were discovered already, probe just the new LUN
+		 * instead of leaving it to full rediscovery
+		 */
+		if (ret != TD_E_SUCCESS || PDISKARR == NULL ||
+		    nvlist_lookup_string(attrs, TD_ISCSI_ATTR_DEVICE_NAME,
+		    &devnam) != 0 || (ctd = jump_dev_prefix(devnam)) == NULL ||
+		    !td_parent_disk_name(ctd, 's', disk, sizeof (disk)))
+			return (ret);
+		if (td_rediscover_device(disk, TD_REDISCOVER_REFRESH) !=
+		    TD_E_SUCCESS)
+			td_debug_print(LS_DBGLVL_WARN,
+			    "iSCSI disk %s not rediscovered, TD errno=%d\n",
+			    disk, TD_ERRNO);
+		return (ret);
 	default:
 		break;
 	}
@@ -692,6 +961,104 @@ td_target_search(nvlist_t *attrs)
 	return (TD_E_NO_OBJECT);
 }
 
+/*
+ * add, remove or refresh single disk in discovered objects
+ * interface to TD user
+ * parameters:
+ *	disk	disk name in cXtXdX form
+ *	op	TD_REDISCOVER_ADD - disk was attached
+ *		TD_REDISCOVER_REMOVE - disk was detached
+ *		TD_REDISCOVER_REFRESH - disk was changed (e.g. relabeled), it
+ *		is added if not known yet and removed if it disappeared
+ * returns TD_ERRNO
+ *
+ * Partitions, slices and Solaris instances of the disk are updated along
+ * with the disk, if they were discovered, so only the given disk is
+ * probed. Enumeration of all object types restarts from the first object
+ * and the order of objects may change. Subsequent td_discover() of
+ * an object type rediscovers all objects of that type.
+ */
+td_errno_t
+td_rediscover_device(const char *disk, td_rediscover_op_t op)
+{
+	td_object_type_t ot;
+	td_errno_t ret;
+
+	td_lock_discovery();
+	ret = rediscover_device(disk, op);
+	for (ot = TD_OT_DISK; is_valid_td_object_type(ot); ot++)
+		td_objset_invalidate(ot);
+	td_unlock_discovery();
+	return (ret);
+}
+
+/*
+ * add, remove or refresh single disk - body of td_rediscover_device()
+ * called with discovery lock held
+ */
+static td_errno_t
+rediscover_device(const char *disk, td_rediscover_op_t op)
+{
+	ddm_handle_t *pdisk = NULL, *pparts, *pslices;
+	td_object_type_t ot;
+	int nremoved;
+	td_errno_t ret;
+
+	clear_td_errno();
+	if (disk == NULL || *disk == '\0' || (op != TD_REDISCOVER_ADD &&
+	    op != TD_REDISCOVER_REMOVE && op != TD_REDISCOVER_REFRESH))
+		return (set_td_errno(TD_E_INVALID_ARG));
+	/* nothing to update before discovery */
+	if (PDISKARR == NULL)
+		return (set_td_errno(TD_E_NO_OBJECT));
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO,
+		    "td_rediscover_device disk=%s op=%d\n", disk, op);
+
+	if (op != TD_REDISCOVER_REMOVE) {
+		pdisk = ddm_get_disk_by_name(disk);
+		if (pdisk == NULL && op == TD_REDISCOVER_ADD)
+			return (set_td_errno(TD_E_NO_DEVICE));
+	}
+
+	/* drop what is known about the disk */
+	nremoved = td_remove_disk_objs(TD_OT_DISK, disk);
+	if (nremoved == 0 && pdisk == NULL)
+		return (set_td_errno(TD_E_NO_DEVICE));
+	for (ot = TD_OT_DISK; is_valid_td_object_type(ot); ot++) {
+		if (objlist[ot].objarr == NULL)
+			continue;
+		if (ot != TD_OT_DISK)
+			(void) td_remove_disk_objs(ot, disk);
+		objlist[ot].rediscovered = B_TRUE;
+	}
+	td_index_invalidate(TD_OT_DISK);
+	if (pdisk == NULL)
+		return (TD_E_SUCCESS);
+
+	/* probe the disk */
+	ret = td_append_objs(TD_OT_DISK, pdisk);
+	if (ret != TD_E_SUCCESS) {
+		ddm_free_handle_list(pdisk);
+		return (set_td_errno(ret));
+	}
+	if (PPARTARR != NULL &&
+	    (pparts = ddm_get_partitions(*pdisk)) != NULL &&
+	    (ret = td_append_objs(TD_OT_PARTITION, pparts)) != TD_E_SUCCESS)
+		ddm_free_handle_list(pparts);
+	if (ret == TD_E_SUCCESS && (PSLICEARR != NULL || td_os_discovered) &&
+	    (pslices = ddm_get_slices(*pdisk)) != NULL) {
+		/* Solaris instances on the disk only */
+		if (td_os_discovered)
+			(void) os_discover(pslices);
+		if (PSLICEARR == NULL ||
+		    (ret = td_append_objs(TD_OT_SLICE, pslices)) !=
+		    TD_E_SUCCESS)
+			ddm_free_handle_list(pslices);
+	}
+	return (set_td_errno(ret));
+}
+
 /*
  * return most recent errno for TD
  * interface to TD user
@@ -699,7 +1066,8 @@ td_target_search(nvlist_t *attrs)
 td_errno_t
 td_get_errno(void)
 {
-	return (td_errno);
+	(void) pthread_once(&td_mt_once, td_mt_init);
+	return ((td_errno_t)(uintptr_t)pthread_getspecific(td_errno_key));
 }
 
 /*
@@ -711,112 +1079,355 @@ td_get_errno(void)
 td_errno_t
 td_discovery_release(void)
 {
+	td_object_type_t ot;
+
 	clear_td_errno();
 	if (TLI)
 		td_debug_print(LS_DBGLVL_INFO, "td_discovery_release\n");
+	td_lock_discovery();
+	/* keep results for next discovery */
+	if (td_cache_enabled())
+		td_cache_snapshot();
+	/* disks may change before next discovery, even if not saved */
+	td_cache_reset();
+	td_os_discovered = B_FALSE;
 	/* free attributes for all object types */
 	free_td_obj_list(TD_OT_DISK);
 	free_td_obj_list(TD_OT_PARTITION);
 	free_td_obj_list(TD_OT_SLICE);
 	free_td_obj_list(TD_OT_OS);
+	td_index_invalidate(TD_OT_DISK);
+	/* open iterators keep their object sets */
+	for (ot = TD_OT_DISK; is_valid_td_object_type(ot); ot++)
+		td_objset_invalidate(ot);
+	td_unlock_discovery();
 	if (TLI)
 		td_debug_print(LS_DBGLVL_INFO, "td_discovery_release ends \n");
 	return (TD_E_SUCCESS);
 }
 
 /*
- * release memory allocated for attributes of a single object
- * interface for TD user
+ * open iterator over discovered objects of specific type
+ * interface to TD user
+ * parameters:
+ *	otype	object type to enumerate
+ *	piter	set to new iterator
+ * returns TD_ERRNO
+ *
+ * The iterator enumerates a copy of attributes of all objects, taken
+ * when the first iterator is opened after discovery. Objects of the given
+ * type are discovered if not done already. The copy is shared by all
+ * iterators and never changes, so any number of threads may enumerate
+ * at the same time, each with its own iterator, without locking. Later
+ * td_discover(), td_rediscover_device() or td_discovery_release() does
+ * not affect open iterators. The TD errno is kept per thread.
+ *
+ * The object-type enumeration (td_get_next(), td_attributes_get()) keeps
+ * one cursor per type, shared by all threads. Its calls take the
+ * discovery lock, so they don't corrupt the cursor, but threads
+ * enumerating the same type at the same time advance each other's
+ * position - they should use iterators.
  */
-void
-td_list_free(nvlist_t *pnv)
+td_errno_t
+td_iter_open(td_object_type_t otype, td_iter_t **piter)
 {
-	if (pnv != NULL)
-		nvlist_free(pnv);
+	struct td_objset *set;
+	td_iter_t *iter;
+
+	clear_td_errno();
+	if (!is_valid_td_object_type(otype) || piter == NULL)
+		return (set_td_errno(TD_E_INVALID_ARG));
+	if ((iter = malloc(sizeof (*iter))) == NULL)
+		return (set_td_errno(TD_E_MEMORY));
+
+	td_lock_discovery();
+	if ((set = td_objsets[otype]) == NULL) {
+		if ((set = td_objset_build(otype)) == NULL) {
+			td_unlock_discovery();
+			free(iter);
+			return (TD_ERRNO);
+		}
+		td_objsets[otype] = set;
+	}
+	atomic_inc_uint(&set->refcnt);
+	td_unlock_discovery();
+
+	iter->set = set;
+	iter->cur = -1;
+	*piter = iter;
+	return (TD_E_SUCCESS);
 }
+
 /*
- * release memory allocated for attributes of a list of objects
- * interface for TD user
+ * advance iterator to next object
+ * interface to TD user
+ * returns TD_ERRNO
+ *	TD_E_END indicates the end of the list has been reached
+ *
+ * must be called to set the first object
  */
-void
-td_attribute_list_free(nvlist_t **attrlist)
+td_errno_t
+td_iter_next(td_iter_t *iter)
 {
-	nvlist_t **olist;
-
-	if (attrlist == NULL)
-		return;
-	for (olist = attrlist; *attrlist != ATTR_LIST_TERMINATOR; attrlist++)
-		td_list_free(*attrlist);
-	free(olist);
+	clear_td_errno();
+	if (iter == NULL)
+		return (set_td_errno(TD_E_INVALID_ARG));
+	if (iter->cur + 1 >= iter->set->nobjs) {
+		iter->cur = iter->set->nobjs;
+		return (set_td_errno(TD_E_END));
+	}
+	iter->cur++;
+	return (TD_E_SUCCESS);
 }
 
 /*
- * end of Target Discovery user interfaces
+ * reset iterator - td_iter_next() must be called to fetch first object
+ * interface to TD user
  */
+td_errno_t
+td_iter_reset(td_iter_t *iter)
+{
+	clear_td_errno();
+	if (iter == NULL)
+		return (set_td_errno(TD_E_INVALID_ARG));
+	iter->cur = -1;
+	return (TD_E_SUCCESS);
+}
 
 /*
- * global functions used only in TD
+ * return number of objects enumerated by iterator
+ * interface to TD user
  */
+int
+td_iter_count(td_iter_t *iter)
+{
+	return (iter == NULL ? 0 : iter->set->nobjs);
+}
 
 /*
- * td_get_rootdir()
- *	Returns the rootdir previously set by a call to td_set_rootdir(). If
- *	td_set_rootdir() hasn't been called this returns a pointer to an empty
- *	string.
- * Parameters:
- *	none
- * Return:
- *	char *	- pointer to current rootdir string
- * Status:
- *	public
+ * fetch attributes of current object of iterator
+ * interface to TD user
+ * returns copy of attributes, to be freed by td_list_free(),
+ *	NULL if there is no current object - TD_ERRNO is set
  */
-char *
-td_get_rootdir(void)
+nvlist_t *
+td_iter_attributes_get(td_iter_t *iter)
 {
-	return (rootdir);
+	nvlist_t *attr;
+
+	clear_td_errno();
+	if (iter == NULL) {
+		(void) set_td_errno(TD_E_INVALID_ARG);
+		return (NULL);
+	}
+	if (iter->cur < 0 || iter->cur >= iter->set->nobjs) {
+		(void) set_td_errno(TD_E_END);
+		return (NULL);
+	}
+	if (nvlist_dup(iter->set->attrs[iter->cur], &attr, 0) != 0) {
+		(void) set_td_errno(TD_E_MEMORY);
+		return (NULL);
+	}
+	return (attr);
 }
 
 /*
- * td_set_rootdir()
- *	Sets the global 'rootdir' variable. Used to install packages
- *	to 'newrootdir'.
- * Parameters:
- *	newrootdir	- non-NULL pathname used to set rootdir
- * Return:
- *	none
- * Status:
- *	public
+ * fetch attributes of current object of iterator without copying them
+ * interface to TD user
+ * returns attributes owned by the iterator, valid until td_iter_close(),
+ *	NULL if there is no current object - TD_ERRNO is set
+ * The list must not be modified or freed.
  */
-void
-td_set_rootdir(char *newrootdir)
+nvlist_t *
+td_iter_attributes_view(td_iter_t *iter)
 {
-	(void) strcpy(rootdir, newrootdir);
-	z_canoninplace(rootdir);
-
-	if (streq(rootdir, "/"))
-		rootdir[0] = '\0';
+	clear_td_errno();
+	if (iter == NULL) {
+		(void) set_td_errno(TD_E_INVALID_ARG);
+		return (NULL);
+	}
+	if (iter->cur < 0 || iter->cur >= iter->set->nobjs) {
+		(void) set_td_errno(TD_E_END);
+		return (NULL);
+	}
+	return (iter->set->attrs[iter->cur]);
 }
 
 /*
- * is_new_var_sadm() taken from soft_install.c
- *	this function will return true if the new var/sadm directory
- * 	structure is present or false of it is not present. For simplicity
- * 	and to have a strict rule, the new structure is defined by the
- *	location of the INST_RELEASE file.
- *
- * parameters:
- *	rootdir - This is the root directory passed in by caller.
- * Return:
- *	1	the new structure is present
- *	0	the new structure is not present (old structure assumed)
- *	-1	INST_RELEASE is not present
- * Status:
- *	software library internal
+ * fetch frequently used numeric attributes of current object of iterator
+ * interface to TD user
+ * returns TD_ERRNO
  */
-int
-td_is_new_var_sadm(const char *rootdir)
+td_errno_t
+td_iter_attributes_info(td_iter_t *iter, td_attr_info_t *info)
 {
-	char		tmpFile[MAXPATHLEN];	/* A scratch variable */
+	clear_td_errno();
+	if (iter == NULL || info == NULL)
+		return (set_td_errno(TD_E_INVALID_ARG));
+	if (iter->cur < 0 || iter->cur >= iter->set->nobjs)
+		return (set_td_errno(TD_E_END));
+	*info = iter->set->infos[iter->cur];
+	return (TD_E_SUCCESS);
+}
+
+/*
+ * close iterator, release object set if it was the last user
+ * interface to TD user
+ */
+void
+td_iter_close(td_iter_t *iter)
+{
+	if (iter == NULL)
+		return;
+	td_objset_rele(iter->set);
+	free(iter);
+}
+
+/*
+ * set size of the worker pool used for attribute discovery
+ * interface to TD user
+ * parameters:
+ *	nthreads	maximum number of worker threads
+ *		1 (default) - attributes are discovered serially on demand
+ *		>1 - td_discover() fetches attributes of all disks, partitions
+ *		or slices up front, probing up to nthreads objects at a time
+ * returns TD_ERRNO
+ *
+ * Discovered attributes are cached in the same object arrays as in the
+ * serial case, so enumeration and attribute retrieval are unaffected.
+ */
+td_errno_t
+td_set_discovery_threads(int nthreads)
+{
+	clear_td_errno();
+	if (nthreads < 1)
+		return (set_td_errno(TD_E_INVALID_ARG));
+	if (nthreads > TD_MAX_DISCOVERY_THREADS)
+		nthreads = TD_MAX_DISCOVERY_THREADS;
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO,
+		    "attribute discovery threads=%d\n", nthreads);
+	td_discovery_threads = nthreads;
+	return (TD_E_SUCCESS);
+}
+
+/*
+ * set file keeping snapshot of discovery results between runs
+ * interface to TD user
+ * parameters:
+ *	path	snapshot file, NULL disables the snapshot
+ * returns TD_ERRNO
+ *
+ * If the snapshot file exists, td_discover() takes attributes of disks
+ * whose device ID, capacity and labels did not change from the snapshot
+ * and probes only new or changed disks. Solaris instances on unchanged
+ * disks are not mounted again. td_discovery_release() rewrites the
+ * snapshot with the current results.
+ */
+td_errno_t
+td_set_cache_file(const char *path)
+{
+	clear_td_errno();
+	if (path == NULL) {
+		td_cache_close();
+		return (TD_E_SUCCESS);
+	}
+	return (set_td_errno(td_cache_open(path)));
+}
+
+/*
+ * release memory allocated for attributes of a single object
+ * interface for TD user
+ */
+void
+td_list_free(nvlist_t *pnv)
+{
+	if (pnv != NULL)
+		nvlist_free(pnv);
+}
+/*
+ * release memory allocated for attributes of a list of objects
+ * interface for TD user
+ */
+void
+td_attribute_list_free(nvlist_t **attrlist)
+{
+	nvlist_t **olist;
+
+	if (attrlist == NULL)
+		return;
+	for (olist = attrlist; *attrlist != ATTR_LIST_TERMINATOR; attrlist++)
+		td_list_free(*attrlist);
+	free(olist);
+}
+
+/*
+ * end of Target Discovery user interfaces
+ */
+
+/*
+ * global functions used only in TD
+ */
+
+/*
+ * td_get_rootdir()
+ *	Returns the rootdir previously set by a call to td_set_rootdir(). If
+ *	td_set_rootdir() hasn't been called this returns a pointer to an empty
+ *	string.
+ * Parameters:
+ *	none
+ * Return:
+ *	char *	- pointer to current rootdir string
+ * Status:
+ *	public
+ */
+char *
+td_get_rootdir(void)
+{
+	return (rootdir);
+}
+
+/*
+ * td_set_rootdir()
+ *	Sets the global 'rootdir' variable. Used to install packages
+ *	to 'newrootdir'.
+ * Parameters:
+ *	newrootdir	- non-NULL pathname used to set rootdir
+ * Return:
+ *	none
+ * Status:
+ *	public
+ */
+void
+td_set_rootdir(char *newrootdir)
+{
+	(void) strcpy(rootdir, newrootdir);
+	z_canoninplace(rootdir);
+
+	if (streq(rootdir, "/"))
+		rootdir[0] = '\0';
+}
+
+/*
+ * is_new_var_sadm() taken from soft_install.c
+ *	this function will return true if the new var/sadm directory
+ * 	structure is present or false of it is not present. For simplicity
+ * 	and to have a strict rule, the new structure is defined by the
+ *	location of the INST_RELEASE file.
+ *
+ * parameters:
+ *	rootdir - This is the root directory passed in by caller.
+ * Return:
+ *	1	the new structure is present
+ *	0	the new structure is not present (old structure assumed)
+ *	-1	INST_RELEASE is not present
+ * Status:
+ *	software library internal
+ */
+int
+td_is_new_var_sadm(const char *rootdir)
+{
+	char		tmpFile[MAXPATHLEN];	/* A scratch variable */
 	FILE		*fp = NULL;
 	char		buf[BUFSIZ + 1];
 	char		*os = NULL;
@@ -907,9 +1518,11 @@ add_td_discovered_obj(td_object_type_t objtype, nvlist_t *onvl)
 	pobja->attrib = onvl;
 	pobja->handle = (ddm_handle_t)onvl;
 	pobja->discovery_done = B_TRUE;
+	pobja->info_done = B_FALSE;
 	if (TLI)
 		td_debug_print(LS_DBGLVL_INFO, "added to td_obj list!!!\n");
 	objlist[objtype].objcnt++;
+	objlist[objtype].issorted = B_FALSE;
 	pobja++;
 	pobja->attrib = NULL;
 	pobja->handle = 0L;
@@ -1154,24 +1767,196 @@ dup_attr_set_errno(struct td_obj *curobj)
 }
 
 /*
- * set errno for TD
- * NOTE: not thread-safe
+ * extract frequently used numeric attributes from attribute list
+ * interface to TD user
+ * parameters:
+ *	ot	type of object the attributes belong to
+ *	attr	attribute list, e.g. from td_get_slices_by_disk()
+ *	info	filled with attribute values, 0 for missing attributes
+ *
+ *	object		tai_tag			tai_flags
+ *	disk		media type		label types
+ *	partition	partition type		boot id
+ *	slice		slice tag		slice flags
+ */
+void
+td_attr_info_fill(td_object_type_t ot, nvlist_t *attr, td_attr_info_t *info)
+{
+	uint32_t value;
+
+	bzero(info, sizeof (*info));
+	if (attr == NULL)
+		return;
+	switch (ot) {
+	case TD_OT_DISK:
+		(void) nvlist_lookup_uint64(attr, TD_DISK_ATTR_SIZE,
+		    &info->tai_size);
+		(void) nvlist_lookup_uint32(attr, TD_DISK_ATTR_BLOCKSIZE,
+		    &info->tai_blocksize);
+		(void) nvlist_lookup_uint32(attr, TD_DISK_ATTR_MTYPE,
+		    &info->tai_tag);
+		(void) nvlist_lookup_uint32(attr, TD_DISK_ATTR_LABEL,
+		    &info->tai_flags);
+		break;
+	case TD_OT_PARTITION:
+		if (nvlist_lookup_uint32(attr, TD_PART_ATTR_START, &value) == 0)
+			info->tai_start = value;
+		if (nvlist_lookup_uint32(attr, TD_PART_ATTR_SIZE, &value) == 0)
+			info->tai_size = value;
+		(void) nvlist_lookup_uint32(attr, TD_PART_ATTR_TYPE,
+		    &info->tai_tag);
+		(void) nvlist_lookup_uint32(attr, TD_PART_ATTR_BOOTID,
+		    &info->tai_flags);
+		break;
+	case TD_OT_SLICE:
+		(void) nvlist_lookup_uint64(attr, TD_SLICE_ATTR_START,
+		    &info->tai_start);
+		(void) nvlist_lookup_uint64(attr, TD_SLICE_ATTR_SIZE,
+		    &info->tai_size);
+		(void) nvlist_lookup_uint32(attr, TD_SLICE_ATTR_TAG,
+		    &info->tai_tag);
+		(void) nvlist_lookup_uint32(attr, TD_SLICE_ATTR_FLAG,
+		    &info->tai_flags);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * set errno for TD, kept per thread
  * return value for convenience
  */
 static td_errno_t
 set_td_errno(int val)
 {
-	return (td_errno = val);
+	(void) pthread_once(&td_mt_once, td_mt_init);
+	(void) pthread_setspecific(td_errno_key, (void *)(uintptr_t)val);
+	return (val);
 }
 
 /*
- * clear errno for TD
- * NOTE: not thread-safe
+ * clear errno for TD of calling thread
  */
 static void
 clear_td_errno(void)
 {
-	td_errno = TD_E_SUCCESS;
+	(void) set_td_errno(TD_E_SUCCESS);
+}
+
+/*
+ * create key of per-thread TD errno and the discovery lock
+ * recursive, since discovery routines call each other
+ */
+static void
+td_mt_init(void)
+{
+	pthread_mutexattr_t attr;
+
+	(void) pthread_key_create(&td_errno_key, NULL);
+	(void) pthread_mutexattr_init(&attr);
+	(void) pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	(void) pthread_mutex_init(&td_discovery_lock, &attr);
+	(void) pthread_mutexattr_destroy(&attr);
+}
+
+static void
+td_lock_discovery(void)
+{
+	(void) pthread_once(&td_mt_once, td_mt_init);
+	(void) pthread_mutex_lock(&td_discovery_lock);
+}
+
+static void
+td_unlock_discovery(void)
+{
+	(void) pthread_mutex_unlock(&td_discovery_lock);
+}
+
+/*
+ * copy attributes of all discovered objects of given type
+ * objects are discovered first if needed
+ * called with discovery lock held
+ * returns new object set holding one reference for td_objsets[],
+ * NULL on failure with TD errno set
+ */
+static struct td_objset *
+td_objset_build(td_object_type_t ot)
+{
+	struct td_class *pobl = &objlist[ot];
+	struct td_objset *set;
+	struct td_obj *pobj, *ocur;
+	nvlist_t *attr;
+
+	if ((ot == TD_OT_OS ? !td_os_discovered : pobl->objarr == NULL) &&
+	    td_discover(ot, NULL) != TD_E_SUCCESS && TD_ERRNO != TD_E_END)
+		return (NULL);
+	if ((set = calloc(1, sizeof (*set))) == NULL) {
+		(void) set_td_errno(TD_E_MEMORY);
+		return (NULL);
+	}
+	set->refcnt = 1;
+	if (pobl->objarr == NULL) {
+		clear_td_errno();
+		return (set);
+	}
+	if ((set->attrs = calloc(pobl->objcnt, sizeof (nvlist_t *))) == NULL ||
+	    (set->infos = calloc(pobl->objcnt, sizeof (td_attr_info_t))) ==
+	    NULL) {
+		free(set->attrs);
+		free(set);
+		(void) set_td_errno(TD_E_MEMORY);
+		return (NULL);
+	}
+	/* td_attributes_get() discovers and filters as for enumeration */
+	ocur = pobl->objcur;
+	for (pobj = pobl->objarr; pobj->handle != 0; pobj++) {
+		pobl->objcur = pobj;
+		if ((attr = td_attributes_get(ot)) != NULL) {
+			td_attr_info_fill(ot, attr, &set->infos[set->nobjs]);
+			set->attrs[set->nobjs++] = attr;
+		} else if (TD_ERRNO == TD_E_MEMORY)
+			break;
+	}
+	pobl->objcur = ocur;
+	if (pobj->handle != 0) {
+		td_objset_rele(set);
+		(void) set_td_errno(TD_E_MEMORY);
+		return (NULL);
+	}
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO,
+		    "object set type=%d with %d objects\n", ot, set->nobjs);
+	clear_td_errno();
+	return (set);
+}
+
+/* drop reference to object set, free it with the last one */
+static void
+td_objset_rele(struct td_objset *set)
+{
+	int i;
+
+	if (atomic_dec_uint_nv(&set->refcnt) != 0)
+		return;
+	for (i = 0; i < set->nobjs; i++)
+		nvlist_free(set->attrs[i]);
+	free(set->attrs);
+	free(set->infos);
+	free(set);
+}
+
+/*
+ * detach current object set of given type, it is rebuilt by next
+ * td_iter_open() - called with discovery lock held
+ */
+static void
+td_objset_invalidate(td_object_type_t ot)
+{
+	if (td_objsets[ot] == NULL)
+		return;
+	td_objset_rele(td_objsets[ot]);
+	td_objsets[ot] = NULL;
 }
 
 /*
@@ -1238,11 +2023,15 @@ td_is_fstyp(const char *slicenm, char *fs)
  * return an nvlist of information interesting to someone wanting Solaris
  * instances
  * - slice name
+ * pslices - slices to examine, NULL for all slices. If given, Snap Boot
+ *	Environments and discovery snapshot are not consulted.
  */
 static td_errno_t
-os_discover(void)
+os_discover(ddm_handle_t *pslices)
 {
-	ddm_handle_t *cslice;
+	ddm_handle_t *pallslices = NULL;
+	struct td_os_cand *cands, *cand;
+	int ncands, icand;
 	FILE *mnttabfp; /* running system mnttab file pointer */
 	char *tmprootmntpnt = NULL;
 	char tmpvarmntpnt[] = TEMPLATEVAR;
@@ -1251,6 +2040,7 @@ os_discover(void)
 	char *orootdir = strdup(td_get_rootdir());
 	char build_id[80];
 	FILE *localvfstabfp;
+	boolean_t full = B_TRUE; /* all slices examined */
 
 	/* set current swap file and device as exempt from later removal */
 	if ((localvfstabfp = fopen(VFSTAB, "r")) != NULL) {
@@ -1273,10 +2063,20 @@ os_discover(void)
 	/* check for Solaris disk */
 
 	/* for each slice, evaluate it for OS instance */
-	if (PDDMSLICES == NULL) { /* get all slices */
-		PDDMSLICES = ddm_get_slices(DDM_DISCOVER_ALL);
-		if (PDDMSLICES == NULL)
+	if (pslices == NULL && objlist[TD_OT_SLICE].rediscovered) {
+		/* slice handles were changed by td_rediscover_device() */
+		pslices = pallslices = ddm_get_slices(DDM_DISCOVER_ALL);
+		if (pslices == NULL)
 			return (TD_E_END);
+	} else if (pslices == NULL) {
+		if (PDDMSLICES == NULL) { /* get all slices */
+			PDDMSLICES = ddm_get_slices(DDM_DISCOVER_ALL);
+			if (PDDMSLICES == NULL)
+				return (TD_E_END);
+		}
+		pslices = PDDMSLICES;
+	} else {
+		full = B_FALSE;
 	}
 	if (TLI)
 		td_debug_print(LS_DBGLVL_INFO, "Opening /etc/mnttab...\n");
@@ -1285,21 +2085,28 @@ os_discover(void)
 		td_debug_print(LS_DBGLVL_ERR,
 		    "could not open mnttab %s fails errno=%d\n",
 		    MNTTAB, errno);
+		if (pallslices != NULL)
+			ddm_free_handle_list(pallslices);
 		return (TD_E_MNTTAB);
 	}
+	/* find candidate slices, probe and mount them in parallel */
+	cands = os_candidates(mnttabfp, pslices, full, &ncands);
+	os_prepare_candidates(cands, ncands);
+
 	/* seeking partition tag is root */
-	for (cslice = PDDMSLICES; *cslice != NULL; cslice++) {
+	for (icand = 0; icand < ncands; icand++) {
 		struct mnttab mpref, mnttab;
 		struct vfstab vref, vfstab;
 		uint32_t partition_tag;
 		char *slicenm; /* name of slice */
 		char slicemp[MAXPATHLEN];
+		char *rootmntpnt; /* where root of slice is mounted */
 		char *varslice = NULL; /* assume no separate var */
 		char vfstabname[MAXPATHLEN];
 		boolean_t varmounted = B_FALSE;
 		FILE *vfstabfp = NULL;
 		boolean_t rootmounted;
-		nvlist_t *nvl, *onvl, *svmnvl = NULL;
+		nvlist_t *onvl;
 		char release[32] = "";
 		char minor[32] = "";
 		char **znvl;
@@ -1308,51 +2115,36 @@ os_discover(void)
 		int ret;
 		char *pclustertoc, *pcluster;
 
-		nvl = ddm_get_slice_attributes(*cslice);
-		if (nvl == NULL)
-			continue;
-
-		/* check VTOC information: partition tag says root fs */
-		if (nvlist_lookup_uint32(nvl, TD_SLICE_ATTR_TAG,
-		    &partition_tag) != 0 ||
-		    (partition_tag != 0 && partition_tag != V_ROOT))
-			continue;
-
-		/* now root slice candidate based on attributes */
-
-		if (nvlist_lookup_string(nvl, TD_SLICE_ATTR_NAME, &slicenm) !=
-		    0) {
-			td_debug_print(LS_DBGLVL_ERR, "slice name not found\n");
-			continue;
-		}
+		cand = &cands[icand];
+		slicenm = cand->slicenm;
+		partition_tag = cand->tag;
 
-		/* xref slice with disks - eliminates RO media slices */
-		if (disk_random_slice(nvl) == NULL) {
-			if (TLI)
-				td_debug_print(LS_DBGLVL_INFO,
-				    "slice %s has no disk entry\n", slicenm);
+		/* neither mounted nor mountable as UFS */
+		if (!cand->mounted && cand->mntrc != MNTRC_MOUNT_SUCCEEDS)
 			continue;
-		}
 
 		bzero(&fr, sizeof (fr)); /* clear upgrade fail reason codes */
 
 		/* is root slice mounted */
-		if (tmprootmntpnt == NULL) /* mount point for root */
-			tmprootmntpnt = mkdtemp(templateroot);
+		if (cand->mounted) {
+			if (tmprootmntpnt == NULL) /* mount point for root */
+				tmprootmntpnt = mkdtemp(templateroot);
+			rootmntpnt = tmprootmntpnt;
+		} else {
+			rootmntpnt = cand->mntpnt;
+		}
 		bzero(&mpref, sizeof (struct mnttab));
-		td_set_rootdir(tmprootmntpnt);
+		td_set_rootdir(rootmntpnt);
 		rootmounted = B_FALSE; /* assume not */
 
 		/* get mount point from mnttab given slice name */
 		(void) snprintf(slicemp, sizeof (slicemp),
 		    "/dev/dsk/%s", slicenm);
 		mpref.mnt_special = slicemp;
-		if (TLI)
-			td_debug_print(LS_DBGLVL_INFO,
-			    "mounting %s %s \n", slicemp, tmprootmntpnt);
 		/* if slice already mounted */
 		resetmnttab(mnttabfp);
-		if (getmntany(mnttabfp, &mnttab, &mpref) == 0) {
+		if (cand->mounted &&
+		    getmntany(mnttabfp, &mnttab, &mpref) == 0) {
 			if (TLI)
 				td_debug_print(LS_DBGLVL_INFO,
 				    "slice %s busy, assumed mounted\n",
@@ -1381,38 +2173,30 @@ os_discover(void)
 					    "separate var already mounted\n");
 				varmounted = B_TRUE;
 			} else { /* var not mounted - find mntpnt in vfstab */
-				(void) strncpy(tmpvarmntpnt, tmprootmntpnt,
+				(void) strncpy(tmpvarmntpnt, rootmntpnt,
 				    sizeof (TEMPLATEVAR));
 				(void) strlcat(tmpvarmntpnt, "/var",
 				    sizeof (TEMPLATEVAR));
 			}
 			(void) strcpy(vfstabname, td_get_rootdir());
 			(void) strcat(vfstabname, VFSTAB);
+		} else if (cand->mounted) {
+			/* unmounted since candidates were collected */
+			continue;
 		} else {
-			/*
-			 * Check to see what type of filesystem the
-			 * device contains. The fsck and mount code only
-			 * applies to ufs filesystems
-			 */
-
-			if (!td_is_fstyp(slicenm, "ufs"))
-				continue;
-
-			/* perform fsck and mount */
-			ret = td_fsck_mount(tmprootmntpnt, slicenm, B_TRUE,
-			    NULL, "-r", "ufs", &svmnvl);
-			if (ret != MNTRC_MOUNT_SUCCEEDS) {
-				continue;
-			}
+			/* mounted by os_prepare_candidates() */
+			if (TLI)
+				td_debug_print(LS_DBGLVL_INFO,
+				    "%s mounted on %s\n", slicemp, rootmntpnt);
 
 			/* read vfstab from mounted slice */
-			(void) strncpy(tmpvarmntpnt, tmprootmntpnt,
+			(void) strncpy(tmpvarmntpnt, rootmntpnt,
 			    sizeof (TEMPLATEVAR));
 			(void) strlcat(tmpvarmntpnt, "/var",
 			    sizeof (TEMPLATEVAR));
 			/* use vfstab from mounted root slice */
 			(void) snprintf(vfstabname, sizeof (vfstabname),
-			    "%s%s", tmprootmntpnt, VFSTAB);
+			    "%s%s", rootmntpnt, VFSTAB);
 		}
 		if (TLI)
 			td_debug_cat_file(LS_DBGLVL_INFO, vfstabname);
@@ -1639,7 +2423,6 @@ add_instance:
 			    != 0) {
 				td_debug_print(LS_DBGLVL_ERR,
 				    "nvlist add_string failure\n");
-				nvlist_free(nvl);
 				tderr = TD_E_MEMORY;
 				goto umount;
 			}
@@ -1647,7 +2430,6 @@ add_instance:
 			    TD_OS_ATTR_VERSION_MINOR, minor) != 0) {
 				td_debug_print(LS_DBGLVL_ERR,
 				    "nvlist add_string failure\n");
-				nvlist_free(nvl);
 				tderr = TD_E_MEMORY;
 				goto umount;
 			}
@@ -1657,18 +2439,19 @@ add_instance:
 		    != 0) {
 			td_debug_print(LS_DBGLVL_ERR,
 			    "nvlist add_string failure\n");
-			nvlist_free(nvl);
 			tderr = TD_E_MEMORY;
 			goto umount;
 		}
-		/* fetch build id */
-		if (td_get_build_id(td_get_rootdir(), build_id,
-		    sizeof (build_id)) != NULL) {
+		/* fetch build id, /etc/release may have been read already */
+		if (cand->etcrelease[0] != '\0' ?
+		    td_parse_build_id(cand->etcrelease, build_id,
+		    sizeof (build_id)) :
+		    td_get_build_id(td_get_rootdir(), build_id,
+		    sizeof (build_id))) {
 			if (nvlist_add_string(onvl, TD_OS_ATTR_BUILD_ID,
 			    build_id) != 0) {
 				td_debug_print(LS_DBGLVL_ERR,
 				    "nvlist add_string failure\n");
-				nvlist_free(nvl);
 				tderr = TD_E_MEMORY;
 				goto umount;
 			}
@@ -1677,16 +2460,15 @@ add_instance:
 		if (TD_UPGRADE_FAIL(fr) &&
 		    nvlist_add_uint32(onvl, TD_OS_ATTR_NOT_UPGRADEABLE,
 		    *(uint32_t *)&fr) != 0) {
-			nvlist_free(nvl);
 			tderr = TD_E_MEMORY;
 			goto umount;
 		}
 		/* allocate or extend list */
 		tderr = add_td_discovered_obj(TD_OT_OS, onvl);
 		if (tderr != TD_E_SUCCESS) {
-			nvlist_free(nvl);
 			goto umount;
 		}
+		td_cache_note_os(slicenm, onvl);
 umount:		/* if we goto to this label, no Solaris instance */
 
 		/* release temp resources for slice */
@@ -1702,21 +2484,28 @@ umount:		/* if we goto to this label, no Solaris instance */
 		/* unmount var if on separate slice */
 		if (varslice != NULL)
 			(void) umount2(tmpvarmntpnt, MS_FORCE);
-		/* unmount current root, var at temporary mount points */
-		if (!rootmounted && umount2(tmprootmntpnt, MS_FORCE) != 0) {
-			/* unmount failed - use new temp mount point */
-			(void) strncpy(templateroot, TEMPLATEROOT,
-			    sizeof (templateroot));
-			tmprootmntpnt = NULL;
-		}
+		/* unmount current root from its private mount point */
+		if (!rootmounted)
+			os_release_candidate(cand);
 		if (tderr != TD_E_SUCCESS)
 			break;
 	} /* next slice */
-	td_be_list(); /* discover all Snap Boot Environments */
+	if (full && tderr == TD_E_SUCCESS && td_cache_enabled())
+		(void) td_cache_restore_os();
+	if (full)
+		td_be_list(); /* discover all Snap Boot Environments */
 	if (tderr == TD_E_SUCCESS)
 		sort_objs(TD_OT_OS);
 	if (tmprootmntpnt != NULL)
 		(void) rmdir(tmprootmntpnt);
+	/* unmount slices skipped after error, free candidates */
+	for (icand = 0; icand < ncands; icand++) {
+		os_release_candidate(&cands[icand]);
+		nvlist_free(cands[icand].nvl);
+	}
+	free(cands);
+	if (pallslices != NULL)
+		ddm_free_handle_list(pallslices);
 	(void) fclose(mnttabfp);
 	td_set_rootdir(orootdir);
 	free(orootdir);
@@ -1724,18 +2513,241 @@ umount:		/* if we goto to this label, no Solaris instance */
 }
 
 /*
- * fsck -m checks to see if file system
- * needs checking.
- *
- * if return code = 0, disk is OK, can be mounted.
- * if return code = 32, disk is dirty, must be fsck'd
- * if return code = 33, disk is already mounted
- *
- * If the file system to be mounted is the true root,
- * don't bother to do the fsck -m (since the results are
- * unpredictable).  We know it must be mounted, so set
- * the cmdstatus to 33.  This will drop us into the code
- * that verifies that the EXPECTED file system is mounted
+ * collect slices which may hold Solaris instance - root or unassigned
+ * slices on disks, not known from discovery snapshot if usecache is set
+ * returns array of candidates, NULL if there are none
+ */
+static struct td_os_cand *
+os_candidates(FILE *mnttabfp, ddm_handle_t *pslices, boolean_t usecache,
+    int *ncands)
+{
+	ddm_handle_t *cslice;
+	struct td_os_cand *cands, *cand;
+	struct mnttab mpref, mnttab;
+	char slicemp[MAXPATHLEN];
+	char diskname[MAXPATHLEN];
+	nvlist_t *nvl;
+
+	*ncands = 0;
+	for (cslice = pslices; *cslice != NULL; cslice++)
+		;
+	cands = calloc(cslice - pslices + 1, sizeof (*cands));
+	if (cands == NULL)
+		return (NULL);
+	for (cslice = pslices; *cslice != NULL; cslice++) {
+		cand = &cands[*ncands];
+
+		nvl = ddm_get_slice_attributes(*cslice);
+		if (nvl == NULL)
+			continue;
+
+		/* check VTOC information: partition tag says root fs */
+		if (nvlist_lookup_uint32(nvl, TD_SLICE_ATTR_TAG,
+		    &cand->tag) != 0 ||
+		    (cand->tag != 0 && cand->tag != V_ROOT)) {
+			nvlist_free(nvl);
+			continue;
+		}
+
+		/* now root slice candidate based on attributes */
+
+		if (nvlist_lookup_string(nvl, TD_SLICE_ATTR_NAME,
+		    &cand->slicenm) != 0) {
+			td_debug_print(LS_DBGLVL_ERR, "slice name not found\n");
+			nvlist_free(nvl);
+			continue;
+		}
+
+		/* xref slice with disks - eliminates RO media slices */
+		if (disk_random_slice(nvl) == NULL) {
+			if (TLI)
+				td_debug_print(LS_DBGLVL_INFO,
+				    "slice %s has no disk entry\n",
+				    cand->slicenm);
+			nvlist_free(nvl);
+			continue;
+		}
+		/* instances on unchanged disk are taken from snapshot */
+		if (usecache && td_cache_enabled() &&
+		    td_parent_disk_name(cand->slicenm, 's', diskname,
+		    sizeof (diskname)) && td_cache_os_valid(diskname)) {
+			nvlist_free(nvl);
+			continue;
+		}
+
+		/* is slice mounted on running system */
+		bzero(&mpref, sizeof (struct mnttab));
+		(void) snprintf(slicemp, sizeof (slicemp),
+		    "/dev/dsk/%s", cand->slicenm);
+		mpref.mnt_special = slicemp;
+		resetmnttab(mnttabfp);
+		cand->mounted = (getmntany(mnttabfp, &mnttab, &mpref) == 0);
+
+		cand->nvl = nvl;
+		cand->probe = TD_UFS_UNKNOWN;
+		cand->mntrc = MNTRC_NO_MOUNT;
+		(*ncands)++;
+	}
+	if (*ncands == 0) {
+		free(cands);
+		return (NULL);
+	}
+	return (cands);
+}
+
+/*
+ * find out whether candidate slice holds UFS file system which may be
+ * Solaris root and if so, check and mount it on private mount point
+ *
+ * The file system is read directly from raw device first, so slices
+ * without UFS or without /etc/vfstab are rejected without running fsck
+ * and mount. Explicit root slices are always mounted, since missing
+ * files are reported as upgrade failure reasons for them.
+ *
+ * Called from worker threads - must not touch TD global state.
+ */
+static void
+os_prepare_candidate(struct td_os_cand *cand)
+{
+	char rawdev[MAXPATHLEN];
+
+	if (cand->mounted)
+		return;
+
+	(void) snprintf(rawdev, sizeof (rawdev), "/dev/rdsk/%s",
+	    cand->slicenm);
+	cand->probe = td_ufs_probe_root(rawdev, cand->etcrelease,
+	    sizeof (cand->etcrelease));
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO, "raw probe of %s: %s\n",
+		    rawdev, cand->probe == TD_UFS_NOT_UFS ? "not UFS" :
+		    cand->probe == TD_UFS_NO_ROOT ? "no vfstab" :
+		    cand->probe == TD_UFS_ROOT ? "vfstab found" : "unknown");
+	switch (cand->probe) {
+	case TD_UFS_NOT_UFS:
+		return;
+	case TD_UFS_NO_ROOT:
+		/* would be rejected for missing vfstab after mount */
+		if (cand->tag != V_ROOT)
+			return;
+		break;
+	case TD_UFS_UNKNOWN:
+		/*
+		 * Check to see what type of filesystem the
+		 * device contains. The fsck and mount code only
+		 * applies to ufs filesystems
+		 */
+		if (!td_is_fstyp(cand->slicenm, "ufs"))
+			return;
+		break;
+	default:
+		break;
+	}
+
+	(void) strlcpy(cand->mntpnt, TEMPLATEROOT, sizeof (cand->mntpnt));
+	if (mkdtemp(cand->mntpnt) == NULL) {
+		td_debug_print(LS_DBGLVL_WARN,
+		    "can't create mount point for %s: %s\n",
+		    cand->slicenm, strerror(errno));
+		cand->mntpnt[0] = '\0';
+		return;
+	}
+	/* perform fsck and mount */
+	cand->mntrc = td_fsck_mount(cand->mntpnt, cand->slicenm, B_TRUE,
+	    NULL, "-r", "ufs", NULL);
+	if (cand->mntrc != MNTRC_MOUNT_SUCCEEDS) {
+		(void) rmdir(cand->mntpnt);
+		cand->mntpnt[0] = '\0';
+	}
+}
+
+/* candidate preparation worker - claims candidates one at a time */
+static void *
+os_prepare_worker(void *arg)
+{
+	struct td_os_pool *pool = arg;
+	int i;
+
+	for (;;) {
+		(void) pthread_mutex_lock(&pool->lock);
+		i = pool->next++;
+		(void) pthread_mutex_unlock(&pool->lock);
+		if (i >= pool->ncands)
+			break;
+		os_prepare_candidate(&pool->cands[i]);
+	}
+	return (NULL);
+}
+
+/*
+ * prepare all candidates, using the attribute discovery worker pool size
+ * fsck and mount of one slice are independent of other slices, so they
+ * can overlap - every slice is mounted on its own mount point
+ */
+static void
+os_prepare_candidates(struct td_os_cand *cands, int ncands)
+{
+	struct td_os_pool pool;
+	pthread_t tids[TD_MAX_DISCOVERY_THREADS];
+	int nthreads, i;
+
+	if (ncands == 0)
+		return;
+	pool.cands = cands;
+	pool.ncands = ncands;
+	pool.next = 0;
+	(void) pthread_mutex_init(&pool.lock, NULL);
+
+	nthreads = MIN(td_discovery_threads, ncands);
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO,
+		    "probing %d Solaris instance candidates threads=%d\n",
+		    ncands, nthreads);
+
+	/* the calling thread is the last worker */
+	for (i = 0; i < nthreads - 1; i++) {
+		if (pthread_create(&tids[i], NULL, os_prepare_worker,
+		    &pool) != 0) {
+			td_debug_print(LS_DBGLVL_WARN,
+			    "probe thread create failed - "
+			    "continuing with %d threads\n", i + 1);
+			break;
+		}
+	}
+	nthreads = i;
+	(void) os_prepare_worker(&pool);
+	for (i = 0; i < nthreads; i++)
+		(void) pthread_join(tids[i], NULL);
+	(void) pthread_mutex_destroy(&pool.lock);
+}
+
+/* unmount candidate from its private mount point */
+static void
+os_release_candidate(struct td_os_cand *cand)
+{
+	if (cand->mntrc != MNTRC_MOUNT_SUCCEEDS)
+		return;
+	if (umount2(cand->mntpnt, MS_FORCE) == 0)
+		(void) rmdir(cand->mntpnt);
+	else
+		td_debug_print(LS_DBGLVL_WARN, "can't unmount %s: %s\n",
+		    cand->mntpnt, strerror(errno));
+	cand->mntrc = MNTRC_NO_MOUNT;
+}
+
+/*
+ * fsck -m checks to see if file system
+ * needs checking.
+ *
+ * if return code = 0, disk is OK, can be mounted.
+ * if return code = 32, disk is dirty, must be fsck'd
+ * if return code = 33, disk is already mounted
+ *
+ * If the file system to be mounted is the true root,
+ * don't bother to do the fsck -m (since the results are
+ * unpredictable).  We know it must be mounted, so set
+ * the cmdstatus to 33.  This will drop us into the code
+ * that verifies that the EXPECTED file system is mounted
  * as root.
  *
  * If no fsckdev was specified, assume that fscking doesn't
@@ -2070,6 +3082,7 @@ free_td_obj_list(td_object_type_t ot)
 {
 	struct td_class *pobl = &objlist[ot];
 	struct td_obj *pobj;
+	struct td_hlist *phl;
 
 	if (pobl->objarr != NULL) {
 		/* release attribute data */
@@ -2084,126 +3097,447 @@ free_td_obj_list(td_object_type_t ot)
 	pobl->objcur = NULL;
 	pobl->objcnt = 0;
 	pobl->issorted = B_FALSE;
+	pobl->rediscovered = B_FALSE;
 	/* free handle lists from lower-level modules */
 	if (pobl->pddm != NULL) {
 		(void) ddm_free_handle_list(pobl->pddm);
 		pobl->pddm = NULL;
 	}
+	while ((phl = pobl->pddmx) != NULL) {
+		pobl->pddmx = phl->next;
+		(void) ddm_free_handle_list(phl->pddm);
+		free(phl);
+	}
 }
 
-static nvlist_t **
-td_discover_object_by_disk(td_object_type_t ot, const char *disk, int *pcount)
+/*
+ * get name of disk holding object
+ * returns B_FALSE if it can't be determined
+ */
+static boolean_t
+td_obj_disk_name(td_object_type_t ot, struct td_obj *pobj, char *disk,
+    size_t len)
+{
+	char *name = NULL, *ddmname = NULL;
+	boolean_t ret;
+
+	if (pobj->attrib != NULL)
+		(void) nvlist_lookup_string(pobj->attrib,
+		    ot == TD_OT_DISK ? TD_DISK_ATTR_NAME :
+		    ot == TD_OT_PARTITION ? TD_PART_ATTR_NAME :
+		    ot == TD_OT_SLICE ? TD_SLICE_ATTR_NAME :
+		    TD_OS_ATTR_SLICE_NAME, &name);
+	/* attributes not discovered yet */
+	if (name == NULL && ot != TD_OT_OS)
+		name = ddmname = ddm_get_name(pobj->handle);
+	if (name == NULL)
+		return (B_FALSE);
+	if (ot == TD_OT_DISK)
+		ret = strlcpy(disk, name, len) < len;
+	else
+		ret = td_parent_disk_name(name,
+		    ot == TD_OT_PARTITION ? 'p' : 's', disk, len);
+	free(ddmname);
+	return (ret);
+}
+
+/*
+ * remove objects of given type residing on disk from object array
+ * returns number of objects removed
+ */
+static int
+td_remove_disk_objs(td_object_type_t ot, const char *disk)
+{
+	struct td_class *pobl = &objlist[ot];
+	struct td_obj *src, *dst;
+	char objdisk[MAXPATHLEN];
+	int nremoved = 0;
+
+	if (pobl->objarr == NULL)
+		return (0);
+	for (src = dst = pobl->objarr; src->handle != 0; src++) {
+		if (td_obj_disk_name(ot, src, objdisk, sizeof (objdisk)) &&
+		    streq(objdisk, disk)) {
+			if (src->attrib != NULL)
+				nvlist_free(src->attrib);
+			nremoved++;
+			continue;
+		}
+		*dst++ = *src;
+	}
+	*dst = *src; /* terminator */
+	pobl->objcnt -= nremoved;
+	pobl->objcur = NULL;
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO,
+		    "%d objects type=%d removed for disk %s\n",
+		    nremoved, ot, disk);
+	return (nremoved);
+}
+
+/*
+ * append objects from handle list to object array
+ * the handle list is kept with the object class until the objects are
+ * released
+ */
+static td_errno_t
+td_append_objs(td_object_type_t ot, ddm_handle_t *pddm)
+{
+	struct td_class *pobl = &objlist[ot];
+	struct td_hlist *phl;
+	struct td_obj *pobja;
+	int n, i;
+
+	for (n = 0; pddm[n] != NULL; n++)
+		;
+	if ((phl = malloc(sizeof (*phl))) == NULL)
+		return (TD_E_MEMORY);
+	pobja = realloc(pobl->objarr, (pobl->objcnt + n + 1) * sizeof (*pobja));
+	if (pobja == NULL) {
+		free(phl);
+		return (TD_E_MEMORY);
+	}
+	pobl->objarr = pobja;
+	pobja += pobl->objcnt;
+	for (i = 0; i <= n; i++, pobja++) {
+		pobja->handle = pddm[i]; /* including terminator */
+		pobja->attrib = NULL;
+		pobja->discovery_done = B_FALSE;
+		pobja->info_done = B_FALSE;
+	}
+	pobl->objcnt += n;
+	pobl->objcur = NULL;
+	pobl->issorted = B_FALSE;
+	phl->pddm = pddm;
+	phl->next = pobl->pddmx;
+	pobl->pddmx = phl;
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO,
+		    "%d objects type=%d appended\n", n, ot);
+	/* with worker pool configured, fetch attributes up front */
+	if (td_discovery_threads > 1)
+		objs_discover_all_attrs(ot);
+	return (TD_E_SUCCESS);
+}
+
+/*
+ * hash disk name for index lookup
+ */
+static uint_t
+td_index_hash(const char *name)
 {
-	struct td_obj *pobj, *pdisk;
-	nvlist_t **ppd = NULL; /* partition list to return */
+	uint_t h = 5381;
+
+	while (*name != '\0')
+		h = (h << 5) + h + (uchar_t)*name++;
+	return (h);
+}
+
+/*
+ * derive name of parent disk from partition or slice name
+ * (cXtXdXpN or cXtXdXsN) by stripping the trailing <sep>N
+ * returns B_FALSE if name is not of the expected form
+ */
+boolean_t
+td_parent_disk_name(const char *objname, char sep, char *disk, size_t len)
+{
+	const char *p;
+
+	p = objname + strlen(objname);
+	while (p > objname && isdigit(p[-1]))
+		p--;
+	if (*p == '\0' || p - 1 <= objname || p[-1] != sep ||
+	    (size_t)(p - 1 - objname) >= len)
+		return (B_FALSE);
+	(void) strlcpy(disk, objname, p - objname);
+	return (B_TRUE);
+}
+
+/* find index entry for disk name */
+static struct td_index_ent *
+td_index_find(const char *disk)
+{
+	struct td_index_ent *ent;
+
+	ent = td_idx.hash[td_index_hash(disk) & (td_idx.nbuckets - 1)];
+	for (; ent != NULL; ent = ent->next)
+		if (streq(ent->disk, disk))
+			return (ent);
+	return (NULL);
+}
+
+/*
+ * release index
+ * if disks are rediscovered, whole index is released, otherwise only
+ * child lists of given object type
+ */
+static void
+td_index_invalidate(td_object_type_t ot)
+{
+	struct td_index_ent *ent;
+	int c;
+
+	if (ot != TD_OT_DISK) {
+		c = TD_INDEX_CHILD(ot);
+		if (td_idx.pool[c] == NULL)
+			return;
+		free(td_idx.pool[c]);
+		td_idx.pool[c] = NULL;
+		for (ent = td_idx.ents; ent->disk != NULL; ent++) {
+			ent->child[c] = NULL;
+			ent->nchild[c] = 0;
+		}
+		return;
+	}
+	free(td_idx.pool[0]);
+	free(td_idx.pool[1]);
+	free(td_idx.ents);
+	free(td_idx.hash);
+	bzero(&td_idx, sizeof (td_idx));
+}
+
+/*
+ * build hash of disk names
+ * disk names are owned by disk attribute lists, which live until the
+ * disks are rediscovered or released
+ */
+static td_errno_t
+td_index_build_disks(void)
+{
+	struct td_index_ent *ent, **bucket;
+	char *name;
+	int i;
+
+	if (td_idx.ents != NULL)
+		return (TD_E_SUCCESS);
+	disks_discover_all_attrs(); /* insure all disk discovery complete */
+	if (TD_ERRNO != TD_E_SUCCESS)
+		return (TD_ERRNO);
+
+	/* hash load factor 0.5 at most */
+	for (td_idx.nbuckets = 16; td_idx.nbuckets < 2 * NDISKS; )
+		td_idx.nbuckets <<= 1;
+	td_idx.hash = calloc(td_idx.nbuckets, sizeof (*td_idx.hash));
+	/* entries plus terminator */
+	td_idx.ents = calloc(NDISKS + 1, sizeof (*td_idx.ents));
+	if (td_idx.hash == NULL || td_idx.ents == NULL) {
+		td_index_invalidate(TD_OT_DISK);
+		return (TD_E_MEMORY);
+	}
+	for (ent = td_idx.ents, i = 0; i < NDISKS; i++) {
+		if (PDISKARR[i].attrib == NULL ||
+		    nvlist_lookup_string(PDISKARR[i].attrib,
+		    TD_DISK_ATTR_NAME, &name) != 0)
+			continue;
+		ent->disk = name;
+		bucket = &td_idx.hash[td_index_hash(name) &
+		    (td_idx.nbuckets - 1)];
+		ent->next = *bucket;
+		*bucket = ent;
+		ent++;
+	}
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO, "disk index built: %d disks "
+		    "%u buckets\n", (int)(ent - td_idx.ents), td_idx.nbuckets);
+	return (TD_E_SUCCESS);
+}
+
+/*
+ * group partitions or slices by parent disk
+ * all child lists share one allocation, each list is terminated by
+ * ATTR_LIST_TERMINATOR
+ */
+static td_errno_t
+td_index_build_children(td_object_type_t ot)
+{
+	struct td_class *pobl = &objlist[ot];
+	struct td_index_ent *ent;
+	struct td_obj *pobj;
+	char disk[MAXPATHLEN];
 	char *pobjname;
-	int i, nmatch = 0;
-	char	device_match[MAXPATHLEN];
+	char *attrname = (ot == TD_OT_PARTITION ?
+	    TD_PART_ATTR_NAME : TD_SLICE_ATTR_NAME);
+	char sep = (ot == TD_OT_PARTITION ? 'p' : 's');
+	int c = TD_INDEX_CHILD(ot);
+	int nmatch, ndisks, i, pass;
+	nvlist_t **pnext;
+
+	if (td_idx.pool[c] != NULL)
+		return (TD_E_SUCCESS);
+	/* discover object type if not done */
+	if (pobl->objarr == NULL) {
+		(void) td_discover(ot, NULL);
+		if (TD_ERRNO != TD_E_SUCCESS)
+			return (TD_ERRNO);
+	}
+	/* discover all attributes if not done */
+	if (td_discovery_threads > 1) {
+		objs_discover_all_attrs(ot);
+	} else {
+		for (i = 0; i < pobl->objcnt; i++) {
+			pobj = &pobl->objarr[i];
+			if (pobj->discovery_done)
+				continue;
+			pobj->attrib = ddm_get_obj_attributes(ot, pobj->handle);
+			pobj->discovery_done = B_TRUE;
+		}
+	}
 
-	clear_td_errno();
-	if (pcount != NULL)
-		*pcount = 0;
+	/*
+	 * first pass counts children of each disk, second pass fills
+	 * the lists in object array order
+	 * if no attributes, we cannot match on name
+	 */
+	for (pass = 0; pass < 2; pass++) {
+		for (nmatch = 0, i = 0; i < pobl->objcnt; i++) {
+			pobj = &pobl->objarr[i];
+			if (pobj->attrib == NULL ||
+			    nvlist_lookup_string(pobj->attrib, attrname,
+			    &pobjname) != 0 ||
+			    !td_parent_disk_name(pobjname, sep, disk,
+			    sizeof (disk)) ||
+			    (ent = td_index_find(disk)) == NULL)
+				continue;
+			if (pass == 1)
+				ent->child[c][ent->nchild[c]] = pobj->attrib;
+			ent->nchild[c]++;
+			nmatch++;
+		}
+		if (pass == 1)
+			break;
+		for (ndisks = 0; td_idx.ents[ndisks].disk != NULL; ndisks++)
+			;
+		td_idx.pool[c] = malloc((nmatch + ndisks) *
+		    sizeof (nvlist_t *));
+		if (td_idx.pool[c] == NULL) {
+			td_index_invalidate(ot);
+			return (TD_E_MEMORY);
+		}
+		for (pnext = td_idx.pool[c], i = 0; i < ndisks; i++) {
+			ent = &td_idx.ents[i];
+			ent->child[c] = pnext;
+			pnext += ent->nchild[c];
+			*pnext++ = ATTR_LIST_TERMINATOR;
+			ent->nchild[c] = 0;
+		}
+	}
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO, "%s index built: %d of %d "
+		    "objects on known disks\n", ot == TD_OT_PARTITION ?
+		    "partition" : "slice", nmatch, pobl->objcnt);
+	return (TD_E_SUCCESS);
+}
+
+/*
+ * find index entry with partitions or slices of given disk
+ * builds index on first use after discovery
+ * sets TD_ERRNO and returns NULL on failure
+ */
+static struct td_index_ent *
+td_index_lookup(td_object_type_t ot, const char *disk)
+{
+	struct td_index_ent *ent;
+	td_errno_t err;
 
 	/* supported only for partitions and slices */
 	if (ot != TD_OT_PARTITION && ot != TD_OT_SLICE) {
 		(void) set_td_errno(TD_E_NO_OBJECT);
 		return (NULL);
 	}
+	if (disk == NULL) {
+		(void) set_td_errno(TD_E_INVALID_ARG);
+		return (NULL);
+	}
 	/* discover disks if not done */
 	if (objlist[TD_OT_DISK].objarr == NULL) {
 		(void) td_discover(TD_OT_DISK, NULL);
 		if (TD_ERRNO != TD_E_SUCCESS)
 			return (NULL);
 	}
-	pdisk = search_disks(disk);
-	if (pdisk == NULL) {
+	if ((err = td_index_build_disks()) != TD_E_SUCCESS) {
+		(void) set_td_errno(err);
+		return (NULL);
+	}
+	if ((ent = td_index_find(disk)) == NULL) {
 		if (TLI)
 			td_debug_print(LS_DBGLVL_INFO,
-			    "search_disks found no matching disk\n");
+			    "disk index found no matching disk %s\n", disk);
 		(void) set_td_errno(TD_E_NO_DEVICE);
 		return (NULL);
 	}
-	if (TLI)
-		td_debug_print(LS_DBGLVL_INFO,
-		    ">>>  discover partition by diskname=%s\n", disk);
-	/* discover object type if not done */
-	if (objlist[ot].objarr == NULL) {
-		(void) td_discover(ot, NULL);
-		if (TD_ERRNO != TD_E_SUCCESS)
-			return (NULL);
+	if ((err = td_index_build_children(ot)) != TD_E_SUCCESS) {
+		(void) set_td_errno(err);
+		return (NULL);
 	}
-	pobj = objlist[ot].objarr;
-	if (TLI)
-		td_debug_print(LS_DBGLVL_INFO,
-		    ">>>   object count=%d\n", objlist[ot].objcnt);
+	return (ent);
+}
 
-	(void) snprintf(device_match, sizeof (device_match), "%s%s",
-	    disk, ot == TD_OT_PARTITION ? "p" : "s");
+static nvlist_t **
+td_discover_object_by_disk(td_object_type_t ot, const char *disk, int *pcount)
+{
+	struct td_index_ent *ent;
+	nvlist_t **ppd; /* partition list to return */
+	int c, i, ret;
 
-	for (i = 0; i < objlist[ot].objcnt; i++, pobj++) {
-		if (TLI)
-			td_debug_print(LS_DBGLVL_INFO,
-			    ">>>   obj %d handle=0x%llx\n", i, pobj->handle);
-		if (!pobj->discovery_done) {
-			pobj->attrib = (ot == TD_OT_PARTITION ?
-			    ddm_get_partition_attributes(pobj->handle):
-			    ddm_get_slice_attributes(pobj->handle));
-			pobj->discovery_done = B_TRUE;
-		}
-		/*
-		 * if no attributes, we cannot match on name
-		 * this may pose a problem, since there could be a partition
-		 * without attributes that is on the disk
-		 */
-		if (pobj->attrib == NULL)
-			continue;
-		/* match on partition/slice name? */
-		if (nvlist_lookup_string(pobj->attrib,
-		    (ot == TD_OT_PARTITION ?
-		    TD_PART_ATTR_NAME : TD_SLICE_ATTR_NAME),
-		    &pobjname) != 0)
-			continue;
-		if (TLI)
-			td_debug_print(LS_DBGLVL_INFO,
-			    " obj=%s search disk=%s\n", pobjname, disk);
-		/*
-		 * Look for an exact match between the slice/partition
-		 * (pobjname) we're processing and the passed in disk
-		 * name + disk part (eg: c0t0d0s or c0d0p)
-		 */
-		if (strstr(pobjname, device_match) == NULL)
-			continue;
-		/* match on disk name */
-		if (TLI)
-			td_debug_print(LS_DBGLVL_INFO,
-			    ">>>   partition/slice %d %s NDISKS=%d\n",
-			    i, pobjname, NDISKS);
-		/* allocate or extend list of pointers */
-		ppd = ((ppd == NULL) ?
-		    malloc(2 * sizeof (*ppd)) :
-		    realloc(ppd, (nmatch + 2) * sizeof (*ppd)));
-		if (ppd == NULL) {
-			(void) set_td_errno(TD_E_MEMORY);
-			return (NULL);
-		}
-		/* copy partition attributes */
-		if (nvlist_dup(pobj->attrib, &ppd[nmatch], NV_UNIQUE_NAME)
-		    != 0) {
-			(void) set_td_errno(TD_E_MEMORY);
+	clear_td_errno();
+	if (pcount != NULL)
+		*pcount = 0;
+
+	if ((ent = td_index_lookup(ot, disk)) == NULL)
+		return (NULL);
+	c = TD_INDEX_CHILD(ot);
+	if (ent->nchild[c] == 0)
+		return (NULL);
+
+	ppd = malloc((ent->nchild[c] + 1) * sizeof (*ppd));
+	if (ppd == NULL) {
+		(void) set_td_errno(TD_E_MEMORY);
+		return (NULL);
+	}
+	/* copy partition/slice attributes */
+	for (i = 0; i < ent->nchild[c]; i++) {
+		if ((ret = nvlist_dup(ent->child[c][i], &ppd[i],
+		    NV_UNIQUE_NAME)) != 0) {
+			ppd[i] = ATTR_LIST_TERMINATOR;
+			td_attribute_list_free(ppd);
+			(void) set_td_errno(ret == EINVAL ?
+			    TD_E_INVALID_ARG : TD_E_MEMORY);
 			return (NULL);
 		}
-		if (TLI)
-			td_debug_print(LS_DBGLVL_INFO,
-			    ">>>   partition/slice match %d %s %s \n",
-			    nmatch, disk, pobjname);
-		nmatch++;
-		ppd[nmatch] = ATTR_LIST_TERMINATOR;
 	}
+	ppd[i] = ATTR_LIST_TERMINATOR;
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO,
+		    ">>>   %d partitions/slices match disk %s\n", i, disk);
 	if (pcount != NULL)
-		*pcount = nmatch;
+		*pcount = i;
 	return (ppd);
 }
 
+/*
+ * fetch partitions or slices of disk without copying attributes
+ * returns array of attribute lists owned by TD, terminated with
+ * ATTR_LIST_TERMINATOR and valid until objects of that type are
+ * rediscovered or released - caller must neither modify nor free it
+ */
+static nvlist_t **
+td_get_object_by_disk(td_object_type_t ot, const char *disk, int *pcount)
+{
+	struct td_index_ent *ent;
+	int c = TD_INDEX_CHILD(ot);
+
+	clear_td_errno();
+	if (pcount != NULL)
+		*pcount = 0;
+
+	if ((ent = td_index_lookup(ot, disk)) == NULL ||
+	    ent->nchild[c] == 0)
+		return (NULL);
+	if (pcount != NULL)
+		*pcount = ent->nchild[c];
+	return (ent->child[c]);
+}
+
 /* insure all disk discovery complete */
 static void
 disks_discover_all_attrs(void)
@@ -2216,6 +3550,10 @@ disks_discover_all_attrs(void)
 		if (TD_ERRNO != TD_E_SUCCESS)
 			return;
 	}
+	if (td_discovery_threads > 1) {
+		objs_discover_all_attrs(TD_OT_DISK);
+		return;
+	}
 	for (j = 0; j < NDISKS; j++)
 		/* discover disk attributes if not done */
 		if (!PDISKARR[j].discovery_done) {
@@ -2225,6 +3563,249 @@ disks_discover_all_attrs(void)
 		}
 }
 
+/* shared state of attribute discovery worker pool */
+struct td_attr_pool {
+	struct td_class *pobl;		/* object class being discovered */
+	int next;			/* index of next object to claim */
+	pthread_mutex_t lock;		/* protects next */
+};
+
+/* fetch attributes for object of given type from disk module */
+static nvlist_t *
+ddm_get_obj_attributes(td_object_type_t ot, ddm_handle_t handle)
+{
+	switch (ot) {
+	case TD_OT_DISK:
+		return (ddm_get_disk_attributes(handle));
+	case TD_OT_PARTITION:
+		return (ddm_get_partition_attributes(handle));
+	case TD_OT_SLICE:
+		return (ddm_get_slice_attributes(handle));
+	default:
+		break;
+	}
+	return (NULL);
+}
+
+/*
+ * attribute discovery worker
+ * claims objects one at a time until all objects of the class are done
+ * each object is written by exactly one worker, so no further locking
+ * is needed for the object array itself
+ */
+static void *
+objs_discover_attrs_worker(void *arg)
+{
+	struct td_attr_pool *pool = arg;
+	struct td_class *pobl = pool->pobl;
+	struct td_obj *pobj;
+	int i;
+
+	for (;;) {
+		(void) pthread_mutex_lock(&pool->lock);
+		i = pool->next++;
+		(void) pthread_mutex_unlock(&pool->lock);
+		if (i >= pobl->objcnt)
+			break;
+		pobj = &pobl->objarr[i];
+		if (pobj->discovery_done)
+			continue;
+		pobj->attrib = ddm_get_obj_attributes(pobl->objtype,
+		    pobj->handle);
+		pobj->discovery_done = B_TRUE;
+	}
+	return (NULL);
+}
+
+/*
+ * discover attributes for all objects of given type using a bounded
+ * pool of worker threads - the calling thread takes part in the work,
+ * so discovery completes even if no additional thread can be created
+ */
+static void
+objs_discover_all_attrs(td_object_type_t ot)
+{
+	struct td_attr_pool pool;
+	pthread_t tids[TD_MAX_DISCOVERY_THREADS];
+	struct td_obj *pobj;
+	int nthreads, i;
+
+	pool.pobl = &objlist[ot];
+	pool.next = 0;
+	if (pool.pobl->objarr == NULL)
+		return;
+	/* nothing to do if all attributes already discovered */
+	for (i = 0; i < pool.pobl->objcnt; i++)
+		if (!pool.pobl->objarr[i].discovery_done)
+			break;
+	if (i == pool.pobl->objcnt)
+		return;
+	pool.next = i;
+	(void) pthread_mutex_init(&pool.lock, NULL);
+
+	nthreads = MIN(td_discovery_threads, pool.pobl->objcnt - pool.next);
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO,
+		    "discovering attributes of %d objects type=%d "
+		    "threads=%d\n", pool.pobl->objcnt, ot, nthreads);
+
+	/* the calling thread is the last worker */
+	for (i = 0; i < nthreads - 1; i++) {
+		if (pthread_create(&tids[i], NULL,
+		    objs_discover_attrs_worker, &pool) != 0) {
+			td_debug_print(LS_DBGLVL_WARN,
+			    "attribute discovery thread create failed - "
+			    "continuing with %d threads\n", i + 1);
+			break;
+		}
+	}
+	nthreads = i;
+	(void) objs_discover_attrs_worker(&pool);
+	for (i = 0; i < nthreads; i++)
+		(void) pthread_join(tids[i], NULL);
+	(void) pthread_mutex_destroy(&pool.lock);
+
+	/*
+	 * xref slices with disks to discard slices on read-only media,
+	 * as is done for serial discovery in td_attributes_get()
+	 */
+	if (ot != TD_OT_SLICE)
+		return;
+	for (pobj = PSLICEARR; pobj->handle != 0; pobj++) {
+		if (pobj->attrib == NULL ||
+		    disk_random_slice(pobj->attrib) != NULL)
+			continue;
+		ddm_free_attr_list(pobj->attrib);
+		pobj->attrib = NULL;
+	}
+}
+
+/*
+ * take attributes of objects on unchanged disks from discovery snapshot
+ * objects not found in snapshot are probed as usual
+ */
+static void
+objs_fill_from_cache(td_object_type_t ot)
+{
+	struct td_obj *pobj;
+	char disk[MAXPATHLEN];
+	char *name;
+	int nfilled = 0;
+
+	for (pobj = objlist[ot].objarr; pobj->handle != 0; pobj++) {
+		if (pobj->discovery_done ||
+		    (name = ddm_get_name(pobj->handle)) == NULL)
+			continue;
+		if (ot == TD_OT_DISK) {
+			(void) strlcpy(disk, name, sizeof (disk));
+		} else if (!td_parent_disk_name(name,
+		    ot == TD_OT_PARTITION ? 'p' : 's', disk, sizeof (disk))) {
+			free(name);
+			continue;
+		}
+		pobj->attrib = td_cache_get_attrs(ot, disk, name);
+		if (pobj->attrib != NULL) {
+			pobj->discovery_done = B_TRUE;
+			nfilled++;
+		}
+		free(name);
+	}
+	if (TLI)
+		td_debug_print(LS_DBGLVL_INFO,
+		    "%d of %d objects type=%d taken from snapshot\n",
+		    nfilled, objlist[ot].objcnt, ot);
+}
+
+/*
+ * group discovered partitions or slices by name of parent disk
+ * returns NULL if objects of given type were not discovered
+ */
+static nvlist_t *
+cache_group_by_disk(td_object_type_t ot)
+{
+	nvlist_t *groups, *group;
+	struct td_obj *pobj;
+	char disk[MAXPATHLEN];
+	char *name;
+
+	if (objlist[ot].objarr == NULL ||
+	    nvlist_alloc(&groups, NV_UNIQUE_NAME, 0) != 0)
+		return (NULL);
+	for (pobj = objlist[ot].objarr; pobj->handle != 0; pobj++) {
+		if (pobj->attrib == NULL ||
+		    nvlist_lookup_string(pobj->attrib, ot == TD_OT_PARTITION ?
+		    TD_PART_ATTR_NAME : TD_SLICE_ATTR_NAME, &name) != 0 ||
+		    !td_parent_disk_name(name,
+		    ot == TD_OT_PARTITION ? 'p' : 's', disk, sizeof (disk)))
+			continue;
+		if (nvlist_lookup_nvlist(groups, disk, &group) != 0) {
+			if (nvlist_alloc(&group, NV_UNIQUE_NAME, 0) != 0)
+				break;
+			if (nvlist_add_nvlist(groups, disk, group) != 0) {
+				nvlist_free(group);
+				break;
+			}
+			nvlist_free(group);
+			if (nvlist_lookup_nvlist(groups, disk, &group) != 0)
+				break;
+		}
+		if (nvlist_add_nvlist(group, name, pobj->attrib) != 0)
+			break;
+	}
+	if (pobj->handle != 0) {
+		/* incomplete group would be taken as complete - drop all */
+		nvlist_free(groups);
+		return (NULL);
+	}
+	return (groups);
+}
+
+/*
+ * save attributes of all discovered disks and their partitions, slices
+ * and Solaris instances to discovery snapshot
+ */
+static void
+td_cache_snapshot(void)
+{
+	nvlist_t *snap, *parts, *slices, *empty, *pnvl, *snvl;
+	struct td_obj *pobj;
+	char *name;
+
+	if (PDISKARR == NULL || nvlist_alloc(&snap, NV_UNIQUE_NAME, 0) != 0)
+		return;
+	if (nvlist_alloc(&empty, NV_UNIQUE_NAME, 0) != 0) {
+		nvlist_free(snap);
+		return;
+	}
+	parts = cache_group_by_disk(TD_OT_PARTITION);
+	slices = cache_group_by_disk(TD_OT_SLICE);
+	for (pobj = PDISKARR; pobj->handle != 0; pobj++) {
+		if (pobj->attrib == NULL ||
+		    nvlist_lookup_string(pobj->attrib, TD_DISK_ATTR_NAME,
+		    &name) != 0)
+			continue;
+		/* disk without partitions or slices gets an empty group */
+		pnvl = snvl = NULL;
+		if (parts != NULL &&
+		    nvlist_lookup_nvlist(parts, name, &pnvl) != 0)
+			pnvl = empty;
+		if (slices != NULL &&
+		    nvlist_lookup_nvlist(slices, name, &snvl) != 0)
+			snvl = empty;
+		if (td_cache_add_disk(snap, name, pobj->attrib, pnvl, snvl,
+		    td_os_discovered) != TD_E_SUCCESS)
+			break;
+	}
+	nvlist_free(parts);
+	nvlist_free(slices);
+	nvlist_free(empty);
+	if (pobj->handle != 0) {
+		nvlist_free(snap);
+		return;
+	}
+	(void) td_cache_save(snap);
+}
+
 static struct td_obj *
 disk_random_slice(nvlist_t *pattrib)
 {
@@ -2325,27 +3906,6 @@ compare_partition_objs(const void *p1, const void *p2)
 	return (strcmp(pd1, pd2));
 }
 
-static int
-compare_disk_objs_search(const void *p1, const void *p2)
-{
-
-	char *searchdisk = (char *)p1, *pdisk = NULL;
-	struct td_obj *o2 = (struct td_obj *)p2;
-
-	/* discover disk attributes if not done */
-	if (!o2->discovery_done) {
-		o2->attrib = ddm_get_disk_attributes(o2->handle);
-		o2->discovery_done = B_TRUE;
-	}
-	if (o2->attrib != NULL)
-		nvlist_lookup_string(o2->attrib, TD_DISK_ATTR_NAME, &pdisk);
-	if (pdisk == NULL)
-		return (1);
-	if (searchdisk == NULL)
-		return (-1);
-	return (strcmp(searchdisk, pdisk));
-}
-
 static int
 compare_disk_slice_search(const void *p1, const void *p2)
 {
@@ -2366,18 +3926,6 @@ compare_disk_slice_search(const void *p1, const void *p2)
 	return (strcmp(pslice, pdisk));
 }
 
-struct td_obj *
-search_disks(const char *searchstr)
-{
-	struct td_class *pobjlist = &objlist[TD_OT_DISK];
-
-	disks_discover_all_attrs(); /* insure all disk discovery complete */
-	if (!pobjlist->issorted)
-		sort_objs(TD_OT_DISK);
-	return (bsearch(searchstr, pobjlist->objarr, pobjlist->objcnt,
-	    sizeof (struct td_obj), compare_disk_objs_search));
-}
-
 static struct td_obj *
 search_disks_for_slices(char *pslice)
 {
@@ -0,0 +1,341 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * Module:	td_ufs.c
+ * Group:	libtd
+ * Description:	Read-only access to UFS file system on raw device or
+ *		image file. Used by Solaris instance discovery to decide
+ *		whether a slice may contain a Solaris root file system
+ *		without running fsck and mounting it.
+ *
+ *		Only what is needed for small lookups is supported -
+ *		direct and single indirect blocks. Whenever the on-disk
+ *		state can't be trusted (file system not clean, log not
+ *		rolled) or the lookup runs into something unsupported,
+ *		TD_UFS_UNKNOWN is returned and the caller falls back to
+ *		mounting the file system.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/fs/ufs_fs.h>
+#include <sys/fs/ufs_inode.h>
+#include <sys/fs/ufs_fsdir.h>
+
+#include <td_lib.h> /* TD internal definitions */
+
+/* state of one file system being read */
+struct td_ufs {
+	int	fd;		/* raw device or image file */
+	union {
+		struct fs fs;
+		char pad[SBSIZE];
+	} sb;			/* superblock */
+	char	*blk;		/* buffer of one file system block */
+	char	*iblk;		/* buffer of indirect block */
+	daddr32_t iblkno;	/* indirect block held in iblk */
+};
+
+#define	UFS_FS(u)	(&(u)->sb.fs)
+
+static boolean_t ufs_pread_sectors(int, char *, size_t, offset_t);
+static boolean_t ufs_pread(struct td_ufs *, void *, size_t, offset_t);
+static boolean_t ufs_read_inode(struct td_ufs *, ino_t, struct dinode *);
+static daddr32_t ufs_bmap(struct td_ufs *, struct dinode *, daddr32_t);
+static ssize_t ufs_read_file(struct td_ufs *, struct dinode *, char *,
+    size_t);
+static int ufs_lookup(struct td_ufs *, struct dinode *, const char *,
+    ino_t *);
+static int ufs_namei(struct td_ufs *, const char *, struct dinode *);
+
+/* read exactly len bytes at offset */
+static boolean_t
+ufs_pread_sectors(int fd, char *p, size_t len, offset_t off)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		n = pread(fd, p, len, off);
+		if (n <= 0)
+			return (B_FALSE);
+		p += n;
+		off += n;
+		len -= n;
+	}
+	return (B_TRUE);
+}
+
+/*
+ * read from file system
+ * raw devices accept only whole sectors, so unaligned requests are
+ * read through a bounce buffer
+ */
+static boolean_t
+ufs_pread(struct td_ufs *u, void *buf, size_t len, offset_t off)
+{
+	offset_t start = off & ~(offset_t)(DEV_BSIZE - 1);
+	size_t span = roundup(off + len, DEV_BSIZE) - start;
+	boolean_t ok;
+	char *bounce;
+
+	if (start == off && span == len)
+		return (ufs_pread_sectors(u->fd, buf, len, off));
+	if ((bounce = malloc(span)) == NULL)
+		return (B_FALSE);
+	if ((ok = ufs_pread_sectors(u->fd, bounce, span, start)))
+		(void) memcpy(buf, bounce + (off - start), len);
+	free(bounce);
+	return (ok);
+}
+
+static boolean_t
+ufs_read_inode(struct td_ufs *u, ino_t ino, struct dinode *dp)
+{
+	struct fs *fs = UFS_FS(u);
+	offset_t off;
+
+	if (ino < UFSROOTINO || ino >= (ino_t)fs->fs_ipg * fs->fs_ncg)
+		return (B_FALSE);
+	off = (offset_t)fsbtodb(fs, itod(fs, ino)) * DEV_BSIZE +
+	    itoo(fs, ino) * sizeof (struct dinode);
+	return (ufs_pread(u, dp, sizeof (*dp), off));
+}
+
+/*
+ * map logical block of file to file system block
+ * returns 0 for holes and for blocks beyond single indirect block
+ */
+static daddr32_t
+ufs_bmap(struct td_ufs *u, struct dinode *dp, daddr32_t lbn)
+{
+	struct fs *fs = UFS_FS(u);
+
+	if (lbn < NDADDR)
+		return (dp->di_db[lbn]);
+	lbn -= NDADDR;
+	if (lbn >= NINDIR(fs) || dp->di_ib[0] == 0)
+		return (0);
+	if (u->iblkno != dp->di_ib[0]) {
+		if (!ufs_pread(u, u->iblk, fs->fs_bsize,
+		    (offset_t)fsbtodb(fs, dp->di_ib[0]) * DEV_BSIZE))
+			return (0);
+		u->iblkno = dp->di_ib[0];
+	}
+	return (((daddr32_t *)u->iblk)[lbn]);
+}
+
+/*
+ * read up to len bytes from start of file
+ * returns number of bytes read, -1 on failure
+ */
+static ssize_t
+ufs_read_file(struct td_ufs *u, struct dinode *dp, char *buf, size_t len)
+{
+	struct fs *fs = UFS_FS(u);
+	daddr32_t lbn, bn;
+	size_t n, done = 0;
+
+	if (len > dp->di_size)
+		len = dp->di_size;
+	for (lbn = 0; done < len; lbn++) {
+		if ((bn = ufs_bmap(u, dp, lbn)) == 0)
+			return (-1);
+		n = MIN(len - done, fs->fs_bsize);
+		if (!ufs_pread(u, buf + done, n,
+		    (offset_t)fsbtodb(fs, bn) * DEV_BSIZE))
+			return (-1);
+		done += n;
+	}
+	return (done);
+}
+
+/*
+ * look up name in directory
+ * returns 0 and inode number if found, ENOENT if not found,
+ * -1 if directory can't be read
+ */
+static int
+ufs_lookup(struct td_ufs *u, struct dinode *dp, const char *name,
+    ino_t *pino)
+{
+	struct fs *fs = UFS_FS(u);
+	struct direct *de;
+	daddr32_t lbn, bn;
+	size_t namlen = strlen(name);
+	u_offset_t left;
+	size_t n, off;
+
+	if ((dp->di_mode & IFMT) != IFDIR)
+		return (-1);
+	left = dp->di_size;
+	for (lbn = 0; left > 0; lbn++) {
+		if ((bn = ufs_bmap(u, dp, lbn)) == 0)
+			return (-1);
+		n = MIN(left, fs->fs_bsize);
+		if (!ufs_pread(u, u->blk, n,
+		    (offset_t)fsbtodb(fs, bn) * DEV_BSIZE))
+			return (-1);
+		for (off = 0; off < n; off += de->d_reclen) {
+			de = (struct direct *)(u->blk + off);
+			if (de->d_reclen == 0 || off + de->d_reclen > n ||
+			    de->d_namlen > MAXNAMLEN)
+				return (-1);
+			if (de->d_ino != 0 && de->d_namlen == namlen &&
+			    strncmp(de->d_name, name, namlen) == 0) {
+				*pino = de->d_ino;
+				return (0);
+			}
+		}
+		left -= n;
+	}
+	return (ENOENT);
+}
+
+/*
+ * look up absolute path, following directories only
+ * returns 0 and inode of file if found, ENOENT if not found,
+ * -1 if path can't be resolved without mounting
+ */
+static int
+ufs_namei(struct td_ufs *u, const char *path, struct dinode *dp)
+{
+	char comp[MAXNAMLEN + 1];
+	const char *p, *end;
+	ino_t ino = UFSROOTINO;
+	int ret;
+
+	if (!ufs_read_inode(u, ino, dp))
+		return (-1);
+	for (p = path; *p != '\0'; p = end) {
+		while (*p == '/')
+			p++;
+		if (*p == '\0')
+			break;
+		if ((end = strchr(p, '/')) == NULL)
+			end = p + strlen(p);
+		if (end - p > MAXNAMLEN)
+			return (-1);
+		(void) strlcpy(comp, p, end - p + 1);
+		/* symbolic links need mounted file system */
+		if ((dp->di_mode & IFMT) == IFLNK)
+			return (-1);
+		if ((ret = ufs_lookup(u, dp, comp, &ino)) != 0)
+			return (ret);
+		if (!ufs_read_inode(u, ino, dp))
+			return (-1);
+	}
+	return (0);
+}
+
+/*
+ * td_ufs_probe_root()
+ *	Checks whether UFS file system on raw device or image file may be
+ *	a Solaris root file system, reading it directly without mounting
+ * Parameters:
+ *	path	- raw device (/dev/rdsk/cXtXdXsX) or UFS image file
+ *	release	- if not NULL, set to first line of /etc/release,
+ *		  or empty string if it can't be read
+ *	len	- size of release buffer
+ * Return:
+ *	TD_UFS_NOT_UFS	- no UFS file system found
+ *	TD_UFS_NO_ROOT	- UFS file system without /etc/vfstab
+ *	TD_UFS_ROOT	- UFS file system with /etc/vfstab
+ *	TD_UFS_UNKNOWN	- must be mounted to tell
+ */
+td_ufs_probe_t
+td_ufs_probe_root(const char *path, char *release, size_t len)
+{
+	struct td_ufs *u;
+	struct fs *fs;
+	struct dinode di;
+	td_ufs_probe_t probe = TD_UFS_UNKNOWN;
+	ssize_t n;
+	char *nl;
+	int ret;
+
+	if (release != NULL && len > 0)
+		release[0] = '\0';
+	if ((u = calloc(1, sizeof (*u))) == NULL)
+		return (TD_UFS_UNKNOWN);
+	if ((u->fd = open(path, O_RDONLY | O_NDELAY)) < 0) {
+		free(u);
+		return (TD_UFS_UNKNOWN);
+	}
+	fs = UFS_FS(u);
+	if (!ufs_pread(u, &u->sb, SBSIZE, (offset_t)SBOFF)) {
+		/* too small to hold UFS superblock */
+		probe = TD_UFS_NOT_UFS;
+		goto done;
+	}
+	if (fs->fs_magic != FS_MAGIC && fs->fs_magic != MTB_UFS_MAGIC) {
+		probe = TD_UFS_NOT_UFS;
+		goto done;
+	}
+	/* sanity of fields used for addressing */
+	if (fs->fs_bsize < DEV_BSIZE || fs->fs_bsize > MAXBSIZE ||
+	    fs->fs_ncg <= 0 || fs->fs_ipg <= 0 || fs->fs_inopb <= 0 ||
+	    NINDIR(fs) <= 0)
+		goto done;
+	/* on-disk metadata is current only if clean or log rolled */
+	if (fs->fs_clean != FSCLEAN && fs->fs_clean != FSSTABLE &&
+	    (fs->fs_clean != FSLOG || fs->fs_rolled != FS_ALL_ROLLED))
+		goto done;
+	if ((u->blk = malloc(fs->fs_bsize)) == NULL ||
+	    (u->iblk = malloc(fs->fs_bsize)) == NULL)
+		goto done;
+
+	if ((ret = ufs_namei(u, "/etc/vfstab", &di)) == ENOENT) {
+		probe = TD_UFS_NO_ROOT;
+		goto done;
+	}
+	if (ret != 0 || (di.di_mode & IFMT) != IFREG)
+		goto done;
+	probe = TD_UFS_ROOT;
+
+	/* first line of /etc/release identifies the build */
+	if (release != NULL && len > 1 &&
+	    ufs_namei(u, "/etc/release", &di) == 0 &&
+	    (di.di_mode & IFMT) == IFREG &&
+	    (n = ufs_read_file(u, &di, release, len - 1)) > 0) {
+		release[n] = '\0';
+		if ((nl = strchr(release, '\n')) != NULL)
+			*nl = '\0';
+	} else if (release != NULL && len > 0) {
+		release[0] = '\0';
+	}
+done:
+	(void) close(u->fd);
+	free(u->blk);
+	free(u->iblk);
+	free(u);
+	return (probe);
+}
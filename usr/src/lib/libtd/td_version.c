@@ -211,8 +211,7 @@ td_get_build_id(const char *rootdir, char *build_id, size_t maxlen)
 	FILE	*fp;
 	char	line[BUFSIZ];
 	char	etcrelease[MAXPATHLEN];
-	char	*token = NULL;
-	char	release[BUFSIZ];
+	boolean_t found = B_FALSE;
 
 	if (rootdir == NULL || build_id == NULL || maxlen < 1)
 		return (B_FALSE);
@@ -220,10 +219,37 @@ td_get_build_id(const char *rootdir, char *build_id, size_t maxlen)
 	(void) strlcat(etcrelease, "/etc/release", sizeof (etcrelease));
 	if ((fp = fopen(etcrelease, "r")) == NULL)
 		return (B_FALSE);
+	if (fgets(line, sizeof (line), fp) != NULL)
+		found = td_parse_build_id(line, build_id, maxlen);
+	(void) fclose(fp);
+	return (found);
+}
+
+/*
+ * td_parse_build_id()
+ *
+ * get build id from first line of /etc/release, as read by
+ * td_get_build_id() or directly from the file system
+ *
+ * Parameters:
+ *	line - first line of /etc/release, modified
+ *	build_id - address of buffer
+ *	maxlen - size of build_id
+ * Return:
+ *	true if found and at least partially copied
+ *	otherwise false
+ * Status:
+ *	software library internal
+ */
+boolean_t
+td_parse_build_id(char *line, char *build_id, size_t maxlen)
+{
+	char	*token = NULL;
+	char	release[BUFSIZ];
+
 	release[0] = '\0';
 	/* Ignore the first two tokens */
-	if (fgets(line, sizeof (line), fp) != NULL &&
-	    strtok(line, " \n") != NULL &&
+	if (strtok(line, " \n") != NULL &&
 	    strtok(NULL, " \n") != NULL) {
 		/*
 		 * Ignore the tokens Community, Edition, X86 and SPARC
@@ -234,12 +260,13 @@ td_get_build_id(const char *rootdir, char *build_id, size_t maxlen)
 			    strcmp(token, "Edition") &&
 			    strcmp(token, "X86") &&
 			    strcmp(token, "SPARC")) {
-				(void) strcat(release, token);
-				(void) strcat(release, " ");
+				(void) strlcat(release, token,
+				    sizeof (release));
+				(void) strlcat(release, " ",
+				    sizeof (release));
 			}
 		}
 	}
-	(void) fclose(fp);
 	if (release[0] == '\0') {
 		return (B_FALSE);
 	}
@@ -0,0 +1,390 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * this is a benchmark program for Target Discovery Manager
+ * it is linked against a synthetic disk module (td_dd_mock.c), so it
+ * runs without root privileges and without real devices
+ * for development use only
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/param.h>
+#include <pthread.h>
+#include <td_api.h>
+#include <libnvpair.h>
+
+#include <ls_api.h>
+
+extern void ddm_mock_init(int, int, int, useconds_t);
+extern void ddm_mock_set_devdir(const char *);
+extern uint_t ddm_mock_disk_probes(void);
+
+#define	BENCH_MAX_ITERATORS	64
+
+/* disks used by discovery snapshot test */
+#define	BENCH_CACHE_DISKS	4
+
+/*
+ * run complete discovery the way the orchestrator does it:
+ * enumerate all disks, then partitions and slices of each disk
+ * returns elapsed time in milliseconds
+ */
+static double
+bench_discovery(int nthreads, int *nobjs)
+{
+	hrtime_t	start;
+	nvlist_t	*attr, **plist;
+	char		*name;
+	int		ndisks, n, i;
+
+	*nobjs = 0;
+	start = gethrtime();
+	(void) td_set_discovery_threads(nthreads);
+	if (td_discover(TD_OT_DISK, &ndisks) != TD_E_SUCCESS) {
+		(void) printf("Discovery failure %d\n", TD_ERRNO);
+		return (0);
+	}
+	for (i = 0; i < ndisks; i++) {
+		if (td_get_next(TD_OT_DISK) != TD_E_SUCCESS)
+			break;
+		if ((attr = td_attributes_get(TD_OT_DISK)) == NULL)
+			continue;
+		(*nobjs)++;
+		if (nvlist_lookup_string(attr, TD_DISK_ATTR_NAME,
+		    &name) == 0) {
+			plist = td_discover_partition_by_disk(name, &n);
+			*nobjs += n;
+			td_attribute_list_free(plist);
+			plist = td_discover_slice_by_disk(name, &n);
+			*nobjs += n;
+			td_attribute_list_free(plist);
+		}
+		td_list_free(attr);
+	}
+	(void) td_discovery_release();
+	return ((gethrtime() - start) / 1000000.0);
+}
+
+/* discover disks, partitions and slices, returns number of objects */
+static int
+discover_all(void)
+{
+	int	n, nobjs = 0;
+
+	if (td_discover(TD_OT_DISK, &n) == TD_E_SUCCESS)
+		nobjs += n;
+	if (td_discover(TD_OT_PARTITION, &n) == TD_E_SUCCESS)
+		nobjs += n;
+	if (td_discover(TD_OT_SLICE, &n) == TD_E_SUCCESS)
+		nobjs += n;
+	return (nobjs);
+}
+
+/* count objects of given type by enumerating them */
+static int
+count_objs(td_object_type_t ot)
+{
+	nvlist_t	*attr;
+	int		n = 0;
+
+	(void) td_reset(ot);
+	while (td_get_next(ot) == TD_E_SUCCESS) {
+		if ((attr = td_attributes_get(ot)) == NULL)
+			continue;
+		n++;
+		td_list_free(attr);
+	}
+	return (n);
+}
+
+/*
+ * compare refresh of one disk after hot-plug event with full rescan
+ * returns B_FALSE if refresh yields different number of objects
+ */
+static boolean_t
+bench_rediscovery(int ndisks, int nthreads)
+{
+	hrtime_t	start;
+	double		full, one;
+	char		disk[MAXNAMELEN];
+	int		nfull, none;
+
+	(void) td_set_discovery_threads(nthreads);
+	(void) snprintf(disk, sizeof (disk), "c%dt%dd0",
+	    (ndisks - 1) / 1024, (ndisks - 1) % 1024);
+
+	start = gethrtime();
+	(void) discover_all();
+	nfull = count_objs(TD_OT_DISK) + count_objs(TD_OT_PARTITION) +
+	    count_objs(TD_OT_SLICE);
+	full = (gethrtime() - start) / 1000000.0;
+
+	start = gethrtime();
+	if (td_rediscover_device(disk, TD_REDISCOVER_REFRESH) !=
+	    TD_E_SUCCESS) {
+		(void) printf("Rediscovery of %s failure %d\n", disk,
+		    TD_ERRNO);
+		(void) td_discovery_release();
+		return (B_FALSE);
+	}
+	none = count_objs(TD_OT_DISK) + count_objs(TD_OT_PARTITION) +
+	    count_objs(TD_OT_SLICE);
+	one = (gethrtime() - start) / 1000000.0;
+	(void) td_discovery_release();
+
+	(void) printf("  rescan:    %10.1f ms  %d objects\n", full, nfull);
+	(void) printf("  refresh %s:%10.1f ms  %d objects\n", disk, one,
+	    none);
+	return (nfull == none);
+}
+
+/* walk slices with private iterator, return number of objects */
+static void *
+iter_walker(void *arg)
+{
+	td_iter_t	*iter;
+	nvlist_t	*attr;
+	int		*nobjs = arg;
+
+	*nobjs = 0;
+	if (td_iter_open(TD_OT_SLICE, &iter) != TD_E_SUCCESS)
+		return (NULL);
+	while (td_iter_next(iter) == TD_E_SUCCESS) {
+		if ((attr = td_iter_attributes_get(iter)) == NULL)
+			continue;
+		(*nobjs)++;
+		td_list_free(attr);
+	}
+	td_iter_close(iter);
+	return (NULL);
+}
+
+/*
+ * enumerate slices from several threads at once, each with its own
+ * iterator, and compare with enumeration by single consumer
+ * returns B_FALSE if any thread saw different number of objects
+ */
+static boolean_t
+bench_iterators(int nthreads)
+{
+	pthread_t	tids[BENCH_MAX_ITERATORS];
+	int		nobjs[BENCH_MAX_ITERATORS];
+	hrtime_t	start;
+	boolean_t	ok = B_TRUE;
+	int		nserial, i, n;
+
+	nthreads = MIN(nthreads, BENCH_MAX_ITERATORS);
+	(void) discover_all();
+	nserial = count_objs(TD_OT_SLICE);
+	start = gethrtime();
+	for (n = 0; n < nthreads; n++)
+		if (pthread_create(&tids[n], NULL, iter_walker,
+		    &nobjs[n]) != 0)
+			break;
+	for (i = 0; i < n; i++) {
+		(void) pthread_join(tids[i], NULL);
+		if (nobjs[i] != nserial)
+			ok = B_FALSE;
+	}
+	(void) printf("  %2d iterators:%7.1f ms  %d objects each\n", n,
+	    (gethrtime() - start) / 1000000.0, nserial);
+	(void) td_discovery_release();
+	return (ok);
+}
+
+/* write label block of synthetic disk, filled with given byte */
+static boolean_t
+cache_write_disk(const char *dir, int d, int fill)
+{
+	char	path[MAXPATHLEN], buf[DEV_BSIZE];
+	int	fd;
+	ssize_t	n;
+
+	(void) snprintf(path, sizeof (path), "%s/c0t%dd0", dir, d);
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0)
+		return (B_FALSE);
+	(void) memset(buf, fill, sizeof (buf));
+	n = write(fd, buf, sizeof (buf));
+	(void) close(fd);
+	return (n == sizeof (buf));
+}
+
+/*
+ * check that a disk relabeled after discovery is probed again by the
+ * next discovery, even if the discovery snapshot could not be saved
+ * in between
+ * returns B_FALSE if the disk was taken from the stale snapshot
+ */
+static boolean_t
+test_cache_failed_save(int nparts, int nslices)
+{
+	char		dir[MAXPATHLEN], snap[MAXPATHLEN];
+	char		path[MAXPATHLEN];
+	uint_t		nprobes, nfresh, nstale;
+	boolean_t	ok = B_FALSE;
+	int		d;
+
+	(void) strlcpy(dir, "/tmp/tdbench.XXXXXX", sizeof (dir));
+	if (mkdtemp(dir) == NULL) {
+		(void) printf("Can't create directory for snapshot test\n");
+		return (B_FALSE);
+	}
+	(void) snprintf(snap, sizeof (snap), "%s/snapshot", dir);
+	ddm_mock_init(BENCH_CACHE_DISKS, nparts, nslices, 0);
+	ddm_mock_set_devdir(dir);
+	for (d = 0; d < BENCH_CACHE_DISKS; d++)
+		if (!cache_write_disk(dir, d, d))
+			goto out;
+
+	/* first discovery saves the snapshot, second one uses it */
+	if (td_set_cache_file(snap) != TD_E_SUCCESS)
+		goto out;
+	(void) discover_all();
+	(void) td_discovery_release();
+	nprobes = ddm_mock_disk_probes();
+	(void) discover_all();
+	nfresh = ddm_mock_disk_probes() - nprobes;
+
+	/* relabel one disk and make saving the snapshot fail */
+	if (!cache_write_disk(dir, 0, 0xff) || unlink(snap) != 0 ||
+	    mkdir(snap, 0700) != 0)
+		goto out;
+	(void) td_discovery_release();
+
+	nprobes = ddm_mock_disk_probes();
+	(void) discover_all();
+	nstale = ddm_mock_disk_probes() - nprobes;
+	(void) td_discovery_release();
+
+	(void) printf("  snapshot:  %d of %d disks probed, %d after "
+	    "failed save\n", nfresh, BENCH_CACHE_DISKS, nstale);
+	ok = (nfresh == 0 && nstale == 1);
+out:
+	(void) td_set_cache_file(NULL);
+	ddm_mock_set_devdir(NULL);
+	(void) rmdir(snap);
+	(void) unlink(snap);
+	for (d = 0; d < BENCH_CACHE_DISKS; d++) {
+		(void) snprintf(path, sizeof (path), "%s/c0t%dd0", dir, d);
+		(void) unlink(path);
+	}
+	(void) rmdir(dir);
+	return (ok);
+}
+
+static void
+usage(void)
+{
+	(void) printf("Usage: tdbench [-n disks] [-p partitions] "
+	    "[-s slices] [-l latency_usec] [-t threads] [-v]\n"
+	    " -n number of synthetic disks (default 2000)\n"
+	    " -p fdisk partitions per disk (default 2)\n"
+	    " -s VTOC slices per disk (default 8)\n"
+	    " -l simulated latency of one device probe (default 200us)\n"
+	    " -t size of the worker pool to compare with (default %d)\n"
+	    " -v include informational-level debugging information\n",
+	    TD_DISCOVERY_THREADS_DEFAULT);
+}
+
+int
+main(int argc, char **argv)
+{
+	int		c;
+	int		ndisks = 2000, nparts = 2, nslices = 8;
+	int		nthreads = TD_DISCOVERY_THREADS_DEFAULT;
+	useconds_t	latency = 200;
+	double		serial, pooled;
+	int		nserial, npooled;
+
+	ls_set_dbg_level(LS_DBGLVL_ERR);
+	while ((c = getopt(argc, argv, "n:p:s:l:t:v")) != EOF) {
+		switch (c) {
+		case 'n':
+			ndisks = atoi(optarg);
+			break;
+		case 'p':
+			nparts = atoi(optarg);
+			break;
+		case 's':
+			nslices = atoi(optarg);
+			break;
+		case 'l':
+			latency = atoi(optarg);
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		case 'v':
+			ls_set_dbg_level(LS_DBGLVL_INFO);
+			break;
+		default:
+			usage();
+			exit(1);
+		}
+	}
+	if (ndisks <= 0 || nthreads <= 0) {
+		usage();
+		exit(1);
+	}
+
+	ddm_mock_init(ndisks, nparts, nslices, latency);
+	(void) printf("%d disks, %d partitions and %d slices per disk, "
+	    "%uus per probe\n", ndisks, nparts, nslices, latency);
+
+	serial = bench_discovery(1, &nserial);
+	(void) printf("  serial:    %10.1f ms  %d objects\n", serial, nserial);
+	pooled = bench_discovery(nthreads, &npooled);
+	(void) printf("  %2d threads:%10.1f ms  %d objects\n", nthreads,
+	    pooled, npooled);
+
+	if (nserial != npooled) {
+		(void) printf("object count mismatch\n");
+		return (1);
+	}
+	if (pooled > 0)
+		(void) printf("  speedup:   %10.2fx\n", serial / pooled);
+
+	if (!bench_rediscovery(ndisks, nthreads)) {
+		(void) printf("object count mismatch after refresh\n");
+		return (1);
+	}
+	if (!bench_iterators(nthreads)) {
+		(void) printf("object count mismatch in iterators\n");
+		return (1);
+	}
+	if (!test_cache_failed_save(nparts, nslices)) {
+		(void) printf("changed disk taken from discovery snapshot\n");
+		return (1);
+	}
+	return (0);
+}
@@ -0,0 +1,246 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * this is a timing harness for Solaris instance probing
+ * for each UFS image file given, it compares the raw UFS reader used by
+ * Target Discovery (td_ufs.c) with the fsck + mount path it replaces,
+ * both in time and in result. Images are attached with lofiadm, which is
+ * not counted, as real slices need no attaching.
+ *
+ * Image files can be created with:
+ *	mkfile 64m /var/tmp/root.img
+ *	lofiadm -a /var/tmp/root.img
+ *	newfs /dev/rlofi/1 </dev/null
+ *	mount /dev/lofi/1 /mnt && mkdir /mnt/etc && \
+ *	    cp /etc/vfstab /etc/release /mnt/etc && umount /mnt
+ *	lofiadm -d /dev/lofi/1
+ *
+ * for development use only
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/mount.h>
+#include <sys/param.h>
+#include <libnvpair.h>
+#include <td_api.h>
+#include <td_lib.h>
+
+#include <ls_api.h>
+
+#define	BENCH_MNTPNT	"/tmp/tdufsbenchXXXXXX"
+
+static char *probe_name[] = {"unknown", "not UFS", "no vfstab", "root"};
+
+/* run command, return its first output line in buf if requested */
+static int
+bench_cmd(const char *cmd, char *buf, size_t len)
+{
+	FILE *p;
+	char line[MAXPATHLEN];
+
+	if ((p = popen(cmd, "r")) == NULL)
+		return (-1);
+	if (buf != NULL)
+		buf[0] = '\0';
+	while (fgets(line, sizeof (line), p) != NULL)
+		if (buf != NULL && buf[0] == '\0') {
+			line[strcspn(line, "\n")] = '\0';
+			(void) strlcpy(buf, line, len);
+		}
+	return (pclose(p));
+}
+
+/*
+ * probe by fsck -m and read-only mount, the way os_discover() did
+ * returns elapsed time in milliseconds, -1 on failure
+ */
+static double
+bench_mount(const char *lofidev, const char *mntpnt, td_ufs_probe_t *probe,
+    char *release, size_t len)
+{
+	char cmd[MAXPATHLEN * 2];
+	char path[MAXPATHLEN];
+	hrtime_t start;
+	FILE *fp;
+
+	release[0] = '\0';
+	start = gethrtime();
+	(void) snprintf(cmd, sizeof (cmd),
+	    "/usr/sbin/fsck -m -F ufs /dev/r%s 2>&1",
+	    lofidev + strlen("/dev/"));
+	if (bench_cmd(cmd, NULL, 0) != 0) {
+		*probe = TD_UFS_NOT_UFS;
+		return ((gethrtime() - start) / 1000000.0);
+	}
+	(void) snprintf(cmd, sizeof (cmd),
+	    "/sbin/mount -F ufs -r %s %s 2>&1", lofidev, mntpnt);
+	if (bench_cmd(cmd, NULL, 0) != 0) {
+		*probe = TD_UFS_UNKNOWN;
+		return ((gethrtime() - start) / 1000000.0);
+	}
+	(void) snprintf(path, sizeof (path), "%s/etc/vfstab", mntpnt);
+	*probe = access(path, F_OK) == 0 ? TD_UFS_ROOT : TD_UFS_NO_ROOT;
+	(void) snprintf(path, sizeof (path), "%s/etc/release", mntpnt);
+	if (*probe == TD_UFS_ROOT && (fp = fopen(path, "r")) != NULL) {
+		if (fgets(release, len, fp) != NULL)
+			release[strcspn(release, "\n")] = '\0';
+		(void) fclose(fp);
+	}
+	if (umount2(mntpnt, MS_FORCE) != 0)
+		return (-1);
+	return ((gethrtime() - start) / 1000000.0);
+}
+
+/* probe by raw read, returns elapsed time in milliseconds */
+static double
+bench_raw(const char *image, td_ufs_probe_t *probe, char *release,
+    size_t len)
+{
+	hrtime_t start;
+
+	start = gethrtime();
+	*probe = td_ufs_probe_root(image, release, len);
+	return ((gethrtime() - start) / 1000000.0);
+}
+
+static void
+usage(void)
+{
+	(void) printf("Usage: tdufsbench [-r rounds] [-f] [-v] image ...\n"
+	    " -r number of times each image is probed (default 10)\n"
+	    " -f raw probe only - does not need root privileges\n"
+	    " -v include informational-level debugging information\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	int		c, i, r;
+	int		rounds = 10;
+	boolean_t	rawonly = B_FALSE;
+	char		mntpnt[] = BENCH_MNTPNT;
+	char		cmd[MAXPATHLEN * 2];
+	char		lofidev[MAXPATHLEN];
+	char		rawrel[BUFSIZ], mntrel[BUFSIZ];
+	td_ufs_probe_t	rawprobe, mntprobe;
+	double		rawms, mntms, rawtotal = 0, mnttotal = 0, t;
+	int		mismatches = 0;
+
+	ls_set_dbg_level(LS_DBGLVL_ERR);
+	while ((c = getopt(argc, argv, "r:fv")) != EOF) {
+		switch (c) {
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 'f':
+			rawonly = B_TRUE;
+			break;
+		case 'v':
+			ls_set_dbg_level(LS_DBGLVL_INFO);
+			break;
+		default:
+			usage();
+			exit(1);
+		}
+	}
+	if (optind == argc || rounds <= 0) {
+		usage();
+		exit(1);
+	}
+	if (!rawonly && getuid() != 0) {
+		(void) printf("mount probing needs root, use -f\n");
+		exit(1);
+	}
+	if (!rawonly && mkdtemp(mntpnt) == NULL) {
+		perror(mntpnt);
+		exit(1);
+	}
+
+	(void) printf("%-32s %10s %10s  %s\n", "image", "raw ms", "mount ms",
+	    "result");
+	for (i = optind; i < argc; i++) {
+		rawms = mntms = 0;
+		for (r = 0; r < rounds; r++)
+			rawms += bench_raw(argv[i], &rawprobe, rawrel,
+			    sizeof (rawrel));
+		rawms /= rounds;
+		rawtotal += rawms;
+		if (rawonly) {
+			(void) printf("%-32s %10.3f %10s  %s <%s>\n", argv[i],
+			    rawms, "-", probe_name[rawprobe], rawrel);
+			continue;
+		}
+
+		(void) snprintf(cmd, sizeof (cmd),
+		    "/usr/sbin/lofiadm -a %s", argv[i]);
+		if (bench_cmd(cmd, lofidev, sizeof (lofidev)) != 0) {
+			(void) printf("%-32s can't attach image\n", argv[i]);
+			continue;
+		}
+		for (r = 0; r < rounds; r++) {
+			if ((t = bench_mount(lofidev, mntpnt, &mntprobe,
+			    mntrel, sizeof (mntrel))) < 0)
+				break;
+			mntms += t;
+		}
+		(void) snprintf(cmd, sizeof (cmd),
+		    "/usr/sbin/lofiadm -d %s", lofidev);
+		(void) bench_cmd(cmd, NULL, 0);
+		if (r < rounds) {
+			(void) printf("%-32s can't unmount image\n", argv[i]);
+			break;
+		}
+		mntms /= rounds;
+		mnttotal += mntms;
+
+		/* raw probe may only be undecided, never differ */
+		if (rawprobe != TD_UFS_UNKNOWN && (rawprobe != mntprobe ||
+		    strcmp(rawrel, mntrel) != 0)) {
+			(void) printf("%-32s %10.3f %10.3f  MISMATCH "
+			    "raw=%s <%s> mount=%s <%s>\n", argv[i], rawms,
+			    mntms, probe_name[rawprobe], rawrel,
+			    probe_name[mntprobe], mntrel);
+			mismatches++;
+			continue;
+		}
+		(void) printf("%-32s %10.3f %10.3f  %s <%s>\n", argv[i],
+		    rawms, mntms, probe_name[rawprobe], rawrel);
+	}
+	if (!rawonly)
+		(void) rmdir(mntpnt);
+
+	(void) printf("%-32s %10.3f", "total", rawtotal);
+	if (!rawonly && rawtotal > 0)
+		(void) printf(" %10.3f  speedup %.1fx", mnttotal,
+		    mnttotal / rawtotal);
+	(void) printf("\n");
+	return (mismatches == 0 ? 0 : 1);
+}
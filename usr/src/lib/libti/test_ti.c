@@ -82,6 +82,7 @@ display_help(void)
 	    "  -h                print this help\n"
 	    "  -x [0-3]          set debug level (0=emerg, 3=info)\n"
 	    "  -c                commit changes - switch off dry run\n"
+	    "  -L                use libzfs instead of ZFS commands\n"
 	    "  -t target_type    specify target type: "
 	    "f=fdisk, x=disk label, v=vtoc, b=BE, p|P=ZFS pool, m=ZFS "
 	    "filesystem, l=ZFS volume, r=ramdisk, d=directory\n"
@@ -1000,6 +1001,7 @@ main(int argc, char *argv[])
 	/*
 	 * x - set debug mode
 	 * c - run in real mode. Target is modified
+	 * L - use libzfs for ZFS operations
 	 * t - target type
 	 * d - target disk
 	 * w - create Solaris2 partition on whole disk
@@ -1014,7 +1016,7 @@ main(int argc, char *argv[])
 	 * n - BE name
 	 */
 
-	while ((opt = getopt(argc, argv, "x:b:d:f:i:m:n:p:Rr:t:z:u:hcws")) !=
+	while ((opt = getopt(argc, argv, "x:b:d:f:i:m:n:p:Rr:t:z:u:hcLws")) !=
 	    EOF) {
 		switch (opt) {
 
@@ -1046,6 +1048,10 @@ main(int argc, char *argv[])
 				fl_dryrun = B_FALSE;
 			break;
 
+			case 'L':
+				ti_zfs_backend(TI_ZFS_BACKEND_LIBZFS);
+			break;
+
 			case 'd':
 				disk_name = optarg;
 			break;
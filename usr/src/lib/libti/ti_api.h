@@ -66,12 +66,20 @@ typedef enum {
 	TI_E_RMDIR_FAILED,		/* */
 	TI_E_PY_INVALID_ARG,		/* invalid arg in Python interface */
 	TI_E_PY_NO_SPACE,		/* no spare error in Python interface */
-	TI_E_PY_SWAP_INVALID		/* swap choice may cause install failure */
+	TI_E_PY_SWAP_INVALID,		/* swap choice may cause install failure */
+	TI_E_INVALID_LAYOUT_ATTR	/* layout set of attributes invalid */
 } ti_errno_t;
 
 /* type of callback function reporting progress */
 typedef ti_errno_t (*ti_cbf_t)(nvlist_t *);
 
+/* mechanism TI ZFS module uses for ZFS operations */
+
+typedef enum {
+	TI_ZFS_BACKEND_CMD,		/* zpool(1M) and zfs(1M) commands */
+	TI_ZFS_BACKEND_LIBZFS		/* libzfs calls, no processes spawned */
+} ti_zfs_backend_t;
+
 /* milestones for progress report */
 
 typedef enum {
@@ -117,6 +125,7 @@ typedef enum {
 #define	TI_TARGET_TYPE_BE		6
 #define	TI_TARGET_TYPE_DC_UFS		7
 #define	TI_TARGET_TYPE_DC_RAMDISK	8
+#define	TI_TARGET_TYPE_LAYOUT		9
 
 /* progress report */
 
@@ -283,6 +292,18 @@ typedef enum {
 /* string - BE mountpoint */
 #define	TI_ATTR_BE_MOUNTPOINT		"ti_be_mountpoint"
 
+/* nv attribute names for layout */
+
+/*
+ * nvlist array - targets to be created as one layout, each with explicit
+ * TI_ATTR_TARGET_TYPE. Targets not depending on each other are created
+ * concurrently, ZFS file systems and volumes in the same pool are batched.
+ */
+#define	TI_ATTR_LAYOUT_TARGETS		"ti_layout_targets"
+
+/* uint32 - set by TI to type of target which failed */
+#define	TI_ATTR_LAYOUT_FAILED_TYPE	"ti_layout_failed_type"
+
 /* string - ramdisk fs type */
 #define	TI_ATTR_DC_RAMDISK_FS_TYPE	"ti_dc_ramdisk_fs_type"
 
@@ -318,6 +339,9 @@ boolean_t ti_target_exists(nvlist_t *);
 /* Makes TI work in dry run mode */
 void ti_dryrun_mode(void);
 
+/* selects mechanism used for ZFS operations */
+void ti_zfs_backend(ti_zfs_backend_t);
+
 #ifdef __cplusplus
 }
 #endif
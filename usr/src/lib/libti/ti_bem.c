@@ -56,11 +56,9 @@ static void
 ibem_debug_print(ls_dbglvl_t dbg_lvl, const char *fmt, ...)
 {
 	va_list	ap;
-	char	buf[MAXPATHLEN + 1];
 
 	va_start(ap, fmt);
-	(void) vsprintf(buf, fmt, ap);
-	(void) ls_write_dbg_message("TIBEM", dbg_lvl, buf);
+	ls_write_dbg_vmessage("TIBEM", dbg_lvl, fmt, ap);
 	va_end(ap);
 }
 
@@ -81,6 +79,7 @@ ibem_system(char *cmd)
 {
 	FILE	*p;
 	int	ret;
+	hrtime_t	start;
 	char	errbuf[IBEM_MAXCMDLEN];
 
 	/*
@@ -94,6 +93,7 @@ ibem_system(char *cmd)
 	ibem_debug_print(LS_DBGLVL_INFO, "bem cmd: %s\n", cmd);
 
 	if (!ibem_dryrun_mode_fl) {
+		start = ls_span_begin();
 		if ((p = popen(cmd, "r")) == NULL)
 			return (-1);
 
@@ -101,6 +101,7 @@ ibem_system(char *cmd)
 			ibem_debug_print(LS_DBGLVL_WARN, " stderr:%s", errbuf);
 
 		ret = pclose(p);
+		ls_span_end(start, "ti", "ibem_system", cmd);
 
 		if ((ret == -1) || (WEXITSTATUS(ret) != 0))
 			return (-1);
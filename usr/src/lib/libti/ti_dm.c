@@ -29,9 +29,14 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
+#include <limits.h>
 #include <unistd.h>
+#include <sys/byteorder.h>
 #include <sys/dkio.h>
+#include <sys/dklabel.h>
+#include <sys/dktp/fdisk.h>
 #include <sys/mnttab.h>
 #include <sys/param.h>
 #include <sys/stat.h>
@@ -86,11 +91,9 @@ static void
 idm_debug_print(ls_dbglvl_t dbg_lvl, const char *fmt, ...)
 {
 	va_list	ap;
-	char	buf[MAXPATHLEN + 1];
 
 	va_start(ap, fmt);
-	(void) vsprintf(buf, fmt, ap);
-	(void) ls_write_dbg_message("TIDM", dbg_lvl, buf);
+	ls_write_dbg_vmessage("TIDM", dbg_lvl, fmt, ap);
 	va_end(ap);
 }
 
@@ -181,6 +184,7 @@ idm_system(char *cmd)
 {
 	FILE	*p;
 	int	ret;
+	hrtime_t	start;
 	char	errbuf[IDM_MAXCMDLEN];
 
 	/*
@@ -195,6 +199,7 @@ idm_system(char *cmd)
 	    "%s\n", cmd);
 
 	if (!idm_dryrun_mode_fl) {
+		start = ls_span_begin();
 		if ((p = popen(cmd, "r")) == NULL)
 			return (-1);
 
@@ -202,6 +207,7 @@ idm_system(char *cmd)
 			idm_debug_print(LS_DBGLVL_WARN, " stderr:%s", errbuf);
 
 		ret = pclose(p);
+		ls_span_end(start, "ti", "idm_system", cmd);
 
 		if ((ret == -1) || (WEXITSTATUS(ret) != 0))
 			return (-1);
@@ -387,6 +393,793 @@ idm_adjust_vtoc(struct extvtoc *pvtoc, uint32_t nsecs)
 }
 
 
+/*
+ * Function:	idm_disk_open
+ * Description:	Opens disk for reading or writing partition table and
+ *		label. If disk name is an absolute path, it is taken as
+ *		file backed disk image, otherwise raw device
+ *		/dev/rdsk/<disk_name><suffix> is opened.
+ *		For disk images geometry IDM_IMAGE_NHEAD/NSECT is assumed,
+ *		for devices physical geometry is obtained from the driver
+ *		if available.
+ *
+ * Scope:	private
+ * Parameters:	disk_name - disk name in c#t#d# format or path to image
+ *		suffix - device node suffix (p0, s2, ...)
+ *		oflag - O_RDONLY or O_RDWR
+ *		dk - filled in with disk information
+ *
+ * Return:	0 - disk opened, -1 - disk couldn't be opened
+ */
+
+static int
+idm_disk_open(char *disk_name, const char *suffix, int oflag, idm_disk_t *dk)
+{
+	struct stat	st;
+	struct dk_minfo	minfo;
+
+	bzero(dk, sizeof (idm_disk_t));
+
+	if (disk_name[0] == '/')
+		(void) strlcpy(dk->path, disk_name, sizeof (dk->path));
+	else
+		(void) snprintf(dk->path, sizeof (dk->path),
+		    "/dev/rdsk/%s%s", disk_name, suffix);
+
+	if ((dk->fd = open(dk->path, oflag | O_NDELAY)) < 0) {
+		idm_debug_print(LS_DBGLVL_ERR, "Couldn't open %s: %s\n",
+		    dk->path, strerror(errno));
+
+		return (-1);
+	}
+
+	if (fstat(dk->fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		dk->image = B_TRUE;
+		dk->capacity = st.st_size / DEV_BSIZE;
+		dk->geom.dkg_nhead = IDM_IMAGE_NHEAD;
+		dk->geom.dkg_nsect = IDM_IMAGE_NSECT;
+		dk->geom.dkg_pcyl = dk->geom.dkg_ncyl = (ushort_t)MIN(
+		    dk->capacity / (IDM_IMAGE_NHEAD * IDM_IMAGE_NSECT),
+		    USHRT_MAX);
+
+		return (0);
+	}
+
+	/* geometry is not needed for every operation - don't insist */
+
+	if (ioctl(dk->fd, DKIOCG_PHYGEOM, &dk->geom) != 0)
+		bzero(&dk->geom, sizeof (dk->geom));
+
+	if (ioctl(dk->fd, DKIOCGMEDIAINFO, &minfo) == 0 &&
+	    minfo.dki_lbsize == DEV_BSIZE)
+		dk->capacity = minfo.dki_capacity;
+	else
+		dk->capacity = (diskaddr_t)dk->geom.dkg_pcyl *
+		    dk->geom.dkg_nhead * dk->geom.dkg_nsect;
+
+	return (0);
+}
+
+
+/*
+ * Function:	idm_disk_io
+ * Description:	Reads or writes whole sectors of disk with one request,
+ *		retrying only if the request is satisfied partially
+ *
+ * Scope:	private
+ * Parameters:	dk - disk
+ *		wr - B_TRUE for write, B_FALSE for read
+ *		buf - data
+ *		len - number of bytes, multiple of sector size
+ *		lba - first sector
+ *
+ * Return:	0 - success, -1 - I/O failed
+ */
+
+static int
+idm_disk_io(idm_disk_t *dk, boolean_t wr, void *buf, size_t len,
+    diskaddr_t lba)
+{
+	char		*p = buf;
+	off_t		off = (off_t)lba * DEV_BSIZE;
+	ssize_t		n;
+
+	assert(len % DEV_BSIZE == 0);
+
+	while (len > 0) {
+		n = wr ? pwrite(dk->fd, p, len, off) : pread(dk->fd, p, len,
+		    off);
+
+		if (n <= 0) {
+			idm_debug_print(LS_DBGLVL_ERR, "Couldn't %s sector "
+			    "%llu of %s: %s\n", wr ? "write" : "read",
+			    (u_longlong_t)(off / DEV_BSIZE), dk->path,
+			    n < 0 ? strerror(errno) : "end of disk");
+
+			return (-1);
+		}
+		p += n;
+		off += n;
+		len -= n;
+	}
+
+	return (0);
+}
+
+
+/*
+ * Function:	idm_set_chs
+ * Description:	Encodes CHS address into fdisk partition entry fields
+ *
+ * Scope:	private
+ * Parameters:	head, sect, cyl - CHS address
+ *		phead, psect, pcyl - fields of struct ipart
+ */
+
+static void
+idm_set_chs(uint64_t head, uint64_t sect, uint64_t cyl, uchar_t *phead,
+    uchar_t *psect, uchar_t *pcyl)
+{
+	*phead = (uchar_t)head;
+	*psect = (uchar_t)((sect & 0x3f) | ((cyl >> 2) & 0xc0));
+	*pcyl = (uchar_t)(cyl & 0xff);
+}
+
+
+/*
+ * Function:	idm_lba_to_chs
+ * Description:	Calculates CHS fields of fdisk partition entry for given
+ *		sector. Sectors beyond reach of CHS addressing are
+ *		expressed by highest possible address, as fdisk(1M) does.
+ *
+ * Scope:	private
+ * Parameters:	dk - disk
+ *		lba - sector
+ *		phead, psect, pcyl - fields of struct ipart
+ */
+
+static void
+idm_lba_to_chs(idm_disk_t *dk, diskaddr_t lba, uchar_t *phead,
+    uchar_t *psect, uchar_t *pcyl)
+{
+	uint32_t	nsecs = dk->geom.dkg_nhead * dk->geom.dkg_nsect;
+	uint64_t	cyl = lba / nsecs;
+
+	if (cyl > IDM_MAX_CHS_CYL) {
+		idm_set_chs(dk->geom.dkg_nhead - 1, dk->geom.dkg_nsect,
+		    IDM_MAX_CHS_CYL, phead, psect, pcyl);
+	} else {
+		idm_set_chs((lba % nsecs) / dk->geom.dkg_nsect,
+		    lba % dk->geom.dkg_nsect + 1, cyl, phead, psect, pcyl);
+	}
+}
+
+
+/*
+ * Function:	idm_mbr_bootstrap
+ * Description:	Installs default bootstrap code into master boot record
+ *		If bootstrap can't be read, boot code area is cleared.
+ *
+ * Scope:	private
+ * Parameters:	mb - master boot record
+ */
+
+static void
+idm_mbr_bootstrap(struct mboot *mb)
+{
+	struct mboot	boot;
+	int		fd;
+
+	bzero(mb->bootinst, sizeof (mb->bootinst));
+
+	if ((fd = open(IDM_MBOOT_FILE, O_RDONLY)) < 0 ||
+	    read(fd, &boot, sizeof (boot)) != sizeof (boot) ||
+	    LE_16(boot.signature) != MBB_MAGIC) {
+		idm_debug_print(LS_DBGLVL_WARN, "Couldn't read bootstrap "
+		    "from %s, master boot record won't be bootable\n",
+		    IDM_MBOOT_FILE);
+	} else {
+		bcopy(boot.bootinst, mb->bootinst, sizeof (mb->bootinst));
+	}
+
+	if (fd >= 0)
+		(void) close(fd);
+}
+
+
+/*
+ * Function:	idm_mbr_build
+ * Description:	Builds master boot record in memory. Partition entries
+ *		are replaced according to partition table, bootstrap code
+ *		and disk signature are kept. If the record was not valid,
+ *		default bootstrap is installed.
+ *		Partitions are checked to fit on disk and not to overlap.
+ *
+ * Scope:	private
+ * Parameters:	dk - disk
+ *		mb - master boot record read from disk (zeroed if not
+ *		     available), updated in place
+ *		pt - partition table
+ *		npart - number of partitions, at most FD_NUMPART
+ *
+ * Return:	IDM_E_SUCCESS - record built
+ *		IDM_E_FDISK_ATTR_INVALID - partition table is invalid
+ */
+
+static idm_errno_t
+idm_mbr_build(idm_disk_t *dk, struct mboot *mb, idm_part_table_t *pt,
+    uint_t npart)
+{
+	struct ipart	parts[FD_NUMPART];
+	uint_t		i, j;
+
+	assert(npart <= FD_NUMPART);
+
+	if (dk->geom.dkg_nhead == 0 || dk->geom.dkg_nsect == 0) {
+		idm_debug_print(LS_DBGLVL_ERR, "fdisk: Geometry of %s "
+		    "is not known\n", dk->path);
+
+		return (IDM_E_FDISK_ATTR_INVALID);
+	}
+
+	bzero(parts, sizeof (parts));
+
+	for (i = 0; i < npart; i++) {
+		if (pt->id[i] == 0 || pt->size[i] == 0)
+			continue;
+
+		if (pt->offset[i] == 0 || pt->offset[i] + pt->size[i] >
+		    MIN(dk->capacity, UINT32_MAX)) {
+			idm_debug_print(LS_DBGLVL_ERR, "fdisk: Partition %d "
+			    "(%llu+%llu) doesn't fit on disk (%llu sectors)\n",
+			    i + 1, pt->offset[i], pt->size[i], dk->capacity);
+
+			return (IDM_E_FDISK_ATTR_INVALID);
+		}
+
+		for (j = 0; j < i; j++) {
+			if (pt->id[j] == 0 || pt->size[j] == 0)
+				continue;
+
+			if (pt->offset[i] < pt->offset[j] + pt->size[j] &&
+			    pt->offset[j] < pt->offset[i] + pt->size[i]) {
+				idm_debug_print(LS_DBGLVL_ERR, "fdisk: "
+				    "Partitions %d and %d overlap\n", j + 1,
+				    i + 1);
+
+				return (IDM_E_FDISK_ATTR_INVALID);
+			}
+		}
+
+		parts[i].bootid = pt->active[i] != 0 ? ACTIVE : NOTACTIVE;
+		parts[i].systid = pt->id[i];
+		parts[i].relsect = LE_32((uint32_t)pt->offset[i]);
+		parts[i].numsect = LE_32((uint32_t)pt->size[i]);
+
+		/* sectors are numbered from 1, so 0 means CHS not given */
+
+		if (pt->bhead != NULL && pt->bsect[i] != 0 &&
+		    pt->esect[i] != 0) {
+			idm_set_chs(pt->bhead[i], pt->bsect[i], pt->bcyl[i],
+			    &parts[i].beghead, &parts[i].begsect,
+			    &parts[i].begcyl);
+			idm_set_chs(pt->ehead[i], pt->esect[i], pt->ecyl[i],
+			    &parts[i].endhead, &parts[i].endsect,
+			    &parts[i].endcyl);
+		} else {
+			idm_lba_to_chs(dk, pt->offset[i], &parts[i].beghead,
+			    &parts[i].begsect, &parts[i].begcyl);
+			idm_lba_to_chs(dk, pt->offset[i] + pt->size[i] - 1,
+			    &parts[i].endhead, &parts[i].endsect,
+			    &parts[i].endcyl);
+		}
+	}
+
+	if (LE_16(mb->signature) != MBB_MAGIC)
+		idm_mbr_bootstrap(mb);
+
+	bcopy(parts, mb->parts, sizeof (parts));
+	mb->signature = LE_16(MBB_MAGIC);
+
+	return (IDM_E_SUCCESS);
+}
+
+
+/*
+ * Function:	idm_mbr_diff
+ * Description:	Displays partition entries of current and new master boot
+ *		record side by side, changed entries are marked with '*'
+ *
+ * Scope:	private
+ * Parameters:	dbglvl - debugging level
+ *		omb - current master boot record
+ *		nmb - new master boot record
+ */
+
+static void
+idm_mbr_diff(ls_dbglvl_t dbglvl, struct mboot *omb, struct mboot *nmb)
+{
+	struct ipart	op[FD_NUMPART], np[FD_NUMPART];
+	int		i;
+
+	bcopy(omb->parts, op, sizeof (op));
+	bcopy(nmb->parts, np, sizeof (np));
+
+	idm_debug_print(dbglvl, "---------------------------------------"
+	    "---------------------------\n");
+	idm_debug_print(dbglvl, "     current:  ID     offset       size"
+	    " | new:  ID     offset       size\n");
+	idm_debug_print(dbglvl, "---------------------------------------"
+	    "---------------------------\n");
+
+	for (i = 0; i < FD_NUMPART; i++) {
+		idm_debug_print(dbglvl, "%2d %c         %s%02X %10u %10u"
+		    " |      %s%02X %10u %10u\n", i + 1,
+		    bcmp(&op[i], &np[i], sizeof (struct ipart)) != 0 ?
+		    '*' : ' ', op[i].bootid == ACTIVE ? "+" : " ",
+		    op[i].systid, LE_32(op[i].relsect), LE_32(op[i].numsect),
+		    np[i].bootid == ACTIVE ? "+" : " ", np[i].systid,
+		    LE_32(np[i].relsect), LE_32(np[i].numsect));
+	}
+
+	idm_debug_print(dbglvl, "---------------------------------------"
+	    "---------------------------\n");
+
+	if (bcmp(omb->bootinst, nmb->bootinst, sizeof (omb->bootinst)) != 0)
+		idm_debug_print(dbglvl, "Bootstrap code will be installed\n");
+}
+
+
+/*
+ * Function:	idm_mbr_update
+ * Description:	Replaces fdisk partition table on disk. Current master
+ *		boot record is read, new one is built in memory and written
+ *		back with one request. Devices are updated by DKIOCSMBOOT,
+ *		so that disk driver picks up new partitions as well.
+ *		In dry run mode, differences are reported and nothing
+ *		is written.
+ *
+ * Scope:	private
+ * Parameters:	dk - disk
+ *		pt - partition table
+ *		npart - number of partitions, at most FD_NUMPART
+ *
+ * Return:	IDM_E_SUCCESS - partition table written
+ *		IDM_E_FDISK_ATTR_INVALID - partition table is invalid
+ *		IDM_E_FDISK_PART_TABLE_FAILED - I/O failed
+ */
+
+static idm_errno_t
+idm_mbr_update(idm_disk_t *dk, idm_part_table_t *pt, uint_t npart)
+{
+	struct mboot	omb, nmb;
+	idm_errno_t	ret;
+
+	if (idm_disk_io(dk, B_FALSE, &omb, sizeof (omb), 0) != 0)
+		return (IDM_E_FDISK_PART_TABLE_FAILED);
+
+	if (LE_16(omb.signature) != MBB_MAGIC) {
+		idm_debug_print(LS_DBGLVL_INFO, "fdisk: %s doesn't contain "
+		    "valid master boot record\n", dk->path);
+
+		bzero(&omb, sizeof (omb));
+	}
+
+	bcopy(&omb, &nmb, sizeof (nmb));
+
+	if ((ret = idm_mbr_build(dk, &nmb, pt, npart)) != IDM_E_SUCCESS)
+		return (ret);
+
+	idm_debug_print(LS_DBGLVL_INFO, "fdisk: Partition table of %s:\n",
+	    dk->path);
+
+	idm_mbr_diff(LS_DBGLVL_INFO, &omb, &nmb);
+
+	/* if invoked in dry run mode, no changes done to the target */
+
+	if (idm_dryrun_mode_fl) {
+		idm_debug_print(LS_DBGLVL_INFO, "Running in dry run mode, "
+		    "partition table won't be written to the disk\n");
+
+		(void) sleep(1);
+
+		return (IDM_E_SUCCESS);
+	}
+
+	if (!dk->image) {
+		if (ioctl(dk->fd, DKIOCSMBOOT, &nmb) == 0)
+			return (IDM_E_SUCCESS);
+
+		if (errno != ENOTTY && errno != ENOTSUP) {
+			idm_debug_print(LS_DBGLVL_ERR, "fdisk: DKIOCSMBOOT "
+			    "failed for %s: %s\n", dk->path, strerror(errno));
+
+			return (IDM_E_FDISK_PART_TABLE_FAILED);
+		}
+	}
+
+	if (idm_disk_io(dk, B_TRUE, &nmb, sizeof (nmb), 0) != 0)
+		return (IDM_E_FDISK_PART_TABLE_FAILED);
+
+	return (IDM_E_SUCCESS);
+}
+
+
+/*
+ * Function:	idm_label_sector
+ * Description:	Finds where SMI label of disk lives - in the first
+ *		sector of the disk on sparc, in the second sector of
+ *		Solaris2 partition on x86. Geometry of the labeled area
+ *		is calculated as well, so that the label never reaches
+ *		beyond Solaris2 partition. Heads and sectors per track
+ *		are taken from physical geometry if known. On x86, disk
+ *		is expected to be opened as a whole, since fdisk partition
+ *		table is read from its first sector.
+ *
+ * Scope:	private
+ * Parameters:	dk - disk or disk image
+ *		sector - set to sector holding the label
+ *		geom - set to default geometry of labeled area
+ *
+ * Return:	0 - success
+ *		-1 - there is no Solaris2 partition on the disk
+ */
+
+static int
+idm_label_sector(idm_disk_t *dk, diskaddr_t *sector, struct dk_geom *geom)
+{
+	diskaddr_t	start = 0, size = dk->capacity;
+	ushort_t	nhead = IDM_IMAGE_NHEAD, nsect = IDM_IMAGE_NSECT;
+	uint32_t	nsecs;
+#ifndef sparc
+	struct mboot	mb;
+	struct ipart	parts[FD_NUMPART];
+	int		i;
+
+	if (idm_disk_io(dk, B_FALSE, &mb, sizeof (mb), 0) != 0)
+		return (-1);
+
+	bcopy(mb.parts, parts, sizeof (parts));
+
+	for (i = 0; i < FD_NUMPART; i++) {
+		if (LE_16(mb.signature) == MBB_MAGIC &&
+		    (parts[i].systid == SUNIXOS2 ||
+		    parts[i].systid == SUNIXOS)) {
+			start = LE_32(parts[i].relsect);
+			size = LE_32(parts[i].numsect);
+			break;
+		}
+	}
+
+	if (i == FD_NUMPART) {
+		idm_debug_print(LS_DBGLVL_ERR, "%s doesn't contain Solaris2 "
+		    "partition\n", dk->path);
+
+		return (-1);
+	}
+#endif
+	if (dk->geom.dkg_nhead != 0 && dk->geom.dkg_nsect != 0) {
+		nhead = dk->geom.dkg_nhead;
+		nsect = dk->geom.dkg_nsect;
+	}
+	nsecs = (uint32_t)nhead * nsect;
+
+	if (size / nsecs <= IDM_DEFAULT_ACYL || size > UINT32_MAX) {
+		idm_debug_print(LS_DBGLVL_ERR, "Size of %s (%llu sectors) "
+		    "is not suitable for SMI label\n", dk->path, size);
+
+		return (-1);
+	}
+
+	bzero(geom, sizeof (struct dk_geom));
+	geom->dkg_nhead = nhead;
+	geom->dkg_nsect = nsect;
+	geom->dkg_pcyl = (ushort_t)MIN(size / nsecs, USHRT_MAX);
+	geom->dkg_acyl = IDM_DEFAULT_ACYL;
+	geom->dkg_ncyl = geom->dkg_pcyl - IDM_DEFAULT_ACYL;
+	geom->dkg_intrlv = 1;
+	geom->dkg_rpm = 3600;
+
+	*sector = start + DK_LABEL_LOC;
+
+	return (0);
+}
+
+
+/*
+ * Function:	idm_label_default
+ * Description:	Builds VTOC of newly labeled disk, as format(1M) does -
+ *		slice 2 spans all data cylinders, on x86 slice 8 holds
+ *		the first cylinder
+ *
+ * Scope:	private
+ * Parameters:	geom - disk geometry
+ *		pvtoc - filled in with default VTOC
+ */
+
+static void
+idm_label_default(struct dk_geom *geom, struct extvtoc *pvtoc)
+{
+	uint32_t	nsecs = (uint32_t)geom->dkg_nhead * geom->dkg_nsect;
+
+	bzero(pvtoc, sizeof (struct extvtoc));
+
+	pvtoc->v_sanity = VTOC_SANE;
+	pvtoc->v_version = V_VERSION;
+	pvtoc->v_sectorsz = DEV_BSIZE;
+	pvtoc->v_nparts = V_NUMPAR;
+
+	(void) snprintf(pvtoc->v_asciilabel, sizeof (pvtoc->v_asciilabel),
+	    "DEFAULT cyl %d alt %d hd %d sec %d", geom->dkg_ncyl,
+	    geom->dkg_acyl, geom->dkg_nhead, geom->dkg_nsect);
+
+	pvtoc->v_part[IDM_ALL_SLICE].p_tag = V_BACKUP;
+	pvtoc->v_part[IDM_ALL_SLICE].p_flag = V_UNMNT;
+	pvtoc->v_part[IDM_ALL_SLICE].p_size =
+	    idm_cyls_to_secs(geom->dkg_ncyl, nsecs);
+
+#ifndef sparc
+	pvtoc->v_part[IDM_BOOT_SLICE].p_tag = V_BOOT;
+	pvtoc->v_part[IDM_BOOT_SLICE].p_flag = V_UNMNT;
+	pvtoc->v_part[IDM_BOOT_SLICE].p_size =
+	    idm_cyls_to_secs(IDM_BOOT_SLICE_RES_CYL, nsecs);
+#endif
+}
+
+
+/*
+ * Function:	idm_label_read
+ * Description:	Reads geometry and VTOC of SMI labeled disk. Devices are
+ *		asked by DKIOCGGEOM and read_extvtoc(3EXT), label of disk
+ *		images is read directly.
+ *
+ * Scope:	private
+ * Parameters:	dk - disk
+ *		pvtoc - filled in with VTOC
+ *		geom - filled in with geometry
+ *
+ * Return:	0 - success
+ *		-1 - disk is not labeled or label can't be read
+ */
+
+static int
+idm_label_read(idm_disk_t *dk, struct extvtoc *pvtoc, struct dk_geom *geom)
+{
+	struct dk_label	label;
+	diskaddr_t	sector;
+	uint16_t	sum = 0, *sp;
+	int		i;
+
+	if (!dk->image) {
+		if (ioctl(dk->fd, DKIOCGGEOM, geom) != 0)
+			return (-1);
+
+		return (read_extvtoc(dk->fd, pvtoc) < 0 ? -1 : 0);
+	}
+
+	if (idm_label_sector(dk, &sector, geom) != 0 ||
+	    idm_disk_io(dk, B_FALSE, &label, sizeof (label), sector) != 0)
+		return (-1);
+
+	for (sp = (uint16_t *)&label; sp < (uint16_t *)(&label + 1); sp++)
+		sum ^= *sp;
+
+	if (label.dkl_magic != DKL_MAGIC || sum != 0 ||
+	    label.dkl_vtoc.v_sanity != VTOC_SANE ||
+	    label.dkl_nhead == 0 || label.dkl_nsect == 0)
+		return (-1);
+
+	geom->dkg_pcyl = label.dkl_pcyl;
+	geom->dkg_ncyl = label.dkl_ncyl;
+	geom->dkg_acyl = label.dkl_acyl;
+	geom->dkg_nhead = label.dkl_nhead;
+	geom->dkg_nsect = label.dkl_nsect;
+	geom->dkg_intrlv = label.dkl_intrlv;
+	geom->dkg_rpm = label.dkl_rpm;
+
+	bzero(pvtoc, sizeof (struct extvtoc));
+	pvtoc->v_sanity = label.dkl_vtoc.v_sanity;
+	pvtoc->v_version = label.dkl_vtoc.v_version;
+	pvtoc->v_sectorsz = DEV_BSIZE;
+	pvtoc->v_nparts = label.dkl_vtoc.v_nparts;
+	bcopy(label.dkl_vtoc.v_volume, pvtoc->v_volume, LEN_DKL_VVOL);
+
+	for (i = 0; i < NDKMAP; i++) {
+		pvtoc->v_part[i].p_tag = label.dkl_vtoc.v_part[i].p_tag;
+		pvtoc->v_part[i].p_flag = label.dkl_vtoc.v_part[i].p_flag;
+#if defined(_SUNOS_VTOC_16)
+		pvtoc->v_part[i].p_start = label.dkl_vtoc.v_part[i].p_start;
+		pvtoc->v_part[i].p_size = label.dkl_vtoc.v_part[i].p_size;
+#else
+		pvtoc->v_part[i].p_start = (diskaddr_t)
+		    label.dkl_map[i].dkl_cylno * label.dkl_nhead *
+		    label.dkl_nsect;
+		pvtoc->v_part[i].p_size = label.dkl_map[i].dkl_nblk;
+#endif
+	}
+
+#if defined(_SUNOS_VTOC_16)
+	bcopy(label.dkl_vtoc.v_asciilabel, pvtoc->v_asciilabel,
+	    LEN_DKL_ASCII);
+#else
+	bcopy(label.dkl_asciilabel, pvtoc->v_asciilabel, LEN_DKL_ASCII);
+#endif
+	return (0);
+}
+
+
+/*
+ * Function:	idm_label_write
+ * Description:	Writes SMI label with given geometry and VTOC. Devices are
+ *		given the geometry by DKIOCSGEOM and updated by
+ *		write_extvtoc(3EXT), for disk images the label sector is
+ *		built in memory and written directly.
+ *
+ * Scope:	private
+ * Parameters:	dk - disk
+ *		pvtoc - VTOC
+ *		geom - geometry
+ *
+ * Return:	0 - success, -1 - label couldn't be written
+ */
+
+static int
+idm_label_write(idm_disk_t *dk, struct extvtoc *pvtoc, struct dk_geom *geom)
+{
+	struct dk_label	label;
+	struct dk_geom	lgeom;
+	diskaddr_t	sector;
+	uint16_t	sum = 0, *sp;
+	uint32_t	nsecs = (uint32_t)geom->dkg_nhead * geom->dkg_nsect;
+	int		i;
+
+	if (!dk->image) {
+		if (ioctl(dk->fd, DKIOCSGEOM, geom) != 0)
+			return (-1);
+
+		return (write_extvtoc(dk->fd, pvtoc) < 0 ? -1 : 0);
+	}
+
+	if (idm_label_sector(dk, &sector, &lgeom) != 0)
+		return (-1);
+
+	bzero(&label, sizeof (label));
+
+	label.dkl_pcyl = geom->dkg_pcyl;
+	label.dkl_ncyl = geom->dkg_ncyl;
+	label.dkl_acyl = geom->dkg_acyl;
+	label.dkl_nhead = geom->dkg_nhead;
+	label.dkl_nsect = geom->dkg_nsect;
+	label.dkl_intrlv = geom->dkg_intrlv != 0 ? geom->dkg_intrlv : 1;
+	label.dkl_rpm = geom->dkg_rpm != 0 ? geom->dkg_rpm : 3600;
+	label.dkl_magic = DKL_MAGIC;
+
+	label.dkl_vtoc.v_sanity = VTOC_SANE;
+	label.dkl_vtoc.v_version = V_VERSION;
+	label.dkl_vtoc.v_nparts = NDKMAP;
+	bcopy(pvtoc->v_volume, label.dkl_vtoc.v_volume, LEN_DKL_VVOL);
+
+	for (i = 0; i < NDKMAP; i++) {
+		if (pvtoc->v_part[i].p_start + pvtoc->v_part[i].p_size >
+		    (diskaddr_t)geom->dkg_pcyl * nsecs) {
+			idm_debug_print(LS_DBGLVL_ERR, "Slice %d doesn't fit "
+			    "into SMI label of %s\n", i, dk->path);
+
+			return (-1);
+		}
+
+		label.dkl_vtoc.v_part[i].p_tag = pvtoc->v_part[i].p_tag;
+		label.dkl_vtoc.v_part[i].p_flag = pvtoc->v_part[i].p_flag;
+#if defined(_SUNOS_VTOC_16)
+		label.dkl_vtoc.v_part[i].p_start =
+		    (daddr32_t)pvtoc->v_part[i].p_start;
+		label.dkl_vtoc.v_part[i].p_size =
+		    (int32_t)pvtoc->v_part[i].p_size;
+#else
+		label.dkl_map[i].dkl_cylno =
+		    (daddr32_t)(pvtoc->v_part[i].p_start / nsecs);
+		label.dkl_map[i].dkl_nblk = (daddr32_t)pvtoc->v_part[i].p_size;
+#endif
+	}
+
+#if defined(_SUNOS_VTOC_16)
+	label.dkl_vtoc.v_sectorsz = DEV_BSIZE;
+	bcopy(pvtoc->v_asciilabel, label.dkl_vtoc.v_asciilabel,
+	    LEN_DKL_ASCII);
+#else
+	bcopy(pvtoc->v_asciilabel, label.dkl_asciilabel, LEN_DKL_ASCII);
+#endif
+
+	/* checksum makes XOR of all 16 bit words of the label zero */
+
+	for (sp = (uint16_t *)&label; sp < &label.dkl_cksum; sp++)
+		sum ^= *sp;
+	label.dkl_cksum = sum;
+
+	return (idm_disk_io(dk, B_TRUE, &label, sizeof (label), sector));
+}
+
+
+/*
+ * Function:	idm_display_vtoc_diff
+ * Description:	Displays slices of current and new VTOC side by side,
+ *		changed slices are marked with '*'
+ *
+ * Scope:	private
+ * Parameters:	dbglvl - debugging level
+ *		ovtoc - current VTOC
+ *		nvtoc - new VTOC
+ */
+
+static void
+idm_display_vtoc_diff(ls_dbglvl_t dbglvl, struct extvtoc *ovtoc,
+    struct extvtoc *nvtoc)
+{
+	struct extpartition	*op, *np;
+	int			i;
+
+	idm_debug_print(dbglvl, "---------------------------------------"
+	    "-----------------------------\n");
+	idm_debug_print(dbglvl, "     current: TAG    1st_sec       size"
+	    " | new: TAG    1st_sec       size\n");
+	idm_debug_print(dbglvl, "---------------------------------------"
+	    "-----------------------------\n");
+
+	for (i = 0; i < V_NUMPAR; i++) {
+		op = &ovtoc->v_part[i];
+		np = &nvtoc->v_part[i];
+
+		if (op->p_size == 0 && np->p_size == 0)
+			continue;
+
+		idm_debug_print(dbglvl, "%2d %c          %02X %10lld %10lld"
+		    " |      %02X %10lld %10lld\n", i,
+		    op->p_tag != np->p_tag || op->p_flag != np->p_flag ||
+		    op->p_start != np->p_start || op->p_size != np->p_size ?
+		    '*' : ' ', op->p_tag, op->p_start, op->p_size,
+		    np->p_tag, np->p_start, np->p_size);
+	}
+
+	idm_debug_print(dbglvl, "---------------------------------------"
+	    "-----------------------------\n");
+}
+
+
+/*
+ * Function:	idm_free_part_table
+ * Description:	Frees partition table structures built from attributes.
+ *		Arrays of the original table belong to the nv list, copy
+ *		made for preserving partitions is freed completely.
+ *
+ * Scope:	private
+ * Parameters:	pt - partition table referring to attributes
+ *		new_pt - copy of partition table or pt if no copy was made
+ */
+
+static void
+idm_free_part_table(idm_part_table_t *pt, idm_part_table_t *new_pt)
+{
+	if (new_pt != pt) {
+		free(new_pt->id);
+		free(new_pt->active);
+		free(new_pt->offset);
+		free(new_pt->size);
+
+		free(new_pt->bhead);
+		free(new_pt->bsect);
+		free(new_pt->bcyl);
+
+		free(new_pt->ehead);
+		free(new_pt->esect);
+		free(new_pt->ecyl);
+
+		free(new_pt);
+	}
+
+	free(pt);
+}
+
+
 /*
  * Function:	idm_fill_preserved_partitions
  * Description:	Read partition geometry information for partitions which should
@@ -394,6 +1187,9 @@ idm_adjust_vtoc(struct extvtoc *pvtoc, uint32_t nsecs)
  *
  * Scope:	private
  * Parameters:	disk_name	- disk device name in c#t#d# format
+ *		dk		- opened disk if primary partitions are
+ *				  read from master boot record directly,
+ *				  NULL if fdisk(1M) is used
  *		pt		- pointer to structure containing information
  *				  about partition table to be created
  *		part_preserve	- array of flags indicating which partition
@@ -406,8 +1202,8 @@ idm_adjust_vtoc(struct extvtoc *pvtoc, uint32_t nsecs)
  */
 
 static idm_errno_t
-idm_fill_preserved_partitions(char *disk_name, idm_part_table_t *pt,
-    boolean_t *part_preserve, uint_t npart)
+idm_fill_preserved_partitions(char *disk_name, idm_disk_t *dk,
+    idm_part_table_t *pt, boolean_t *part_preserve, uint_t npart)
 {
 	FILE			*pt_file;
 	char			cmd[IDM_MAXCMDLEN];
@@ -421,6 +1217,48 @@ idm_fill_preserved_partitions(char *disk_name, idm_part_table_t *pt,
 	uint_t			i;
 	int			ret;
 
+	if (dk != NULL) {
+		struct mboot	mb;
+		struct ipart	parts[FD_NUMPART];
+
+		if (idm_disk_io(dk, B_FALSE, &mb, sizeof (mb), 0) != 0 ||
+		    LE_16(mb.signature) != MBB_MAGIC) {
+			idm_debug_print(LS_DBGLVL_ERR,
+			    "Couldn't read partition table for disk %s\n",
+			    disk_name);
+
+			return (IDM_E_FDISK_CLI_FAILED);
+		}
+
+		pt_orig = calloc(FD_NUMPART, sizeof (idm_fdisk_partition_t));
+
+		if (pt_orig == NULL) {
+			idm_debug_print(LS_DBGLVL_ERR, "OOM :-(\n");
+
+			return (IDM_E_FDISK_CLI_FAILED);
+		}
+
+		bcopy(mb.parts, parts, sizeof (parts));
+
+		for (i = 0; i < FD_NUMPART; i++) {
+			pt_orig[i].id = parts[i].systid;
+			pt_orig[i].active = parts[i].bootid;
+			pt_orig[i].bhead = parts[i].beghead;
+			pt_orig[i].bsect = parts[i].begsect & 0x3f;
+			pt_orig[i].bcyl = parts[i].begcyl |
+			    ((parts[i].begsect & 0xc0) << 2);
+			pt_orig[i].ehead = parts[i].endhead;
+			pt_orig[i].esect = parts[i].endsect & 0x3f;
+			pt_orig[i].ecyl = parts[i].endcyl |
+			    ((parts[i].endsect & 0xc0) << 2);
+			pt_orig[i].offset = LE_32(parts[i].relsect);
+			pt_orig[i].size = LE_32(parts[i].numsect);
+		}
+
+		npart_orig = FD_NUMPART;
+		goto display;
+	}
+
 	/* Read original partition table to temporary file */
 
 	(void) snprintf(cmd, sizeof (cmd),
@@ -519,6 +1357,7 @@ idm_fill_preserved_partitions(char *disk_name, idm_part_table_t *pt,
 
 	(void) fclose(pt_file);
 
+display:
 	idm_debug_print(LS_DBGLVL_INFO,
 	    "Original partition table contains %u entries\n", npart_orig);
 
@@ -837,49 +1676,77 @@ idm_release_swap(char *disk_name)
 /*
  * Function:	idm_fdisk_whole_disk
  * Description:	Uses whole disk as target. Creates one Solaris2 partition
- *		occupying all available disk space.
+ *		occupying all available disk space, the same fdisk -B
+ *		does - first cylinder is left unused and partition is
+ *		limited to 2TB. Master boot record is built in memory
+ *		and written directly, fdisk(1M) is not invoked.
+ *		In dry run mode, differences against current partition
+ *		table are reported.
  *
  * Scope:	public
  * Parameters:	disk_name - disk which should be formatted with one Solaris2
- *		parition
+ *		parition, or path to disk image
  *
  * Return:	IDM_E_SUCCESS - Solaris2 partition created successfully
- *		IDM_E_FDISK_WDISK_FAILED - "fdisk -n -B" command failed
+ *		IDM_E_FDISK_WDISK_FAILED - partition table couldn't be written
  */
 
 idm_errno_t
 idm_fdisk_whole_disk(char *disk_name)
 {
-	char	cmd[IDM_MAXCMDLEN];
-	int	ret;
+	idm_disk_t		dk;
+	idm_part_table_t	pt;
+	uint8_t			id[FD_NUMPART] = {SUNIXOS2, 0, 0, 0};
+	uint8_t			active[FD_NUMPART] = {ACTIVE, 0, 0, 0};
+	uint64_t		offset[FD_NUMPART], size[FD_NUMPART];
+	uint32_t		nsecs;
+	idm_errno_t		ret;
 
-	/* if invoked in dry run mode, no changes done to the target */
+	idm_debug_print(LS_DBGLVL_INFO, "fdisk: "
+	    "Creating Solaris2 partition on whole disk %s:\n", disk_name);
 
-	if (idm_dryrun_mode_fl) {
-		(void) sleep(1);
+	if (idm_disk_open(disk_name, "p0", idm_dryrun_mode_fl ? O_RDONLY :
+	    O_RDWR, &dk) != 0) {
+		/* if invoked in dry run mode, there is nothing to compare */
 
-		return (IDM_E_SUCCESS);
+		if (idm_dryrun_mode_fl) {
+			(void) sleep(1);
+
+			return (IDM_E_SUCCESS);
+		}
+
+		return (IDM_E_FDISK_WDISK_FAILED);
 	}
 
-	/*
-	 * Provide fdisk(1M) with "-n" option in order to make it work
-	 * in non-interactive mode. Otherwise it might hang the installer
-	 * when waiting for user input.
-	 */
+	nsecs = (uint32_t)dk.geom.dkg_nhead * dk.geom.dkg_nsect;
 
-	(void) snprintf(cmd, sizeof (cmd),
-	    "/usr/sbin/fdisk -n -B /dev/rdsk/%sp0",
-	    disk_name);
+	if (nsecs == 0 || MIN(dk.capacity, UINT32_MAX) / nsecs < 2) {
+		idm_debug_print(LS_DBGLVL_ERR, "fdisk: "
+		    "Geometry of disk %s is not usable\n", disk_name);
 
-	idm_debug_print(LS_DBGLVL_INFO, "fdisk: "
-	    "Creating Solaris2 partition on whole disk %s:\n", disk_name);
+		(void) close(dk.fd);
+		return (IDM_E_FDISK_WDISK_FAILED);
+	}
 
-	ret = idm_system(cmd);
+	bzero(offset, sizeof (offset));
+	bzero(size, sizeof (size));
+	offset[0] = nsecs;
+	size[0] = (MIN(dk.capacity, UINT32_MAX) / nsecs - 1) * nsecs;
 
-	if (ret == -1) {
+	bzero(&pt, sizeof (pt));
+	pt.id = id;
+	pt.active = active;
+	pt.offset = offset;
+	pt.size = size;
+
+	ret = idm_mbr_update(&dk, &pt, FD_NUMPART);
+
+	(void) close(dk.fd);
+
+	if (ret != IDM_E_SUCCESS) {
 		idm_debug_print(LS_DBGLVL_ERR, "fdisk: "
-		    "fdisk -n -B failed. Couldn't create Solaris2 "
-		    "partition on whole disk %s", disk_name);
+		    "Couldn't create Solaris2 partition on whole disk %s\n",
+		    disk_name);
 
 		return (IDM_E_FDISK_WDISK_FAILED);
 	}
@@ -889,10 +1756,13 @@ idm_fdisk_whole_disk(char *disk_name)
 
 /*
  * Function:	idm_fdisk_create_part_table
- * Description:	Creates partition table on disk
+ * Description:	Creates partition table on disk. If only primary
+ *		partitions are to be created, master boot record is built
+ *		in memory and written directly. Logical volumes within
+ *		extended partition are created by fdisk(1M).
  *
  * Scope:	public
- * Parameters:	disk_name - disk which should be partitioned
+ * Parameters:	attrs - set of attributes describing partition table
  *
  * Return:	IDM_E_SUCCESS - partition table created successfully
  *		IDM_E_FDISK_ATTR_INVALID - invalid set of attributes passed
@@ -913,6 +1783,8 @@ idm_fdisk_create_part_table(nvlist_t *attrs)
 	char			pt_file_template[] = "/tmp/ti_fdisk_XXXXXX";
 	char			*pt_file_name;
 	FILE			*pt_file;
+	idm_disk_t		dk, *dkp = NULL;
+	idm_errno_t		err;
 
 	uint8_t		*part_ids, *part_active_flags;
 	uint64_t	*part_bheads, *part_bsecs, *part_bcyls;
@@ -1172,6 +2044,24 @@ idm_fdisk_create_part_table(nvlist_t *attrs)
 		}
 	}
 
+	/*
+	 * Primary partitions are written to master boot record directly.
+	 * In dry run mode, disk is only read in order to report
+	 * differences - if it can't be opened, there is nothing to compare.
+	 */
+
+	if (part_num <= FD_NUMPART) {
+		if (idm_disk_open(disk_name, "p0", idm_dryrun_mode_fl ?
+		    O_RDONLY : O_RDWR, &dk) == 0) {
+			dkp = &dk;
+		} else if (!idm_dryrun_mode_fl) {
+			idm_debug_print(LS_DBGLVL_ERR, "Can't create part. "
+			    "table, disk %s couldn't be opened\n", disk_name);
+
+			return (IDM_E_FDISK_PART_TABLE_FAILED);
+		}
+	}
+
 	/*
 	 * save all pointers in partition table structure for easier
 	 * manipulation
@@ -1182,6 +2072,8 @@ idm_fdisk_create_part_table(nvlist_t *attrs)
 	if (part_table == NULL) {
 		idm_debug_print(LS_DBGLVL_ERR, "OOM :-(\n");
 
+		if (dkp != NULL)
+			(void) close(dkp->fd);
 		return (IDM_E_FDISK_PART_TABLE_FAILED);
 	}
 
@@ -1225,6 +2117,8 @@ idm_fdisk_create_part_table(nvlist_t *attrs)
 
 		if (new_part_table == NULL) {
 			idm_debug_print(LS_DBGLVL_ERR, "OOM :-(\n");
+			if (dkp != NULL)
+				(void) close(dkp->fd);
 			return (IDM_E_FDISK_PART_TABLE_FAILED);
 		}
 
@@ -1252,6 +2146,8 @@ idm_fdisk_create_part_table(nvlist_t *attrs)
 		    new_part_table->esect == NULL ||
 		    new_part_table->ecyl == NULL) {
 			idm_debug_print(LS_DBGLVL_ERR, "OOM :-(\n");
+			if (dkp != NULL)
+				(void) close(dkp->fd);
 			return (IDM_E_FDISK_PART_TABLE_FAILED);
 		}
 
@@ -1280,12 +2176,15 @@ idm_fdisk_create_part_table(nvlist_t *attrs)
 			    part_num * sizeof (uint64_t));
 		}
 
-		if (idm_fill_preserved_partitions(disk_name, new_part_table,
-		    part_preserve, part_num) != IDM_E_SUCCESS) {
+		if (idm_fill_preserved_partitions(disk_name, dkp,
+		    new_part_table, part_preserve, part_num) !=
+		    IDM_E_SUCCESS) {
 			idm_debug_print(LS_DBGLVL_ERR,
 			    "Couldn't preserve partitions on disk %s - "
 			    "fdisk failed\n", disk_name);
 
+			if (dkp != NULL)
+				(void) close(dkp->fd);
 			return (IDM_E_FDISK_PART_TABLE_FAILED);
 		}
 	}
@@ -1328,6 +2227,23 @@ idm_fdisk_create_part_table(nvlist_t *attrs)
 	    "-----------------------------------------------"
 	    "-----------------\n");
 
+	if (dkp != NULL) {
+		err = idm_mbr_update(dkp, new_part_table, part_num);
+
+		(void) close(dkp->fd);
+		idm_free_part_table(part_table, new_part_table);
+
+		if (err != IDM_E_SUCCESS) {
+			idm_debug_print(LS_DBGLVL_ERR, "fdisk: "
+			    "Couldn't create fdisk partition table on "
+			    "disk %s\n", disk_name);
+
+			return (IDM_E_FDISK_PART_TABLE_FAILED);
+		}
+
+		return (IDM_E_SUCCESS);
+	}
+
 	/* if invoked in dry run mode, no changes done to the target */
 
 	if (idm_dryrun_mode_fl) {
@@ -1418,24 +2334,7 @@ idm_fdisk_create_part_table(nvlist_t *attrs)
 
 	/* Free previously allocated space */
 
-	if (part_preserve != NULL) {
-		free(new_part_table->id);
-		free(new_part_table->active);
-		free(new_part_table->offset);
-		free(new_part_table->size);
-
-		free(new_part_table->bhead);
-		free(new_part_table->bsect);
-		free(new_part_table->bcyl);
-
-		free(new_part_table->ehead);
-		free(new_part_table->esect);
-		free(new_part_table->ecyl);
-
-		free(new_part_table);
-	}
-
-	free(part_table);
+	idm_free_part_table(part_table, new_part_table);
 
 	/*
 	 * keep temporary file - if something went wrong during
@@ -1451,6 +2350,10 @@ idm_fdisk_create_part_table(nvlist_t *attrs)
  * Function:	idm_create_disk_label
  * Description:	Creates disk label (currently only SMI is supported)
  *		according to set of attributes provided as nv list.
+ *		Default label is built in memory - disk images are labeled
+ *		directly, devices by DKIOCSGEOM and write_extvtoc(3EXT).
+ *		format(1M) is invoked only if disk driver refuses the
+ *		label. In dry run mode, the label is only reported.
  *
  * Scope:	public
  * Parameters:	attrs - set of attribtues describing the target
@@ -1466,9 +2369,10 @@ idm_create_disk_label(nvlist_t *attrs)
 	char		cmd[IDM_MAXCMDLEN];
 	int		ret;
 	struct dk_geom	geom;
-	char		device[MAXPATHLEN];
+	struct extvtoc	extvtoc;
+	idm_disk_t	dk;
+	diskaddr_t	sector;
 	char		*disk_name;
-	int		fd;
 	boolean_t	EFI = B_FALSE;
 
 	/* sanity check */
@@ -1491,23 +2395,33 @@ idm_create_disk_label(nvlist_t *attrs)
 
 	/* check for existing disk label */
 
-	(void) snprintf(device, MAXPATHLEN, "/dev/rdsk/%ss2", disk_name);
-
-	if ((fd = open(device, O_RDWR | O_NDELAY)) < 0) {
+	if (idm_disk_open(disk_name, "s2", idm_dryrun_mode_fl ? O_RDONLY :
+	    O_RDWR, &dk) != 0) {
 		idm_debug_print(LS_DBGLVL_ERR, "Can't create disk label, "
-		    "couldn't open %s device\n", device);
+		    "couldn't open %s device\n", dk.path);
 
 		return (IDM_E_DISK_LABEL_FAILED);
 	}
 
-	if (ioctl(fd, DKIOCGGEOM, &geom) == -1) {
+	if (dk.image) {
+		if (idm_label_read(&dk, &extvtoc, &geom) == 0) {
+			idm_debug_print(LS_DBGLVL_INFO, "Disk %s has "
+			    "a SMI label\n", disk_name);
+
+			(void) close(dk.fd);
+			return (IDM_E_SUCCESS);
+		}
+
+		idm_debug_print(LS_DBGLVL_INFO, "Disk %s is "
+		    "unlabeled\n", disk_name);
+	} else if (ioctl(dk.fd, DKIOCGGEOM, &geom) == -1) {
 		if (errno == ENOTSUP) {
 			/*
 			 * DKIOCGGEOM is not supported on EFI/GPT disks.
 			 * Use efi_alloc_and_read to verify we have EFI/GPT.
 			 */
 			struct dk_gpt	*efip;
-			if (efi_alloc_and_read(fd, &efip) >= 0) {
+			if (efi_alloc_and_read(dk.fd, &efip) >= 0) {
 
 				/* EFI label */
 
@@ -1528,20 +2442,89 @@ idm_create_disk_label(nvlist_t *attrs)
 			idm_debug_print(LS_DBGLVL_INFO, "Disk %s is "
 			    "unlabeled\n", disk_name);
 		}
-
-		(void) close(fd);
 	} else {
 		idm_debug_print(LS_DBGLVL_INFO, "Disk %s has "
 		    "a SMI label\n", disk_name);
 
 		/* disk is already labeled */
+		(void) close(dk.fd);
 		return (IDM_E_SUCCESS);
 
 	}
 
+	/*
+	 * Build default label covering the labeled area - the whole disk
+	 * on sparc, Solaris2 partition on x86. Fdisk partition table of
+	 * devices is read from the whole disk device. If the area can't
+	 * be determined, devices are labeled by format(1M).
+	 */
+
+	if (dk.image) {
+		if (idm_label_sector(&dk, &sector, &geom) != 0) {
+			(void) close(dk.fd);
+			return (IDM_E_DISK_LABEL_FAILED);
+		}
+
+		ret = 0;
+	} else {
+#ifndef sparc
+		idm_disk_t	pdk;
+
+		if ((ret = idm_disk_open(disk_name, "p0", O_RDONLY,
+		    &pdk)) == 0) {
+			ret = idm_label_sector(&pdk, &sector, &geom);
+			(void) close(pdk.fd);
+		}
+#else
+		ret = idm_label_sector(&dk, &sector, &geom);
+#endif
+	}
+
+	if (ret == 0) {
+		idm_label_default(&geom, &extvtoc);
+
+		idm_debug_print(LS_DBGLVL_INFO, "SMI label for %s: %s\n",
+		    disk_name, extvtoc.v_asciilabel);
+
+		idm_display_vtoc(LS_DBGLVL_INFO, &extvtoc);
+
+		/* if invoked in dry run mode, no changes done to the target */
+
+		if (idm_dryrun_mode_fl) {
+			idm_debug_print(LS_DBGLVL_INFO, "Running in dry run "
+			    "mode, %s label won't be replaced\n",
+			    EFI ? "EFI" : "missing");
+
+			(void) close(dk.fd);
+			return (IDM_E_SUCCESS);
+		}
+
+		if ((ret = idm_label_write(&dk, &extvtoc, &geom)) == 0) {
+			(void) close(dk.fd);
+			return (IDM_E_SUCCESS);
+		}
+	}
+
+	(void) close(dk.fd);
+
+	if (dk.image) {
+		idm_debug_print(LS_DBGLVL_ERR, "Couldn't label disk image "
+		    "%s\n", disk_name);
+
+		return (IDM_E_DISK_LABEL_FAILED);
+	}
+
+	if (idm_dryrun_mode_fl) {
+		idm_debug_print(LS_DBGLVL_INFO, "Running in dry run mode, "
+		    "disk %s won't be labeled by format(1M)\n", disk_name);
+
+		return (IDM_E_SUCCESS);
+	}
+
 	/* Label the disk using format */
-	idm_debug_print(LS_DBGLVL_INFO, "format: "
-	    "Creating SMI label for %s\n", disk_name);
+	idm_debug_print(LS_DBGLVL_WARN, "format: "
+	    "Disk driver refused the label, creating SMI label for %s\n",
+	    disk_name);
 
 	if (EFI) {
 
@@ -1573,6 +2556,9 @@ idm_create_disk_label(nvlist_t *attrs)
  * Function:	idm_create_vtoc
  * Description:	Creates VTOC structure on existing Solaris2 partition
  *		according to set of attributes provided as nv list.
+ *		Disk may be a device or file backed disk image, which
+ *		is labeled directly. In dry run mode, differences
+ *		against current VTOC are reported.
  *
  * Scope:	public
  * Parameters:	attrs - set of attribtues describing the target
@@ -1587,11 +2573,10 @@ idm_create_vtoc(nvlist_t *attrs)
 {
 	char		cmd[IDM_MAXCMDLEN];
 	int		ret;
-	struct extvtoc	extvtoc;
+	struct extvtoc	extvtoc, orig_extvtoc;
 	struct dk_geom	geom;
-	char		device[MAXPATHLEN];
+	idm_disk_t	dk;
 	char		*disk_name;
-	int		fd;
 	int		i;
 	uint16_t	slice_num;
 	uint16_t	*slice_parts, *slice_tags;
@@ -1765,27 +2750,33 @@ idm_create_vtoc(nvlist_t *attrs)
 	idm_debug_print(LS_DBGLVL_INFO, "Creating %d slices on disk %s...\n",
 	    slice_num, disk_name);
 
-	(void) snprintf(device, MAXPATHLEN, "/dev/rdsk/%ss2", disk_name);
-
 	/* open device */
 
-	if ((fd = open(device, O_RDWR | O_NDELAY)) < 0) {
+	if (idm_disk_open(disk_name, "s2", idm_dryrun_mode_fl ? O_RDONLY :
+	    O_RDWR, &dk) != 0) {
 		idm_debug_print(LS_DBGLVL_ERR, "Can't create VTOC, "
-		    "couldn't open %s device\n", device);
+		    "couldn't open %s device\n", dk.path);
 
 		return (IDM_E_VTOC_FAILED);
 	}
 
 	/*
-	 * Display disk geometry information
+	 * Read original VTOC from target together with geometry.
+	 * Slices are recreated according to the attributes provided,
+	 * rest of the information is preserved.
 	 */
 
-	if (ioctl(fd, DKIOCGGEOM, &geom) != 0) {
-		idm_debug_print(LS_DBGLVL_ERR, "Couldn't obtain "
-		    "information about geometry of %s device\n", device);
+	if (idm_label_read(&dk, &extvtoc, &geom) != 0) {
+		idm_debug_print(LS_DBGLVL_ERR, "vtoc: Couldn't read "
+		    "geometry and existing VTOC from %s device\n", dk.path);
+
+		(void) close(dk.fd);
 
 		return (IDM_E_VTOC_FAILED);
 	} else {
+		/*
+		 * Display disk geometry information
+		 */
 		/* calculate number of sectors per cylinder */
 
 		nsecs = (uint32_t)geom.dkg_nhead * geom.dkg_nsect;
@@ -1799,20 +2790,7 @@ idm_create_vtoc(nvlist_t *attrs)
 		    (int)geom.dkg_bcyl, (int)geom.dkg_pcyl);
 	}
 
-	/*
-	 * Read original VTOC from target.
-	 * Slices are recreated according to the attributes provided,
-	 * rest of the information is preserved.
-	 */
-
-	if (read_extvtoc(fd, &extvtoc) < 0) {
-		idm_debug_print(LS_DBGLVL_ERR, "vtoc: Couldn't read "
-		    "existing VTOC from %s device\n", device);
-
-		(void) close(fd);
-
-		return (IDM_E_VTOC_FAILED);
-	}
+	orig_extvtoc = extvtoc;
 
 	idm_debug_print(LS_DBGLVL_INFO, "---------------------------------\n");
 	idm_debug_print(LS_DBGLVL_INFO, "  Original VTOC configuration    \n");
@@ -1956,6 +2934,7 @@ idm_create_vtoc(nvlist_t *attrs)
 	if (idm_adjust_vtoc(&extvtoc, nsecs) != IDM_E_SUCCESS) {
 		idm_debug_print(LS_DBGLVL_ERR, "Adjusting VTOC failed\n");
 
+		(void) close(dk.fd);
 		return (IDM_E_VTOC_FAILED);
 	}
 
@@ -1974,6 +2953,7 @@ idm_create_vtoc(nvlist_t *attrs)
 	if (idm_check_vtoc(&extvtoc) != IDM_E_SUCCESS) {
 		idm_debug_print(LS_DBGLVL_ERR, "Checking VTOC failed\n");
 
+		(void) close(dk.fd);
 		return (IDM_E_VTOC_FAILED);
 	}
 
@@ -1982,23 +2962,28 @@ idm_create_vtoc(nvlist_t *attrs)
 	/* if invoked in dry run mode, no changes done to the target */
 
 	if (idm_dryrun_mode_fl) {
+		idm_debug_print(LS_DBGLVL_INFO, "Running in dry run mode, "
+		    "VTOC of %s won't be changed:\n", dk.path);
+
+		idm_display_vtoc_diff(LS_DBGLVL_INFO, &orig_extvtoc, &extvtoc);
+
 		(void) sleep(1);
 
-		(void) close(fd);
+		(void) close(dk.fd);
 		return (IDM_E_SUCCESS);
 	}
 
-	if (write_extvtoc(fd, &extvtoc) < 0) {
+	if (idm_label_write(&dk, &extvtoc, &geom) != 0) {
 		idm_debug_print(LS_DBGLVL_ERR, "Couldn't write "
-		    "VTOC to %s device, write_extvtoc() failed\n", device);
-		(void) close(fd);
+		    "VTOC to %s device\n", dk.path);
+		(void) close(dk.fd);
 
 		return (IDM_E_VTOC_FAILED);
 	}
 
-	(void) close(fd);
+	(void) close(dk.fd);
 
-	if (create_swap_slice) {
+	if (create_swap_slice && !dk.image) {
 		idm_debug_print(LS_DBGLVL_INFO, "Adding /dev/dsk/%ss1 "
 		    "as a swap device...\n", disk_name);
 
@@ -33,6 +33,8 @@
  *		data structures, constants, and function prototypes.
  */
 
+#include <sys/param.h>
+#include <sys/dkio.h>
 #include "ti_api.h"
 #include "ls_api.h"
 
@@ -74,6 +76,15 @@ typedef struct idm_part_table_t {
 	uint64_t	*size;	/* numbers of sectors */
 } idm_part_table_t;
 
+/* disk being partitioned - raw device or file backed disk image */
+typedef struct idm_disk_t {
+	int		fd;
+	boolean_t	image;		/* regular file, not a device */
+	char		path[MAXPATHLEN];
+	diskaddr_t	capacity;	/* number of sectors */
+	struct dk_geom	geom;		/* physical geometry */
+} idm_disk_t;
+
 
 /* return codes */
 
@@ -120,6 +131,19 @@ typedef enum idm_errno_t {
 /* file for storing original partition table info */
 #define	IDM_ORIG_PARTITION_TABLE_FILE	"/tmp/fdisk_ptable.orig"
 
+/* bootstrap installed into master boot record which doesn't have one */
+#define	IDM_MBOOT_FILE		"/usr/lib/fs/ufs/mboot"
+
+/* geometry assumed for disk images, the same fdisk(1M) uses for LBA */
+#define	IDM_IMAGE_NHEAD		255
+#define	IDM_IMAGE_NSECT		63
+
+/* alternate cylinders reserved by SMI label */
+#define	IDM_DEFAULT_ACYL	2
+
+/* highest cylinder which can be expressed in CHS fields of MBR */
+#define	IDM_MAX_CHS_CYL		1023
+
 /* macros */
 
 /*
@@ -145,6 +169,7 @@ typedef enum idm_errno_t {
 /* function prototypes */
 idm_errno_t idm_fdisk_create_part_table(nvlist_t *attrs);
 idm_errno_t idm_fdisk_whole_disk(char *disk_name);
+idm_errno_t idm_create_disk_label(nvlist_t *attrs);
 idm_errno_t idm_create_vtoc(nvlist_t *attrs);
 idm_errno_t idm_unmount_all(char *disk_name);
 idm_errno_t idm_release_swap(char *disk_name);
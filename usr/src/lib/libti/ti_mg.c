@@ -25,7 +25,10 @@
 
 #include <assert.h>
 #include <libnvpair.h>
+#include <pthread.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <strings.h>
 #include <unistd.h>
 #include <sys/param.h>
 #include <sys/types.h>
@@ -64,6 +67,50 @@ static int	ti_milestone_percentage[TI_MILESTONE_LAST] = {
 	100	/* TI_MILESTONE_ZFS_FS */
 };
 
+/* maximum number of steps layout is split into */
+#define	TI_LAYOUT_MAX_STEPS	64
+
+#define	TI_TYPE_BIT(type)	(1 << (type))
+
+#define	TI_TYPES_DISK		(TI_TYPE_BIT(TI_TARGET_TYPE_FDISK) | \
+				TI_TYPE_BIT(TI_TARGET_TYPE_DISK_LABEL) | \
+				TI_TYPE_BIT(TI_TARGET_TYPE_VTOC))
+
+/* TI modules instantiating targets, see ti_layout_module[] */
+typedef enum {
+	TI_MODULE_DISK,
+	TI_MODULE_ZFS,
+	TI_MODULE_BE,
+	TI_MODULE_DC,
+	TI_MODULE_LAST
+} ti_module_t;
+
+typedef enum {
+	TI_STEP_PENDING,
+	TI_STEP_RUNNING,
+	TI_STEP_DONE
+} ti_step_state_t;
+
+/* one step of layout - target or batch of targets of the same type */
+typedef struct ti_layout_step {
+	uint32_t		type;		/* target type */
+	nvlist_t		*attrs;		/* target attributes */
+	uint64_t		deps;		/* steps to be done before */
+	ti_step_state_t		state;
+	ti_errno_t		status;		/* valid when done */
+	pthread_t		tid;
+	boolean_t		joinable;	/* has its own thread */
+	struct ti_layout	*layout;
+} ti_layout_step_t;
+
+typedef struct ti_layout {
+	pthread_mutex_t		lock;		/* protects steps and busy */
+	pthread_cond_t		cv;		/* signaled when step is done */
+	ti_layout_step_t	steps[TI_LAYOUT_MAX_STEPS];
+	int			nsteps;
+	boolean_t		busy[TI_MODULE_LAST];
+} ti_layout_t;
+
 /* forward private function declarations */
 
 /* create fdisk partition table */
@@ -90,6 +137,9 @@ static ti_errno_t imm_create_zfs_fs_target(nvlist_t *attrs);
 /* create ZFS volumes */
 static ti_errno_t imm_create_zfs_vol_target(nvlist_t *attrs);
 
+/* create set of targets */
+static ti_errno_t imm_create_layout_target(nvlist_t *attrs);
+
 /* private variables */
 
 /* target methods - array indices defined in ti_api.h */
@@ -102,7 +152,8 @@ static ti_create_target_method_t ti_create_target_method_table[] = {
 	imm_create_zfs_vol_target,	/* TI_TARGET_TYPE_ZFS_VOLUME */
 	imm_create_be_target, 		/* TI_TARGET_TYPE_BE */
 	ti_create_directory,		/* TI_TARGET_TYPE_DC_UFS */
-	ti_create_ramdisk 		/* TI_TARGET_TYPE_DC_RAMDISK */
+	ti_create_ramdisk, 		/* TI_TARGET_TYPE_DC_RAMDISK */
+	imm_create_layout_target	/* TI_TARGET_TYPE_LAYOUT */
 };
 
 static ti_release_target_method_t ti_release_target_method_table[] = {
@@ -114,7 +165,40 @@ static ti_release_target_method_t ti_release_target_method_table[] = {
 	NULL,		/* TI_TARGET_TYPE_ZFS_VOLUME */
 	NULL, 		/* TI_TARGET_TYPE_BE */
 	NULL,		/* TI_TARGET_TYPE_DC_UFS */
-	ti_release_ramdisk 		/* TI_TARGET_TYPE_DC_RAMDISK */
+	ti_release_ramdisk, 		/* TI_TARGET_TYPE_DC_RAMDISK */
+	NULL		/* TI_TARGET_TYPE_LAYOUT */
+};
+
+/* module instantiating target of given type */
+static ti_module_t ti_layout_module[] = {
+	TI_MODULE_DISK,		/* TI_TARGET_TYPE_FDISK */
+	TI_MODULE_DISK,		/* TI_TARGET_TYPE_DISK_LABEL */
+	TI_MODULE_DISK,		/* TI_TARGET_TYPE_VTOC */
+	TI_MODULE_ZFS,		/* TI_TARGET_TYPE_ZFS_RPOOL */
+	TI_MODULE_ZFS,		/* TI_TARGET_TYPE_ZFS_FS */
+	TI_MODULE_ZFS,		/* TI_TARGET_TYPE_ZFS_VOLUME */
+	TI_MODULE_BE,		/* TI_TARGET_TYPE_BE */
+	TI_MODULE_DC,		/* TI_TARGET_TYPE_DC_UFS */
+	TI_MODULE_DC		/* TI_TARGET_TYPE_DC_RAMDISK */
+};
+
+/*
+ * target types which have to be created before target of given type.
+ * ZFS file systems may be nested in BE datasets, ZFS volumes and BE
+ * don't depend on each other.
+ */
+static uint32_t ti_layout_after[] = {
+	0,						/* FDISK */
+	TI_TYPE_BIT(TI_TARGET_TYPE_FDISK),		/* DISK_LABEL */
+	TI_TYPE_BIT(TI_TARGET_TYPE_FDISK) |
+	    TI_TYPE_BIT(TI_TARGET_TYPE_DISK_LABEL),	/* VTOC */
+	TI_TYPES_DISK,					/* ZFS_RPOOL */
+	TI_TYPES_DISK | TI_TYPE_BIT(TI_TARGET_TYPE_ZFS_RPOOL) |
+	    TI_TYPE_BIT(TI_TARGET_TYPE_BE),		/* ZFS_FS */
+	TI_TYPES_DISK | TI_TYPE_BIT(TI_TARGET_TYPE_ZFS_RPOOL),	/* ZFS_VOLUME */
+	TI_TYPES_DISK | TI_TYPE_BIT(TI_TARGET_TYPE_ZFS_RPOOL),	/* BE */
+	0,						/* DC_UFS */
+	0						/* DC_RAMDISK */
 };
 
 static ti_target_exists_method_t ti_target_exists_method_table[] = {
@@ -139,11 +223,9 @@ static void
 imm_debug_print(ls_dbglvl_t dbg_lvl, const char *fmt, ...)
 {
 	va_list	ap;
-	char	buf[MAXPATHLEN + 1];
 
 	va_start(ap, fmt);
-	(void) vsprintf(buf, fmt, ap);
-	(void) ls_write_dbg_message("TIMM", dbg_lvl, buf);
+	ls_write_dbg_vmessage("TIMM", dbg_lvl, fmt, ap);
 	va_end(ap);
 }
 
@@ -416,6 +498,369 @@ imm_create_be_target(nvlist_t *attrs)
 }
 
 
+/*
+ * Function:	imm_layout_batch
+ * Description:	Merges two ZFS file system or two ZFS volume targets
+ *		in the same pool into one target, so that they are
+ *		created by one call to ZFS module. Targets without
+ *		properties or volume types get empty properties and
+ *		generic type respectively.
+ *
+ * Scope:	private
+ * Parameters:	type - TI_TARGET_TYPE_ZFS_FS or TI_TARGET_TYPE_ZFS_VOLUME
+ *		a - attributes of the first target
+ *		b - attributes of the second target
+ *
+ * Return:	merged attributes, NULL if targets can't be merged
+ */
+
+static nvlist_t *
+imm_layout_batch(uint32_t type, nvlist_t *a, nvlist_t *b)
+{
+	char		*pool_attr, *num_attr, *names_attr;
+	char		*apool, *bpool;
+	char		**an, **bn, **names = NULL;
+	uint32_t	*asz, *bsz, *sizes = NULL;
+	uint16_t	*at = NULL, *bt = NULL, *types = NULL;
+	nvlist_t	**ap = NULL, **bp = NULL, **props = NULL;
+	nvlist_t	*empty = NULL, *m = NULL;
+	uint_t		na, nb, n, i, nelem;
+	boolean_t	ok = B_FALSE;
+
+	if (type == TI_TARGET_TYPE_ZFS_FS) {
+		pool_attr = TI_ATTR_ZFS_FS_POOL_NAME;
+		num_attr = TI_ATTR_ZFS_FS_NUM;
+		names_attr = TI_ATTR_ZFS_FS_NAMES;
+	} else {
+		pool_attr = TI_ATTR_ZFS_VOL_POOL_NAME;
+		num_attr = TI_ATTR_ZFS_VOL_NUM;
+		names_attr = TI_ATTR_ZFS_VOL_NAMES;
+	}
+
+	if (nvlist_lookup_string(a, pool_attr, &apool) != 0 ||
+	    nvlist_lookup_string(b, pool_attr, &bpool) != 0 ||
+	    strcmp(apool, bpool) != 0 ||
+	    nvlist_lookup_string_array(a, names_attr, &an, &na) != 0 ||
+	    nvlist_lookup_string_array(b, names_attr, &bn, &nb) != 0)
+		return (NULL);
+
+	if (type == TI_TARGET_TYPE_ZFS_VOLUME &&
+	    (nvlist_lookup_uint32_array(a, TI_ATTR_ZFS_VOL_MB_SIZES, &asz,
+	    &nelem) != 0 || nelem != na ||
+	    nvlist_lookup_uint32_array(b, TI_ATTR_ZFS_VOL_MB_SIZES, &bsz,
+	    &nelem) != 0 || nelem != nb ||
+	    (nvlist_lookup_uint16_array(a, TI_ATTR_ZFS_VOL_TYPES, &at,
+	    &nelem) == 0 && nelem != na) ||
+	    (nvlist_lookup_uint16_array(b, TI_ATTR_ZFS_VOL_TYPES, &bt,
+	    &nelem) == 0 && nelem != nb)))
+		return (NULL);
+
+	if ((nvlist_lookup_nvlist_array(a, TI_ATTR_ZFS_PROPERTIES, &ap,
+	    &nelem) == 0 && nelem != na) ||
+	    (nvlist_lookup_nvlist_array(b, TI_ATTR_ZFS_PROPERTIES, &bp,
+	    &nelem) == 0 && nelem != nb))
+		return (NULL);
+
+	n = na + nb;
+
+	if ((names = calloc(n, sizeof (char *))) == NULL ||
+	    (sizes = calloc(n, sizeof (uint32_t))) == NULL ||
+	    (types = calloc(n, sizeof (uint16_t))) == NULL ||
+	    (props = calloc(n, sizeof (nvlist_t *))) == NULL ||
+	    nvlist_alloc(&empty, TI_TARGET_NVLIST_TYPE, 0) != 0 ||
+	    nvlist_alloc(&m, TI_TARGET_NVLIST_TYPE, 0) != 0)
+		goto done;
+
+	for (i = 0; i < n; i++) {
+		if (i < na) {
+			names[i] = an[i];
+			props[i] = ap != NULL ? ap[i] : empty;
+		} else {
+			names[i] = bn[i - na];
+			props[i] = bp != NULL ? bp[i - na] : empty;
+		}
+
+		if (type != TI_TARGET_TYPE_ZFS_VOLUME)
+			continue;
+
+		if (i < na) {
+			sizes[i] = asz[i];
+			types[i] = at != NULL ? at[i] : TI_ZFS_VOL_TYPE_GENERIC;
+		} else {
+			sizes[i] = bsz[i - na];
+			types[i] = bt != NULL ? bt[i - na] :
+			    TI_ZFS_VOL_TYPE_GENERIC;
+		}
+	}
+
+	if (nvlist_add_uint32(m, TI_ATTR_TARGET_TYPE, type) != 0 ||
+	    nvlist_add_string(m, pool_attr, apool) != 0 ||
+	    nvlist_add_uint16(m, num_attr, n) != 0 ||
+	    nvlist_add_string_array(m, names_attr, names, n) != 0 ||
+	    ((ap != NULL || bp != NULL) &&
+	    nvlist_add_nvlist_array(m, TI_ATTR_ZFS_PROPERTIES, props,
+	    n) != 0))
+		goto done;
+
+	if (type == TI_TARGET_TYPE_ZFS_VOLUME &&
+	    (nvlist_add_uint32_array(m, TI_ATTR_ZFS_VOL_MB_SIZES, sizes,
+	    n) != 0 ||
+	    ((at != NULL || bt != NULL) &&
+	    nvlist_add_uint16_array(m, TI_ATTR_ZFS_VOL_TYPES, types,
+	    n) != 0)))
+		goto done;
+
+	ok = B_TRUE;
+done:
+	free(names);
+	free(sizes);
+	free(types);
+	free(props);
+	nvlist_free(empty);
+
+	if (!ok) {
+		nvlist_free(m);
+		return (NULL);
+	}
+
+	return (m);
+}
+
+/*
+ * Function:	imm_layout_worker
+ * Description:	Creates one layout target and wakes up layout scheduler
+ *
+ * Scope:	private
+ * Parameters:	arg - layout step
+ *
+ * Return:	NULL
+ */
+
+static void *
+imm_layout_worker(void *arg)
+{
+	ti_layout_step_t	*step = arg;
+	ti_layout_t		*layout = step->layout;
+	ti_errno_t		status;
+	hrtime_t		start;
+
+	start = gethrtime();
+	status = ti_create_target_method_table[step->type](step->attrs);
+
+	imm_debug_print(LS_DBGLVL_INFO, "Layout step %d (target type %u) "
+	    "finished in %lld ms, status %d\n", (int)(step - layout->steps),
+	    step->type, (gethrtime() - start) / 1000000, status);
+
+	(void) pthread_mutex_lock(&layout->lock);
+	step->status = status;
+	step->state = TI_STEP_DONE;
+	layout->busy[ti_layout_module[step->type]] = B_FALSE;
+	(void) pthread_cond_signal(&layout->cv);
+	(void) pthread_mutex_unlock(&layout->lock);
+
+	return (NULL);
+}
+
+/*
+ * Function:	imm_create_layout_target
+ * Description:	Creates set of targets as one layout.
+ *
+ *		[1] ZFS file system and ZFS volume targets in the same pool
+ *		    are batched into one target.
+ *		[2] Dependencies between targets are derived from their
+ *		    types (ti_layout_after[]), targets of the same type are
+ *		    created in order given.
+ *		[3] Every target is created in its own thread as soon as
+ *		    targets it depends on are created. Targets instantiated
+ *		    by the same TI module are never created concurrently,
+ *		    so for instance swap and dump volumes are created while
+ *		    BE is being created.
+ *
+ *		If any target fails, no more targets are started and
+ *		type of the failed target is set in attribute
+ *		TI_ATTR_LAYOUT_FAILED_TYPE.
+ *
+ * Scope:	private
+ * Parameters:	attrs - set of attributes describing the layout
+ *
+ * Return:	TI_E_SUCCESS - all targets created successfully
+ *		TI_E_INVALID_LAYOUT_ATTR - invalid set of attributes
+ *		return code of the first failed target otherwise
+ */
+
+static ti_errno_t
+imm_create_layout_target(nvlist_t *attrs)
+{
+	ti_layout_t		layout;
+	ti_layout_step_t	*step;
+	nvlist_t		**targets;
+	nvlist_t		*batch;
+	uint_t			ntargets;
+	uint32_t		type;
+	uint64_t		done;
+	int			i, j, running, started, failed;
+	ti_errno_t		ret = TI_E_SUCCESS;
+
+	if (nvlist_lookup_nvlist_array(attrs, TI_ATTR_LAYOUT_TARGETS,
+	    &targets, &ntargets) != 0) {
+		imm_debug_print(LS_DBGLVL_ERR, "TI_ATTR_LAYOUT_TARGETS "
+		    "attribute not provided, but required\n");
+
+		return (TI_E_INVALID_LAYOUT_ATTR);
+	}
+
+	bzero(&layout, sizeof (layout));
+
+	/* build steps, batching ZFS file systems and volumes */
+
+	for (i = 0; i < ntargets; i++) {
+		if (nvlist_lookup_uint32(targets[i], TI_ATTR_TARGET_TYPE,
+		    &type) != 0 || type >= TI_TARGET_TYPE_LAYOUT) {
+			imm_debug_print(LS_DBGLVL_ERR, "Layout target %d "
+			    "has invalid type\n", i);
+
+			ret = TI_E_INVALID_LAYOUT_ATTR;
+			goto done;
+		}
+
+		batch = NULL;
+		if (type == TI_TARGET_TYPE_ZFS_FS ||
+		    type == TI_TARGET_TYPE_ZFS_VOLUME) {
+			for (j = 0; j < layout.nsteps; j++) {
+				step = &layout.steps[j];
+				if (step->type == type && (batch =
+				    imm_layout_batch(type, step->attrs,
+				    targets[i])) != NULL)
+					break;
+			}
+		}
+
+		if (batch != NULL) {
+			imm_debug_print(LS_DBGLVL_INFO, "Layout target %d "
+			    "batched into step %d\n", i, j);
+
+			nvlist_free(step->attrs);
+			step->attrs = batch;
+			continue;
+		}
+
+		if (layout.nsteps == TI_LAYOUT_MAX_STEPS) {
+			imm_debug_print(LS_DBGLVL_ERR, "Too many layout "
+			    "targets, at most %d supported\n",
+			    TI_LAYOUT_MAX_STEPS);
+
+			ret = TI_E_INVALID_LAYOUT_ATTR;
+			goto done;
+		}
+
+		step = &layout.steps[layout.nsteps];
+		if (nvlist_dup(targets[i], &step->attrs, 0) != 0) {
+			ret = TI_E_INVALID_LAYOUT_ATTR;
+			goto done;
+		}
+		step->type = type;
+		step->layout = &layout;
+		layout.nsteps++;
+	}
+
+	/* dependencies */
+
+	for (i = 0; i < layout.nsteps; i++) {
+		step = &layout.steps[i];
+		for (j = 0; j < layout.nsteps; j++) {
+			type = layout.steps[j].type;
+			if ((ti_layout_after[step->type] & TI_TYPE_BIT(type)) ||
+			    (type == step->type && j < i))
+				step->deps |= 1ULL << j;
+		}
+
+		imm_debug_print(LS_DBGLVL_INFO, "Layout step %d: target "
+		    "type %u, waits for steps 0x%llx\n", i, step->type,
+		    step->deps);
+	}
+
+	/* schedule */
+
+	(void) pthread_mutex_init(&layout.lock, NULL);
+	(void) pthread_cond_init(&layout.cv, NULL);
+	(void) pthread_mutex_lock(&layout.lock);
+
+	for (;;) {
+		done = 0;
+		running = started = 0;
+		failed = -1;
+
+		for (i = 0; i < layout.nsteps; i++) {
+			step = &layout.steps[i];
+			if (step->state == TI_STEP_RUNNING)
+				running++;
+			else if (step->state == TI_STEP_DONE &&
+			    step->status == TI_E_SUCCESS)
+				done |= 1ULL << i;
+			else if (step->state == TI_STEP_DONE && failed == -1)
+				failed = i;
+		}
+
+		for (i = 0; failed == -1 && i < layout.nsteps; i++) {
+			step = &layout.steps[i];
+			if (step->state != TI_STEP_PENDING ||
+			    (step->deps & ~done) != 0 ||
+			    layout.busy[ti_layout_module[step->type]])
+				continue;
+
+			step->state = TI_STEP_RUNNING;
+			layout.busy[ti_layout_module[step->type]] = B_TRUE;
+			started++;
+
+			if (pthread_create(&step->tid, NULL, imm_layout_worker,
+			    step) == 0) {
+				step->joinable = B_TRUE;
+				running++;
+				continue;
+			}
+
+			/* no thread available, create target right now */
+			imm_debug_print(LS_DBGLVL_WARN, "Couldn't create "
+			    "thread for layout step %d\n", i);
+
+			(void) pthread_mutex_unlock(&layout.lock);
+			(void) imm_layout_worker(step);
+			(void) pthread_mutex_lock(&layout.lock);
+		}
+
+		if (running != 0)
+			(void) pthread_cond_wait(&layout.cv, &layout.lock);
+		else if (started == 0)
+			break;
+	}
+
+	(void) pthread_mutex_unlock(&layout.lock);
+
+	for (i = 0; i < layout.nsteps; i++)
+		if (layout.steps[i].joinable)
+			(void) pthread_join(layout.steps[i].tid, NULL);
+
+	(void) pthread_cond_destroy(&layout.cv);
+	(void) pthread_mutex_destroy(&layout.lock);
+
+	if (failed != -1) {
+		step = &layout.steps[failed];
+		imm_debug_print(LS_DBGLVL_ERR, "Layout step %d (target type "
+		    "%u) failed\n", failed, step->type);
+
+		(void) nvlist_add_uint32(attrs, TI_ATTR_LAYOUT_FAILED_TYPE,
+		    step->type);
+		ret = step->status;
+	}
+
+done:
+	for (i = 0; i < layout.nsteps; i++)
+		nvlist_free(layout.steps[i].attrs);
+
+	return (ret);
+}
+
+
 /*
  * Function:	ti_report_progress
  * Description:	Report progress by calling callback function. Progress
@@ -625,6 +1070,8 @@ ti_create_implicit_target(nvlist_t *attrs, ti_cbf_t cbf)
 {
 	char		*disk_name;
 	uint16_t	ms_num;
+	hrtime_t	start;
+	boolean_t	ok;
 
 	/*
 	 * Decide, if there are any action items for Disk Module.
@@ -655,7 +1102,11 @@ ti_create_implicit_target(nvlist_t *attrs, ti_cbf_t cbf)
 
 		/* instantiate fdisk target */
 
-		if (imm_create_fdisk_target(attrs) != TI_E_SUCCESS) {
+		start = ls_span_begin();
+		ok = (imm_create_fdisk_target(attrs) == TI_E_SUCCESS);
+		ls_span_end(start, "ti", "fdisk", disk_name);
+
+		if (!ok) {
 			imm_debug_print(LS_DBGLVL_ERR, "Couldn't create "
 			    "fdisk target\n");
 
@@ -680,7 +1131,11 @@ ti_create_implicit_target(nvlist_t *attrs, ti_cbf_t cbf)
 		 * to be created.
 		 */
 
-		if (idm_create_vtoc(attrs) != IDM_E_SUCCESS) {
+		start = ls_span_begin();
+		ok = (idm_create_vtoc(attrs) == IDM_E_SUCCESS);
+		ls_span_end(start, "ti", "vtoc", disk_name);
+
+		if (!ok) {
 			imm_debug_print(LS_DBGLVL_ERR, "Creating VTOC "
 			    "structure on disk %s failed\n", disk_name);
 
@@ -707,7 +1162,11 @@ ti_create_implicit_target(nvlist_t *attrs, ti_cbf_t cbf)
 	 * to be created.
 	 */
 
-	if (zfm_create_pool(attrs) != ZFM_E_SUCCESS) {
+	start = ls_span_begin();
+	ok = (zfm_create_pool(attrs) == ZFM_E_SUCCESS);
+	ls_span_end(start, "ti", "zfs_rpool", NULL);
+
+	if (!ok) {
 		imm_debug_print(LS_DBGLVL_ERR, "Creating ZFS root pool "
 		    "failed\n");
 
@@ -730,7 +1189,11 @@ ti_create_implicit_target(nvlist_t *attrs, ti_cbf_t cbf)
 	 * to be created.
 	 */
 
-	if (zfm_create_fs(attrs) != ZFM_E_SUCCESS) {
+	start = ls_span_begin();
+	ok = (zfm_create_fs(attrs) == ZFM_E_SUCCESS);
+	ls_span_end(start, "ti", "zfs_fs", NULL);
+
+	if (!ok) {
 		imm_debug_print(LS_DBGLVL_ERR, "Creating ZFS filesystems "
 		    "failed\n");
 
@@ -747,7 +1210,11 @@ ti_create_implicit_target(nvlist_t *attrs, ti_cbf_t cbf)
 	 * to be created.
 	 */
 
-	if (zfm_create_volumes(attrs) != ZFM_E_SUCCESS) {
+	start = ls_span_begin();
+	ok = (zfm_create_volumes(attrs) == ZFM_E_SUCCESS);
+	ls_span_end(start, "ti", "zfs_volumes", NULL);
+
+	if (!ok) {
 		imm_debug_print(LS_DBGLVL_ERR, "Creating ZFS volumes "
 		    "failed\n");
 
@@ -796,6 +1263,7 @@ ti_create_target(nvlist_t *attrs, ti_cbf_t cbf)
 	uint32_t	target_type;
 	char		*target_name;
 	ti_errno_t	ret;
+	hrtime_t	start;
 
 	/* sanity check */
 	assert(attrs != NULL);
@@ -812,7 +1280,11 @@ ti_create_target(nvlist_t *attrs, ti_cbf_t cbf)
 		imm_debug_print(LS_DBGLVL_INFO, "Target type not specified - "
 		    "will be determined implicitly\n");
 
-		return (ti_create_implicit_target(attrs, cbf));
+		start = ls_span_begin();
+		ret = ti_create_implicit_target(attrs, cbf);
+		ls_span_end(start, "ti", "ti_create_target", "IMPLICIT");
+
+		return (ret);
 	}
 
 
@@ -853,6 +1325,10 @@ ti_create_target(nvlist_t *attrs, ti_cbf_t cbf)
 		target_name = "DC_RAMDISK";
 		break;
 
+	case TI_TARGET_TYPE_LAYOUT:
+		target_name = "LAYOUT";
+		break;
+
 	default:
 		target_name = "UNKNOWN";
 		break;
@@ -887,7 +1363,9 @@ ti_create_target(nvlist_t *attrs, ti_cbf_t cbf)
 
 	/* create target */
 
+	start = ls_span_begin();
 	ret = ti_create_target_method_table[target_type](attrs);
+	ls_span_end(start, "ti", "ti_create_target", target_name);
 
 	return (ret);
 }
@@ -1141,3 +1619,21 @@ ti_dryrun_mode(void)
 	ibem_dryrun_mode();
 	dcm_dryrun_mode();
 }
+
+
+/*
+ * Function:	ti_zfs_backend
+ * Description:	Selects mechanism used for creating and releasing ZFS pools,
+ *		file systems and volumes. ZFS commands are used by default.
+ *
+ * Scope:	public
+ * Parameters:	backend - TI_ZFS_BACKEND_CMD or TI_ZFS_BACKEND_LIBZFS
+ *
+ * Return:
+ */
+
+void
+ti_zfs_backend(ti_zfs_backend_t backend)
+{
+	zfm_set_backend(backend);
+}
@@ -27,6 +27,8 @@
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <libgen.h>
+#include <libzfs.h>
 #include <stdarg.h>
 #include <strings.h>
 #include <wait.h>
@@ -56,12 +58,36 @@
 /* if set to B_TRUE, dry run mode is invoked, no changes done to the target */
 static boolean_t	zfm_dryrun_mode_fl = B_FALSE;
 
+/* mechanism used for ZFS operations, see zfm_set_backend() */
+static ti_zfs_backend_t	zfm_backend = TI_ZFS_BACKEND_CMD;
+
+/*
+ * zfm_g_zfs and zfm_exec_cnt are not protected by a lock. The ZFS module
+ * is never entered by two threads at once - imm_create_layout_target()
+ * runs at most one step of each TI module at a time.
+ */
+
+/* libzfs handle, opened when libzfs backend is used for the first time */
+static libzfs_handle_t	*zfm_g_zfs = NULL;
+
+/* number of processes spawned, reported by zfm_exec_count() */
+static uint_t		zfm_exec_cnt = 0;
+
 /* declarations of private functions */
 static zfm_errno_t zfm_add_volume_to_swap_pool(char *zpool_name,
     char *volume_name);
 static zfm_errno_t zfm_set_volume_as_dump(char *zpool_name, char *volume_name);
 static zfm_errno_t zfm_set_dataset_properties(char *zpool_name,
     char *dataset_name, nvlist_t *props);
+static libzfs_handle_t *zfm_libzfs(void);
+static zfm_errno_t zfm_add_dataset_properties(nvlist_t *zprops,
+    nvlist_t *props);
+static int zfm_lib_create_pool(libzfs_handle_t *hdl, char *zpool_name,
+    char *zfs_device);
+static int zfm_lib_destroy_pool(libzfs_handle_t *hdl, char *zpool_name);
+static int zfm_lib_create_dataset(libzfs_handle_t *hdl, char *zpool_name,
+    char *dataset_name, zfs_type_t type, uint64_t volsize,
+    uint64_t blocksize, nvlist_t *props);
 
 
 /* ------------------------ private functions --------------------------- */
@@ -73,11 +99,9 @@ static void
 zfm_debug_print(ls_dbglvl_t dbg_lvl, const char *fmt, ...)
 {
 	va_list	ap;
-	char	buf[MAXPATHLEN + 1];
 
 	va_start(ap, fmt);
-	(void) vsprintf(buf, fmt, ap);
-	(void) ls_write_dbg_message("TIZFM", dbg_lvl, buf);
+	ls_write_dbg_vmessage("TIZFM", dbg_lvl, fmt, ap);
 	va_end(ap);
 }
 
@@ -99,6 +123,7 @@ zfm_system(char *cmd)
 {
 	FILE	*p;
 	int	ret;
+	hrtime_t	start;
 	char	errbuf[IDM_MAXCMDLEN];
 
 	/*
@@ -112,13 +137,17 @@ zfm_system(char *cmd)
 	zfm_debug_print(LS_DBGLVL_INFO, "zfs cmd: %s\n", cmd);
 
 	if (!zfm_dryrun_mode_fl) {
+		start = ls_span_begin();
 		if ((p = popen(cmd, "r")) == NULL)
 			return (-1);
 
+		zfm_exec_cnt++;
+
 		while (fgets(errbuf, sizeof (errbuf), p) != NULL)
 			zfm_debug_print(LS_DBGLVL_WARN, " stderr:%s", errbuf);
 
 		ret = pclose(p);
+		ls_span_end(start, "ti", "zfm_system", cmd);
 
 		if ((ret == -1) || (WEXITSTATUS(ret) != 0))
 			return (-1);
@@ -143,9 +172,19 @@ zfm_system(char *cmd)
 static boolean_t
 zfm_zpool_exists(char *zpool_name)
 {
-	FILE	*p;
-	char	cmd[IDM_MAXCMDLEN];
-	int	ret;
+	FILE		*p;
+	char		cmd[IDM_MAXCMDLEN];
+	int		ret;
+	libzfs_handle_t	*hdl;
+	zpool_handle_t	*zhp;
+
+	if ((hdl = zfm_libzfs()) != NULL) {
+		if ((zhp = zpool_open_canfail(hdl, zpool_name)) == NULL)
+			return (B_FALSE);
+
+		zpool_close(zhp);
+		return (B_TRUE);
+	}
 
 	(void) snprintf(cmd, sizeof (cmd),
 	    "/usr/sbin/zpool list %s >/dev/null 2>&1", zpool_name);
@@ -153,6 +192,7 @@ zfm_zpool_exists(char *zpool_name)
 	if ((p = popen(cmd, "w")) == NULL)
 		return (B_FALSE);
 
+	zfm_exec_cnt++;
 	ret = pclose(p);
 
 	if ((ret != -1) && (WEXITSTATUS(ret) == 0))
@@ -177,9 +217,17 @@ zfm_zpool_exists(char *zpool_name)
 static boolean_t
 zfm_dataset_exists(char *zpool_name, char *dataset_name)
 {
-	FILE	*p;
-	char	cmd[IDM_MAXCMDLEN];
-	int	ret;
+	FILE		*p;
+	char		cmd[IDM_MAXCMDLEN];
+	int		ret;
+	libzfs_handle_t	*hdl;
+
+	if ((hdl = zfm_libzfs()) != NULL) {
+		(void) snprintf(cmd, sizeof (cmd), "%s/%s", zpool_name,
+		    dataset_name);
+
+		return (zfs_dataset_exists(hdl, cmd, ZFS_TYPE_DATASET));
+	}
 
 	(void) snprintf(cmd, sizeof (cmd),
 	    "/usr/sbin/zfs list %s/%s >/dev/null 2>&1", zpool_name,
@@ -188,6 +236,7 @@ zfm_dataset_exists(char *zpool_name, char *dataset_name)
 	if ((p = popen(cmd, "w")) == NULL)
 		return (B_FALSE);
 
+	zfm_exec_cnt++;
 	ret = pclose(p);
 
 	if ((ret != -1) && (WEXITSTATUS(ret) == 0))
@@ -323,6 +372,327 @@ zfm_set_dataset_properties(char *zpool_name, char *dataset_name,
 }
 
 
+/*
+ * Function:	zfm_libzfs
+ *
+ * Description:	Returns libzfs handle if libzfs backend was selected.
+ *		The handle is opened on first use. If libzfs can't be
+ *		initialized, TI ZFS module falls back to ZFS commands.
+ *
+ * Scope:	private
+ * Parameters:
+ *
+ * Return:	libzfs handle, NULL if ZFS commands are to be used
+ *
+ */
+
+static libzfs_handle_t *
+zfm_libzfs(void)
+{
+	if (zfm_backend != TI_ZFS_BACKEND_LIBZFS)
+		return (NULL);
+
+	if (zfm_g_zfs == NULL) {
+		if ((zfm_g_zfs = libzfs_init()) == NULL) {
+			zfm_debug_print(LS_DBGLVL_WARN, "Couldn't initialize "
+			    "libzfs, ZFS commands will be used instead\n");
+
+			zfm_backend = TI_ZFS_BACKEND_CMD;
+			return (NULL);
+		}
+
+		/* errors are reported through zfm_debug_print() */
+		libzfs_print_on_error(zfm_g_zfs, B_FALSE);
+	}
+
+	return (zfm_g_zfs);
+}
+
+
+/*
+ * Function:	zfm_add_dataset_properties
+ *
+ * Description:	Adds ZFS properties provided as pair of string arrays
+ *		to the property list passed to libzfs
+ *
+ * Scope:	private
+ * Parameters:	zprops - libzfs property list
+ *		props - properties as provided by TI consumer, may be NULL
+ *
+ * Return:	ZFM_E_SUCCESS - all properties added
+ *		ZFM_E_ZFS_SET_PROP_FAILED - couldn't add ZFS properties
+ *
+ */
+
+static zfm_errno_t
+zfm_add_dataset_properties(nvlist_t *zprops, nvlist_t *props)
+{
+	char	**prop_names, **prop_values;
+	uint_t	prop_numn, prop_numv;
+	int	i;
+
+	if (props == NULL ||
+	    (nvlist_lookup_string_array(props, TI_ATTR_ZFS_PROP_NAMES,
+	    &prop_names, &prop_numn) != 0) ||
+	    (nvlist_lookup_string_array(props, TI_ATTR_ZFS_PROP_VALUES,
+	    &prop_values, &prop_numv) != 0))
+		return (ZFM_E_SUCCESS);
+
+	if (prop_numv < prop_numn) {
+		zfm_debug_print(LS_DBGLVL_ERR, "Size of ZFS property value "
+		    "array doesn't match num of property names\n");
+
+		return (ZFM_E_ZFS_SET_PROP_FAILED);
+	}
+
+	for (i = 0; i < prop_numn; i++) {
+		zfm_debug_print(LS_DBGLVL_INFO, " property %s=%s\n",
+		    prop_names[i], prop_values[i]);
+
+		if (nvlist_add_string(zprops, prop_names[i],
+		    prop_values[i]) != 0)
+			return (ZFM_E_ZFS_SET_PROP_FAILED);
+	}
+
+	return (ZFM_E_SUCCESS);
+}
+
+
+/*
+ * Function:	zfm_lib_create_pool
+ *
+ * Description:	Creates ZFS pool on one device with libzfs and mounts
+ *		its root dataset, the way "zpool create -f" does.
+ *		Root dataset is marked as 'busy' at create time.
+ *
+ * Scope:	private
+ * Parameters:	hdl - libzfs handle
+ *		zpool_name - ZFS pool name
+ *		zfs_device - slice name (e.g. c0t0d0s0), device or file path
+ *
+ * Return:	0 - pool created, -1 - failed
+ *
+ */
+
+static int
+zfm_lib_create_pool(libzfs_handle_t *hdl, char *zpool_name, char *zfs_device)
+{
+	char		path[MAXPATHLEN];
+	struct stat	st;
+	nvlist_t	*nvroot = NULL, *vdev = NULL, *fsprops = NULL;
+	zfs_handle_t	*zhp;
+	boolean_t	is_file;
+	int		ret = -1;
+
+	/* zpool(1M) accepts short slice names, libzfs wants full path */
+	if (*zfs_device == '/')
+		(void) strlcpy(path, zfs_device, sizeof (path));
+	else
+		(void) snprintf(path, sizeof (path), "/dev/dsk/%s",
+		    zfs_device);
+
+	is_file = stat(path, &st) == 0 && S_ISREG(st.st_mode);
+
+	if (nvlist_alloc(&vdev, NV_UNIQUE_NAME, 0) != 0 ||
+	    nvlist_add_string(vdev, ZPOOL_CONFIG_TYPE,
+	    is_file ? VDEV_TYPE_FILE : VDEV_TYPE_DISK) != 0 ||
+	    nvlist_add_string(vdev, ZPOOL_CONFIG_PATH, path) != 0 ||
+	    (!is_file &&
+	    nvlist_add_uint64(vdev, ZPOOL_CONFIG_WHOLE_DISK, 0) != 0) ||
+	    nvlist_alloc(&nvroot, NV_UNIQUE_NAME, 0) != 0 ||
+	    nvlist_add_string(nvroot, ZPOOL_CONFIG_TYPE, VDEV_TYPE_ROOT) != 0 ||
+	    nvlist_add_nvlist_array(nvroot, ZPOOL_CONFIG_CHILDREN, &vdev,
+	    1) != 0 ||
+	    nvlist_alloc(&fsprops, NV_UNIQUE_NAME, 0) != 0 ||
+	    nvlist_add_string(fsprops, TI_RPOOL_PROPERTY_STATE,
+	    TI_RPOOL_BUSY) != 0) {
+		zfm_debug_print(LS_DBGLVL_ERR, "libzfs: Couldn't build "
+		    "configuration of pool <%s>\n", zpool_name);
+
+		goto done;
+	}
+
+	zfm_debug_print(LS_DBGLVL_INFO, "libzfs: create pool %s on %s\n",
+	    zpool_name, path);
+
+	if (zfm_dryrun_mode_fl) {
+		ret = 0;
+		goto done;
+	}
+
+	if (zpool_create(hdl, zpool_name, nvroot, NULL, fsprops) != 0) {
+		zfm_debug_print(LS_DBGLVL_ERR, "libzfs: %s\n",
+		    libzfs_error_description(hdl));
+
+		goto done;
+	}
+
+	if ((zhp = zfs_open(hdl, zpool_name, ZFS_TYPE_FILESYSTEM)) == NULL ||
+	    zfs_mount(zhp, NULL, 0) != 0) {
+		zfm_debug_print(LS_DBGLVL_ERR, "libzfs: Couldn't mount root "
+		    "dataset of pool <%s>: %s\n", zpool_name,
+		    libzfs_error_description(hdl));
+	} else {
+		ret = 0;
+	}
+
+	if (zhp != NULL)
+		zfs_close(zhp);
+
+done:
+	nvlist_free(fsprops);
+	nvlist_free(nvroot);
+	nvlist_free(vdev);
+	return (ret);
+}
+
+
+/*
+ * Function:	zfm_lib_destroy_pool
+ *
+ * Description:	Forcibly unmounts all datasets of ZFS pool and destroys
+ *		the pool with libzfs, the way "zpool destroy -f" does
+ *
+ * Scope:	private
+ * Parameters:	hdl - libzfs handle
+ *		zpool_name - ZFS pool name
+ *
+ * Return:	0 - pool destroyed, -1 - failed
+ *
+ */
+
+static int
+zfm_lib_destroy_pool(libzfs_handle_t *hdl, char *zpool_name)
+{
+	zpool_handle_t	*zhp;
+	int		ret = -1;
+
+	zfm_debug_print(LS_DBGLVL_INFO, "libzfs: destroy pool %s\n",
+	    zpool_name);
+
+	if (zfm_dryrun_mode_fl)
+		return (0);
+
+	if ((zhp = zpool_open_canfail(hdl, zpool_name)) == NULL) {
+		zfm_debug_print(LS_DBGLVL_ERR, "libzfs: %s\n",
+		    libzfs_error_description(hdl));
+
+		return (-1);
+	}
+
+	if (zpool_disable_datasets(zhp, B_TRUE) != 0 ||
+	    zpool_destroy(zhp) != 0) {
+		zfm_debug_print(LS_DBGLVL_ERR, "libzfs: %s\n",
+		    libzfs_error_description(hdl));
+	} else {
+		ret = 0;
+	}
+
+	zpool_close(zhp);
+	return (ret);
+}
+
+
+/*
+ * Function:	zfm_lib_create_dataset
+ *
+ * Description:	Creates ZFS file system or volume with libzfs, including
+ *		missing ancestors. All properties are passed in one list,
+ *		so they are set atomically at create time. As with
+ *		"zfs create", volumes get reservation of their size and
+ *		file systems are mounted and shared.
+ *
+ * Scope:	private
+ * Parameters:	hdl - libzfs handle
+ *		zpool_name - ZFS pool name
+ *		dataset_name - ZFS dataset name
+ *		type - ZFS_TYPE_FILESYSTEM or ZFS_TYPE_VOLUME
+ *		volsize - volume size in bytes
+ *		blocksize - volume block size, 0 for default
+ *		props - properties as provided by TI consumer, may be NULL
+ *
+ * Return:	0 - dataset created, -1 - failed
+ *
+ */
+
+static int
+zfm_lib_create_dataset(libzfs_handle_t *hdl, char *zpool_name,
+    char *dataset_name, zfs_type_t type, uint64_t volsize,
+    uint64_t blocksize, nvlist_t *props)
+{
+	char		path[MAXPATHLEN];
+	nvlist_t	*zprops;
+	zfs_handle_t	*zhp;
+	int		ret = -1;
+
+	(void) snprintf(path, sizeof (path), "%s/%s", zpool_name,
+	    dataset_name);
+
+	if (nvlist_alloc(&zprops, NV_UNIQUE_NAME, 0) != 0)
+		return (-1);
+
+	zfm_debug_print(LS_DBGLVL_INFO, "libzfs: create %s\n", path);
+
+	if (zfm_add_dataset_properties(zprops, props) != ZFM_E_SUCCESS)
+		goto done;
+
+	if (type == ZFS_TYPE_VOLUME) {
+		if (nvlist_add_uint64(zprops,
+		    zfs_prop_to_name(ZFS_PROP_VOLSIZE), volsize) != 0 ||
+		    (blocksize != 0 && nvlist_add_uint64(zprops,
+		    zfs_prop_to_name(ZFS_PROP_VOLBLOCKSIZE), blocksize) != 0))
+			goto done;
+
+		/* reserve space for metadata as well, like zfs create -V */
+		if (!nvlist_exists(zprops,
+		    zfs_prop_to_name(ZFS_PROP_REFRESERVATION)) &&
+		    nvlist_add_uint64(zprops,
+		    zfs_prop_to_name(ZFS_PROP_REFRESERVATION),
+		    zvol_volsize_to_reservation(volsize, zprops)) != 0)
+			goto done;
+	}
+
+	if (zfm_dryrun_mode_fl) {
+		ret = 0;
+		goto done;
+	}
+
+	if (zfs_create_ancestors(hdl, path) != 0 ||
+	    zfs_create(hdl, path, type, zprops) != 0) {
+		zfm_debug_print(LS_DBGLVL_ERR, "libzfs: %s\n",
+		    libzfs_error_description(hdl));
+
+		goto done;
+	}
+
+	if (type != ZFS_TYPE_FILESYSTEM) {
+		ret = 0;
+		goto done;
+	}
+
+	if ((zhp = zfs_open(hdl, path, ZFS_TYPE_FILESYSTEM)) == NULL) {
+		zfm_debug_print(LS_DBGLVL_ERR, "libzfs: %s\n",
+		    libzfs_error_description(hdl));
+
+		goto done;
+	}
+
+	if (zfs_prop_get_int(zhp, ZFS_PROP_CANMOUNT) == ZFS_CANMOUNT_ON &&
+	    (zfs_mount(zhp, NULL, 0) != 0 || zfs_share(zhp) != 0)) {
+		zfm_debug_print(LS_DBGLVL_ERR, "libzfs: Couldn't mount %s: "
+		    "%s\n", path, libzfs_error_description(hdl));
+	} else {
+		ret = 0;
+	}
+
+	zfs_close(zhp);
+
+done:
+	nvlist_free(zprops);
+	return (ret);
+}
+
+
 /* ----------------------- public functions --------------------------- */
 
 /*
@@ -348,6 +718,7 @@ zfm_create_pool(nvlist_t *attrs)
 	char		*zfs_device;
 	boolean_t	zfs_root_pool_fl = B_TRUE;
 	boolean_t	zfs_preserve_pool_fl;
+	libzfs_handle_t	*hdl = zfm_libzfs();
 
 	/*
 	 * validate set of attributes provided
@@ -399,7 +770,9 @@ zfm_create_pool(nvlist_t *attrs)
 			(void) snprintf(cmd, sizeof (cmd),
 			    "/usr/sbin/zpool destroy -f %s", zfs_pool_name);
 
-			if (zfm_system(cmd) == -1) {
+			if (hdl != NULL ?
+			    zfm_lib_destroy_pool(hdl, zfs_pool_name) == -1 :
+			    zfm_system(cmd) == -1) {
 				zfm_debug_print(LS_DBGLVL_ERR, "zfs: "
 				    "Couldn't destroy ZFS pool\n");
 
@@ -420,7 +793,9 @@ zfm_create_pool(nvlist_t *attrs)
 	    "/usr/sbin/zpool create -f %s %s",
 	    zfs_pool_name, zfs_device);
 
-	if (zfm_system(cmd) == -1) {
+	if (hdl != NULL ?
+	    zfm_lib_create_pool(hdl, zfs_pool_name, zfs_device) == -1 :
+	    zfm_system(cmd) == -1) {
 		zfm_debug_print(LS_DBGLVL_ERR, "zfs: "
 		    "Couldn't create ZFS pool\n");
 
@@ -438,9 +813,27 @@ zfm_create_pool(nvlist_t *attrs)
 	 *	org.openindiana.caiman:install=busy
 	 * After installer finishes its job, the property value is
 	 * changed to 'ready' indicating successful installation
+	 *
+	 * libzfs backend has already set the property when creating
+	 * the pool and creates the directory without spawning mkdir(1)
 	 */
 
-	if (zfs_root_pool_fl) {
+	if (zfs_root_pool_fl && hdl != NULL) {
+		(void) snprintf(cmd, sizeof (cmd), "/%s/%s",
+		    zfs_pool_name, ZFM_GRUB_MENU_DIR);
+
+		zfm_debug_print(LS_DBGLVL_INFO, "mkdirp %s\n", cmd);
+
+		if (!zfm_dryrun_mode_fl && mkdirp(cmd, 0755) == -1 &&
+		    errno != EEXIST) {
+			zfm_debug_print(LS_DBGLVL_ERR, "zfs: "
+			    "Couldn't create <%s> directory in root "
+			    "dataset <%s>\n", ZFM_GRUB_MENU_DIR,
+			    zfs_pool_name);
+
+			return (ZFM_E_ZFS_POOL_CREATE_FAILED);
+		}
+	} else if (zfs_root_pool_fl) {
 		(void) snprintf(cmd, sizeof (cmd),
 		    "/usr/bin/mkdir -p /%s/%s",
 		    zfs_pool_name, ZFM_GRUB_MENU_DIR);
@@ -494,6 +887,7 @@ zfm_release_pool(nvlist_t *attrs)
 	char		*zfs_pool_name;
 	char		*zfs_device;
 	boolean_t	zfs_root_pool_fl = B_TRUE;
+	libzfs_handle_t	*hdl;
 
 	/*
 	 * validate set of attributes provided
@@ -563,7 +957,9 @@ zfm_release_pool(nvlist_t *attrs)
 	(void) snprintf(cmd, sizeof (cmd),
 	    "/usr/sbin/zpool destroy -f %s", zfs_pool_name);
 
-	if (zfm_system(cmd) != 0) {
+	if ((hdl = zfm_libzfs()) != NULL ?
+	    zfm_lib_destroy_pool(hdl, zfs_pool_name) != 0 :
+	    zfm_system(cmd) != 0) {
 		zfm_debug_print(LS_DBGLVL_INFO,
 		    "Releasing of ZFS pool %s failed\n", zfs_pool_name);
 
@@ -603,6 +999,7 @@ zfm_create_fs(nvlist_t *attrs)
 	uint_t		nelem;
 	int		i;
 	uint16_t	fs_num;
+	libzfs_handle_t	*hdl = zfm_libzfs();
 
 	/*
 	 * validate set of attributes provided
@@ -681,6 +1078,23 @@ zfm_create_fs(nvlist_t *attrs)
 			continue;
 		}
 
+		/*
+		 * libzfs backend sets properties when creating file system
+		 */
+
+		if (hdl != NULL) {
+			if (zfm_lib_create_dataset(hdl, zfs_pool_name,
+			    fs_names[i], ZFS_TYPE_FILESYSTEM, 0, 0,
+			    props != NULL ? props[i] : NULL) == -1) {
+				zfm_debug_print(LS_DBGLVL_ERR, "zfs: "
+				    "Couldn't create ZFS filesystem\n");
+
+				return (ZFM_E_ZFS_FS_CREATE_FAILED);
+			}
+
+			continue;
+		}
+
 		(void) snprintf(cmd, sizeof (cmd), "/usr/sbin/zfs "
 		    "create -p %s/%s", zfs_pool_name, fs_names[i]);
 
@@ -822,6 +1236,8 @@ zfm_create_volumes(nvlist_t *attrs)
 	uint_t		nelem;
 	int		i;
 	uint16_t	vol_num;
+	int		blocksize;
+	libzfs_handle_t	*hdl = zfm_libzfs();
 
 	/*
 	 * validate set of attributes provided
@@ -963,12 +1379,11 @@ zfm_create_volumes(nvlist_t *attrs)
 		if (vol_types == NULL ||
 		    (vol_types[i] != TI_ZFS_VOL_TYPE_SWAP &&
 		    vol_types[i] != TI_ZFS_VOL_TYPE_DUMP)) {
+			blocksize = 0;
 			(void) snprintf(cmd, sizeof (cmd),
 			    "/usr/sbin/zfs create -V %dm %s/%s",
 			    vol_sizes[i], zfs_pool_name, vol_names[i]);
 		} else {
-			int	blocksize;
-
 			if (vol_types[i] == TI_ZFS_VOL_TYPE_SWAP)
 				blocksize = ZFM_SWAP_BLOCK_SIZE;
 			else
@@ -981,7 +1396,15 @@ zfm_create_volumes(nvlist_t *attrs)
 
 		}
 
-		if (zfm_system(cmd) == -1) {
+		/*
+		 * libzfs backend sets properties when creating volume
+		 */
+
+		if (hdl != NULL ?
+		    zfm_lib_create_dataset(hdl, zfs_pool_name, vol_names[i],
+		    ZFS_TYPE_VOLUME, (uint64_t)vol_sizes[i] * 1024 * 1024,
+		    blocksize, props != NULL ? props[i] : NULL) == -1 :
+		    zfm_system(cmd) == -1) {
 			zfm_debug_print(LS_DBGLVL_ERR,
 			    "Couldn't create ZFS volume <%s> on pool <%s>\n",
 			    vol_names[i], zfs_pool_name);
@@ -992,7 +1415,11 @@ zfm_create_volumes(nvlist_t *attrs)
 		/*
 		 * Set ZFS properties if provided
 		 */
-		if (props != NULL && props[i] != NULL) {
+		if (hdl != NULL) {
+			zfm_debug_print(LS_DBGLVL_INFO,
+			    "Properties set at create time for %s dataset\n",
+			    vol_names[i]);
+		} else if (props != NULL && props[i] != NULL) {
 			if (zfm_set_dataset_properties(zfs_pool_name,
 			    vol_names[i], props[i]) != ZFM_E_SUCCESS)
 				return (ZFM_E_ZFS_FS_CREATE_FAILED);
@@ -1092,3 +1519,47 @@ zfm_dryrun_mode(void)
 {
 	zfm_dryrun_mode_fl = B_TRUE;
 }
+
+
+/*
+ * Function:	zfm_set_backend
+ * Description:	Selects mechanism used for ZFS operations. With
+ *		TI_ZFS_BACKEND_LIBZFS, pools and datasets are created,
+ *		checked and destroyed through libzfs and all properties
+ *		of dataset are set in one call when it is created.
+ *		Swap and dump are still configured by swap(1M) and dumpadm(1M).
+ *
+ * Scope:	public
+ * Parameters:	backend - TI_ZFS_BACKEND_CMD or TI_ZFS_BACKEND_LIBZFS
+ *
+ * Return:
+ */
+
+void
+zfm_set_backend(ti_zfs_backend_t backend)
+{
+	zfm_backend = backend;
+
+	if (backend != TI_ZFS_BACKEND_LIBZFS && zfm_g_zfs != NULL) {
+		libzfs_fini(zfm_g_zfs);
+		zfm_g_zfs = NULL;
+	}
+}
+
+
+/*
+ * Function:	zfm_exec_count
+ * Description:	Returns number of processes spawned by TI ZFS module.
+ *		Used for comparing ZFS backends.
+ *
+ * Scope:	public
+ * Parameters:
+ *
+ * Return:	number of processes spawned so far
+ */
+
+uint_t
+zfm_exec_count(void)
+{
+	return (zfm_exec_cnt);
+}
@@ -96,6 +96,14 @@ zfm_errno_t zfm_create_volumes(nvlist_t *attrs);
 
 void zfm_dryrun_mode(void);
 
+/* selects ZFS commands or libzfs for ZFS operations */
+
+void zfm_set_backend(ti_zfs_backend_t backend);
+
+/* number of processes spawned by TI ZFS module so far */
+
+uint_t zfm_exec_count(void);
+
 /* checks if ZFS dataset exists */
 
 boolean_t zfm_fs_exists(nvlist_t *attrs);
@@ -0,0 +1,314 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * this is a test harness for the partition table engine of the TI disk
+ * module. It lays out sparse disk image the way the installer does -
+ * whole disk Solaris2 partition, then custom fdisk partition table with
+ * one partition preserved, SMI label and VTOC with default slice layout,
+ * and finally runs the same in dry run mode, which must leave the image
+ * untouched. Every step is verified by reading the image back and timed.
+ *
+ * Image is created on path given on command line and removed when done.
+ * No privileges are needed, for development use only
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/param.h>
+#include <sys/byteorder.h>
+#include <sys/dklabel.h>
+#include <sys/dktp/fdisk.h>
+#include <sys/vtoc.h>
+#include <libnvpair.h>
+
+#include <ti_api.h>
+#include <ti_dm.h>
+#include <ls_api.h>
+
+#define	TEST_IMAGE_MB		4096
+#define	TEST_NSECS		(IDM_IMAGE_NHEAD * IDM_IMAGE_NSECT)
+#define	TEST_FAT32		0x0c
+
+static char	*image;
+static int	failures = 0;
+
+#define	CHECK(cond, what)	test_check((cond), (what), #cond)
+
+static boolean_t
+test_check(boolean_t ok, const char *what, const char *cond)
+{
+	if (!ok) {
+		(void) printf("  FAIL %s: %s\n", what, cond);
+		failures++;
+	}
+	return (ok);
+}
+
+/* read sectors of image */
+static boolean_t
+test_read(void *buf, size_t len, diskaddr_t lba)
+{
+	int	fd;
+	ssize_t	n;
+
+	if ((fd = open(image, O_RDONLY)) < 0)
+		return (B_FALSE);
+	n = pread(fd, buf, len, (off_t)lba * DEV_BSIZE);
+	(void) close(fd);
+	return (n == len);
+}
+
+static void
+test_parts(struct ipart *parts)
+{
+	struct mboot	mb;
+
+	bzero(parts, FD_NUMPART * sizeof (struct ipart));
+	if (test_read(&mb, sizeof (mb), 0) &&
+	    CHECK(LE_16(mb.signature) == MBB_MAGIC, "MBR signature"))
+		bcopy(mb.parts, parts, FD_NUMPART * sizeof (struct ipart));
+}
+
+static void
+test_report(const char *step, hrtime_t start, int before)
+{
+	(void) printf("%-24s %10.3f ms  %s\n", step,
+	    (gethrtime() - start) / 1000000.0,
+	    failures == before ? "ok" : "FAILED");
+}
+
+/* Solaris2 partition occupying whole disk but the first cylinder */
+static void
+test_whole_disk(void)
+{
+	struct ipart	parts[FD_NUMPART];
+	hrtime_t	start = gethrtime();
+	int		before = failures;
+
+	CHECK(idm_fdisk_whole_disk(image) == IDM_E_SUCCESS,
+	    "whole disk partition");
+	test_parts(parts);
+	CHECK(parts[0].systid == SUNIXOS2, "partition id");
+	CHECK(parts[0].bootid == ACTIVE, "active flag");
+	CHECK(LE_32(parts[0].relsect) == TEST_NSECS, "partition offset");
+	CHECK(LE_32(parts[0].numsect) ==
+	    (TEST_IMAGE_MB * 2048 / TEST_NSECS - 1) * TEST_NSECS,
+	    "partition size");
+	CHECK(parts[0].beghead == 0 && parts[0].begsect == 1 &&
+	    parts[0].begcyl == 1, "partition start CHS");
+	CHECK(parts[1].systid == 0 && parts[2].systid == 0 &&
+	    parts[3].systid == 0, "unused partitions");
+	test_report("fdisk whole disk", start, before);
+}
+
+/*
+ * FAT32 partition followed by Solaris2 partition. If preserve is set,
+ * the FAT32 partition is kept as found on the disk and the attributes
+ * describing it are intentionally wrong
+ */
+static void
+test_part_table(boolean_t preserve)
+{
+	nvlist_t	*attrs;
+	struct ipart	parts[FD_NUMPART];
+	uint8_t		ids[FD_NUMPART] = {TEST_FAT32, SUNIXOS2, 0, 0};
+	uint8_t		active[FD_NUMPART] = {0, ACTIVE, 0, 0};
+	uint64_t	offsets[FD_NUMPART] = {TEST_NSECS, 101 * TEST_NSECS};
+	uint64_t	sizes[FD_NUMPART] = {100 * TEST_NSECS,
+	    150 * TEST_NSECS};
+	boolean_t	keep[FD_NUMPART] = {B_TRUE, B_FALSE, B_FALSE, B_FALSE};
+	hrtime_t	start = gethrtime();
+	int		before = failures;
+
+	if (preserve) {
+		ids[0] = SUNIXOS;
+		sizes[1] = 200 * TEST_NSECS;
+	}
+	if (nvlist_alloc(&attrs, TI_TARGET_NVLIST_TYPE, 0) != 0 ||
+	    nvlist_add_string(attrs, TI_ATTR_FDISK_DISK_NAME, image) != 0 ||
+	    nvlist_add_uint16(attrs, TI_ATTR_FDISK_PART_NUM,
+	    FD_NUMPART) != 0 ||
+	    nvlist_add_uint8_array(attrs, TI_ATTR_FDISK_PART_IDS, ids,
+	    FD_NUMPART) != 0 ||
+	    nvlist_add_uint8_array(attrs, TI_ATTR_FDISK_PART_ACTIVE, active,
+	    FD_NUMPART) != 0 ||
+	    nvlist_add_uint64_array(attrs, TI_ATTR_FDISK_PART_RSECTS, offsets,
+	    FD_NUMPART) != 0 ||
+	    nvlist_add_uint64_array(attrs, TI_ATTR_FDISK_PART_NUMSECTS, sizes,
+	    FD_NUMPART) != 0 ||
+	    (preserve && nvlist_add_boolean_array(attrs,
+	    TI_ATTR_FDISK_PART_PRESERVE, keep, FD_NUMPART) != 0)) {
+		(void) printf("can't build fdisk attributes\n");
+		exit(1);
+	}
+
+	CHECK(idm_fdisk_create_part_table(attrs) == IDM_E_SUCCESS,
+	    "partition table");
+	nvlist_free(attrs);
+
+	test_parts(parts);
+	CHECK(parts[0].systid == TEST_FAT32 && parts[0].bootid == 0 &&
+	    LE_32(parts[0].relsect) == TEST_NSECS &&
+	    LE_32(parts[0].numsect) == 100 * TEST_NSECS, "partition 1");
+	CHECK(parts[1].systid == SUNIXOS2 && parts[1].bootid == ACTIVE &&
+	    LE_32(parts[1].relsect) == 101 * TEST_NSECS &&
+	    LE_32(parts[1].numsect) == sizes[1], "partition 2");
+	CHECK(parts[1].beghead == 0 && parts[1].begsect == 1 &&
+	    parts[1].begcyl == 101, "partition 2 start CHS");
+	CHECK(parts[1].endhead == IDM_IMAGE_NHEAD - 1 &&
+	    (parts[1].endsect & 0x3f) == IDM_IMAGE_NSECT &&
+	    (parts[1].endcyl | ((parts[1].endsect & 0xc0) << 2)) ==
+	    (preserve ? 300 : 250), "partition 2 end CHS");
+	test_report(preserve ? "fdisk preserve" : "fdisk table", start,
+	    before);
+}
+
+/* SMI label and VTOC with default slice layout within Solaris2 partition */
+static void
+test_label(void)
+{
+	nvlist_t	*attrs;
+	struct dk_label	label;
+	uint16_t	sum = 0, *sp;
+	hrtime_t	start = gethrtime();
+	int		before = failures;
+
+	if (nvlist_alloc(&attrs, TI_TARGET_NVLIST_TYPE, 0) != 0 ||
+	    nvlist_add_string(attrs, TI_ATTR_LABEL_DISK_NAME, image) != 0 ||
+	    nvlist_add_string(attrs, TI_ATTR_SLICE_DISK_NAME, image) != 0 ||
+	    nvlist_add_boolean_value(attrs, TI_ATTR_SLICE_DEFAULT_LAYOUT,
+	    B_TRUE) != 0) {
+		(void) printf("can't build label attributes\n");
+		exit(1);
+	}
+
+	CHECK(idm_create_disk_label(attrs) == IDM_E_SUCCESS, "disk label");
+	CHECK(idm_create_vtoc(attrs) == IDM_E_SUCCESS, "VTOC");
+	nvlist_free(attrs);
+
+	if (!CHECK(test_read(&label, sizeof (label), 101 * TEST_NSECS +
+	    DK_LABEL_LOC), "read label")) {
+		test_report("label and VTOC", start, before);
+		return;
+	}
+	for (sp = (uint16_t *)&label; sp < (uint16_t *)(&label + 1); sp++)
+		sum ^= *sp;
+	CHECK(label.dkl_magic == DKL_MAGIC && sum == 0, "label checksum");
+	CHECK(label.dkl_pcyl == 200 &&
+	    label.dkl_ncyl == 200 - IDM_DEFAULT_ACYL, "label geometry");
+	CHECK(label.dkl_vtoc.v_part[IDM_ALL_SLICE].p_tag == V_BACKUP &&
+	    label.dkl_vtoc.v_part[IDM_ALL_SLICE].p_size ==
+	    label.dkl_ncyl * TEST_NSECS, "backup slice");
+	CHECK(label.dkl_vtoc.v_part[IDM_BOOT_SLICE].p_tag == V_BOOT &&
+	    label.dkl_vtoc.v_part[IDM_BOOT_SLICE].p_size == TEST_NSECS,
+	    "boot slice");
+	CHECK(label.dkl_vtoc.v_part[0].p_tag == V_ROOT &&
+	    label.dkl_vtoc.v_part[0].p_start == TEST_NSECS &&
+	    label.dkl_vtoc.v_part[0].p_size ==
+	    (label.dkl_ncyl - 1) * TEST_NSECS, "root slice");
+	test_report("label and VTOC", start, before);
+}
+
+/* dry run must report differences only */
+static void
+test_dryrun(void)
+{
+	char		before_img[2][DEV_BSIZE], after_img[2][DEV_BSIZE];
+	diskaddr_t	lba[2] = {0, 101 * TEST_NSECS + DK_LABEL_LOC};
+	hrtime_t	start = gethrtime();
+	int		before = failures;
+	int		i;
+
+	for (i = 0; i < 2; i++)
+		(void) test_read(before_img[i], DEV_BSIZE, lba[i]);
+
+	idm_dryrun_mode();
+	CHECK(idm_fdisk_whole_disk(image) == IDM_E_SUCCESS,
+	    "dry run whole disk partition");
+
+	for (i = 0; i < 2; i++) {
+		(void) test_read(after_img[i], DEV_BSIZE, lba[i]);
+		CHECK(bcmp(before_img[i], after_img[i], DEV_BSIZE) == 0,
+		    "image unchanged");
+	}
+	test_report("dry run", start, before);
+}
+
+static void
+usage(void)
+{
+	(void) printf("Usage: tidmtest [-v] file\n"
+	    " -v include informational-level debugging information\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	int		c, fd;
+
+	ls_set_dbg_level(LS_DBGLVL_ERR);
+	while ((c = getopt(argc, argv, "v")) != EOF) {
+		switch (c) {
+		case 'v':
+			ls_set_dbg_level(LS_DBGLVL_INFO);
+			break;
+		default:
+			usage();
+			exit(1);
+		}
+	}
+	if (optind != argc - 1 || argv[optind][0] != '/') {
+		usage();
+		exit(1);
+	}
+	image = argv[optind];
+	if ((fd = open(image, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0 ||
+	    ftruncate(fd, (off_t)TEST_IMAGE_MB * 1024 * 1024) != 0) {
+		perror(image);
+		exit(1);
+	}
+	(void) close(fd);
+
+#ifndef sparc
+	test_whole_disk();
+	test_part_table(B_FALSE);
+	test_part_table(B_TRUE);
+	test_label();
+	test_dryrun();
+#else
+	(void) printf("fdisk partitions are not used on sparc\n");
+#endif
+
+	(void) unlink(image);
+	(void) printf("%s\n", failures == 0 ? "all tests passed" :
+	    "some tests FAILED");
+	return (failures == 0 ? 0 : 1);
+}
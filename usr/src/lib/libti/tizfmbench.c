@@ -0,0 +1,315 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * this is a timing harness for the TI ZFS module
+ * it creates root pool with BE and shared file systems and volumes
+ * the way the installer lays them out, then releases the pool, once
+ * with ZFS commands and once with libzfs. Number of processes spawned
+ * and wall time are reported for both backends.
+ *
+ * Pool is created on sparse file given on command line, which is
+ * created if it doesn't exist and removed when done.
+ *
+ * needs root privileges, for development use only
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/param.h>
+#include <libnvpair.h>
+
+#include <ti_api.h>
+#include <ti_zfm.h>
+#include <ls_api.h>
+
+#define	BENCH_POOL		"tizfmbench"
+#define	BENCH_VDEV_MB		1024
+#define	BENCH_MAX_PROPS		4
+
+/* dataset and its properties as name, value pairs */
+typedef struct bench_ds {
+	char		*name;
+	uint32_t	mb;		/* volume size */
+	char		*props[2 * BENCH_MAX_PROPS + 1];
+} bench_ds_t;
+
+static bench_ds_t bench_fs[] = {
+	{"ROOT", 0, {"canmount", "off", "mountpoint", "legacy", NULL}},
+	{"ROOT/bench", 0, {"canmount", "noauto", "mountpoint", "legacy",
+	    "compression", "on", "org.opensolaris.libbe:policy", "static",
+	    NULL}},
+	{"ROOT/bench/var", 0, {"canmount", "noauto", "mountpoint", "legacy",
+	    NULL}},
+	{"export", 0, {"mountpoint", "/" BENCH_POOL "/export", NULL}},
+	{"export/home", 0, {"compression", "on", NULL}},
+	{"export/home/bench", 0, {"compression", "on", "atime", "off",
+	    NULL}}
+};
+
+static bench_ds_t bench_vol[] = {
+	{TI_ZFS_VOL_NAME_SWAP, 128, {"checksum", "off", NULL}},
+	{TI_ZFS_VOL_NAME_DUMP, 128, {"checksum", "off", "compression", "on",
+	    NULL}}
+};
+
+#define	BENCH_NFS	(sizeof (bench_fs) / sizeof (bench_ds_t))
+#define	BENCH_NVOL	(sizeof (bench_vol) / sizeof (bench_ds_t))
+
+static char *backend_name[] = {"commands", "libzfs"};
+
+/* build TI property list of dataset */
+static nvlist_t *
+bench_props(bench_ds_t *ds)
+{
+	nvlist_t	*props;
+	char		*names[BENCH_MAX_PROPS], *values[BENCH_MAX_PROPS];
+	uint_t		n;
+
+	for (n = 0; ds->props[2 * n] != NULL; n++) {
+		names[n] = ds->props[2 * n];
+		values[n] = ds->props[2 * n + 1];
+	}
+	if (nvlist_alloc(&props, TI_TARGET_NVLIST_TYPE, 0) != 0)
+		return (NULL);
+	if (nvlist_add_string_array(props, TI_ATTR_ZFS_PROP_NAMES, names,
+	    n) != 0 ||
+	    nvlist_add_string_array(props, TI_ATTR_ZFS_PROP_VALUES, values,
+	    n) != 0) {
+		nvlist_free(props);
+		return (NULL);
+	}
+	return (props);
+}
+
+/*
+ * build attributes of pool, file systems and volumes
+ * returns 0 on success, -1 on failure
+ */
+static int
+bench_attrs(char *vdev, nvlist_t **pool, nvlist_t **fs, nvlist_t **vol)
+{
+	char		*names[BENCH_NFS + BENCH_NVOL];
+	nvlist_t	*props[BENCH_NFS + BENCH_NVOL];
+	uint32_t	sizes[BENCH_NVOL];
+	int		i, ret = -1;
+
+	*pool = *fs = *vol = NULL;
+	bzero(props, sizeof (props));
+	for (i = 0; i < BENCH_NFS; i++) {
+		names[i] = bench_fs[i].name;
+		if ((props[i] = bench_props(&bench_fs[i])) == NULL)
+			goto done;
+	}
+	for (i = 0; i < BENCH_NVOL; i++) {
+		names[BENCH_NFS + i] = bench_vol[i].name;
+		sizes[i] = bench_vol[i].mb;
+		if ((props[BENCH_NFS + i] = bench_props(&bench_vol[i])) ==
+		    NULL)
+			goto done;
+	}
+
+	if (nvlist_alloc(pool, TI_TARGET_NVLIST_TYPE, 0) != 0 ||
+	    nvlist_add_string(*pool, TI_ATTR_ZFS_RPOOL_NAME,
+	    BENCH_POOL) != 0 ||
+	    nvlist_add_string(*pool, TI_ATTR_ZFS_RPOOL_DEVICE, vdev) != 0)
+		goto done;
+
+	if (nvlist_alloc(fs, TI_TARGET_NVLIST_TYPE, 0) != 0 ||
+	    nvlist_add_uint16(*fs, TI_ATTR_ZFS_FS_NUM, BENCH_NFS) != 0 ||
+	    nvlist_add_string(*fs, TI_ATTR_ZFS_FS_POOL_NAME,
+	    BENCH_POOL) != 0 ||
+	    nvlist_add_string_array(*fs, TI_ATTR_ZFS_FS_NAMES, names,
+	    BENCH_NFS) != 0 ||
+	    nvlist_add_nvlist_array(*fs, TI_ATTR_ZFS_PROPERTIES, props,
+	    BENCH_NFS) != 0)
+		goto done;
+
+	/* generic volumes, so that swap and dump of the system stay intact */
+	if (nvlist_alloc(vol, TI_TARGET_NVLIST_TYPE, 0) != 0 ||
+	    nvlist_add_uint16(*vol, TI_ATTR_ZFS_VOL_NUM, BENCH_NVOL) != 0 ||
+	    nvlist_add_string(*vol, TI_ATTR_ZFS_VOL_POOL_NAME,
+	    BENCH_POOL) != 0 ||
+	    nvlist_add_string_array(*vol, TI_ATTR_ZFS_VOL_NAMES,
+	    names + BENCH_NFS, BENCH_NVOL) != 0 ||
+	    nvlist_add_uint32_array(*vol, TI_ATTR_ZFS_VOL_MB_SIZES, sizes,
+	    BENCH_NVOL) != 0 ||
+	    nvlist_add_nvlist_array(*vol, TI_ATTR_ZFS_PROPERTIES,
+	    props + BENCH_NFS, BENCH_NVOL) != 0)
+		goto done;
+
+	ret = 0;
+done:
+	for (i = 0; i < BENCH_NFS + BENCH_NVOL; i++)
+		nvlist_free(props[i]);
+	if (ret != 0) {
+		nvlist_free(*pool);
+		nvlist_free(*fs);
+		nvlist_free(*vol);
+	}
+	return (ret);
+}
+
+/*
+ * create and release layout with given backend
+ * returns 0 on success and elapsed milliseconds and spawned processes
+ * of both phases, -1 on failure
+ */
+static int
+bench_layout(ti_zfs_backend_t backend, nvlist_t *pool, nvlist_t *fs,
+    nvlist_t *vol, double *ms, uint_t *execs)
+{
+	hrtime_t	start;
+	uint_t		e;
+
+	zfm_set_backend(backend);
+
+	start = gethrtime();
+	e = zfm_exec_count();
+	if (zfm_create_pool(pool) != ZFM_E_SUCCESS ||
+	    zfm_create_fs(fs) != ZFM_E_SUCCESS ||
+	    zfm_create_volumes(vol) != ZFM_E_SUCCESS) {
+		(void) printf("%s: couldn't create layout\n",
+		    backend_name[backend]);
+		(void) zfm_release_pool(pool);
+		return (-1);
+	}
+	ms[0] += (gethrtime() - start) / 1000000.0;
+	execs[0] += zfm_exec_count() - e;
+
+	start = gethrtime();
+	e = zfm_exec_count();
+	if (zfm_release_pool(pool) != ZFM_E_SUCCESS) {
+		(void) printf("%s: couldn't release pool\n",
+		    backend_name[backend]);
+		return (-1);
+	}
+	ms[1] += (gethrtime() - start) / 1000000.0;
+	execs[1] += zfm_exec_count() - e;
+	return (0);
+}
+
+static void
+usage(void)
+{
+	(void) printf("Usage: tizfmbench [-r rounds] [-s size] [-v] file\n"
+	    " -r number of times layout is created (default 3)\n"
+	    " -s size of pool file in MB (default %d)\n"
+	    " -v include informational-level debugging information\n",
+	    BENCH_VDEV_MB);
+}
+
+int
+main(int argc, char **argv)
+{
+	int		c, r, b, fd;
+	int		rounds = 3;
+	uint64_t	mb = BENCH_VDEV_MB;
+	char		*vdev;
+	boolean_t	created = B_FALSE;
+	nvlist_t	*pool, *fs, *vol;
+	double		ms[2][2];
+	uint_t		execs[2][2];
+	int		ret = 0;
+
+	ls_set_dbg_level(LS_DBGLVL_ERR);
+	while ((c = getopt(argc, argv, "r:s:v")) != EOF) {
+		switch (c) {
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 's':
+			mb = strtoull(optarg, NULL, 10);
+			break;
+		case 'v':
+			ls_set_dbg_level(LS_DBGLVL_INFO);
+			break;
+		default:
+			usage();
+			exit(1);
+		}
+	}
+	if (optind != argc - 1 || rounds <= 0 || mb == 0 ||
+	    argv[optind][0] != '/') {
+		usage();
+		exit(1);
+	}
+	if (getuid() != 0) {
+		(void) printf("creating ZFS pool needs root\n");
+		exit(1);
+	}
+	vdev = argv[optind];
+	if (access(vdev, F_OK) != 0) {
+		if ((fd = open(vdev, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0 ||
+		    ftruncate(fd, (off_t)(mb * 1024 * 1024)) != 0) {
+			perror(vdev);
+			exit(1);
+		}
+		(void) close(fd);
+		created = B_TRUE;
+	}
+	if (bench_attrs(vdev, &pool, &fs, &vol) != 0) {
+		(void) printf("can't build target attributes\n");
+		exit(1);
+	}
+
+	bzero(ms, sizeof (ms));
+	bzero(execs, sizeof (execs));
+	for (r = 0; r < rounds && ret == 0; r++)
+		for (b = TI_ZFS_BACKEND_CMD; b <= TI_ZFS_BACKEND_LIBZFS; b++)
+			if (bench_layout(b, pool, fs, vol, ms[b],
+			    execs[b]) != 0) {
+				ret = 1;
+				break;
+			}
+
+	if (ret == 0) {
+		(void) printf("%d file systems, %d volumes, %d rounds\n",
+		    (int)BENCH_NFS, (int)BENCH_NVOL, rounds);
+		(void) printf("%-10s %12s %8s %12s %8s\n", "backend",
+		    "create ms", "execs", "release ms", "execs");
+		for (b = TI_ZFS_BACKEND_CMD; b <= TI_ZFS_BACKEND_LIBZFS; b++)
+			(void) printf("%-10s %12.3f %8u %12.3f %8u\n",
+			    backend_name[b], ms[b][0] / rounds,
+			    execs[b][0] / rounds, ms[b][1] / rounds,
+			    execs[b][1] / rounds);
+		if (ms[TI_ZFS_BACKEND_LIBZFS][0] > 0)
+			(void) printf("create speedup %.1fx\n",
+			    ms[TI_ZFS_BACKEND_CMD][0] /
+			    ms[TI_ZFS_BACKEND_LIBZFS][0]);
+	}
+
+	nvlist_free(pool);
+	nvlist_free(fs);
+	nvlist_free(vol);
+	if (created)
+		(void) unlink(vdev);
+	return (ret);
+}
@@ -0,0 +1,446 @@
+#
+# CDDL HEADER START
+#
+# The contents of this file are subject to the terms of the
+# Common Development and Distribution License (the "License").
+# You may not use this file except in compliance with the License.
+#
+# You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+# or http://www.opensolaris.org/os/licensing.
+# See the License for the specific language governing permissions
+# and limitations under the License.
+#
+# When distributing Covered Code, include this CDDL HEADER in each
+# file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+# If applicable, add the following below this CDDL HEADER, with the
+# fields enclosed by brackets "[]" replaced with your own identifying
+# information: Portions Copyright [yyyy] [name of copyright owner]
+#
+# CDDL HEADER END
+#
+# Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+#
+""" Local IPS package cache shared by the transfer module and distro_const
+
+Packages are kept as pkg(5) archives, one per package, named by SHA-1
+of their contents, and an index maps package FMRIs to them:
+
+	<cache>/objects/<2 digits>/<sha1>.p5p
+	<cache>/index	"<fmri> <sha1> <size> <last use>" per line
+	<cache>/lock	serializes index updates between processes
+	<cache>/use	read locked by every process using the cache
+
+Packages are only cached by full FMRI, as solved by pkg(1) for the
+image being installed, so that the cache never supplies a version the
+publisher's incorporations wouldn't allow.
+
+Archives are verified against their name every time they are used and
+the least recently used ones are removed once the cache grows over its
+size limit, except for those used by the cache object removing them.
+Archives of other processes are protected by the use lock: a process
+only removes archives if it can write lock the use file, that is when
+nobody else has the cache open, otherwise removal is left to the last
+process to close the cache. Archives can be received into a package
+repository to install them from, and the whole cache can be exported
+as a package repository to be served by pkg.depotd(1M) or used through
+a file:// URL.
+"""
+
+import errno
+import fcntl
+import hashlib
+import os
+import shutil
+import subprocess as sp
+import sys
+import tempfile
+import threading
+import time
+import liblogsvc as logsvc
+from osol_install.install_utils import exec_cmd_outputs_to_log
+from osol_install.transfer_defs import TRANSFER_ID
+
+PKG = "/usr/bin/pkg"
+PKGRECV = "/usr/bin/pkgrecv"
+PKGREPO = "/usr/bin/pkgrepo"
+HASH_BUFSIZE = 1024 * 1024
+
+
+class PkgCacheEntry(object):
+    """Index entry of one cached package"""
+    def __init__(self, fmri, digest, size, atime):
+        self.fmri = fmri
+        self.digest = digest
+        self.size = size
+        self.atime = atime
+
+
+class PkgCache(object):
+    """Content addressed cache of IPS package archives. A process should
+    have only one object of a cache open at a time, closing the use lock
+    of one drops the lock of all of them.
+    """
+
+    def __init__(self, root, max_size=0, log_handler=None):
+        """Open the cache in directory root, creating it if needed.
+		max_size is the size limit in bytes, 0 for no limit.
+		Raises OSError if the cache can't be created.
+		"""
+        self.root = root
+        self.max_size = max_size
+        self.log_handler = log_handler
+        self.hits = 0
+        self.misses = 0
+        self.bytes_reused = 0
+        self.bytes_fetched = 0
+        self._in_use = set()
+        self._lock = threading.Lock()
+
+        for subdir in [root, os.path.join(root, "objects"),
+                       os.path.join(root, "tmp")]:
+            try:
+                os.mkdir(subdir, 0755)
+            except OSError, err:
+                if err.errno != errno.EEXIST:
+                    raise
+
+        # Held until close(), so that other processes keep our archives
+        self._usefd = os.open(os.path.join(root, "use"),
+                              os.O_RDWR | os.O_CREAT, 0644)
+        try:
+            fcntl.lockf(self._usefd, fcntl.LOCK_SH)
+        except IOError:
+            os.close(self._usefd)
+            raise
+
+    def dbg_msg(self, msg):
+        """Log a debugging message to logging service"""
+        if self.log_handler is not None:
+            self.log_handler.debug(msg)
+        else:
+            logsvc.write_dbg(TRANSFER_ID, logsvc.LS_DBGLVL_INFO,
+                             msg + "\n")
+
+    def object_path(self, digest):
+        """Return pathname of the archive with given SHA-1"""
+        return os.path.join(self.root, "objects", digest[:2],
+                            digest + ".p5p")
+
+    @staticmethod
+    def hash_file(path):
+        """Return SHA-1 of file contents as hex string"""
+        sha = hashlib.sha1()
+        with open(path, "rb") as fh:
+            while True:
+                buf = fh.read(HASH_BUFSIZE)
+                if not buf:
+                    break
+                sha.update(buf)
+        return sha.hexdigest()
+
+    def _update_index(self, func):
+        """Read the index, let func modify the dictionary of entries
+		and write it back, all under the cache lock, so that several
+		threads and processes can share the cache. Returns the value
+		returned by func.
+		"""
+        self._lock.acquire()
+        lockfd = os.open(os.path.join(self.root, "lock"),
+                         os.O_RDWR | os.O_CREAT, 0644)
+        try:
+            fcntl.lockf(lockfd, fcntl.LOCK_EX)
+            index = {}
+            try:
+                with open(os.path.join(self.root, "index"), "r") as fh:
+                    for line in fh:
+                        fields = line.split()
+                        # entries of unversioned names are dropped
+                        if len(fields) != 4 or "@" not in fields[0]:
+                            continue
+                        index[fields[0]] = PkgCacheEntry(fields[0],
+                            fields[1], int(fields[2]), float(fields[3]))
+            except IOError, err:
+                if err.errno != errno.ENOENT:
+                    raise
+
+            ret = func(index)
+
+            tmp = os.path.join(self.root, "index.tmp")
+            with open(tmp, "w") as fh:
+                for ent in index.values():
+                    fh.write("%s %s %d %f\n" % (ent.fmri, ent.digest,
+                                                ent.size, ent.atime))
+            os.rename(tmp, os.path.join(self.root, "index"))
+            return ret
+        finally:
+            os.close(lockfd)
+            self._lock.release()
+
+    def _evict(self, index, keep):
+        """Remove least recently used archives until the cache fits
+		into its size limit. Archive keep and archives handed out
+		by this object are never removed. Nothing is removed while
+		other processes have the cache open, since their archives
+		aren't known here.
+		"""
+        if self.max_size <= 0 or self._usefd is None:
+            return
+
+        # Upgrading the read lock of this process fails while others hold
+        # theirs. The read lock is restored afterwards.
+        try:
+            fcntl.lockf(self._usefd, fcntl.LOCK_EX | fcntl.LOCK_NB)
+        except IOError, err:
+            if err.errno not in (errno.EAGAIN, errno.EACCES):
+                raise
+            self.dbg_msg("Package cache: in use by other processes, "
+                         "nothing removed")
+            return
+        try:
+            self._evict_unused(index, keep)
+        finally:
+            fcntl.lockf(self._usefd, fcntl.LOCK_SH)
+
+    def _evict_unused(self, index, keep):
+        """Remove archives for _evict() once no other process uses
+		the cache
+		"""
+        # Archives may be shared by several FMRIs
+        sizes = {}
+        for ent in index.values():
+            sizes[ent.digest] = ent.size
+        total = sum(sizes.values())
+
+        for ent in sorted(index.values(), key=lambda e: e.atime):
+            if total <= self.max_size:
+                break
+            if ent.digest == keep or ent.digest in self._in_use:
+                continue
+            del index[ent.fmri]
+            if ent.digest in [e.digest for e in index.values()]:
+                continue
+            total -= ent.size
+            try:
+                os.unlink(self.object_path(ent.digest))
+            except OSError:
+                pass
+            self.dbg_msg("Package cache: removed " + ent.fmri)
+
+    @staticmethod
+    def resolve(image, pkgs):
+        """Return FMRIs of all packages pkg would install into image
+		for pkgs, dependencies included. They are solved by pkg itself,
+		with the incorporations of the publisher, so that a package is
+		cached separately for every version and never in a version
+		the image wouldn't get.
+		Returns None if the packages can't be solved, the cache
+		shouldn't be used then.
+		"""
+        try:
+            pipe = sp.Popen([PKG, '-R', image, 'install', '-nv'] + pkgs,
+                            stdout=sp.PIPE, stderr=open(os.devnull, "w"),
+                            close_fds=True)
+            plan = pipe.communicate()[0]
+        except OSError:
+            return None
+        # nothing to install
+        if pipe.returncode == 4:
+            return []
+        if pipe.returncode != 0:
+            return None
+        fmris = PkgCache.plan_fmris(plan)
+        if not fmris:
+            return None
+        return fmris
+
+    @staticmethod
+    def plan_fmris(plan):
+        """Return FMRIs of packages to be installed from the output of
+		pkg install -nv. pkg(1) of this release has no parsable
+		output, so the format of its plan is relied upon: packages
+		are either listed as FMRIs, or as versions under package
+		names nested under publishers. If none are found, resolve()
+		fails and packages aren't cached.
+		"""
+        fmris = []
+        names = {}
+        for line in plan.splitlines():
+            fields = line.split()
+            indent = len(line) - len(line.lstrip())
+            if len(fields) == 1:
+                names[indent] = fields[0]
+                continue
+            if len(fields) != 3 or fields[1] != "->":
+                continue
+            if fields[2].startswith("pkg:"):
+                fmri = fields[2]
+            else:
+                outer = sorted([i for i in names if i < indent])
+                if len(outer) < 2:
+                    continue
+                fmri = "pkg://%s/%s@%s" % (names[outer[-2]],
+                                           names[outer[-1]], fields[2])
+            if "@" in fmri:
+                fmris.append(fmri)
+        return fmris
+
+    def lookup(self, fmri):
+        """Return pathname of archive with package fmri, or None if it
+		isn't cached or doesn't match its checksum any more.
+		"""
+        def touch(index):
+            ent = index.get(fmri)
+            if ent is not None:
+                ent.atime = time.time()
+                self._in_use.add(ent.digest)
+            return ent
+
+        ent = self._update_index(touch)
+        if ent is None:
+            return None
+
+        path = self.object_path(ent.digest)
+        try:
+            if self.hash_file(path) == ent.digest:
+                return path
+        except IOError:
+            pass
+
+        self.dbg_msg("Package cache: " + path + " of " + fmri +
+                     " is damaged, removed")
+        def remove(index):
+            if fmri in index:
+                del index[fmri]
+        self._update_index(remove)
+        try:
+            os.unlink(path)
+        except OSError:
+            pass
+        return None
+
+    def store(self, fmri, archive):
+        """Move archive with package fmri into the cache
+		Returns pathname of the cached archive.
+		"""
+        digest = self.hash_file(archive)
+        size = os.path.getsize(archive)
+        path = self.object_path(digest)
+        try:
+            os.mkdir(os.path.dirname(path), 0755)
+        except OSError, err:
+            if err.errno != errno.EEXIST:
+                raise
+        os.rename(archive, path)
+
+        def add(index):
+            index[fmri] = PkgCacheEntry(fmri, digest, size, time.time())
+            self._in_use.add(digest)
+            self._evict(index, digest)
+        self._update_index(add)
+        return path
+
+    def fetch(self, url, fmri):
+        """Return pathname of archive with package fmri, receiving it
+		from repository url if it isn't cached yet. fmri has to be
+		versioned, see resolve().
+		Returns None if the package couldn't be received.
+		"""
+        if "@" not in fmri:
+            return None
+
+        path = self.lookup(fmri)
+        size = None
+        if path is not None:
+            # It may have been removed by hand meanwhile
+            try:
+                size = os.path.getsize(path)
+            except OSError, err:
+                if err.errno != errno.ENOENT:
+                    raise
+        if size is not None:
+            self._lock.acquire()
+            self.hits += 1
+            self.bytes_reused += size
+            self._lock.release()
+            self.dbg_msg("Package cache: " + fmri + " found")
+            return path
+
+        tmpdir = tempfile.mkdtemp(dir=os.path.join(self.root, "tmp"))
+        archive = os.path.join(tmpdir, "pkg.p5p")
+        try:
+            cmd = [PKGRECV, '-s', url, '-a', '-d', archive, fmri]
+            try:
+                status = exec_cmd_outputs_to_log(cmd, self.log_handler)
+            except OSError:
+                status = -1
+            if status != 0 or not os.path.exists(archive):
+                self.dbg_msg("Package cache: failed executing " +
+                             " ".join(cmd))
+                return None
+            size = os.path.getsize(archive)
+            path = self.store(fmri, archive)
+        finally:
+            shutil.rmtree(tmpdir, ignore_errors=True)
+
+        self._lock.acquire()
+        self.misses += 1
+        self.bytes_fetched += size
+        self._lock.release()
+        self.dbg_msg("Package cache: " + fmri + " received")
+        return path
+
+    def export(self, repo):
+        """Receive all cached packages into package repository repo,
+		creating it if needed. The repository can be used by pkg(1)
+		as a file:// origin or served by pkg.depotd(1M).
+		Returns number of packages which couldn't be exported.
+		"""
+        if not os.path.exists(repo):
+            if exec_cmd_outputs_to_log([PKGREPO, 'create', repo],
+                                       self.log_handler) != 0:
+                raise OSError(errno.EIO, "Unable to create repository " +
+                              repo)
+
+        nfailed = 0
+        index = self._update_index(dict)
+        for ent in index.values():
+            cmd = [PKGRECV, '-s', self.object_path(ent.digest), '-d', repo,
+                   ent.fmri]
+            if exec_cmd_outputs_to_log(cmd, self.log_handler) != 0:
+                nfailed += 1
+        if exec_cmd_outputs_to_log([PKGREPO, '-s', repo, 'refresh'],
+                                   self.log_handler) != 0:
+            nfailed += 1
+        return nfailed
+
+    def close(self):
+        """Stop using the cache. Archives handed out by this object may
+		be removed from now on. If no other process uses the cache, it
+		is trimmed to its size limit, which may have been left to this
+		process by the others.
+		"""
+        if self._usefd is None:
+            return
+        self._in_use.clear()
+        if self.max_size > 0:
+            self._update_index(lambda index: self._evict(index, None))
+        os.close(self._usefd)
+        self._usefd = None
+
+    def stats(self):
+        """Return one line summary of cache use"""
+        return ("Package cache %s: %d hits, %d misses, %d MB reused, "
+                "%d MB received" % (self.root, self.hits, self.misses,
+                                   self.bytes_reused / (1024 * 1024),
+                                   self.bytes_fetched / (1024 * 1024)))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        print >> sys.stderr, "Usage: " + sys.argv[0] + " <cache> <repository>"
+        print >> sys.stderr, "    export cached packages into repository"
+        sys.exit(2)
+    CACHE = PkgCache(sys.argv[1])
+    NFAILED = CACHE.export(sys.argv[2])
+    CACHE.close()
+    sys.exit(NFAILED != 0)
@@ -0,0 +1,168 @@
+#!/usr/bin/python2.6
+#
+# CDDL HEADER START
+#
+# The contents of this file are subject to the terms of the
+# Common Development and Distribution License (the "License").
+# You may not use this file except in compliance with the License.
+#
+# You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+# or http://www.opensolaris.org/os/licensing.
+# See the License for the specific language governing permissions
+# and limitations under the License.
+#
+# When distributing Covered Code, include this CDDL HEADER in each
+# file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+# If applicable, add the following below this CDDL HEADER, with the
+# fields enclosed by brackets "[]" replaced with your own identifying
+# information: Portions Copyright [yyyy] [name of copyright owner]
+#
+# CDDL HEADER END
+#
+# Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+#
+# Test of TM_PERFORM_BLOCK. Unlike the other tests it needs no special
+# setup, images and targets are files created in /tmp. Writing to a device
+# is only tested if a scratch device or volume of at least 42MB is given
+# as argument, e.g. /dev/zvol/rdsk/rpool/scratch. Its contents are lost.
+#
+import os
+import sys
+import tempfile
+from libtransfer import *
+from osol_install.transfer_mod import tm_perform_transfer
+from osol_install.transfer_defs import *
+
+CHUNK = 1024 * 1024
+
+num_failed = 0
+tmpdir = tempfile.mkdtemp(prefix="test_block_write.")
+image = os.path.join(tmpdir, "image")
+target = os.path.join(tmpdir, "target")
+
+# Image with data separated by ranges of zeros, which shouldn't be written
+fh = open(image, "w")
+fh.write(os.urandom(3 * CHUNK + 100))
+fh.seek(20 * CHUNK)
+fh.write(os.urandom(5000))
+fh.seek(40 * CHUNK + 777)
+fh.write("x")
+fh.close()
+
+def same_contents(path1, path2):
+	"""Compare contents of two files"""
+	fh1 = open(path1)
+	fh2 = open(path2)
+	try:
+		while True:
+			buf1 = fh1.read(CHUNK)
+			buf2 = fh2.read(CHUNK)
+			if buf1 != buf2:
+				return False
+			if not buf1:
+				return True
+	finally:
+		fh1.close()
+		fh2.close()
+
+def on_device(path, device):
+	"""Compare contents of file with the beginning of device, which is
+	read in whole chunks"""
+	fh1 = open(path)
+	fh2 = open(device)
+	try:
+		while True:
+			buf1 = fh1.read(CHUNK)
+			if not buf1:
+				return True
+			buf2 = fh2.read(CHUNK)
+			if buf1 != buf2[:len(buf1)]:
+				return False
+	finally:
+		fh1.close()
+		fh2.close()
+
+print "Testing valid image and new target file.  should PASS"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_BLOCK),
+    (TM_BLOCK_IMAGE, image),
+    (TM_BLOCK_TARGET, target)])
+if status == TM_E_SUCCESS and same_contents(image, target):
+	print "PASSED"
+else:
+	num_failed += 1
+	print "FAILED"
+
+print "Testing zero ranges left as holes in target.  should PASS"
+if os.stat(target).st_blocks * 512 < 10 * CHUNK:
+	print "PASSED"
+else:
+	num_failed += 1
+	print "FAILED"
+
+print "Testing existing target with garbage, verified.  should PASS"
+fh = open(target, "w")
+fh.write("\xff" * (50 * CHUNK))
+fh.close()
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_BLOCK),
+    (TM_BLOCK_IMAGE, image),
+    (TM_BLOCK_TARGET, target),
+    (TM_BLOCK_VERIFY, "true")])
+if status == TM_E_SUCCESS and same_contents(image, target):
+	print "PASSED"
+else:
+	num_failed += 1
+	print "FAILED"
+
+if len(sys.argv) > 1:
+	device = sys.argv[1]
+	print "Testing zero ranges written to device with garbage.  should PASS"
+	fh = open(device, "w")
+	for i in range(42):
+		fh.write("\xff" * CHUNK)
+	fh.close()
+	status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_BLOCK),
+	    (TM_BLOCK_IMAGE, image),
+	    (TM_BLOCK_TARGET, device)])
+	if status == TM_E_SUCCESS and on_device(image, device):
+		print "PASSED"
+	else:
+		num_failed += 1
+		print "FAILED"
+
+print "Testing missing TM_BLOCK_TARGET, should FAIL"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_BLOCK),
+    (TM_BLOCK_IMAGE, image)])
+if status == TM_E_SUCCESS:
+	num_failed += 1
+	print "PASSED"
+else:
+	print "FAILED"
+
+print "Testing invalid image. Should FAIL"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_BLOCK),
+    (TM_BLOCK_IMAGE, os.path.join(tmpdir, "missing")),
+    (TM_BLOCK_TARGET, target)])
+if status == TM_E_SUCCESS:
+	num_failed += 1
+	print "PASSED"
+else:
+	print "FAILED"
+
+print "Testing invalid target. Should FAIL"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_BLOCK),
+    (TM_BLOCK_IMAGE, image),
+    (TM_BLOCK_TARGET, os.path.join(tmpdir, "missing", "target"))])
+if status == TM_E_SUCCESS:
+	num_failed += 1
+	print "PASSED"
+else:
+	print "FAILED"
+
+os.unlink(image)
+os.unlink(target)
+os.rmdir(tmpdir)
+
+if num_failed != 0:
+	print "Check your results %d tests did not perform as expected" % num_failed
+else:
+	print "Tests performed as expected"
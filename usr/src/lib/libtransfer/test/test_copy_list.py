@@ -0,0 +1,158 @@
+#!/usr/bin/python2.6
+#
+# CDDL HEADER START
+#
+# The contents of this file are subject to the terms of the
+# Common Development and Distribution License (the "License").
+# You may not use this file except in compliance with the License.
+#
+# You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+# or http://www.opensolaris.org/os/licensing.
+# See the License for the specific language governing permissions
+# and limitations under the License.
+#
+# When distributing Covered Code, include this CDDL HEADER in each
+# file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+# If applicable, add the following below this CDDL HEADER, with the
+# fields enclosed by brackets "[]" replaced with your own identifying
+# information: Portions Copyright [yyyy] [name of copyright owner]
+#
+# CDDL HEADER END
+#
+# Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+#
+from libtransfer import *
+from osol_install.transfer_mod import tm_perform_transfer
+from osol_install.transfer_defs import *
+
+num_failed = 0
+
+print "Testing valid src, dest, and file.  should PASS"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_COPY),
+    (TM_CPIO_ACTION, TM_CPIO_LIST),
+    (TM_CPIO_LIST_FILE, '/export/home/jeanm/transfer_mod_test/file_list'),
+    (TM_CPIO_DST_MNTPT, '/export/home/copy_list1'),
+    (TM_CPIO_SRC_MNTPT, '/usr/sbin')])
+if status == TM_E_SUCCESS:
+	print "PASSED"
+else:
+	num_failed += 1
+	print "FAILED"
+
+print "Testing valid src, dest, and file, 1 thread.  should PASS"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_COPY),
+    (TM_CPIO_ACTION, TM_CPIO_LIST),
+    (TM_CPIO_LIST_FILE, '/export/home/jeanm/transfer_mod_test/file_list'),
+    (TM_CPIO_DST_MNTPT, '/export/home/copy_list2'),
+    (TM_CPIO_SRC_MNTPT, '/usr/sbin'),
+    (TM_COPY_THREADS, '1')])
+if status == TM_E_SUCCESS:
+	print "PASSED"
+else:
+	num_failed += 1
+	print "FAILED"
+
+print "Testing entire src copied while walked. should PASS"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_COPY),
+    (TM_CPIO_ACTION, TM_CPIO_ENTIRE),
+    (TM_ATTR_IMAGE_INFO, '/export/home/jeanm/transfer_mod_test/.image_info'),
+    (TM_CPIO_DST_MNTPT, '/export/home/copy_entire1'),
+    (TM_CPIO_SRC_MNTPT, '/usr/sbin')])
+if status == TM_E_SUCCESS:
+	print "PASSED"
+else:
+	num_failed += 1
+	print "FAILED"
+
+print "Testing entire src read ahead, then copied. should PASS"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_COPY),
+    (TM_CPIO_ACTION, TM_CPIO_ENTIRE),
+    (TM_ATTR_IMAGE_INFO, '/export/home/jeanm/transfer_mod_test/.image_info'),
+    (TM_CPIO_DST_MNTPT, '/export/home/copy_entire2'),
+    (TM_CPIO_SRC_MNTPT, '/usr/sbin'),
+    (TM_WAIT_TARGET, 'true')])
+if status == TM_E_SUCCESS:
+	print "PASSED"
+else:
+	num_failed += 1
+	print "FAILED"
+
+print "Testing entire src copied again, only changes. should PASS"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_COPY),
+    (TM_CPIO_ACTION, TM_CPIO_ENTIRE),
+    (TM_ATTR_IMAGE_INFO, '/export/home/jeanm/transfer_mod_test/.image_info'),
+    (TM_CPIO_DST_MNTPT, '/export/home/copy_entire1'),
+    (TM_CPIO_SRC_MNTPT, '/usr/sbin'),
+    (TM_COPY_DELTA, 'true')])
+if status == TM_E_SUCCESS:
+	print "PASSED"
+else:
+	num_failed += 1
+	print "FAILED"
+
+print "Testing valid src, dest, and file into empty dest, only changes. " \
+    "should PASS"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_COPY),
+    (TM_CPIO_ACTION, TM_CPIO_LIST),
+    (TM_CPIO_LIST_FILE, '/export/home/jeanm/transfer_mod_test/file_list'),
+    (TM_CPIO_DST_MNTPT, '/export/home/copy_list4'),
+    (TM_CPIO_SRC_MNTPT, '/usr/sbin'),
+    (TM_COPY_DELTA, 'true')])
+if status == TM_E_SUCCESS:
+	print "PASSED"
+else:
+	num_failed += 1
+	print "FAILED"
+
+print "Testing invalid number of threads. Should FAIL"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_COPY),
+    (TM_CPIO_ACTION, TM_CPIO_LIST),
+    (TM_CPIO_LIST_FILE, '/export/home/jeanm/transfer_mod_test/file_list'),
+    (TM_CPIO_DST_MNTPT, '/export/home/copy_list1'),
+    (TM_CPIO_SRC_MNTPT, '/usr/sbin'),
+    (TM_COPY_THREADS, 'many')])
+if status == TM_E_SUCCESS:
+	num_failed += 1
+	print "PASSED"
+else:
+	print "FAILED"
+
+print "Testing missing TM_CPIO_LIST_FILE, should FAIL"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_COPY),
+    (TM_CPIO_ACTION, TM_CPIO_LIST),
+    (TM_CPIO_DST_MNTPT, '/export/home/copy_list1'),
+    (TM_CPIO_SRC_MNTPT, '/usr/sbin')])
+if status == TM_E_SUCCESS:
+	num_failed += 1
+	print "PASSED"
+else:
+	print "FAILED"
+
+print "Testing invalid src. Should FAIL"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_COPY),
+    (TM_CPIO_ACTION, TM_CPIO_LIST),
+    (TM_CPIO_LIST_FILE, '/export/home/jeanm/transfer_mod_test/file_list'),
+    (TM_CPIO_DST_MNTPT, '/export/home/copy_list3'),
+    (TM_CPIO_SRC_MNTPT, '/usr/jean')])
+if status == TM_E_SUCCESS:
+	num_failed += 1
+	print "PASSED"
+else:
+	print "FAILED"
+
+print "Testing invalid dst. Should FAIL"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_COPY),
+    (TM_CPIO_ACTION, TM_CPIO_LIST),
+    (TM_CPIO_LIST_FILE, '/export/home/jeanm/transfer_mod_test/file_list'),
+    (TM_CPIO_DST_MNTPT, '/export/home/missing'),
+    (TM_CPIO_SRC_MNTPT, '/usr/sbin')])
+if status == TM_E_SUCCESS:
+	num_failed += 1
+	print "PASSED"
+else:
+	print "FAILED"
+
+if num_failed != 0:
+	print "Check your results %d tests did not perform as expected" % num_failed
+else:
+	print "Tests performed as expected"
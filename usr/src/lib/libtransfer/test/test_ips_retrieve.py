@@ -39,6 +39,78 @@ else:
 	num_failed += 1
 	print "FAIL"
 
+# The local repository can be populated with pkgrecv(1), e.g.
+# pkgrepo create /export/home/repo
+# pkgrecv -s http://pkg.opensolaris.org/release -d /export/home/repo \
+#     `cat ./pkg_file.txt`
+print "Test valid pkg file, parallel retrieval from local repository. " \
+    "Should PASS"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_IPS),
+	    (TM_IPS_ACTION, TM_IPS_RETRIEVE),
+	    (TM_IPS_PKGS, '/export/home/jeanm/transfer_mod_test/pkg_file.txt'),
+	    (TM_IPS_PKG_URL, 'file:///export/home/repo'),
+	    (TM_IPS_FETCH_THREADS, '4'),
+	    (TM_IPS_INIT_MNTPT, '/export/home/test4')])
+if status == TM_E_SUCCESS:
+	print "PASS"
+else:
+	num_failed += 1
+	print "FAIL"
+
+print "Test missing pkg, parallel retrieval. Should FAIL"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_IPS),
+	    (TM_IPS_ACTION, TM_IPS_RETRIEVE),
+	    (TM_IPS_PKGS, './pkg_missing_file.txt'),
+	    (TM_IPS_PKG_URL, 'file:///export/home/repo'),
+	    (TM_IPS_FETCH_THREADS, '4'),
+	    (TM_IPS_INIT_MNTPT, '/export/home/test1')])
+if status == TM_E_SUCCESS:
+	num_failed += 1
+	print "PASS"
+else:
+	print "FAIL"
+
+print "Test valid pkg file, packages retrieved through package cache. " \
+    "Should PASS"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_IPS),
+	    (TM_IPS_ACTION, TM_IPS_RETRIEVE),
+	    (TM_IPS_PKGS, '/export/home/jeanm/transfer_mod_test/pkg_file.txt'),
+	    (TM_IPS_PKG_URL, 'file:///export/home/repo'),
+	    (TM_IPS_CACHE_DIR, '/export/home/pkg_cache'),
+	    (TM_IPS_CACHE_SIZE, '1024'),
+	    (TM_IPS_INIT_MNTPT, '/export/home/test5')])
+if status == TM_E_SUCCESS:
+	print "PASS"
+else:
+	num_failed += 1
+	print "FAIL"
+
+print "Test invalid package cache size. Should FAIL"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_IPS),
+	    (TM_IPS_ACTION, TM_IPS_RETRIEVE),
+	    (TM_IPS_PKGS, './pkg_file.txt'),
+	    (TM_IPS_PKG_URL, 'file:///export/home/repo'),
+	    (TM_IPS_CACHE_DIR, '/export/home/pkg_cache'),
+	    (TM_IPS_CACHE_SIZE, 'big'),
+	    (TM_IPS_INIT_MNTPT, '/export/home/test1')])
+if status == TM_E_SUCCESS:
+	num_failed += 1
+	print "PASS"
+else:
+	print "FAIL"
+
+print "Test invalid number of fetch threads. Should FAIL"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_IPS),
+	    (TM_IPS_ACTION, TM_IPS_RETRIEVE),
+	    (TM_IPS_PKGS, './pkg_file.txt'),
+	    (TM_IPS_FETCH_THREADS, 'many'),
+	    (TM_IPS_INIT_MNTPT, '/export/home/test1')])
+if status == TM_E_SUCCESS:
+	num_failed += 1
+	print "PASS"
+else:
+	print "FAIL"
+
 print "Test missing TM_IPS_PKGS. Should FAIL"
 status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_IPS),
 	    (TM_IPS_ACTION, TM_IPS_RETRIEVE),
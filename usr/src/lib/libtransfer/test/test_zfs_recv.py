@@ -0,0 +1,91 @@
+#!/usr/bin/python2.6
+#
+# CDDL HEADER START
+#
+# The contents of this file are subject to the terms of the
+# Common Development and Distribution License (the "License").
+# You may not use this file except in compliance with the License.
+#
+# You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+# or http://www.opensolaris.org/os/licensing.
+# See the License for the specific language governing permissions
+# and limitations under the License.
+#
+# When distributing Covered Code, include this CDDL HEADER in each
+# file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+# If applicable, add the following below this CDDL HEADER, with the
+# fields enclosed by brackets "[]" replaced with your own identifying
+# information: Portions Copyright [yyyy] [name of copyright owner]
+#
+# CDDL HEADER END
+#
+# Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+#
+from libtransfer import *
+from osol_install.transfer_mod import tm_perform_transfer
+from osol_install.transfer_defs import *
+
+num_failed = 0
+
+print "Testing valid stream and dataset.  should PASS"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_ZFS_RECV),
+    (TM_ZFS_STREAM, '/export/home/jeanm/transfer_mod_test/solaris.zstream'),
+    (TM_ZFS_DATASET, 'rpool/zfs_recv1')])
+if status == TM_E_SUCCESS:
+	print "PASSED"
+else:
+	num_failed += 1
+	print "FAILED"
+
+print "Testing missing TM_ZFS_STREAM, should FAIL"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_ZFS_RECV),
+    (TM_ZFS_DATASET, 'rpool/zfs_recv1')])
+if status == TM_E_SUCCESS:
+	num_failed += 1
+	print "PASSED"
+else:
+	print "FAILED"
+
+print "Testing missing TM_ZFS_DATASET, should FAIL"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_ZFS_RECV),
+    (TM_ZFS_STREAM, '/export/home/jeanm/transfer_mod_test/solaris.zstream')])
+if status == TM_E_SUCCESS:
+	num_failed += 1
+	print "PASSED"
+else:
+	print "FAILED"
+
+print "Testing invalid stream. Should FAIL"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_ZFS_RECV),
+    (TM_ZFS_STREAM, '/export/home/jeanm/transfer_mod_test/missing'),
+    (TM_ZFS_DATASET, 'rpool/zfs_recv1')])
+if status == TM_E_SUCCESS:
+	num_failed += 1
+	print "PASSED"
+else:
+	print "FAILED"
+
+print "Testing stream which is not a ZFS stream. Should FAIL"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_ZFS_RECV),
+    (TM_ZFS_STREAM, '/export/home/jeanm/transfer_mod_test/file_list'),
+    (TM_ZFS_DATASET, 'rpool/zfs_recv1')])
+if status == TM_E_SUCCESS:
+	num_failed += 1
+	print "PASSED"
+else:
+	print "FAILED"
+
+print "Testing invalid dataset. Should FAIL"
+status = tm_perform_transfer([(TM_ATTR_MECHANISM, TM_PERFORM_ZFS_RECV),
+    (TM_ZFS_STREAM, '/export/home/jeanm/transfer_mod_test/solaris.zstream'),
+    (TM_ZFS_DATASET, 'nopool/zfs_recv1')])
+if status == TM_E_SUCCESS:
+	num_failed += 1
+	print "PASSED"
+else:
+	print "FAILED"
+
+if num_failed != 0:
+	print "Check your results %d tests did not perform as expected" % num_failed
+else:
+	print "Tests performed as expected"
@@ -51,6 +51,9 @@ TM_IPS_INIT_MNTPT = TM_DEFINES['TM_IPS_INIT_MNTPT'].strip('"')
 TM_IPS_PKGS = TM_DEFINES['TM_IPS_PKGS'].strip('"')
 TM_PERFORM_CPIO = int(TM_DEFINES['TM_PERFORM_CPIO'])
 TM_PERFORM_IPS = int(TM_DEFINES['TM_PERFORM_IPS'])
+TM_PERFORM_COPY = int(TM_DEFINES['TM_PERFORM_COPY'])
+TM_PERFORM_ZFS_RECV = int(TM_DEFINES['TM_PERFORM_ZFS_RECV'])
+TM_PERFORM_BLOCK = int(TM_DEFINES['TM_PERFORM_BLOCK'])
 TM_CPIO_ENTIRE = int(TM_DEFINES['TM_CPIO_ENTIRE'])
 TM_CPIO_LIST = int(TM_DEFINES['TM_CPIO_LIST'])
 TM_IPS_INIT_RETRY_TIMEOUT = TM_DEFINES['TM_IPS_INIT_RETRY_TIMEOUT'].strip('"')
@@ -81,6 +84,17 @@ TM_IPS_REFRESH_CATALOG = TM_DEFINES['TM_IPS_REFRESH_CATALOG'].strip('"')
 TM_IPS_PROP_NAME = TM_DEFINES['TM_IPS_PROP_NAME'].strip('"')
 TM_IPS_PROP_VALUE = TM_DEFINES['TM_IPS_PROP_VALUE'].strip('"')
 TM_IPS_ALT_URL = TM_DEFINES['TM_IPS_ALT_URL'].strip('"')
+TM_IPS_FETCH_THREADS = TM_DEFINES['TM_IPS_FETCH_THREADS'].strip('"')
+TM_IPS_CACHE_DIR = TM_DEFINES['TM_IPS_CACHE_DIR'].strip('"')
+TM_IPS_CACHE_SIZE = TM_DEFINES['TM_IPS_CACHE_SIZE'].strip('"')
+TM_COPY_THREADS = TM_DEFINES['TM_COPY_THREADS'].strip('"')
+TM_COPY_DELTA = TM_DEFINES['TM_COPY_DELTA'].strip('"')
+TM_ZFS_STREAM = TM_DEFINES['TM_ZFS_STREAM'].strip('"')
+TM_ZFS_DATASET = TM_DEFINES['TM_ZFS_DATASET'].strip('"')
+TM_BLOCK_IMAGE = TM_DEFINES['TM_BLOCK_IMAGE'].strip('"')
+TM_BLOCK_TARGET = TM_DEFINES['TM_BLOCK_TARGET'].strip('"')
+TM_BLOCK_VERIFY = TM_DEFINES['TM_BLOCK_VERIFY'].strip('"')
+TM_WAIT_TARGET = TM_DEFINES['TM_WAIT_TARGET'].strip('"')
 
 # The following is only useful for python code, not C code.  So, it will 
 # only be defined here, instead of being defined in transfermod.h
@@ -23,6 +23,8 @@
 """ Slim Install Transfer Module """
 import errno
 import operator
+import Queue
+import shutil
 import sys
 import time
 import os
@@ -35,6 +37,7 @@ import re
 import liblogsvc as logsvc
 import libtransfer as tmod
 from osol_install.install_utils import exec_cmd_outputs_to_log
+from osol_install.pkg_cache import PkgCache
 from osol_install.transfer_defs import TRANSFER_ID, \
     TM_ATTR_IMAGE_INFO, \
     TM_ATTR_MECHANISM, \
@@ -45,12 +48,23 @@ from osol_install.transfer_defs import TRANSFER_ID, \
     TM_CPIO_LIST_FILE, \
     TM_CPIO_ENTIRE_SKIP_FILE_LIST, \
     TM_CPIO_ARGS, \
+    TM_COPY_THREADS, \
+    TM_COPY_DELTA, \
     TM_IPS_PKG_URL, \
     TM_IPS_PKG_AUTH, \
     TM_IPS_INIT_MNTPT, \
     TM_IPS_PKGS, \
     TM_PERFORM_CPIO, \
     TM_PERFORM_IPS, \
+    TM_PERFORM_COPY, \
+    TM_PERFORM_ZFS_RECV, \
+    TM_ZFS_STREAM, \
+    TM_ZFS_DATASET, \
+    TM_PERFORM_BLOCK, \
+    TM_BLOCK_IMAGE, \
+    TM_BLOCK_TARGET, \
+    TM_BLOCK_VERIFY, \
+    TM_WAIT_TARGET, \
     TM_CPIO_ENTIRE, \
     TM_CPIO_LIST, \
     TM_IPS_INIT, \
@@ -74,6 +88,9 @@ from osol_install.transfer_defs import TRANSFER_ID, \
     TM_IPS_PROP_VALUE, \
     TM_IPS_ALT_URL, \
     TM_IPS_INIT_RETRY_TIMEOUT, \
+    TM_IPS_FETCH_THREADS, \
+    TM_IPS_CACHE_DIR, \
+    TM_IPS_CACHE_SIZE, \
     TM_PYTHON_LOG_HANDLER, \
     TM_E_SUCCESS, \
     TM_E_INVALID_TRANSFER_TYPE_ATTR, \
@@ -89,6 +106,10 @@ from osol_install.transfer_defs import TRANSFER_ID, \
     TM_E_IPS_SET_AUTH_FAILED, \
     TM_E_IPS_UNSET_AUTH_FAILED, \
     TM_E_IPS_SET_PROP_FAILED, \
+    TM_E_INVALID_ZFS_ATTR, \
+    TM_E_ZFS_RECV_FAILED, \
+    TM_E_INVALID_BLOCK_ATTR, \
+    TM_E_BLOCK_WRITE_FAILED, \
     TM_E_PYTHON_ERROR 
 
 class TMDefs(object):
@@ -97,37 +118,65 @@ class TMDefs(object):
     FIND_PERCENT = 4
     CPIO = "/usr/bin/cpio"
     PKG = "/usr/bin/pkg"
+    PKGRECV = "/usr/bin/pkgrecv"
+    PKGREPO = "/usr/bin/pkgrepo"
     MOUNT = "/usr/sbin/mount -o ro,nologging "
     GZCAT = "/usr/bin/gzcat "
     GZCAT_DST = "/var/run/boot_archive"
     PKG_EXIT_SUCCESS = 0
     PKG_EXIT_NOP = 4
-	
+    # packages fetched in parallel if only the package cache is asked for
+    DEFAULT_FETCH_THREADS = 4
+    # at most this part of physical memory is read ahead while waiting
+    # for the target, so that it stays in the page cache
+    PREFETCH_MEM_FRACTION = 4
+    # names of the install timeline spans, see logsvc.span_end()
+    MECHANISM_SPANS = {TM_PERFORM_CPIO: "cpio", TM_PERFORM_COPY: "copy",
+                       TM_PERFORM_IPS: "ips",
+                       TM_PERFORM_ZFS_RECV: "zfs_recv",
+                       TM_PERFORM_BLOCK: "block"}
+    IPS_SPANS = {TM_IPS_INIT: "ips_image_create",
+                 TM_IPS_REPO_CONTENTS_VERIFY: "ips_contents_verify",
+                 TM_IPS_RETRIEVE: "ips_install",
+                 TM_IPS_SET_AUTH: "ips_set_publisher",
+                 TM_IPS_REFRESH: "ips_refresh",
+                 TM_IPS_UNSET_AUTH: "ips_unset_publisher",
+                 TM_IPS_PURGE_HIST: "ips_purge_history",
+                 TM_IPS_UNINSTALL: "ips_uninstall",
+                 TM_IPS_SET_PROP: "ips_set_property"}
+
     def __init__(self):
         self.tm_lock = None
-        self.do_abort = 0
         self.percent = 0.0
 
 class CpioSpec(object):
     """Class used to hold values specifying a mountpoint for cpio operation"""
     def __init__(self, chdir_prefix=None, cpio_dir=None,
         match_pattern=None, clobber_files=0, cpio_args="pdum",
-        file_list=None):
+        file_list=None, manifest=None):
         self.chdir_prefix = chdir_prefix
         self.cpio_dir = cpio_dir
         self.match_pattern = match_pattern
         self.clobber_files = clobber_files
         self.cpio_args = cpio_args
         self.file_list = file_list
+        self.manifest = manifest
 
 class Flist(object):
-    """ Class used to hold file list entries for cpio operation """
+    """ Class used to hold file list entries for cpio operation.
+    If cpio_dir is set, there is no file list. The native copier walks
+    that directory under chdir_prefix while copying it instead.
+    If manifest is set, the list was taken from that image content
+    manifest and the native copier reads it instead of the list.
+    """
     def __init__(self, name=None, chdir_prefix=None, clobber_files=0,
-                 cpio_args=None):
+                 cpio_args=None, cpio_dir=None, manifest=None):
         self.name = name
         self.chdir_prefix = chdir_prefix
         self.clobber_files = clobber_files
         self.cpio_args = cpio_args
+        self.cpio_dir = cpio_dir
+        self.manifest = manifest
         self.handle = None
 
     def open(self):
@@ -174,14 +223,83 @@ class TIPSPkgmissing(TError):
 
 def tm_abort_transfer():
     """Method to signal to abort the transfer"""
-    if PARAMS.tm_lock.locked():
+    # The cancel token is shared with the native copiers, ZFS stream
+    # receive and block image write, which don't hold the interpreter
+    # lock, and it wakes threads waiting in tmod.cancel_wait().
+    tmod.cancel()
+    if PARAMS.tm_lock is not None and PARAMS.tm_lock.locked():
         PARAMS.tm_lock.release()
-    else:
-        PARAMS.do_abort = 1
+
+def tm_reset_abort():
+    """Method to forget abort signaled before, called once when an
+	install starts rather than for every transfer, so that abort
+	signaled between transfers of the install is not lost"""
+    tmod.cancel_reset()
 
 def tm_abort_signaled():
     """Method to detect abort"""
-    return PARAMS.do_abort
+    return tmod.cancelled()
+
+def tm_wait_target(sources, info_msg, err_code):
+    """Read the source of the transfer ahead while the installer
+	prepares the target, then wait for the target to be ready.
+	sources -- list of (directory, list file, directory to walk)
+	           tuples, see tmod.prefetch()
+	info_msg -- function logging informational messages
+	err_code -- return code if the target couldn't be prepared
+	Raises TAbort if the target couldn't be prepared or the transfer
+	was aborted.
+	"""
+    start = time.time()
+    try:
+        budget = os.sysconf("SC_PHYS_PAGES") * os.sysconf("SC_PAGESIZE") / \
+            TMDefs.PREFETCH_MEM_FRACTION
+    except (ValueError, OSError):
+        budget = 0
+
+    nread = 0
+    span = logsvc.span_begin()
+    for (src, flist, fdir) in sources:
+        if nread >= budget:
+            break
+        (ret, num) = tmod.prefetch(src, flist or "", fdir or "",
+                                   budget - nread)
+        nread += num
+    logsvc.span_end(span, "transfer", "prefetch",
+                    "%d MB" % (nread / (1024 * 1024)))
+    prepared = time.time()
+
+    span = logsvc.span_begin()
+    ret = tmod.target_wait()
+    logsvc.span_end(span, "transfer", "target_wait")
+    info_msg("Read %d MB of the source ahead in %.1f s, waited %.1f s "
+             "for the target" % (nread / (1024 * 1024), prepared - start,
+                                 time.time() - prepared))
+    if ret == errno.EINTR:
+        raise TAbort("User aborted transfer")
+    if ret != 0:
+        raise TAbort("Target of the transfer couldn't be prepared",
+                     err_code)
+
+class TMProgress(object):
+    """Snapshot of file transfer progress, see tm_get_progress()"""
+    def __init__(self, active=False, bytes_done=0, bytes_total=0,
+        files_done=0, throughput=0, eta=0, path=""):
+        self.active = active
+        self.bytes_done = bytes_done
+        self.bytes_total = bytes_total
+        self.files_done = files_done
+        self.throughput = throughput
+        self.eta = eta
+        self.path = path
+
+def tm_get_progress():
+    """Return progress of running file transfer as TMProgress object.
+	Bytes and files done are exact for TM_PERFORM_COPY, estimated
+	from file system usage for TM_PERFORM_CPIO. Throughput (bytes per
+	second) and eta (seconds remaining) are 0 until known.
+	"""
+    return TMProgress(*tmod.get_progress())
 
 class ProgressMon(object):
     """The ProgressMon class contains methods to monitor
@@ -194,48 +312,71 @@ class ProgressMon(object):
         self.initpct = initpct
         self.endpct = endpct
         self.done = done
+        self.copied = False
         self.thread1 = None
+        self.wakeup = None
 
     def startmonitor(self, filesys, distrosize, message, initpct=0,
-        endpct=100):
+        endpct=100, copied=False):
         """Start thread to monitor progress in populating file system
            filesys - file system to monitor
            distrosize = full distro size in kilobytes
            message = progress message to log. 
            initpct = base percent value from which to start calculating.
            endpct = percentage value at which to stop calculating
+           copied = if True, progress is computed from bytes written
+                    by the native copier rather than from file system
+                    usage, which is then published as estimated bytes
+                    transferred
            """
         self.message =	message
         self.distrosize = distrosize
         self.initpct = initpct
         self.endpct = endpct
+        self.copied = copied
         self.done = False
+        # The thread sleeps on this pipe between updates, so that it can
+        # be stopped without waiting for the next update
+        self.wakeup = os.pipe()
         self.thread1 = threading.Thread(target=self.__progressthread,
                                         args=(filesys, ))
         self.thread1.start()
         return 0
 
     def wait(self):
-        """Wait"""
+        """Stop the monitor if it was marked done and wait for it"""
+        if self.done:
+            os.write(self.wakeup[1], "x")
         self.thread1.join()
+        os.close(self.wakeup[0])
+        os.close(self.wakeup[1])
 
     def __progressthread(self, filesystem):
         """Monitor progress in populating file system
               filesystem - file system to monitor
            """
-        initsize = self.__fssize(filesystem)
+        initsize = self.__size(filesystem)
         totpct = self.endpct - self.initpct
         prevpct = -1
 
+        # Counters of the native copier are cheap to read, file system
+        # usage is sampled by running df.
+        if self.copied:
+            interval = 0.5
+        else:
+            interval = 2
+
         # Loop until the user aborts or we're done transferring.
         # Keep track of the percentage done and let the user know
         # how far the transfer has progressed.
         while True:
             # Compute increase in filesystem size
-            fssz = self.__fssize(filesystem)
+            fssz = self.__size(filesystem)
             if (fssz == -1):
                 return -1
             fsgain = fssz - initsize
+            if not self.copied:
+                tmod.progress_set(max(fsgain, 0) * 1024)
 
             # Compute percentage transfer
             actualpct = fsgain * 100 / self.distrosize
@@ -251,10 +392,18 @@ class ProgressMon(object):
                 prevpct = pct
             if pct >= self.endpct:
                 return 0
-            time.sleep(2)
+            # Returns early if the transfer is cancelled or the
+            # monitor stopped
+            tmod.cancel_wait(self.wakeup[0], int(interval * 1000))
             if tm_abort_signaled() or self.done:
                 return 0
 
+    def __size(self, filesystem):
+        """Amount of data transferred so far in kilobytes"""
+        if self.copied:
+            return int(tmod.get_progress()[1] / 1024)
+        return self.__fssize(filesystem)
+
     @staticmethod
     def __fssize(filesystem):
         """Find the current size of the specified file system.
@@ -298,6 +447,10 @@ class TransferCpio(object):
         self.image_info = ""
         self.distro_size = 0
         self.log_handler = None
+        self.mechanism = TM_PERFORM_CPIO
+        self.copy_threads = 0
+        self.copy_delta = False
+        self.wait_target = False
 
         # This is live media specific and shouldn't be part
         # of transfer mod.
@@ -318,10 +471,12 @@ class TransferCpio(object):
         # There will not be a os.walk() of the "chdir_prefix".
         # The "chdir_prefix" value is still important here, because
         # the content list is generated assuming "chdir_prefix"
-        # is the root.
+        # is the root. If the image content manifest generated from
+        # the list is available, pathnames are taken from it instead.
         self.cpio_prefixes.append(CpioSpec(chdir_prefix="/.cdrom", \
                                   cpio_dir=".", \
-                                  file_list="/.cdrom/.livecd-cdrom-content"))
+                                  file_list="/.cdrom/.livecd-cdrom-content", \
+                                  manifest="/.cdrom/.livecd-cdrom-manifest"))
 			
 	
     def info_msg(self, msg):
@@ -378,17 +533,50 @@ class TransferCpio(object):
                 pass
         filehandle.close()
 
+    def check_dst_mntpt(self):
+        """Check that the dst_mntpt really exists. If not, error."""
+        try:
+            mst = os.lstat(self.dst_mntpt)
+            if not st.S_ISDIR(mst.st_mode):
+                raise TValueError("Destination mountpoint "
+                                  "doesn't exist", 
+                                  TM_E_INVALID_CPIO_ACT_ATTR)
+        except OSError:
+            raise TValueError("Destination mountpoint is "
+                              "inaccessible", TM_E_INVALID_CPIO_ACT_ATTR)
+
     @staticmethod
     def check_abort():
         """Check if the user aborted the transfer""" 
-        if tm_abort_signaled() == 1:
+        if tm_abort_signaled():
             raise TAbort("User aborted transfer")
 
+    def wait_output(self, pipe):
+        """Read output of command run by pipe until it exits. The
+		interpreter lock is released while waiting for the output,
+		so no CPU is used until there is some. If the transfer is
+		aborted, the command is killed.
+		Raises TAbort if the transfer was aborted.
+		"""
+        fd = pipe.stdout.fileno()
+        while True:
+            if tmod.cancel_wait(fd, -1) == errno.EINTR:
+                self.dbg_msg("Transfer aborted, killing " + str(pipe.pid))
+                try:
+                    pipe.terminate()
+                except OSError:
+                    pass
+                raise TAbort("User aborted transfer")
+            if not os.read(fd, 65536):
+                return
+
     def build_cpio_entire_file_list(self):
         """Do a file tree walk of all the mountpoints provided and
 		build up pathname lists. Pathname lists of all mountpoints
 		under the same prefix are aggregated in the same file to
 		reduce the number of cpio invocations.
+		With the native copier, mountpoints copied entirely get
+		no list, they are walked while being copied.
 		"""	
 		
         self.info_msg("-- Starting transfer process, " +
@@ -465,6 +653,19 @@ class TransferCpio(object):
                              traceback.format_exc(),
                              TM_E_CPIO_ENTIRE_FAILED)
 
+            # The native copier walks whole directories itself while
+            # copying them, so that copying doesn't wait for the lists.
+            if self.mechanism == TM_PERFORM_COPY and patt is None and \
+                cp.file_list is None:
+                self.dbg_msg(" Streaming " + cp.chdir_prefix + "/" +
+                             cp.cpio_dir + " to the copier")
+                fent_list.append(Flist(chdir_prefix=cp.chdir_prefix,
+                                       clobber_files=cp.clobber_files,
+                                       cpio_args=cp.cpio_args,
+                                       cpio_dir=cp.cpio_dir))
+                old_cprefix = ""
+                continue
+
             # Create a new file if the prefix, or cpio_args
             # or clobber files, have changed, or a
             # file containing a pre-generated list of
@@ -505,7 +706,41 @@ class TransferCpio(object):
             # it is written out to the cpio file list.
             tmp_flist = []
 
-            if (cp.file_list):
+            paths = None
+            if cp.manifest is not None:
+                # The manifest was generated at build time.
+                # Fall back to the content list if it can't be read.
+                try:
+                    paths = tmod.manifest_paths(cp.manifest)
+                    self.dbg_msg("Using image content manifest " +
+                                 cp.manifest + ", " + str(len(paths)) +
+                                 " entries")
+                except OSError, err:
+                    self.dbg_msg("Image content manifest not used: " +
+                                 str(err))
+
+            #
+            # The manifest is written before the media is mastered, so
+            # it is in content list order. The copier orders entries by
+            # extent location itself, for cpio they are looked up here
+            # and sorted below like the content list.
+            #
+            if paths is not None and self.mechanism == TM_PERFORM_COPY:
+                fent.manifest = cp.manifest
+                for fname in paths:
+                    fent.handle.write(fname + "\n")
+            elif paths is not None:
+                fent.manifest = cp.manifest
+                for fname in paths:
+                    try:
+                        st1 = os.lstat(fname)
+                    except OSError:
+                        self.info_msg("Warning: Error" +
+                                      " processing " + fname +
+                                      " from " + cp.manifest)
+                        continue
+                    tmp_flist.append((st1.st_ino, fname))
+            elif (cp.file_list):
                 try:
                     image_content = open(cp.file_list, 'r')
                 except IOError:
@@ -531,6 +766,29 @@ class TransferCpio(object):
                     # hsfs file and the filename to a
                     # temporary list
                     tmp_flist.append((st1.st_ino, fname))
+            elif patt is None:
+                #
+                # Without a pattern to match, the tree is walked
+                # natively by multiple threads, following the same
+                # rules as the os.walk below. Pathnames come back
+                # already sorted by inode number.
+                #
+                try:
+                    paths = tmod.walk_tree(cp.chdir_prefix, cp.cpio_dir)
+                except OSError, err:
+                    raise TAbort("Failed to walk " + cp.chdir_prefix +
+                                 "/" + cp.cpio_dir + ": " + str(err),
+                                 TM_E_CPIO_ENTIRE_FAILED)
+                self.check_abort()
+
+                for fname in paths:
+                    fent.handle.write(fname + "\n")
+
+                nfiles = nfiles + len(paths)
+                PARAMS.percent = int(min(nfiles / TMDefs.MAX_NUMFILES, 1) *
+                                     total_find_percent)
+                tmod.logprogress(PARAMS.percent, "Building cpio file lists")
+                opercent = PARAMS.percent
             else:
                 #
                 # os.walk does not recurse into directory
@@ -635,8 +893,9 @@ class TransferCpio(object):
             lf.flush()
 				
         for fent in fent_list:
-            fent.handle.close()
-            fent.handle = None
+            if fent.handle is not None:
+                fent.handle.close()
+                fent.handle = None
         return fent_list
 
     def cpio_skip_files(self):
@@ -675,84 +934,167 @@ class TransferCpio(object):
               contents can be overlaid by contents from the running instance
               """
 		
+        span = logsvc.span_begin()
         fent_list = self.build_cpio_entire_file_list()
+        logsvc.span_end(span, "transfer", "build_file_list")
         self.cpio_transfer_filelist(fent_list, TM_E_CPIO_ENTIRE_FAILED)
         for fent in fent_list:
-            os.unlink(fent.name)
-            fent.name = ""
+            if fent.name:
+                os.unlink(fent.name)
+                fent.name = ""
 
         if self.skip_file_list:
+            span = logsvc.span_begin()
             self.cpio_skip_files()
+            logsvc.span_end(span, "transfer", "skip_files",
+                            self.skip_file_list)
+
+    def copy_filelist(self, fent, err_code):
+        """Copy files listed in fent, or the directory tree it names,
+        with the native copier. The cpio options of the list are
+        honoured the way cpio would.
+        """
+        flags = 0
+        if 'u' in fent.cpio_args:
+            flags |= tmod.TM_COPY_UNCOND
+        if 'm' in fent.cpio_args:
+            flags |= tmod.TM_COPY_MTIME
+        if self.copy_delta:
+            flags |= tmod.TM_COPY_DEDUP
+
+        span = logsvc.span_begin()
+        if fent.cpio_dir is not None:
+            # Symbolic links in the way are replaced by the copier
+            # itself, see do_clobber_files()
+            if fent.clobber_files == 1:
+                flags |= tmod.TM_COPY_CLOBBER
+            what = fent.chdir_prefix + "/" + fent.cpio_dir
+            self.info_msg("Copying " + what + " to " + self.dst_mntpt)
+            (status, nerrors) = tmod.copy_tree(fent.chdir_prefix,
+                                               fent.cpio_dir,
+                                               self.dst_mntpt, flags,
+                                               self.copy_threads)
+        elif fent.manifest is not None:
+            what = fent.manifest
+            self.dbg_msg("Copying files in " + fent.manifest + " from " +
+                         fent.chdir_prefix + " to " + self.dst_mntpt)
+            (status, nerrors) = tmod.copy_manifest(fent.chdir_prefix,
+                                                   self.dst_mntpt,
+                                                   fent.manifest, flags,
+                                                   self.copy_threads)
+        else:
+            what = fent.name
+            self.dbg_msg("Copying files in " + fent.name + " from " +
+                         fent.chdir_prefix + " to " + self.dst_mntpt)
+            (status, nerrors) = tmod.copy_filelist(fent.chdir_prefix,
+                                                   self.dst_mntpt,
+                                                   fent.name, flags,
+                                                   self.copy_threads)
+        logsvc.span_end(span, "transfer", "copy", what)
+        if status == errno.EINTR:
+            raise TAbort("User aborted transfer")
+        elif status != 0:
+            raise TAbort("Copying files in " + what + " failed: " +
+                         os.strerror(status), err_code)
+        if nerrors != 0:
+            self.info_msg("WARNING: " + str(nerrors) + " files in " +
+                          what + " couldn't be copied")
 
     def cpio_transfer_filelist(self, fent_list, err_code):
         """Transfer every file in fent_list"""
-        self.info_msg("Beginning cpio actions")
+        if self.wait_target:
+            # Files are read in the order they are going to be copied
+            tm_wait_target([(fent.chdir_prefix, fent.name, fent.cpio_dir)
+                            for fent in fent_list], self.info_msg, err_code)
+            self.check_dst_mntpt()
+
+        if self.mechanism == TM_PERFORM_COPY:
+            self.info_msg("Beginning copy actions")
+        else:
+            self.info_msg("Beginning cpio actions")
 
         #
-        # Now process each entry in the list. cpio is executed with the
-        # -V option so that it prints a dot for each pathname processed.
-        # This is needed to provide the ability to abort midway.
+        # Now process each entry in the list. While cpio is running,
+        # its output is waited for together with the cancel token, so
+        # that it can be killed as soon as the transfer is aborted.
         #
 
         #
-        # Start the disk space monitor thread
+        # Publish expected size of the transfer and start the progress
+        # monitor thread
         #
+        tmod.progress_start(self.distro_size * 1024)
         if self.distro_size:
             pmon = ProgressMon()
             pmon.startmonitor(self.dst_mntpt, self.distro_size,
-                              "Transferring Contents", PARAMS.percent, 95)
+                              "Transferring Contents", PARAMS.percent, 95,
+                              self.mechanism == TM_PERFORM_COPY)
 
         # Walk file lists, cpio'ing each in turn.
-        for fent in fent_list:
-            self.check_abort()
-
-            if fent.clobber_files == 1:
-                self.do_clobber_files(fent.name)
-
-            try:
-                os.chdir(fent.chdir_prefix)
-            except OSError:
-                raise TAbort("Failed to access " +
-                             fent.chdir_prefix, err_code)
-            cmd = TMDefs.CPIO + " -" + fent.cpio_args + "V " + \
-                self.dst_mntpt + " < " + fent.name
-            self.dbg_msg("Executing: " + cmd + " CWD: " +
-                         fent.chdir_prefix)
-            err_file = os.tmpfile()
-            if self.log_handler is not None:
-                retval = exec_cmd_outputs_to_log(cmd.split(),
-                                             self.log_handler)
-                if (retval != 0):
-                    self.log_handler.error(cmd +
-                                           " had errors")
-            else:
-                pipe = sp.Popen(cmd, shell=True, stdout=sp.PIPE,
-                             stderr=err_file, close_fds=True)
-                char = True
-                while char:
-                    char = pipe.stdout.read(1)
-                    self.check_abort()
-                retval = pipe.wait()
-
-                if retval != 0 and self.debugflag == 1:
-                    err_file.seek(0)
-                    self.info_msg("WARNING: " + cmd
-                                  + " had errors")
-                    self.info_msg("         "
-                                  + err_file.read())
+        try:
+            for fent in fent_list:
+                self.check_abort()
 
-                err_file.close()
+                if fent.clobber_files == 1 and fent.name:
+                    self.do_clobber_files(fent.name)
 
-        if self.distro_size:
-            pmon.done = True
-            pmon.wait()
+                try:
+                    os.chdir(fent.chdir_prefix)
+                except OSError:
+                    raise TAbort("Failed to access " +
+                                 fent.chdir_prefix, err_code)
+
+                if self.mechanism == TM_PERFORM_COPY:
+                    self.copy_filelist(fent, err_code)
+                    continue
+
+                span = logsvc.span_begin()
+                cmd = TMDefs.CPIO + " -" + fent.cpio_args + " " + \
+                    self.dst_mntpt + " < " + fent.name
+                self.dbg_msg("Executing: " + cmd + " CWD: " +
+                             fent.chdir_prefix)
+                err_file = os.tmpfile()
+                if self.log_handler is not None:
+                    retval = exec_cmd_outputs_to_log(cmd.split(),
+                                                 self.log_handler)
+                    if (retval != 0):
+                        self.log_handler.error(cmd +
+                                               " had errors")
+                else:
+                    # cpio is run directly rather than by the shell,
+                    # so that it can be killed on abort
+                    list_fh = open(fent.name, "r")
+                    pipe = sp.Popen([TMDefs.CPIO, "-" + fent.cpio_args,
+                                    self.dst_mntpt], stdin=list_fh,
+                                    stdout=sp.PIPE, stderr=err_file,
+                                    close_fds=True)
+                    list_fh.close()
+                    try:
+                        self.wait_output(pipe)
+                    finally:
+                        retval = pipe.wait()
+
+                    if retval != 0 and self.debugflag == 1:
+                        err_file.seek(0)
+                        self.info_msg("WARNING: " + cmd
+                                      + " had errors")
+                        self.info_msg("         "
+                                      + err_file.read())
+
+                    err_file.close()
+                logsvc.span_end(span, "transfer", "cpio", fent.name)
+        finally:
+            if self.distro_size:
+                pmon.done = True
+                pmon.wait()
+            tmod.progress_end()
 
 
     def perform_transfer(self, args):
         """Main function for doing the copying of bits"""
         for opt, val in args:
             if opt == TM_ATTR_MECHANISM:
-                continue
+                self.mechanism = val
             elif opt == "dbgflag":
                 if val == "true":
                     self.debugflag = 1
@@ -773,6 +1115,20 @@ class TransferCpio(object):
                 self.skip_file_list = val
             elif opt == TM_CPIO_ARGS:
                 self.cpio_args = val
+            elif opt == TM_COPY_THREADS:
+                try:
+                    self.copy_threads = int(val)
+                except ValueError:
+                    raise TValueError("Invalid number of copy threads " +
+                                      str(val),
+                                      TM_E_INVALID_TRANSFER_TYPE_ATTR)
+            elif opt == TM_COPY_DELTA:
+                # Files already in the target are only rewritten if
+                # they differ, e.g. when reinstalling the same image
+                # onto a dataset rolled back to a previous install
+                self.copy_delta = (val == "true")
+            elif opt == TM_WAIT_TARGET:
+                self.wait_target = (val == "true")
             elif opt == TM_PYTHON_LOG_HANDLER:
                 self.log_handler = val
             else:
@@ -791,16 +1147,9 @@ class TransferCpio(object):
         if self.cpio_action == TM_CPIO_ENTIRE and self.image_info == "":
             self.image_info = "/.cdrom/.image_info"
 
-        # Check that the dst_mntpt really exists. If not, error.
-        try:
-            mst = os.lstat(self.dst_mntpt)
-            if not st.S_ISDIR(mst.st_mode):
-                raise TValueError("Destination mountpoint "
-                                  "doesn't exist", 
-                                  TM_E_INVALID_CPIO_ACT_ATTR)
-        except OSError:
-            raise TValueError("Destination mountpoint is "
-                              "inaccessible", TM_E_INVALID_CPIO_ACT_ATTR)
+        # The target may not be mounted yet
+        if not self.wait_target:
+            self.check_dst_mntpt()
 
         #
         # Read in approx size of the entire distribution from
@@ -858,6 +1207,195 @@ class TransferCpio(object):
         self.info_msg("-- Completed transfer process, " +
                       time.strftime(self.tformat) + " --")
 
+class TransferZfs(object):
+    """This class receives "zfs send" stream of the image, built by
+	distro_const, into the root dataset of the target boot environment.
+	All the image contents arrive in one sequential read of the stream
+	instead of being copied file by file.
+	"""
+
+    def __init__(self):
+        self.stream = ""
+        self.dataset = ""
+        self.tformat = "%a, %d %b %Y %H:%M:%S +0000"
+        self.log_handler = None
+        self.wait_target = False
+
+    def info_msg(self, msg):
+        """Log an informational message to logging service"""
+        if self.log_handler is not None:
+            self.log_handler.info(msg)
+        else:
+            logsvc.write_log(TRANSFER_ID, msg + "\n")
+
+    def prerror(self, msg):
+        """Log an error message to logging service and stderr"""
+        if self.log_handler is not None:
+            self.log_handler.error(msg)
+        else:
+            msg1 = msg + "\n"
+            logsvc.write_dbg(TRANSFER_ID, logsvc.LS_DBGLVL_ERR,
+                             msg1)
+            sys.stderr.write(msg1)
+            sys.stderr.flush()
+
+    def perform_transfer(self, args):
+        """Receive the stream into the dataset. Progress is reported
+	in bytes of the stream consumed.
+	"""
+        for opt, val in args:
+            if opt == TM_ATTR_MECHANISM or opt == "dbgflag":
+                continue
+            elif opt == TM_ZFS_STREAM:
+                self.stream = val
+            elif opt == TM_ZFS_DATASET:
+                self.dataset = val
+            elif opt == TM_WAIT_TARGET:
+                self.wait_target = (val == "true")
+            elif opt == TM_PYTHON_LOG_HANDLER:
+                self.log_handler = val
+            else:
+                raise TValueError("Invalid attribute " +
+                                  str(opt),
+                                  TM_E_INVALID_TRANSFER_TYPE_ATTR)
+
+        if self.stream == "" or self.dataset == "":
+            raise TValueError("ZFS stream or dataset not set",
+                              TM_E_INVALID_ZFS_ATTR)
+
+        try:
+            size = os.stat(self.stream).st_size
+        except OSError:
+            raise TValueError("ZFS stream " + self.stream +
+                              " is inaccessible", TM_E_INVALID_ZFS_ATTR)
+
+        # The dataset is created together with the target
+        if self.wait_target:
+            tm_wait_target([(self.stream, None, None)], self.info_msg,
+                           TM_E_ZFS_RECV_FAILED)
+
+        self.info_msg("-- Receiving " + self.stream + " into " +
+                      self.dataset + ", " + time.strftime(self.tformat) +
+                      " --")
+
+        tmod.progress_start(size)
+        pmon = ProgressMon()
+        pmon.startmonitor(self.dataset, max(size / 1024, 1),
+                          "Transferring Contents", 0, 95, True)
+        span = logsvc.span_begin()
+        try:
+            ret = tmod.zfs_receive(self.stream, self.dataset)
+        finally:
+            logsvc.span_end(span, "transfer", "zfs_receive", self.stream)
+            pmon.done = True
+            pmon.wait()
+            tmod.progress_end()
+
+        if ret == errno.EINTR:
+            raise TAbort("User aborted transfer")
+        if ret != 0:
+            raise TAbort("Receive of " + self.stream + " failed: " +
+                         os.strerror(ret), TM_E_ZFS_RECV_FAILED)
+
+        tmod.logprogress(100, "Completing transfer process")
+        self.info_msg("-- Completed transfer process, " +
+                      time.strftime(self.tformat) + " --")
+
+class TransferBlock(object):
+    """This class writes a prepared image, typically of the root pool
+	slice of identical hardware, block by block onto a device or file.
+	Chunks of the image which are all zero are left as holes when
+	the target is a file.
+	"""
+
+    def __init__(self):
+        self.image = ""
+        self.target = ""
+        self.flags = 0
+        self.tformat = "%a, %d %b %Y %H:%M:%S +0000"
+        self.log_handler = None
+
+    def info_msg(self, msg):
+        """Log an informational message to logging service"""
+        if self.log_handler is not None:
+            self.log_handler.info(msg)
+        else:
+            logsvc.write_log(TRANSFER_ID, msg + "\n")
+
+    def prerror(self, msg):
+        """Log an error message to logging service and stderr"""
+        if self.log_handler is not None:
+            self.log_handler.error(msg)
+        else:
+            msg1 = msg + "\n"
+            logsvc.write_dbg(TRANSFER_ID, logsvc.LS_DBGLVL_ERR,
+                             msg1)
+            sys.stderr.write(msg1)
+            sys.stderr.flush()
+
+    def perform_transfer(self, args):
+        """Write the image onto the target. Progress is reported in
+	bytes of the image processed.
+	"""
+        for opt, val in args:
+            if opt == TM_ATTR_MECHANISM or opt == "dbgflag":
+                continue
+            elif opt == TM_BLOCK_IMAGE:
+                self.image = val
+            elif opt == TM_BLOCK_TARGET:
+                self.target = val
+            elif opt == TM_BLOCK_VERIFY:
+                if val.lower() == "true":
+                    self.flags |= tmod.TM_BLOCK_FLAG_VERIFY
+            elif opt == TM_PYTHON_LOG_HANDLER:
+                self.log_handler = val
+            else:
+                raise TValueError("Invalid attribute " +
+                                  str(opt),
+                                  TM_E_INVALID_TRANSFER_TYPE_ATTR)
+
+        if self.image == "" or self.target == "":
+            raise TValueError("Block image or target not set",
+                              TM_E_INVALID_BLOCK_ATTR)
+
+        try:
+            size = os.stat(self.image).st_size
+        except OSError:
+            raise TValueError("Block image " + self.image +
+                              " is inaccessible", TM_E_INVALID_BLOCK_ATTR)
+
+        self.info_msg("-- Writing " + self.image + " to " +
+                      self.target + ", " + time.strftime(self.tformat) +
+                      " --")
+
+        tmod.progress_start(size)
+        pmon = ProgressMon()
+        pmon.startmonitor(self.target, max(size / 1024, 1),
+                          "Transferring Contents", 0, 95, True)
+        span = logsvc.span_begin()
+        try:
+            (ret, nwritten, nskipped) = tmod.block_write(self.image,
+                                                         self.target,
+                                                         self.flags)
+        finally:
+            logsvc.span_end(span, "transfer", "block_write", self.image)
+            pmon.done = True
+            pmon.wait()
+            tmod.progress_end()
+
+        if ret == errno.EINTR:
+            raise TAbort("User aborted transfer")
+        if ret != 0:
+            raise TAbort("Writing " + self.image + " to " + self.target +
+                         " failed: " + os.strerror(ret),
+                         TM_E_BLOCK_WRITE_FAILED)
+
+        self.info_msg("%d bytes written, %d zero bytes skipped" %
+                      (nwritten, nskipped))
+        tmod.logprogress(100, "Completing transfer process")
+        self.info_msg("-- Completed transfer process, " +
+                      time.strftime(self.tformat) + " --")
+
 class TransferIps(object):
     """This class contains all the methods used to create an IPS
 	image and populate it
@@ -883,6 +1421,10 @@ class TransferIps(object):
         self._log_handler = None
         self._verbose_mode = ""
 	self._init_retry_timeout = 0
+        self._fetch_threads = 0
+        self._cache_dir = ""
+        self._cache_size = 0
+        self._cache = None
 		
     @staticmethod
     def prerror(msg):
@@ -1205,8 +1747,22 @@ class TransferIps(object):
             # Package list is passed in a file; read it all in, append to
             # command list and then execute one pkg operation for performance
             with open(self._pkgs_file, 'r') as pkgfile:
-                cmd.extend(pkgfile.read().splitlines())
-                
+                pkgs = pkgfile.read().splitlines()
+
+            # Unless packages are retrieved in parallel or cached
+            if action_str == "install" and (self._fetch_threads > 1 or
+                                            self._cache_dir != ""):
+                if self._pkg_url != "":
+                    self.open_cache()
+                    try:
+                        self.perform_ips_pipeline(cmd, pkgs)
+                    finally:
+                        self.close_cache()
+                    return
+                self.prerror("IPS repository not set, packages are "
+                             "retrieved by pkg install")
+
+            cmd.extend(pkgs)
             status = exec_cmd_outputs_to_log(cmd, self._log_handler)
             # pkg install/uninstall returns
             # PKG_EXIT_SUCCESS: install/uninstall was successful
@@ -1229,6 +1785,203 @@ class TransferIps(object):
             raise TAbort("Failed executing %s" % ((" ".join(cmd))),
                         TM_E_IPS_RETRIEVE_FAILED)
 
+    def open_cache(self):
+        """Open the package cache, if one was requested. If it can't be
+        used, packages are retrieved from the repository only.
+        """
+        if self._cache_dir == "":
+            return
+        try:
+            self._cache = PkgCache(self._cache_dir,
+                                   self._cache_size * 1024 * 1024,
+                                   self._log_handler)
+        except OSError, err:
+            self.prerror("Package cache " + self._cache_dir +
+                         " not used: " + str(err))
+
+    def close_cache(self):
+        """Close the package cache opened by open_cache(), so that its
+        packages can be removed by other installers.
+        """
+        if self._cache is not None:
+            self._cache.close()
+            self._cache = None
+
+    def ips_recv(self, src, repo, pkg):
+        """Receive package pkg from repository or archive src into
+        staging repository repo. Returns True if it was received.
+        """
+        cmd = [TMDefs.PKGRECV, '-s', src, '-d', repo, pkg]
+        try:
+            status = exec_cmd_outputs_to_log(cmd, self._log_handler)
+        except OSError:
+            status = -1
+        if status != 0:
+            logsvc.write_dbg(TRANSFER_ID, logsvc.LS_DBGLVL_WARN,
+                             "Failed executing %s\n" % " ".join(cmd))
+        return status == 0
+
+    def ips_fetcher(self, repo, lock, work, ready, done):
+        """Receive packages, given by their solved FMRIs, into staging
+        repository repo until work queue is empty. Without the package
+        cache they are received from the repository. With the cache,
+        they are taken from the cache or received into it, and then
+        copied from their archives into repo under lock, since all
+        fetchers share one staging repository then. Every package is
+        appended to the done list under ready condition, even if it
+        couldn't be received, since pkg install then retrieves it from
+        the repository itself.
+        """
+        while not tm_abort_signaled():
+            try:
+                pkg = work.get_nowait()
+            except Queue.Empty:
+                break
+
+            if self._cache is None:
+                received = self.ips_recv(self._pkg_url, repo, pkg)
+            else:
+                archive = self._cache.fetch(self._pkg_url, pkg)
+                received = False
+                if archive is not None:
+                    lock.acquire()
+                    try:
+                        received = self.ips_recv(archive, repo, pkg)
+                    finally:
+                        lock.release()
+
+            ready.acquire()
+            done.append((pkg, received))
+            ready.notify()
+            ready.release()
+
+    def perform_ips_pipeline(self, cmd, pkgs):
+        """Retrieve packages in parallel, then install them. The
+		packages are solved by pkg install -n first, so that all
+		packages pkg would install, dependencies included, are
+		received in the versions it would install. They are received
+		by several pkgrecv processes in parallel, each one into its
+		own staging repository outside of the image. Once all of them
+		are there, they are installed in one pkg operation with the
+		staging repositories as additional origins, so that the
+		packages are solved together, as without staging. Progress is
+		reported through the transfer callback for every package
+		received. If the packages can't be solved, nothing is staged
+		and pkg install retrieves them itself.
+		With the package cache, packages are taken from the cache or
+		received into it, and then copied into a single staging
+		repository, so that pkg gets one additional origin however
+		many packages there are.
+		arguments:
+			cmd: pkg install command without packages
+			pkgs: packages to install
+		Raises: TAbort if the packages couldn't be staged,
+			TIPSPkgmissing if installation failed
+		"""
+        if not pkgs:
+            return
+
+        # Packages are received as solved by pkg, dependencies included
+        fetched = PkgCache.resolve(self._init_mntpt, pkgs)
+        if fetched is None:
+            self.prerror("Packages couldn't be solved, they are "
+                         "retrieved by pkg install")
+            fetched = []
+        stage = None
+        if fetched:
+            stage = tempfile.mkdtemp(prefix="tm_ips_stage.")
+        nfetched = len(fetched)
+        nthreads = min(self._fetch_threads or TMDefs.DEFAULT_FETCH_THREADS,
+                       nfetched)
+        # Cached packages are only copied, one repository is enough
+        nrepos = nthreads
+        if self._cache is not None:
+            nrepos = min(nthreads, 1)
+
+        work = Queue.Queue()
+        for pkg in fetched:
+            work.put(pkg)
+        ready = threading.Condition()
+        lock = threading.Lock()
+        done = []
+        fetchers = []
+        repos = []
+        origins = []
+        nreceived = 0
+
+        try:
+            for i in range(nrepos):
+                repo = os.path.join(stage, str(i))
+                status = exec_cmd_outputs_to_log([TMDefs.PKGREPO,
+                                                 'create', repo],
+                                                 self._log_handler)
+                if status != 0:
+                    raise TAbort("Unable to create staging "
+                                 "repository " + repo,
+                                 TM_E_IPS_RETRIEVE_FAILED)
+                repos.append(repo)
+                origins.extend(['-g', 'file://' + repo])
+            for i in range(nthreads):
+                fetchers.append(threading.Thread(target=self.ips_fetcher,
+                                                 args=(repos[i % nrepos],
+                                                       lock, work, ready,
+                                                       done)))
+            for fetcher in fetchers:
+                fetcher.start()
+
+            while nreceived < nfetched:
+                ready.acquire()
+                while not done and not tm_abort_signaled() and \
+                    [f for f in fetchers if f.isAlive()]:
+                    # Timeout, so that abort is noticed
+                    ready.wait(1)
+                batch = done[:]
+                del done[:]
+                ready.release()
+                if tm_abort_signaled():
+                    raise TAbort("User aborted transfer")
+                if not batch:
+                    raise TAbort("Retrieval of packages stopped",
+                                 TM_E_IPS_RETRIEVE_FAILED)
+
+                for (pkg, received) in batch:
+                    nreceived += 1
+                    if received:
+                        msg = "Retrieved " + pkg
+                    else:
+                        msg = "Retrieving " + pkg + " from repository"
+                    tmod.logprogress(nreceived * 100 / (2 * nfetched), msg)
+
+            npkgs = len(pkgs)
+            tmod.logprogress(50, "Installing " + str(npkgs) + " packages")
+            status = exec_cmd_outputs_to_log(cmd + origins + pkgs,
+                                             self._log_handler)
+            if status not in [TMDefs.PKG_EXIT_SUCCESS,
+                              TMDefs.PKG_EXIT_NOP]:
+                err_str = "Failed executing %s" % \
+                    " ".join(cmd + origins + pkgs)
+                if self._log_handler is not None:
+                    self._log_handler.error(err_str)
+                else:
+                    logsvc.write_dbg(TRANSFER_ID,
+                                     logsvc.LS_DBGLVL_ERR,
+                                     err_str + "\n")
+                raise TIPSPkgmissing(TM_E_IPS_PKG_MISSING)
+            tmod.logprogress(100, "Installed " + str(npkgs) + " packages")
+        finally:
+            # Fetchers stop taking packages once the queue is empty
+            while True:
+                try:
+                    work.get_nowait()
+                except Queue.Empty:
+                    break
+            for fetcher in fetchers:
+                fetcher.join()
+            if stage is not None:
+                shutil.rmtree(stage, ignore_errors=True)
+            if self._cache is not None:
+                logsvc.write_log(TRANSFER_ID, self._cache.stats() + "\n")
+
     def perform_ips_purge_hist(self):
         """Perform an IPS pkg purge-history.
 		Raises: TAbort if unable to purge the history.
@@ -1281,6 +2034,22 @@ class TransferIps(object):
                 self._init_retry_timeout = val
             elif opt == TM_IPS_PKGS:
                 self._pkgs_file = val
+            elif opt == TM_IPS_CACHE_DIR:
+                self._cache_dir = val
+            elif opt == TM_IPS_CACHE_SIZE:
+                try:
+                    self._cache_size = int(val)
+                except ValueError:
+                    raise TValueError("Invalid package cache size " +
+                                      str(val),
+                                      TM_E_INVALID_TRANSFER_TYPE_ATTR)
+            elif opt == TM_IPS_FETCH_THREADS:
+                try:
+                    self._fetch_threads = int(val)
+                except ValueError:
+                    raise TValueError("Invalid number of fetch threads " +
+                                      str(val),
+                                      TM_E_INVALID_TRANSFER_TYPE_ATTR)
             elif opt == TM_IPS_IMAGE_TYPE:
                 self._image_type = val
             elif opt == TM_IPS_IMAGE_CREATE_FORCE:
@@ -1346,34 +2115,40 @@ class TransferIps(object):
         if self._action == "":
             raise TValueError("TM_IPS_ACTION not set",
                               TM_E_INVALID_IPS_ACT_ATTR)
-        elif self._action == TM_IPS_INIT:
-            self.perform_ips_init()
-        elif self._action == TM_IPS_REPO_CONTENTS_VERIFY:
-            self.perform_ips_repo_contents_ver()
-        elif self._action == TM_IPS_RETRIEVE:
-            self.perform_ips_pkg_op("install")
-        elif self._action == TM_IPS_SET_AUTH:
-            self.perform_ips_set_auth()
-        elif self._action == TM_IPS_REFRESH:
-            self.perform_ips_refresh()
-        elif self._action == TM_IPS_UNSET_AUTH:
-            self.perform_ips_unset_auth()
-        elif self._action == TM_IPS_PURGE_HIST:
-            self.perform_ips_purge_hist()
-        elif self._action == TM_IPS_UNINSTALL:
-            self.perform_ips_pkg_op("uninstall")
-        elif self._action == TM_IPS_SET_PROP:
-            self.perform_ips_set_prop()
-        else:
-            raise TValueError("Invalid TM_IPS_ACTION",
-                              TM_E_INVALID_IPS_ACT_ATTR)
+
+        span = logsvc.span_begin()
+        try:
+            if self._action == TM_IPS_INIT:
+                self.perform_ips_init()
+            elif self._action == TM_IPS_REPO_CONTENTS_VERIFY:
+                self.perform_ips_repo_contents_ver()
+            elif self._action == TM_IPS_RETRIEVE:
+                self.perform_ips_pkg_op("install")
+            elif self._action == TM_IPS_SET_AUTH:
+                self.perform_ips_set_auth()
+            elif self._action == TM_IPS_REFRESH:
+                self.perform_ips_refresh()
+            elif self._action == TM_IPS_UNSET_AUTH:
+                self.perform_ips_unset_auth()
+            elif self._action == TM_IPS_PURGE_HIST:
+                self.perform_ips_purge_hist()
+            elif self._action == TM_IPS_UNINSTALL:
+                self.perform_ips_pkg_op("uninstall")
+            elif self._action == TM_IPS_SET_PROP:
+                self.perform_ips_set_prop()
+            else:
+                raise TValueError("Invalid TM_IPS_ACTION",
+                                  TM_E_INVALID_IPS_ACT_ATTR)
+        finally:
+            logsvc.span_end(span, "transfer",
+                            TMDefs.IPS_SPANS.get(self._action, "ips"))
 
 def tm_perform_transfer(args, callback=None):
-    """Transfer data via cpio or IPS from a specified source to
-	destination. The cpio transfer can be either an entire directory
-	or a list of files. The IPS functionality that is supported is
-	image-create, content verification, set-publisher, refresh,
-	unset-publisher, and retrieval.
+    """Transfer data via cpio, native copy, ZFS stream receive, block
+	image write or IPS from a specified source to destination. The cpio
+	transfer can be either an entire directory or a list of files. The
+	IPS functionality that is supported is image-create, content
+	verification, set-publisher, refresh, unset-publisher, and retrieval.
 	Arguments: nvlist specifying the transfer characteristics
 		callback function for logging.
 	Returns: TM_E_SUCCESS
@@ -1386,6 +2161,10 @@ def tm_perform_transfer(args, callback=None):
 		 TM_E_IPS_INIT_FAILED
 		 TM_E_INVALID_CPIO_ACT_ATTR
 		 TM_E_INVALID_CPIO_FILELIST_ATTR
+		 TM_E_INVALID_ZFS_ATTR
+		 TM_E_ZFS_RECV_FAILED
+		 TM_E_INVALID_BLOCK_ATTR
+		 TM_E_BLOCK_WRITE_FAILED
 	"""
 
     # lock, so there isn't more than 1 transfer running at a time
@@ -1409,15 +2188,24 @@ def tm_perform_transfer(args, callback=None):
 
         if action == TM_PERFORM_IPS:
             tobj = TransferIps()
-        elif action == TM_PERFORM_CPIO:
+        elif action == TM_PERFORM_CPIO or action == TM_PERFORM_COPY:
             tobj = TransferCpio()
+        elif action == TM_PERFORM_ZFS_RECV:
+            tobj = TransferZfs()
+        elif action == TM_PERFORM_BLOCK:
+            tobj = TransferBlock()
         else:
             if PARAMS.tm_lock.locked():
                 PARAMS.tm_lock.release()
             retval = TM_E_INVALID_TRANSFER_TYPE_ATTR
             return retval
 
+        span = logsvc.span_begin()
         try:
+            # abort signaled since the install started holds for every
+            # transfer of the install, see tm_reset_abort()
+            if tm_abort_signaled():
+                raise TAbort("User aborted transfer")
             tobj.perform_transfer(args)
         except IOError:
             tobj.prerror("File operation error: ")
@@ -1439,6 +2227,9 @@ def tm_perform_transfer(args, callback=None):
             tobj.prerror(traceback.format_exc())
             retval = TM_E_PYTHON_ERROR
 
+        logsvc.span_end(span, "transfer", "tm_perform_transfer",
+                        TMDefs.MECHANISM_SPANS[action])
+
     finally:
         if PARAMS.tm_lock.locked():
             PARAMS.tm_lock.release()
@@ -71,13 +71,60 @@ extern "C" {
 #define	TM_IPS_PROP_NAME		"TM_IPS_PROP_NAME"
 #define	TM_IPS_PROP_VALUE		"TM_IPS_PROP_VALUE"
 #define	TM_IPS_VERBOSE_MODE		"TM_IPS_VERBOSE_MODE"
+#define	TM_IPS_FETCH_THREADS		"TM_IPS_FETCH_THREADS"
+#define	TM_IPS_CACHE_DIR		"TM_IPS_CACHE_DIR"
+#define	TM_IPS_CACHE_SIZE		"TM_IPS_CACHE_SIZE"
+#define	TM_COPY_THREADS			"TM_COPY_THREADS"
+#define	TM_COPY_DELTA			"TM_COPY_DELTA"
+#define	TM_ZFS_STREAM			"TM_ZFS_STREAM"
+#define	TM_ZFS_DATASET			"TM_ZFS_DATASET"
+#define	TM_BLOCK_IMAGE			"TM_BLOCK_IMAGE"
+#define	TM_BLOCK_TARGET			"TM_BLOCK_TARGET"
+#define	TM_BLOCK_VERIFY			"TM_BLOCK_VERIFY"
+/*
+ * if "true", TM_PERFORM_CPIO, TM_PERFORM_COPY and TM_PERFORM_ZFS_RECV
+ * prepare the transfer and read the source ahead while the target is
+ * pending, see TM_set_target_state()
+ */
+#define	TM_WAIT_TARGET			"TM_WAIT_TARGET"
 
 #define	TM_PERFORM_CPIO		0
 #define	TM_PERFORM_IPS		1
+/*
+ * same as TM_PERFORM_CPIO and takes the same TM_CPIO_* attributes, but
+ * files are copied by multithreaded native copier instead of cpio(1).
+ * If TM_COPY_DELTA is "true", files already in the target are kept if
+ * their contents match the image. Only the media content list has
+ * hashes in the image content manifest, other files are compared with
+ * the source, reading both.
+ */
+#define	TM_PERFORM_COPY		2
+/*
+ * receive "zfs send" stream of the image given by TM_ZFS_STREAM into
+ * existing dataset TM_ZFS_DATASET, replacing its contents. The dataset
+ * has to be unmounted and is left unmounted.
+ */
+#define	TM_PERFORM_ZFS_RECV	3
+/*
+ * write image given by TM_BLOCK_IMAGE block by block onto device or file
+ * TM_BLOCK_TARGET, read back and check written data if TM_BLOCK_VERIFY
+ * is "true"
+ */
+#define	TM_PERFORM_BLOCK	4
 #define	TM_CPIO_ENTIRE		0
 #define	TM_CPIO_LIST		1
 #define	TM_IPS_INIT		0
 #define	TM_IPS_REPO_CONTENTS_VERIFY	1
+/*
+ * install packages listed in TM_IPS_PKGS. If TM_IPS_FETCH_THREADS is more
+ * than 1 and TM_IPS_PKG_URL is set, that many pkgrecv(1) processes
+ * retrieve packages in parallel into staging repositories, from which
+ * they are then installed in one pkg(1) operation. With TM_IPS_PKG_URL,
+ * packages can also be kept in local package cache TM_IPS_CACHE_DIR,
+ * limited to TM_IPS_CACHE_SIZE megabytes (0 for no limit). Packages are
+ * cached in versions solved by pkg(1) for the image, and retrieved by
+ * several processes even if TM_IPS_FETCH_THREADS isn't given.
+ */
 #define	TM_IPS_RETRIEVE		2
 #define	TM_IPS_REFRESH		3
 #define	TM_IPS_SET_AUTH		4
@@ -109,15 +156,98 @@ typedef enum {
 	TM_E_IPS_SET_AUTH_FAILED,	/* ips set-auth failed */
 	TM_E_IPS_UNSET_AUTH_FAILED,	/* ips unset-auth failed */
 	TM_E_IPS_SET_PROP_FAILED,	/* ips set-property failed */
+	TM_E_INVALID_ZFS_ATTR,		/* zfs stream or dataset invalid */
+	TM_E_ZFS_RECV_FAILED,		/* zfs receive failed */
+	TM_E_INVALID_BLOCK_ATTR,	/* block image or target invalid */
+	TM_E_BLOCK_WRITE_FAILED,	/* write of block image failed */
 	TM_E_PYTHON_ERROR		/* General Python error */
 } tm_errno_t;
 
 typedef void (*tm_callback_t)(const int percentage,
     const char *localized_GUI_message);
 
+/*
+ * State of the target set by the installer while it prepares the target
+ * concurrently with the transfer. Progress of the transfer isn't reported
+ * through tm_callback_t while the target is pending.
+ */
+typedef enum {
+	TM_TARGET_READY = 0,		/* target mounted, or not managed */
+	TM_TARGET_PENDING,		/* target is being prepared */
+	TM_TARGET_FAILED		/* target couldn't be prepared */
+} tm_target_state_t;
+
+#define	TM_PROGRESS_PATH_LEN	1024
+
+/*
+ * Snapshot of running file transfer, see TM_get_progress().
+ * Byte and file counts are exact for TM_PERFORM_COPY; for TM_PERFORM_CPIO
+ * bytes are estimated from growth of the target file system. For
+ * TM_PERFORM_ZFS_RECV and TM_PERFORM_BLOCK bytes are those of the stream
+ * or image, no files are counted.
+ */
+typedef struct tm_progress {
+	boolean_t	active;		/* file transfer in progress */
+	uint64_t	bytes_done;	/* bytes transferred so far */
+	uint64_t	bytes_total;	/* expected total, 0 if unknown */
+	uint64_t	files_done;	/* files transferred so far */
+	uint64_t	throughput;	/* bytes per second, 0 if unknown */
+	uint32_t	eta;		/* seconds remaining, 0 if unknown */
+	char		path[TM_PROGRESS_PATH_LEN]; /* file being transferred */
+} tm_progress_t;
+
+/*
+ * Image content manifest, generated by distro_const next to the content
+ * list of the media. The file is mapped into memory as is: a header, an
+ * array of fixed size entries and a table of NUL terminated pathnames,
+ * all in native byte order. Pathnames are relative to the root of the
+ * media and entries are in the order of the content list. Extent
+ * locations aren't known until the media is mastered, readers look the
+ * entries up on the media and sort them by inode number.
+ */
+#define	TM_MANIFEST_MAGIC	0x544d4d46	/* "TMMF" */
+#define	TM_MANIFEST_VERSION	1
+#define	TM_MANIFEST_HASH_LEN	20		/* SHA-1 */
+
+typedef struct tm_manifest_hdr {
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	nentries;
+	uint64_t	content_size;	/* bytes in regular files */
+	uint64_t	image_size;	/* size of installed image in KB */
+	uint64_t	strtab_off;	/* offset of pathname table */
+	uint64_t	strtab_size;
+} tm_manifest_hdr_t;
+
+typedef struct tm_manifest_ent {
+	uint64_t	size;
+	uint64_t	path_off;	/* offset in pathname table */
+	uint32_t	mode;
+	uint32_t	uid;
+	uint32_t	gid;
+	uint32_t	link_group;	/* 1 + index of first link, or 0 */
+	uint8_t		hash[TM_MANIFEST_HASH_LEN]; /* of regular files */
+	uint8_t		pad[4];
+} tm_manifest_ent_t;
+
+/* manifest mapped by TM_manifest_open() */
+typedef struct tm_manifest {
+	void			*addr;
+	size_t			len;
+	const tm_manifest_hdr_t	*hdr;
+	const tm_manifest_ent_t	*ents;
+	const char		*strtab;
+} tm_manifest_t;
+
 tm_errno_t TM_perform_transfer(nvlist_t *targs, tm_callback_t progress);
 void TM_abort_transfer(void);
+void TM_reset_abort(void);
 void TM_enable_debug(void);
+void TM_get_progress(tm_progress_t *progress);
+void TM_set_target_state(tm_target_state_t state);
+int TM_manifest_open(const char *path, tm_manifest_t *manifest);
+const char *TM_manifest_path(const tm_manifest_t *manifest, uint64_t i);
+void TM_manifest_close(tm_manifest_t *manifest);
 
 #ifdef __cplusplus
 }
@@ -28,6 +28,14 @@
 #include <ls_api.h>
 #include <errno.h>
 #include "transfermod.h"
+#include "tm_block.h"
+#include "tm_cancel.h"
+#include "tm_copy.h"
+#include "tm_manifest.h"
+#include "tm_prefetch.h"
+#include "tm_progress.h"
+#include "tm_walk.h"
+#include "tm_zfs.h"
 
 #define	TRANSFER_PY_SCRIPT "osol_install.transfer_mod"
 #define	PERFORM_TRANSFER_FUNC "tm_perform_transfer"
@@ -36,6 +44,25 @@
 
 static PyObject *tmod_logprogress(PyObject *self, PyObject *args);
 static PyObject *tmod_set_callback(PyObject *self, PyObject *args);
+static PyObject *tmod_copy_filelist(PyObject *self, PyObject *args);
+static PyObject *tmod_copy_tree(PyObject *self, PyObject *args);
+static PyObject *tmod_copy_manifest(PyObject *self, PyObject *args);
+static PyObject *tmod_walk_tree(PyObject *self, PyObject *args);
+static PyObject *tmod_block_write(PyObject *self, PyObject *args);
+static PyObject *tmod_zfs_receive(PyObject *self, PyObject *args);
+static PyObject *tmod_manifest_create(PyObject *self, PyObject *args);
+static PyObject *tmod_manifest_info(PyObject *self, PyObject *args);
+static PyObject *tmod_manifest_paths(PyObject *self, PyObject *args);
+static PyObject *tmod_progress_start(PyObject *self, PyObject *args);
+static PyObject *tmod_progress_end(PyObject *self, PyObject *args);
+static PyObject *tmod_progress_set(PyObject *self, PyObject *args);
+static PyObject *tmod_get_progress(PyObject *self, PyObject *args);
+static PyObject *tmod_cancel(PyObject *self, PyObject *args);
+static PyObject *tmod_cancel_reset(PyObject *self, PyObject *args);
+static PyObject *tmod_cancelled(PyObject *self, PyObject *args);
+static PyObject *tmod_cancel_wait(PyObject *self, PyObject *args);
+static PyObject *tmod_prefetch(PyObject *self, PyObject *args);
+static PyObject *tmod_target_wait(PyObject *self, PyObject *args);
 
 static PyThreadState * mainThreadState = NULL;
 static tm_callback_t progress;
@@ -52,6 +79,44 @@ static struct PyMethodDef libtransferMethods[] = {
 	    "Record the percentage completion of the transfer process"},
 	{"set_py_callback", tmod_set_callback, METH_VARARGS,
 	    "Save the Python callback"},
+	{"copy_filelist", tmod_copy_filelist, METH_VARARGS,
+	    "Copy files listed in a file from source to destination directory"},
+	{"copy_tree", tmod_copy_tree, METH_VARARGS,
+	    "Copy directory tree while walking it with multiple threads"},
+	{"copy_manifest", tmod_copy_manifest, METH_VARARGS,
+	    "Copy entries of image content manifest, skipping unchanged files"},
+	{"walk_tree", tmod_walk_tree, METH_VARARGS,
+	    "Return entries of directory tree sorted by inode number"},
+	{"block_write", tmod_block_write, METH_VARARGS,
+	    "Write image block by block onto device or file"},
+	{"zfs_receive", tmod_zfs_receive, METH_VARARGS,
+	    "Receive ZFS stream from a file into existing dataset"},
+	{"manifest_create", tmod_manifest_create, METH_VARARGS,
+	    "Generate image content manifest from content list"},
+	{"manifest_info", tmod_manifest_info, METH_VARARGS,
+	    "Return summary of image content manifest"},
+	{"manifest_paths", tmod_manifest_paths, METH_VARARGS,
+	    "Return pathnames recorded in image content manifest"},
+	{"progress_start", tmod_progress_start, METH_VARARGS,
+	    "Reset progress counters for transfer of given number of bytes"},
+	{"progress_end", tmod_progress_end, METH_NOARGS,
+	    "Mark the file transfer finished"},
+	{"progress_set", tmod_progress_set, METH_VARARGS,
+	    "Set estimated number of bytes transferred"},
+	{"get_progress", tmod_get_progress, METH_NOARGS,
+	    "Return snapshot of the file transfer progress"},
+	{"cancel", tmod_cancel, METH_NOARGS,
+	    "Cancel running transfer"},
+	{"cancel_reset", tmod_cancel_reset, METH_NOARGS,
+	    "Clear the cancel token at the beginning of a transfer"},
+	{"cancelled", tmod_cancelled, METH_NOARGS,
+	    "Return True if the transfer was cancelled"},
+	{"cancel_wait", tmod_cancel_wait, METH_VARARGS,
+	    "Wait for a file descriptor, cancel of the transfer or timeout"},
+	{"prefetch", tmod_prefetch, METH_VARARGS,
+	    "Read source of the transfer ahead into the page cache"},
+	{"target_wait", tmod_target_wait, METH_NOARGS,
+	    "Wait until the target of the transfer is ready"},
 	{NULL, NULL, 0, NULL}
 };
 
@@ -67,6 +132,12 @@ initlibtransfer()
 	}
 
 	PyModule_AddIntConstant(m, "TM_E_SUCCESS", TM_E_SUCCESS);
+	PyModule_AddIntConstant(m, "TM_COPY_UNCOND", TM_COPY_UNCOND);
+	PyModule_AddIntConstant(m, "TM_COPY_MTIME", TM_COPY_MTIME);
+	PyModule_AddIntConstant(m, "TM_COPY_CLOBBER", TM_COPY_CLOBBER);
+	PyModule_AddIntConstant(m, "TM_COPY_DEDUP", TM_COPY_DEDUP);
+	PyModule_AddIntConstant(m, "TM_BLOCK_FLAG_VERIFY",
+	    TM_BLOCK_FLAG_VERIFY);
 }
 
 /*
@@ -93,7 +164,11 @@ tmod_logprogress(PyObject *self, PyObject *args)
 	if (!PyArg_ParseTuple(args, "is", &percent, &message))
 		return (Py_BuildValue("i", 0));
 
-	if (progress != NULL) {
+	/*
+	 * Progress of target instantiation is still being reported
+	 * while the transfer reads its source ahead, don't mix them up.
+	 */
+	if (progress != NULL && !tm_target_pending()) {
 		(*progress)(percent, message);
 	}
 
@@ -119,6 +194,444 @@ tmod_set_callback(PyObject *self, PyObject *args)
 	return (Py_BuildValue("i", rval));
 }
 
+/*
+ * Copy files listed in a file with the native copier.
+ * Arguments: source directory, destination directory, list file,
+ * TM_COPY_* flags and number of worker threads (0 for default).
+ * Returns tuple (status, number of entries which failed), where status
+ * is 0, EINTR if the copy was aborted or errno if the list couldn't be
+ * processed. The interpreter lock is released while copying, so that
+ * other Python threads can monitor progress or abort the copy.
+ */
+/* ARGSUSED */
+static PyObject *
+tmod_copy_filelist(PyObject *self, PyObject *args)
+{
+	char	*src, *dst, *list;
+	int	flags, nthreads, ret;
+	uint_t	nerrors = 0;
+
+	if (!PyArg_ParseTuple(args, "sssii", &src, &dst, &list, &flags,
+	    &nthreads))
+		return (NULL);
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = tm_copy_filelist(src, dst, list, flags, nthreads, &nerrors);
+	Py_END_ALLOW_THREADS
+
+	return (Py_BuildValue("(iI)", ret, nerrors));
+}
+
+/*
+ * Copy directory tree with the native copier, entries are copied as the
+ * parallel walker finds them.
+ * Arguments: source directory, directory to copy relative to the source,
+ * destination directory, TM_COPY_* flags and number of worker threads.
+ * Returns tuple (status, number of entries which failed), see
+ * tmod_copy_filelist().
+ */
+/* ARGSUSED */
+static PyObject *
+tmod_copy_tree(PyObject *self, PyObject *args)
+{
+	char	*src, *dir, *dst;
+	int	flags, nthreads, ret;
+	uint_t	nerrors = 0;
+
+	if (!PyArg_ParseTuple(args, "sssii", &src, &dir, &dst, &flags,
+	    &nthreads))
+		return (NULL);
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = tm_copy_tree(src, dir, dst, flags, nthreads, &nerrors);
+	Py_END_ALLOW_THREADS
+
+	return (Py_BuildValue("(iI)", ret, nerrors));
+}
+
+/*
+ * Copy entries of image content manifest with the native copier, with
+ * TM_COPY_DEDUP only files whose contents differ from the recorded SHA-1
+ * are copied.
+ * Arguments: source directory, destination directory, manifest,
+ * TM_COPY_* flags and number of worker threads.
+ * Returns tuple (status, number of entries which failed), see
+ * tmod_copy_filelist().
+ */
+/* ARGSUSED */
+static PyObject *
+tmod_copy_manifest(PyObject *self, PyObject *args)
+{
+	char	*src, *dst, *manifest;
+	int	flags, nthreads, ret;
+	uint_t	nerrors = 0;
+
+	if (!PyArg_ParseTuple(args, "sssii", &src, &dst, &manifest, &flags,
+	    &nthreads))
+		return (NULL);
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = tm_copy_manifest(src, dst, manifest, flags, nthreads, &nerrors);
+	Py_END_ALLOW_THREADS
+
+	return (Py_BuildValue("(iI)", ret, nerrors));
+}
+
+/*
+ * Write image onto device or file, see tm_block_write().
+ * Arguments: image, target, flags (TM_BLOCK_FLAG_VERIFY).
+ * Returns tuple (status, bytes written, zero bytes skipped), status is 0
+ * on success, errno value otherwise.
+ */
+/* ARGSUSED */
+static PyObject *
+tmod_block_write(PyObject *self, PyObject *args)
+{
+	char		*image, *target;
+	int		flags, ret;
+	uint64_t	nwritten, nskipped;
+
+	if (!PyArg_ParseTuple(args, "ssi", &image, &target, &flags))
+		return (NULL);
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = tm_block_write(image, target, flags, &nwritten, &nskipped);
+	Py_END_ALLOW_THREADS
+
+	return (Py_BuildValue("(iKK)", ret, (unsigned PY_LONG_LONG)nwritten,
+	    (unsigned PY_LONG_LONG)nskipped));
+}
+
+/*
+ * Receive ZFS stream into a dataset, see tm_zfs_receive().
+ * Arguments: file containing the stream (possibly gzip compressed),
+ * name of the dataset.
+ * Returns 0 on success, errno value otherwise.
+ */
+/* ARGSUSED */
+static PyObject *
+tmod_zfs_receive(PyObject *self, PyObject *args)
+{
+	char	*stream, *dataset;
+	int	ret;
+
+	if (!PyArg_ParseTuple(args, "ss", &stream, &dataset))
+		return (NULL);
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = tm_zfs_receive(stream, dataset);
+	Py_END_ALLOW_THREADS
+
+	return (Py_BuildValue("i", ret));
+}
+
+/*
+ * Walk directory tree with multiple threads.
+ * Arguments: root directory, directory to walk relative to the root.
+ * Returns list of pathnames relative to the root, sorted by inode number,
+ * or raises OSError if the tree couldn't be walked.
+ */
+/* ARGSUSED */
+static PyObject *
+tmod_walk_tree(PyObject *self, PyObject *args)
+{
+	char		*root, *dir;
+	tm_walk_ent_t	*ents = NULL;
+	size_t		nents = 0, i;
+	PyObject	*list, *path;
+	int		ret;
+
+	if (!PyArg_ParseTuple(args, "ss", &root, &dir))
+		return (NULL);
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = tm_walk_list(root, dir, 0, &ents, &nents);
+	Py_END_ALLOW_THREADS
+
+	if (ret != 0) {
+		errno = ret;
+		return (PyErr_SetFromErrno(PyExc_OSError));
+	}
+
+	if ((list = PyList_New(nents)) == NULL) {
+		tm_walk_free_list(ents, nents);
+		return (NULL);
+	}
+	for (i = 0; i < nents; i++) {
+		if ((path = PyString_FromString(ents[i].path)) == NULL) {
+			Py_DECREF(list);
+			tm_walk_free_list(ents, nents);
+			return (NULL);
+		}
+		PyList_SET_ITEM(list, i, path);
+	}
+	tm_walk_free_list(ents, nents);
+	return (list);
+}
+
+/*
+ * Generate image content manifest.
+ * Arguments: image root, content list with pathnames relative to the
+ * root, size of installed image in KB and manifest to create.
+ * Returns 0 on success, errno on failure.
+ */
+/* ARGSUSED */
+static PyObject *
+tmod_manifest_create(PyObject *self, PyObject *args)
+{
+	char			*root, *list, *path;
+	unsigned long long	image_size;
+	int			ret;
+
+	if (!PyArg_ParseTuple(args, "ssKs", &root, &list, &image_size,
+	    &path))
+		return (NULL);
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = tm_manifest_create(root, list, image_size, path);
+	Py_END_ALLOW_THREADS
+
+	return (Py_BuildValue("i", ret));
+}
+
+/*
+ * Open image content manifest, raising OSError on failure
+ */
+static int
+tmod_manifest_open(const char *path, tm_manifest_t *manifest)
+{
+	int	ret;
+
+	if ((ret = TM_manifest_open(path, manifest)) != 0) {
+		errno = ret;
+		(void) PyErr_SetFromErrnoWithFilename(PyExc_OSError,
+		    (char *)path);
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * Return tuple (number of entries, bytes in regular files, size of
+ * installed image in KB) recorded in image content manifest.
+ */
+/* ARGSUSED */
+static PyObject *
+tmod_manifest_info(PyObject *self, PyObject *args)
+{
+	tm_manifest_t	manifest;
+	PyObject	*ret;
+	char		*path;
+
+	if (!PyArg_ParseTuple(args, "s", &path))
+		return (NULL);
+	if (tmod_manifest_open(path, &manifest) != 0)
+		return (NULL);
+
+	ret = Py_BuildValue("(KKK)",
+	    (unsigned long long)manifest.hdr->nentries,
+	    (unsigned long long)manifest.hdr->content_size,
+	    (unsigned long long)manifest.hdr->image_size);
+	TM_manifest_close(&manifest);
+	return (ret);
+}
+
+/*
+ * Return list of pathnames recorded in image content manifest, in the
+ * order of the content list it was generated from.
+ */
+/* ARGSUSED */
+static PyObject *
+tmod_manifest_paths(PyObject *self, PyObject *args)
+{
+	tm_manifest_t	manifest;
+	PyObject	*list, *path;
+	const char	*p;
+	char		*name;
+	uint64_t	i;
+
+	if (!PyArg_ParseTuple(args, "s", &name))
+		return (NULL);
+	if (tmod_manifest_open(name, &manifest) != 0)
+		return (NULL);
+
+	if ((list = PyList_New(manifest.hdr->nentries)) == NULL) {
+		TM_manifest_close(&manifest);
+		return (NULL);
+	}
+	for (i = 0; i < manifest.hdr->nentries; i++) {
+		if ((p = TM_manifest_path(&manifest, i)) == NULL) {
+			errno = EINVAL;
+			(void) PyErr_SetFromErrnoWithFilename(PyExc_OSError,
+			    name);
+			path = NULL;
+		} else {
+			path = PyString_FromString(p);
+		}
+		if (path == NULL) {
+			Py_DECREF(list);
+			TM_manifest_close(&manifest);
+			return (NULL);
+		}
+		PyList_SET_ITEM(list, i, path);
+	}
+	TM_manifest_close(&manifest);
+	return (list);
+}
+
+/*
+ * Progress of file transfer is published by the Python transfer module
+ * through the functions below, unless it is counted by the native copier
+ * itself. See TM_get_progress().
+ */
+/* ARGSUSED */
+static PyObject *
+tmod_progress_start(PyObject *self, PyObject *args)
+{
+	unsigned long long	total;
+
+	if (!PyArg_ParseTuple(args, "K", &total))
+		return (NULL);
+	tm_progress_start(total);
+	return (Py_BuildValue("i", 0));
+}
+
+/* ARGSUSED */
+static PyObject *
+tmod_progress_end(PyObject *self, PyObject *args)
+{
+	tm_progress_end();
+	return (Py_BuildValue("i", 0));
+}
+
+/* ARGSUSED */
+static PyObject *
+tmod_progress_set(PyObject *self, PyObject *args)
+{
+	unsigned long long	bytes;
+
+	if (!PyArg_ParseTuple(args, "K", &bytes))
+		return (NULL);
+	tm_progress_set(bytes);
+	return (Py_BuildValue("i", 0));
+}
+
+/*
+ * Return tuple (active, bytes done, bytes total, files done,
+ * throughput, eta, path)
+ */
+/* ARGSUSED */
+static PyObject *
+tmod_get_progress(PyObject *self, PyObject *args)
+{
+	tm_progress_t	prog;
+
+	TM_get_progress(&prog);
+	return (Py_BuildValue("(iKKKKIs)", prog.active,
+	    (unsigned long long)prog.bytes_done,
+	    (unsigned long long)prog.bytes_total,
+	    (unsigned long long)prog.files_done,
+	    (unsigned long long)prog.throughput, prog.eta, prog.path));
+}
+
+/*
+ * The cancel token, see tm_cancel.c. The Python transfer module resets
+ * it when a transfer starts and checks it between steps.
+ */
+/* ARGSUSED */
+static PyObject *
+tmod_cancel(PyObject *self, PyObject *args)
+{
+	tm_cancel();
+	return (Py_BuildValue("i", 0));
+}
+
+/* ARGSUSED */
+static PyObject *
+tmod_cancel_reset(PyObject *self, PyObject *args)
+{
+	tm_cancel_reset();
+	return (Py_BuildValue("i", 0));
+}
+
+/* ARGSUSED */
+static PyObject *
+tmod_cancelled(PyObject *self, PyObject *args)
+{
+	return (PyBool_FromLong(tm_cancelled()));
+}
+
+/*
+ * Wait until file descriptor is readable, the transfer is cancelled or
+ * timeout expires, see tm_cancel_wait().
+ * Arguments: file descriptor (-1 for none), timeout in milliseconds
+ * (-1 for none).
+ * Returns 0, EINTR or ETIMEDOUT. The interpreter lock is released while
+ * waiting.
+ */
+/* ARGSUSED */
+static PyObject *
+tmod_cancel_wait(PyObject *self, PyObject *args)
+{
+	int	fd, timeout, ret;
+
+	if (!PyArg_ParseTuple(args, "ii", &fd, &timeout))
+		return (NULL);
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = tm_cancel_wait(fd, timeout);
+	Py_END_ALLOW_THREADS
+
+	return (Py_BuildValue("i", ret));
+}
+
+/*
+ * Read the source of the transfer ahead while the target is being
+ * prepared, see tm_prefetch().
+ * Arguments: source directory or file, file list relative to the source
+ * ("" for none), directory relative to the source to walk ("" for none),
+ * maximum number of bytes to read.
+ * Returns tuple (status, bytes read).
+ */
+/* ARGSUSED */
+static PyObject *
+tmod_prefetch(PyObject *self, PyObject *args)
+{
+	char			*src, *list, *dir;
+	unsigned long long	budget;
+	uint64_t		nread = 0;
+	int			ret;
+
+	if (!PyArg_ParseTuple(args, "sssK", &src, &list, &dir, &budget))
+		return (NULL);
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = tm_prefetch(src, *list != '\0' ? list : NULL,
+	    *dir != '\0' ? dir : NULL, budget, &nread);
+	Py_END_ALLOW_THREADS
+
+	return (Py_BuildValue("(iK)", ret, (unsigned long long)nread));
+}
+
+/*
+ * Wait until the installer has prepared the target of the transfer,
+ * see tm_target_wait().
+ * Returns 0 if the target is ready, EIO if it couldn't be prepared or
+ * EINTR if the transfer was cancelled.
+ */
+/* ARGSUSED */
+static PyObject *
+tmod_target_wait(PyObject *self, PyObject *args)
+{
+	int	ret;
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = tm_target_wait();
+	Py_END_ALLOW_THREADS
+
+	return (Py_BuildValue("i", ret));
+}
+
 /*
  * The C interface to tm_perform_transfer (python module)
  * This function will parse the nvlist and put the values
@@ -296,6 +809,9 @@ TM_perform_transfer(nvlist_t *nvl, tm_callback_t prog)
 
 /*
  * Indicate cancellation of a transfer process if any.
+ * The cancel token is set first, so that the native copiers and threads
+ * waiting in tm_cancel_wait() stop right away, without waiting for the
+ * interpreter lock.
  */
 void
 TM_abort_transfer()
@@ -303,6 +819,8 @@ TM_abort_transfer()
 	PyObject *pFunc, *pModule, *pName;
 	boolean_t	call_Py_Finalize = B_FALSE;
 
+	tm_cancel();
+
 	if (!Py_IsInitialized()) {
 		Py_Initialize();
 
@@ -390,6 +908,17 @@ TM_abort_transfer()
 		Py_Finalize();
 }
 
+/*
+ * Forget cancellation requested by TM_abort_transfer() before. Called by
+ * the installer once when it starts an install, an abort then holds for
+ * all transfers of the install.
+ */
+void
+TM_reset_abort()
+{
+	tm_cancel_reset();
+}
+
 /* Enable debugging messages */
 void
 TM_enable_debug()
@@ -0,0 +1,315 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * Block image writer.
+ *
+ * For installs onto identical hardware a prepared image of the root pool
+ * slice can be written onto the target instead of transferring files.
+ * The image is read and written sequentially in large chunks aligned to
+ * TM_BLOCK_CHUNK, bypassing the page cache where the file system allows
+ * it. On a regular file target, which is truncated first, chunks
+ * containing only zeros are not written but left as holes. A device or
+ * volume gets every chunk written: what it held before would otherwise
+ * show through, e.g. as old pool labels or as blocks failing checksums.
+ *
+ * With TM_BLOCK_FLAG_VERIFY, every written chunk is read back from the
+ * target and its SHA-1 digest compared with the digest of the chunk
+ * taken from the image. The read back goes into the same buffer, so
+ * verification needs no additional memory.
+ *
+ * Bytes of the image processed, written or skipped, are published
+ * through the transfer progress counters (tm_progress.c).
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sha1.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <ls_api.h>
+#include "tm_block.h"
+#include "tm_cancel.h"
+#include "tm_progress.h"
+
+#define	TRANSFER_ID		"TRANSFERMOD"
+
+/* alignment of the buffer, suits direct I/O on files and raw devices */
+#define	TMB_ALIGN		8192
+/* writes to raw devices are padded to whole sectors */
+#define	TMB_SECTOR		512
+
+/*
+ * tmb_debug_print()
+ */
+static void
+tmb_debug_print(ls_dbglvl_t dbg_lvl, char *fmt, ...)
+{
+	va_list	ap;
+
+	va_start(ap, fmt);
+	ls_write_dbg_vmessage(TRANSFER_ID, dbg_lvl, fmt, ap);
+	va_end(ap);
+}
+
+/*
+ * tmb_is_zero()
+ *	Checks whether buffer contains zeros only. Length is multiple of
+ *	sizeof (uint64_t) except for the last chunk of the image.
+ */
+static boolean_t
+tmb_is_zero(const char *buf, size_t len)
+{
+	const uint64_t	*p = (const uint64_t *)buf;
+	size_t		i, n = len / sizeof (uint64_t);
+
+	for (i = 0; i < n; i++) {
+		if (p[i] != 0)
+			return (B_FALSE);
+	}
+	for (i = n * sizeof (uint64_t); i < len; i++) {
+		if (buf[i] != 0)
+			return (B_FALSE);
+	}
+	return (B_TRUE);
+}
+
+/*
+ * tmb_digest()
+ */
+static void
+tmb_digest(const char *buf, size_t len, uint8_t *digest)
+{
+	SHA1_CTX	ctx;
+
+	SHA1Init(&ctx);
+	SHA1Update(&ctx, buf, len);
+	SHA1Final(digest, &ctx);
+}
+
+/*
+ * tmb_pread()
+ *	Reads whole range unless end of file is reached
+ */
+static ssize_t
+tmb_pread(int fd, char *buf, size_t len, off_t off)
+{
+	ssize_t	n;
+	size_t	done = 0;
+
+	while (done < len) {
+		if ((n = pread(fd, buf + done, len - done, off + done)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+		if (n == 0)
+			break;
+		done += n;
+	}
+	return (done);
+}
+
+/*
+ * tmb_pwrite()
+ */
+static int
+tmb_pwrite(int fd, const char *buf, size_t len, off_t off)
+{
+	ssize_t	n;
+	size_t	done = 0;
+
+	while (done < len) {
+		if ((n = pwrite(fd, buf + done, len - done, off + done)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return (errno);
+		}
+		if (n == 0)
+			return (ENOSPC);
+		done += n;
+	}
+	return (0);
+}
+
+/*
+ * tm_block_write()
+ *	Writes image onto target, see above
+ * Input:
+ *	image	- file containing the image
+ *	target	- raw device or file to write to, file is created if it
+ *		  doesn't exist and truncated to the size of the image
+ *	flags	- TM_BLOCK_FLAG_VERIFY
+ * Output:
+ *	nwritten - number of bytes written
+ *	nskipped - number of zero bytes left as holes in regular file
+ * Returns:
+ *	0	- image written
+ *	EINTR	- the transfer was cancelled
+ *	EIO	- verification of written data failed
+ *	errno	- image couldn't be read or target written
+ */
+int
+tm_block_write(const char *image, const char *target, int flags,
+    uint64_t *nwritten, uint64_t *nskipped)
+{
+	uint8_t		digest[SHA1_DIGEST_LENGTH];
+	uint8_t		rdigest[SHA1_DIGEST_LENGTH];
+	struct stat	ist, tst;
+	boolean_t	rawdev, sparse;
+	off_t		off;
+	ssize_t		n;
+	size_t		len;
+	char		*buf;
+	int		ifd, tfd, ret = 0;
+
+	*nwritten = *nskipped = 0;
+
+	if ((ifd = open(image, O_RDONLY)) < 0 || fstat(ifd, &ist) != 0) {
+		ret = errno;
+		tmb_debug_print(LS_DBGLVL_ERR, "block: can't open %s: %s\n",
+		    image, strerror(ret));
+		if (ifd >= 0)
+			(void) close(ifd);
+		return (ret);
+	}
+	if ((tfd = open(target, O_RDWR | O_CREAT, 0600)) < 0 ||
+	    fstat(tfd, &tst) != 0) {
+		ret = errno;
+		tmb_debug_print(LS_DBGLVL_ERR, "block: can't open %s: %s\n",
+		    target, strerror(ret));
+		if (tfd >= 0)
+			(void) close(tfd);
+		(void) close(ifd);
+		return (ret);
+	}
+	rawdev = S_ISCHR(tst.st_mode);
+	sparse = S_ISREG(tst.st_mode);
+
+	/*
+	 * Regular file is sized up front, skipped chunks become holes
+	 * reading back as zeros
+	 */
+	if (sparse && (ftruncate(tfd, 0) != 0 ||
+	    ftruncate(tfd, ist.st_size) != 0)) {
+		ret = errno;
+		tmb_debug_print(LS_DBGLVL_ERR, "block: can't size %s: %s\n",
+		    target, strerror(ret));
+		goto done;
+	}
+
+	/* not supported by every file system, page cache is used then */
+	(void) directio(ifd, DIRECTIO_ON);
+	(void) directio(tfd, DIRECTIO_ON);
+
+	if ((buf = memalign(TMB_ALIGN, TM_BLOCK_CHUNK)) == NULL) {
+		ret = ENOMEM;
+		goto done;
+	}
+
+	tmb_debug_print(LS_DBGLVL_INFO, "block: writing %s (%lld bytes) to "
+	    "%s%s\n", image, (longlong_t)ist.st_size, target,
+	    (flags & TM_BLOCK_FLAG_VERIFY) ? ", verified" : "");
+	tm_progress_path(target);
+
+	for (off = 0; off < ist.st_size; off += n) {
+		if (tm_cancelled()) {
+			ret = EINTR;
+			break;
+		}
+		if ((n = tmb_pread(ifd, buf, TM_BLOCK_CHUNK, off)) <= 0) {
+			ret = (n < 0) ? errno : EIO;
+			tmb_debug_print(LS_DBGLVL_ERR, "block: read of %s "
+			    "failed at %lld: %s\n", image, (longlong_t)off,
+			    strerror(ret));
+			break;
+		}
+
+		if (sparse && tmb_is_zero(buf, n)) {
+			*nskipped += n;
+			tm_progress_add(n, 0);
+			continue;
+		}
+
+		len = n;
+		if (rawdev && len % TMB_SECTOR != 0) {
+			bzero(buf + len, TMB_SECTOR - len % TMB_SECTOR);
+			len += TMB_SECTOR - len % TMB_SECTOR;
+		}
+		if (flags & TM_BLOCK_FLAG_VERIFY)
+			tmb_digest(buf, len, digest);
+
+		if ((ret = tmb_pwrite(tfd, buf, len, off)) != 0) {
+			tmb_debug_print(LS_DBGLVL_ERR, "block: write to %s "
+			    "failed at %lld: %s\n", target, (longlong_t)off,
+			    strerror(ret));
+			break;
+		}
+
+		if (flags & TM_BLOCK_FLAG_VERIFY) {
+			if (tmb_pread(tfd, buf, len, off) != len) {
+				ret = EIO;
+			} else {
+				tmb_digest(buf, len, rdigest);
+				if (memcmp(digest, rdigest,
+				    sizeof (digest)) != 0)
+					ret = EIO;
+			}
+			if (ret != 0) {
+				tmb_debug_print(LS_DBGLVL_ERR, "block: "
+				    "verification of %s failed at %lld\n",
+				    target, (longlong_t)off);
+				break;
+			}
+		}
+
+		*nwritten += n;
+		tm_progress_add(n, 0);
+	}
+	free(buf);
+
+	if (ret == 0 && fsync(tfd) != 0) {
+		ret = errno;
+		tmb_debug_print(LS_DBGLVL_ERR, "block: can't sync %s: %s\n",
+		    target, strerror(ret));
+	}
+	if (ret == 0)
+		tmb_debug_print(LS_DBGLVL_INFO, "block: %llu bytes written, "
+		    "%llu zero bytes skipped\n", (u_longlong_t)*nwritten,
+		    (u_longlong_t)*nskipped);
+
+done:
+	(void) close(tfd);
+	(void) close(ifd);
+	return (ret);
+}
@@ -0,0 +1,54 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+#ifndef _TM_BLOCK_H
+#define	_TM_BLOCK_H
+
+/*
+ * Block image writer used by the TM_PERFORM_BLOCK transfer mechanism.
+ * It writes a file system or pool image onto a device or file. Blocks
+ * which are all zero are left as holes in a file target.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+
+/* tm_block_write() flags */
+#define	TM_BLOCK_FLAG_VERIFY	0x01	/* read back and check each chunk */
+
+/* size of chunks the image is transferred and checked in */
+#define	TM_BLOCK_CHUNK		(1024 * 1024)
+
+int	tm_block_write(const char *image, const char *target, int flags,
+    uint64_t *nwritten, uint64_t *nskipped);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TM_BLOCK_H */
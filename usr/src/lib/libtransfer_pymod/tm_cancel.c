@@ -0,0 +1,180 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * Cancel token of the transfer engine.
+ *
+ * TM_abort_transfer() is called from another thread of the installer
+ * while the transfer thread copies files, waits for an external command
+ * or sleeps between progress updates. Loops doing work check the flag
+ * between blocks. Threads which would otherwise block wait in
+ * tm_cancel_wait(), which polls a self-pipe made readable by
+ * tm_cancel(), so they are woken as soon as the transfer is cancelled
+ * and use no CPU while they wait.
+ *
+ * The token is only reset by TM_reset_abort(), which the installer calls
+ * once when it starts an install, not by the individual transfers or
+ * copiers. Cancel requested between two transfers of an install, e.g.
+ * between the IPS actions or successive cpio lists, is not lost.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include "tm_cancel.h"
+
+static pthread_mutex_t	tmx_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile int	tmx_cancelled = 0;
+static int		tmx_pipe[2] = { -1, -1 };
+
+/*
+ * tmx_open()
+ *	Creates the self-pipe on first use, called with tmx_lock held.
+ *	Both ends are non-blocking, so that neither cancel nor reset ever
+ *	blocks, and not inherited by commands run by the transfer.
+ */
+static void
+tmx_open(void)
+{
+	int	i;
+
+	if (tmx_pipe[0] >= 0 || pipe(tmx_pipe) != 0)
+		return;
+	for (i = 0; i < 2; i++) {
+		(void) fcntl(tmx_pipe[i], F_SETFL,
+		    fcntl(tmx_pipe[i], F_GETFL) | O_NONBLOCK);
+		(void) fcntl(tmx_pipe[i], F_SETFD, FD_CLOEXEC);
+	}
+}
+
+/*
+ * tm_cancel_reset()
+ *	Clears the token. Called once per install, through TM_reset_abort(),
+ *	not at the beginning of each transfer
+ */
+void
+tm_cancel_reset(void)
+{
+	char	buf[64];
+
+	(void) pthread_mutex_lock(&tmx_lock);
+	tmx_open();
+	if (tmx_pipe[0] >= 0)
+		while (read(tmx_pipe[0], buf, sizeof (buf)) > 0)
+			;
+	tmx_cancelled = 0;
+	(void) pthread_mutex_unlock(&tmx_lock);
+}
+
+/*
+ * tm_cancel()
+ *	Cancels running transfer, may be called from any thread. Running
+ *	copiers stop as soon as possible and return EINTR.
+ */
+void
+tm_cancel(void)
+{
+	(void) pthread_mutex_lock(&tmx_lock);
+	tmx_open();
+	if (!tmx_cancelled) {
+		/* set before waking waiters, so that they see it */
+		tmx_cancelled = 1;
+		if (tmx_pipe[1] >= 0)
+			(void) write(tmx_pipe[1], "x", 1);
+	}
+	(void) pthread_mutex_unlock(&tmx_lock);
+}
+
+/*
+ * tm_cancelled()
+ *	Returns B_TRUE if the transfer was cancelled, cheap enough to be
+ *	called for every block copied
+ */
+boolean_t
+tm_cancelled(void)
+{
+	return (tmx_cancelled ? B_TRUE : B_FALSE);
+}
+
+/*
+ * tm_cancel_wait()
+ *	Waits until file descriptor becomes readable, the transfer is
+ *	cancelled or the timeout expires. Interrupting signals don't cut
+ *	the wait short.
+ * Input:
+ *	fd	- descriptor to wait for, -1 to only wait for cancel
+ *	timeout	- in milliseconds, -1 to wait without limit
+ * Returns:
+ *	0		- fd is readable or hung up
+ *	EINTR		- the transfer was cancelled
+ *	ETIMEDOUT	- timeout expired
+ *	errno		- poll failed
+ */
+int
+tm_cancel_wait(int fd, int timeout)
+{
+	struct pollfd	pfd[2];
+	hrtime_t	deadline;
+	int		n, nfds = 0, left = timeout;
+
+	(void) pthread_mutex_lock(&tmx_lock);
+	tmx_open();
+	(void) pthread_mutex_unlock(&tmx_lock);
+
+	/* without the pipe, cancel is only noticed at the timeout */
+	if (tmx_pipe[0] >= 0) {
+		pfd[nfds].fd = tmx_pipe[0];
+		pfd[nfds++].events = POLLIN;
+	}
+	if (fd >= 0) {
+		pfd[nfds].fd = fd;
+		pfd[nfds++].events = POLLIN;
+	}
+	deadline = gethrtime() + (hrtime_t)timeout * (NANOSEC / MILLISEC);
+
+	for (;;) {
+		if (tmx_cancelled)
+			return (EINTR);
+		if ((n = poll(pfd, nfds, left)) < 0) {
+			if (errno != EINTR)
+				return (errno);
+			if (timeout >= 0 && (left = (deadline - gethrtime()) /
+			    (NANOSEC / MILLISEC)) < 0)
+				left = 0;
+			continue;
+		}
+		if (tmx_cancelled)
+			return (EINTR);
+		if (n == 0)
+			return (ETIMEDOUT);
+		if (pfd[nfds - 1].fd == fd && pfd[nfds - 1].revents != 0)
+			return (0);
+	}
+}
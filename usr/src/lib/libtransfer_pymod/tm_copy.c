@@ -0,0 +1,1178 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * Native file copier for the transfer module.
+ *
+ * Pathnames are either read from a list file, the same way "cpio -p" reads
+ * them from stdin, taken from the image content manifest, or streamed
+ * from the parallel tree walker (tm_walk.c), so that copying starts as
+ * soon as the first entries are found. The
+ * thread producing an entry creates directories, symbolic links and
+ * special files itself, so that parents always exist before their
+ * entries are populated, and hands regular files off to a pool of worker
+ * threads which copy contents, extended attributes, ACLs, ownership and
+ * times. Additional links to already seen (device, inode) pairs are
+ * created once all workers finished. Attributes of directories are set
+ * last, since populating a directory would change its times and its
+ * permissions might not allow populating it at all.
+ *
+ * With TM_COPY_DEDUP, a regular file already present in the destination,
+ * typically left there by a previous install of the same image, is only
+ * rewritten if its contents differ, so reinstalling an image onto a
+ * dataset rolled back to a snapshot of an earlier install only writes
+ * the difference between the two. Contents are checked against the
+ * SHA-1 recorded in the manifest, or against the source if there is no
+ * manifest, reading large chunks at a time. Only the media content list
+ * has a manifest. The trees copied by tm_copy_tree() (/, usr and opt
+ * of the live image) are compared with the source, which reads every
+ * unchanged file in both the source and the destination, so the time
+ * of such a reinstall is still bound by the size of the image.
+ *
+ * Number of bytes and files copied, as well as the file being copied, is
+ * published through the transfer progress counters (tm_progress.c).
+ * Unchanged files are accounted as if they were copied.
+ */
+
+#include <atomic.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <sha1.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/acl.h>
+#include <sys/mkdev.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <libnvpair.h>
+
+#include <ls_api.h>
+#include "transfermod.h"
+#include "tm_cancel.h"
+#include "tm_copy.h"
+#include "tm_progress.h"
+#include "tm_walk.h"
+
+#define	TRANSFER_ID		"TRANSFERMOD"
+
+#define	TMC_BUFSIZE		(128 * 1024)
+#define	TMC_CMP_BUFSIZE		(1024 * 1024)
+#define	TMC_QUEUE_MAX		1024
+#define	TMC_LINK_BUCKETS	4096
+
+/* regular file waiting for a worker */
+typedef struct tmc_work {
+	struct tmc_work	*next;
+	char		*path;
+	const uint8_t	*hash;		/* SHA-1 from manifest, or NULL */
+} tmc_work_t;
+
+/* directory whose attributes are set when copying is finished */
+typedef struct tmc_dir {
+	struct tmc_dir	*next;
+	char		*path;
+	struct stat	st;
+} tmc_dir_t;
+
+/*
+ * file with more than one link. Entries in hash table remember the first
+ * path of given (device, inode) pair, entries on the deferred list point
+ * to them through 'first'
+ */
+typedef struct tmc_link {
+	struct tmc_link	*next;
+	dev_t		dev;
+	ino_t		ino;
+	char		*path;
+	struct tmc_link	*first;
+} tmc_link_t;
+
+typedef struct tmc_ctx {
+	const char	*src;
+	const char	*dst;
+	int		flags;
+	boolean_t	root;
+	uint_t		nerrors;
+	uint_t		nunchanged;	/* files kept by TM_COPY_DEDUP */
+
+	pthread_t	tids[TM_COPY_MAX_THREADS];
+	int		nthreads;
+
+	pthread_mutex_t	lock;
+	pthread_cond_t	cv_work;
+	pthread_cond_t	cv_space;
+	tmc_work_t	*head;
+	tmc_work_t	*tail;
+	int		nqueued;
+	boolean_t	done;
+
+	/* protects lists below, entries may come from several walkers */
+	pthread_mutex_t	meta_lock;
+	tmc_dir_t	*dirs;
+	tmc_link_t	*links[TMC_LINK_BUCKETS];
+	tmc_link_t	*deferred;
+} tmc_ctx_t;
+
+/*
+ * tmc_debug_print()
+ */
+static void
+tmc_debug_print(ls_dbglvl_t dbg_lvl, char *fmt, ...)
+{
+	va_list	ap;
+
+	va_start(ap, fmt);
+	ls_write_dbg_vmessage(TRANSFER_ID, dbg_lvl, fmt, ap);
+	va_end(ap);
+}
+
+/*
+ * tmc_error()
+ *	Reports failure of an operation on one entry. Like cpio, the
+ *	copier carries on with the rest of the list.
+ */
+static void
+tmc_error(tmc_ctx_t *ctx, const char *path, const char *op, int err)
+{
+	atomic_inc_uint(&ctx->nerrors);
+	tmc_debug_print(LS_DBGLVL_ERR, "copy: %s of %s failed: %s\n", op,
+	    path, strerror(err));
+}
+
+static void
+tmc_path(char *buf, const char *base, const char *rel)
+{
+	(void) snprintf(buf, MAXPATHLEN, "%s/%s", base, rel);
+}
+
+/*
+ * tmc_mkparent()
+ *	Creates missing parent directories of given path, like cpio -d
+ */
+static int
+tmc_mkparent(const char *path)
+{
+	char	parent[MAXPATHLEN];
+
+	(void) strlcpy(parent, path, sizeof (parent));
+	if (mkdirp(dirname(parent), 0755) != 0 && errno != EEXIST)
+		return (-1);
+	return (0);
+}
+
+/*
+ * tmc_keep_existing()
+ *	Unless TM_COPY_UNCOND is set, existing destination is kept if it is
+ *	not older than the source. With TM_COPY_CLOBBER, existing symbolic
+ *	links are always replaced.
+ */
+static boolean_t
+tmc_keep_existing(tmc_ctx_t *ctx, const char *dpath, const struct stat *st)
+{
+	struct stat	dst;
+
+	if (ctx->flags & TM_COPY_UNCOND)
+		return (B_FALSE);
+	if (lstat(dpath, &dst) != 0)
+		return (B_FALSE);
+	if ((ctx->flags & TM_COPY_CLOBBER) && S_ISLNK(dst.st_mode))
+		return (B_FALSE);
+	return (dst.st_mtime >= st->st_mtime);
+}
+
+static int
+tmc_write(int fd, const char *buf, size_t len)
+{
+	ssize_t	n;
+
+	while (len > 0) {
+		if ((n = write(fd, buf, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+		buf += n;
+		len -= n;
+	}
+	return (0);
+}
+
+/*
+ * tmc_read()
+ *	Reads up to len bytes, returns less only at the end of file
+ *	returns number of bytes read, -1 on failure
+ */
+static ssize_t
+tmc_read(int fd, char *buf, size_t len)
+{
+	ssize_t	n;
+	size_t	done = 0;
+
+	while (done < len) {
+		if ((n = read(fd, buf + done, len - done)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+		if (n == 0)
+			break;
+		done += n;
+	}
+	return (done);
+}
+
+/*
+ * tmc_copy_data()
+ *	Copies contents of one open file to another, accounts the bytes
+ *	in the global counter if 'count' is set
+ *	returns 0 on success, errno on failure
+ */
+static int
+tmc_copy_data(int sfd, int dfd, char *buf, boolean_t count)
+{
+	ssize_t	n;
+
+	for (;;) {
+		if (tm_cancelled())
+			return (EINTR);
+		if ((n = read(sfd, buf, TMC_BUFSIZE)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return (errno);
+		}
+		if (n == 0)
+			return (0);
+		if (tmc_write(dfd, buf, n) != 0)
+			return (errno);
+		if (count)
+			tm_progress_add(n, 0);
+	}
+}
+
+/*
+ * tmc_copy_xattrs()
+ *	Copies extended attributes of an open file or directory.
+ *	System attribute views are skipped, they are not files.
+ *	If 'buf' is NULL, a buffer is allocated for the copy.
+ */
+static void
+tmc_copy_xattrs(tmc_ctx_t *ctx, const char *path, int sfd, int dfd,
+    char *buf)
+{
+	int		sattr, dattr, afd, bfd;
+	DIR		*dirp;
+	struct dirent	*dp;
+	struct stat	st;
+	char		*abuf = NULL;
+	int		err;
+
+	if (fpathconf(sfd, _PC_XATTR_EXISTS) <= 0)
+		return;
+	if (buf == NULL && (buf = abuf = malloc(TMC_BUFSIZE)) == NULL) {
+		tmc_error(ctx, path, "copy of attributes", ENOMEM);
+		return;
+	}
+
+	if ((sattr = openat(sfd, ".", O_RDONLY | O_XATTR)) < 0) {
+		tmc_error(ctx, path, "open of attribute directory", errno);
+		free(abuf);
+		return;
+	}
+	if ((dattr = openat(dfd, ".", O_RDONLY | O_XATTR)) < 0) {
+		tmc_error(ctx, path, "open of target attribute directory",
+		    errno);
+		(void) close(sattr);
+		free(abuf);
+		return;
+	}
+	if ((dirp = fdopendir(sattr)) == NULL) {
+		tmc_error(ctx, path, "read of attribute directory", errno);
+		(void) close(sattr);
+		(void) close(dattr);
+		free(abuf);
+		return;
+	}
+
+	while ((dp = readdir(dirp)) != NULL) {
+		if (strcmp(dp->d_name, ".") == 0 ||
+		    strcmp(dp->d_name, "..") == 0 ||
+		    strcmp(dp->d_name, "SUNWattr_ro") == 0 ||
+		    strcmp(dp->d_name, "SUNWattr_rw") == 0)
+			continue;
+
+		if ((afd = openat(sattr, dp->d_name, O_RDONLY)) < 0) {
+			tmc_error(ctx, path, "open of attribute", errno);
+			continue;
+		}
+		if (fstat(afd, &st) != 0 ||
+		    (bfd = openat(dattr, dp->d_name,
+		    O_WRONLY | O_CREAT | O_TRUNC, st.st_mode & 07777)) < 0) {
+			tmc_error(ctx, path, "creation of attribute", errno);
+			(void) close(afd);
+			continue;
+		}
+		if ((err = tmc_copy_data(afd, bfd, buf, B_FALSE)) != 0)
+			tmc_error(ctx, path, "copy of attribute", err);
+		if (ctx->root)
+			(void) fchown(bfd, st.st_uid, st.st_gid);
+		(void) close(afd);
+		(void) close(bfd);
+	}
+
+	(void) closedir(dirp);
+	(void) close(dattr);
+	free(abuf);
+}
+
+/*
+ * tmc_set_fattrs()
+ *	Sets ownership, permissions, ACL and times of copied file
+ *	Ownership goes first, since chown(2) clears set-id bits
+ */
+static void
+tmc_set_fattrs(tmc_ctx_t *ctx, const char *path, int sfd, int dfd,
+    const struct stat *st)
+{
+	acl_t		*aclp = NULL;
+	struct timeval	tv[2];
+
+	if (ctx->root && fchown(dfd, st->st_uid, st->st_gid) != 0)
+		tmc_error(ctx, path, "chown", errno);
+	if (fchmod(dfd, st->st_mode & 07777) != 0)
+		tmc_error(ctx, path, "chmod", errno);
+
+	if (facl_get(sfd, ACL_NO_TRIVIAL, &aclp) != 0) {
+		tmc_error(ctx, path, "read of ACL", errno);
+	} else if (aclp != NULL) {
+		if (facl_set(dfd, aclp) != 0)
+			tmc_error(ctx, path, "write of ACL", errno);
+		acl_free(aclp);
+	}
+
+	if (ctx->flags & TM_COPY_MTIME) {
+		tv[0].tv_sec = st->st_atim.tv_sec;
+		tv[0].tv_usec = st->st_atim.tv_nsec / 1000;
+		tv[1].tv_sec = st->st_mtim.tv_sec;
+		tv[1].tv_usec = st->st_mtim.tv_nsec / 1000;
+		if (futimesat(dfd, NULL, tv) != 0)
+			tmc_error(ctx, path, "setting times", errno);
+	}
+}
+
+/*
+ * tmc_unchanged()
+ *	Checks if existing destination of a regular file already has
+ *	the contents of the source. The destination is hashed if SHA-1 of
+ *	the source is known, otherwise both files are compared chunk by
+ *	chunk, stopping at the first difference. 'buf' has to hold two
+ *	chunks of TMC_CMP_BUFSIZE.
+ *	returns descriptor of the destination open for reading if contents
+ *	are the same, -1 otherwise, with source rewound for copying
+ */
+static int
+tmc_unchanged(int sfd, const char *dpath, const struct stat *st,
+    const uint8_t *hash, char *buf)
+{
+	struct stat	dst;
+	SHA1_CTX	sha;
+	uint8_t		digest[SHA1_DIGEST_LENGTH];
+	char		*sbuf = buf + TMC_CMP_BUFSIZE;
+	boolean_t	same = B_TRUE;
+	ssize_t		n;
+	int		dfd;
+
+	if ((dfd = open(dpath, O_RDONLY | O_NOFOLLOW)) < 0)
+		return (-1);
+	if (fstat(dfd, &dst) != 0 || !S_ISREG(dst.st_mode) ||
+	    dst.st_size != st->st_size) {
+		(void) close(dfd);
+		return (-1);
+	}
+
+	if (hash != NULL)
+		SHA1Init(&sha);
+	while (same) {
+		if (tm_cancelled() || (n = tmc_read(dfd, buf,
+		    TMC_CMP_BUFSIZE)) < 0) {
+			same = B_FALSE;
+			break;
+		}
+		if (n == 0)
+			break;
+		if (hash != NULL)
+			SHA1Update(&sha, buf, n);
+		else if (tmc_read(sfd, sbuf, n) != n ||
+		    bcmp(buf, sbuf, n) != 0)
+			same = B_FALSE;
+	}
+	if (same && hash != NULL) {
+		SHA1Final(digest, &sha);
+		same = (bcmp(digest, hash, SHA1_DIGEST_LENGTH) == 0);
+	}
+
+	if (!same) {
+		(void) close(dfd);
+		(void) lseek(sfd, 0, SEEK_SET);
+		return (-1);
+	}
+	return (dfd);
+}
+
+/*
+ * tmc_copy_file()
+ *	Copies one regular file, invoked from worker threads
+ */
+static void
+tmc_copy_file(tmc_ctx_t *ctx, const char *path, const uint8_t *hash,
+    char *buf)
+{
+	char		spath[MAXPATHLEN], dpath[MAXPATHLEN];
+	struct stat	st;
+	int		sfd, dfd, err;
+
+	tmc_path(spath, ctx->src, path);
+	tmc_path(dpath, ctx->dst, path);
+	tm_progress_path(path);
+
+	if ((sfd = open(spath, O_RDONLY)) < 0) {
+		tmc_error(ctx, path, "open", errno);
+		return;
+	}
+	if (fstat(sfd, &st) != 0) {
+		tmc_error(ctx, path, "stat", errno);
+		(void) close(sfd);
+		return;
+	}
+	if (tmc_keep_existing(ctx, dpath, &st)) {
+		(void) close(sfd);
+		return;
+	}
+
+	/*
+	 * Attributes of unchanged files are set all the same, they might
+	 * differ between the images
+	 */
+	if ((ctx->flags & TM_COPY_DEDUP) &&
+	    (dfd = tmc_unchanged(sfd, dpath, &st, hash, buf)) >= 0) {
+		tmc_copy_xattrs(ctx, path, sfd, dfd, buf);
+		tmc_set_fattrs(ctx, path, sfd, dfd, &st);
+		atomic_inc_uint(&ctx->nunchanged);
+		tm_progress_add(st.st_size, 1);
+		(void) close(sfd);
+		(void) close(dfd);
+		return;
+	}
+
+	/*
+	 * Remove the target rather than truncating it, like cpio does.
+	 * Running binaries and symbolic links pointing elsewhere are
+	 * replaced instead of being written through.
+	 */
+	(void) unlink(dpath);
+	dfd = open(dpath, O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	if (dfd < 0 && errno == ENOENT && tmc_mkparent(dpath) == 0)
+		dfd = open(dpath, O_WRONLY | O_CREAT | O_EXCL,
+		    S_IRUSR | S_IWUSR);
+	if (dfd < 0) {
+		tmc_error(ctx, path, "create", errno);
+		(void) close(sfd);
+		return;
+	}
+
+	if ((err = tmc_copy_data(sfd, dfd, buf, B_TRUE)) != 0) {
+		if (err != EINTR)
+			tmc_error(ctx, path, "copy", err);
+	} else {
+		tmc_copy_xattrs(ctx, path, sfd, dfd, buf);
+		tmc_set_fattrs(ctx, path, sfd, dfd, &st);
+		tm_progress_add(0, 1);
+	}
+	(void) close(sfd);
+	(void) close(dfd);
+}
+
+static void *
+tmc_worker(void *arg)
+{
+	tmc_ctx_t	*ctx = arg;
+	tmc_work_t	*w;
+	char		*buf;
+
+	if ((buf = malloc((ctx->flags & TM_COPY_DEDUP) ?
+	    2 * TMC_CMP_BUFSIZE : TMC_BUFSIZE)) == NULL) {
+		tmc_debug_print(LS_DBGLVL_ERR,
+		    "copy: worker can't allocate buffer\n");
+		return (NULL);
+	}
+
+	for (;;) {
+		(void) pthread_mutex_lock(&ctx->lock);
+		while (ctx->head == NULL && !ctx->done)
+			(void) pthread_cond_wait(&ctx->cv_work, &ctx->lock);
+		if ((w = ctx->head) == NULL) {
+			(void) pthread_mutex_unlock(&ctx->lock);
+			break;
+		}
+		if ((ctx->head = w->next) == NULL)
+			ctx->tail = NULL;
+		ctx->nqueued--;
+		(void) pthread_cond_signal(&ctx->cv_space);
+		(void) pthread_mutex_unlock(&ctx->lock);
+
+		if (!tm_cancelled())
+			tmc_copy_file(ctx, w->path, w->hash, buf);
+		free(w->path);
+		free(w);
+	}
+
+	free(buf);
+	return (NULL);
+}
+
+/*
+ * tmc_enqueue()
+ *	Hands regular file off to workers, waits if the queue is full
+ */
+static int
+tmc_enqueue(tmc_ctx_t *ctx, const char *path, const uint8_t *hash)
+{
+	tmc_work_t	*w;
+
+	if ((w = malloc(sizeof (tmc_work_t))) == NULL)
+		return (ENOMEM);
+	if ((w->path = strdup(path)) == NULL) {
+		free(w);
+		return (ENOMEM);
+	}
+	w->hash = hash;
+	w->next = NULL;
+
+	(void) pthread_mutex_lock(&ctx->lock);
+	while (ctx->nqueued >= TMC_QUEUE_MAX)
+		(void) pthread_cond_wait(&ctx->cv_space, &ctx->lock);
+	if (ctx->tail == NULL)
+		ctx->head = w;
+	else
+		ctx->tail->next = w;
+	ctx->tail = w;
+	ctx->nqueued++;
+	(void) pthread_cond_signal(&ctx->cv_work);
+	(void) pthread_mutex_unlock(&ctx->lock);
+	return (0);
+}
+
+/*
+ * tmc_link_seen()
+ *	Remembers file with multiple links. If another link to the same
+ *	file was already seen, path is put on the deferred list.
+ *	returns B_TRUE if the link is deferred, B_FALSE if the file has
+ *	to be copied
+ */
+static boolean_t
+tmc_link_seen(tmc_ctx_t *ctx, const char *path, const struct stat *st)
+{
+	tmc_link_t	*lp, *dp;
+	uint_t		h;
+
+	h = (uint_t)((st->st_ino ^ st->st_dev) % TMC_LINK_BUCKETS);
+	(void) pthread_mutex_lock(&ctx->meta_lock);
+	for (lp = ctx->links[h]; lp != NULL; lp = lp->next)
+		if (lp->ino == st->st_ino && lp->dev == st->st_dev)
+			break;
+
+	/* if we are out of memory, the link is copied as separate file */
+	if ((dp = calloc(1, sizeof (tmc_link_t))) == NULL ||
+	    (dp->path = strdup(path)) == NULL) {
+		(void) pthread_mutex_unlock(&ctx->meta_lock);
+		free(dp);
+		return (B_FALSE);
+	}
+	dp->dev = st->st_dev;
+	dp->ino = st->st_ino;
+
+	if (lp == NULL) {
+		dp->next = ctx->links[h];
+		ctx->links[h] = dp;
+	} else {
+		dp->first = lp;
+		dp->next = ctx->deferred;
+		ctx->deferred = dp;
+	}
+	(void) pthread_mutex_unlock(&ctx->meta_lock);
+	return (lp != NULL);
+}
+
+/*
+ * tmc_make_links()
+ *	Creates deferred hard links once their first path was copied
+ */
+static void
+tmc_make_links(tmc_ctx_t *ctx)
+{
+	tmc_link_t	*dp;
+	char		target[MAXPATHLEN], dpath[MAXPATHLEN];
+	int		ret;
+
+	for (dp = ctx->deferred; dp != NULL && !tm_cancelled();
+	    dp = dp->next) {
+		tmc_path(target, ctx->dst, dp->first->path);
+		tmc_path(dpath, ctx->dst, dp->path);
+		(void) unlink(dpath);
+		ret = link(target, dpath);
+		if (ret != 0 && errno == ENOENT && tmc_mkparent(dpath) == 0)
+			ret = link(target, dpath);
+		if (ret != 0)
+			tmc_error(ctx, dp->path, "link", errno);
+		else
+			tm_progress_add(0, 1);
+	}
+}
+
+/*
+ * tmc_make_dir()
+ *	Creates directory, its attributes are set by tmc_set_dir_attrs()
+ */
+static void
+tmc_make_dir(tmc_ctx_t *ctx, const char *path, const char *spath,
+    const char *dpath, const struct stat *st)
+{
+	struct stat	dst;
+	tmc_dir_t	*dp;
+	int		ret, sfd, dfd;
+
+	ret = mkdir(dpath, S_IRWXU);
+	if (ret != 0 && errno == ENOENT && tmc_mkparent(dpath) == 0)
+		ret = mkdir(dpath, S_IRWXU);
+	if (ret != 0 && errno == EEXIST && lstat(dpath, &dst) == 0 &&
+	    !S_ISDIR(dst.st_mode) && (ctx->flags & TM_COPY_UNCOND)) {
+		(void) unlink(dpath);
+		ret = mkdir(dpath, S_IRWXU);
+	}
+	if (ret != 0 && errno != EEXIST) {
+		tmc_error(ctx, path, "mkdir", errno);
+		return;
+	}
+
+	if ((sfd = open(spath, O_RDONLY)) >= 0) {
+		if ((dfd = open(dpath, O_RDONLY)) >= 0) {
+			tmc_copy_xattrs(ctx, path, sfd, dfd, NULL);
+			(void) close(dfd);
+		}
+		(void) close(sfd);
+	}
+
+	if ((dp = malloc(sizeof (tmc_dir_t))) == NULL ||
+	    (dp->path = strdup(path)) == NULL) {
+		free(dp);
+		tmc_error(ctx, path, "setting attributes", ENOMEM);
+		return;
+	}
+	dp->st = *st;
+	(void) pthread_mutex_lock(&ctx->meta_lock);
+	dp->next = ctx->dirs;
+	ctx->dirs = dp;
+	(void) pthread_mutex_unlock(&ctx->meta_lock);
+	tm_progress_add(0, 1);
+}
+
+/*
+ * tmc_set_dir_attrs()
+ *	Sets attributes of created directories. The list is in reverse order
+ *	of creation, so subdirectories are done before their parents. That
+ *	holds for parallel walks as well, as a directory is created before
+ *	its entries are read.
+ */
+static void
+tmc_set_dir_attrs(tmc_ctx_t *ctx)
+{
+	tmc_dir_t	*dp;
+	char		spath[MAXPATHLEN], dpath[MAXPATHLEN];
+	acl_t		*aclp;
+	struct timeval	tv[2];
+
+	for (dp = ctx->dirs; dp != NULL && !tm_cancelled(); dp = dp->next) {
+		tmc_path(spath, ctx->src, dp->path);
+		tmc_path(dpath, ctx->dst, dp->path);
+
+		if (ctx->root &&
+		    chown(dpath, dp->st.st_uid, dp->st.st_gid) != 0)
+			tmc_error(ctx, dp->path, "chown", errno);
+		if (chmod(dpath, dp->st.st_mode & 07777) != 0)
+			tmc_error(ctx, dp->path, "chmod", errno);
+
+		aclp = NULL;
+		if (acl_get(spath, ACL_NO_TRIVIAL, &aclp) == 0 &&
+		    aclp != NULL) {
+			if (acl_set(dpath, aclp) != 0)
+				tmc_error(ctx, dp->path, "write of ACL",
+				    errno);
+			acl_free(aclp);
+		}
+
+		if (ctx->flags & TM_COPY_MTIME) {
+			tv[0].tv_sec = dp->st.st_atim.tv_sec;
+			tv[0].tv_usec = dp->st.st_atim.tv_nsec / 1000;
+			tv[1].tv_sec = dp->st.st_mtim.tv_sec;
+			tv[1].tv_usec = dp->st.st_mtim.tv_nsec / 1000;
+			if (utimes(dpath, tv) != 0)
+				tmc_error(ctx, dp->path, "setting times",
+				    errno);
+		}
+	}
+}
+
+/*
+ * tmc_make_special()
+ *	Creates symbolic link, device node or named pipe
+ */
+static void
+tmc_make_special(tmc_ctx_t *ctx, const char *path, const char *spath,
+    const char *dpath, const struct stat *st)
+{
+	char	target[MAXPATHLEN + 1];
+	ssize_t	len = 0;
+	int	ret;
+
+	if (S_ISLNK(st->st_mode)) {
+		if ((len = readlink(spath, target, MAXPATHLEN)) < 0) {
+			tmc_error(ctx, path, "readlink", errno);
+			return;
+		}
+		target[len] = '\0';
+	} else if (!S_ISCHR(st->st_mode) && !S_ISBLK(st->st_mode) &&
+	    !S_ISFIFO(st->st_mode)) {
+		tmc_debug_print(LS_DBGLVL_INFO, "copy: %s skipped, "
+		    "unsupported file type\n", path);
+		return;
+	}
+
+	if (tmc_keep_existing(ctx, dpath, st))
+		return;
+	(void) unlink(dpath);
+
+	ret = S_ISLNK(st->st_mode) ? symlink(target, dpath) :
+	    mknod(dpath, st->st_mode, st->st_rdev);
+	if (ret != 0 && errno == ENOENT && tmc_mkparent(dpath) == 0)
+		ret = S_ISLNK(st->st_mode) ? symlink(target, dpath) :
+		    mknod(dpath, st->st_mode, st->st_rdev);
+	if (ret != 0) {
+		tmc_error(ctx, path, "create", errno);
+		return;
+	}
+
+	if (ctx->root && lchown(dpath, st->st_uid, st->st_gid) != 0)
+		tmc_error(ctx, path, "chown", errno);
+	if (!S_ISLNK(st->st_mode) && chmod(dpath, st->st_mode & 07777) != 0)
+		tmc_error(ctx, path, "chmod", errno);
+	tm_progress_add(0, 1);
+}
+
+/*
+ * tmc_free_ctx()
+ */
+static void
+tmc_free_ctx(tmc_ctx_t *ctx)
+{
+	tmc_dir_t	*dp;
+	tmc_link_t	*lp;
+	int		i;
+
+	while ((dp = ctx->dirs) != NULL) {
+		ctx->dirs = dp->next;
+		free(dp->path);
+		free(dp);
+	}
+	while ((lp = ctx->deferred) != NULL) {
+		ctx->deferred = lp->next;
+		free(lp->path);
+		free(lp);
+	}
+	for (i = 0; i < TMC_LINK_BUCKETS; i++) {
+		while ((lp = ctx->links[i]) != NULL) {
+			ctx->links[i] = lp->next;
+			free(lp->path);
+			free(lp);
+		}
+	}
+	(void) pthread_mutex_destroy(&ctx->lock);
+	(void) pthread_mutex_destroy(&ctx->meta_lock);
+	(void) pthread_cond_destroy(&ctx->cv_work);
+	(void) pthread_cond_destroy(&ctx->cv_space);
+}
+
+/*
+ * tmc_copy_entry()
+ *	Creates directory or special file, or hands regular file off to
+ *	workers together with SHA-1 of its contents, if known.
+ *	Returns 0, or errno if the copy can't go on.
+ */
+static int
+tmc_copy_entry(tmc_ctx_t *ctx, const char *path, const struct stat *st,
+    const uint8_t *hash)
+{
+	char	spath[MAXPATHLEN], dpath[MAXPATHLEN];
+
+	tmc_path(spath, ctx->src, path);
+	tmc_path(dpath, ctx->dst, path);
+
+	if (S_ISDIR(st->st_mode))
+		tmc_make_dir(ctx, path, spath, dpath, st);
+	else if (!S_ISREG(st->st_mode))
+		tmc_make_special(ctx, path, spath, dpath, st);
+	else if (st->st_nlink <= 1 || !tmc_link_seen(ctx, path, st))
+		return (tmc_enqueue(ctx, path, hash));
+	return (0);
+}
+
+/*
+ * tmc_walk_entry()
+ *	tm_walk() callback streaming entries to the copier
+ */
+static int
+tmc_walk_entry(const char *path, const struct stat *st, void *arg)
+{
+	if (tm_cancelled())
+		return (EINTR);
+	return (tmc_copy_entry(arg, path, st, NULL));
+}
+
+/*
+ * tmc_start()
+ *	Initializes copier context and starts workers
+ *	returns 0 on success, EINTR if the transfer was already cancelled,
+ *	e.g. between two lists, errno on failure
+ *	The copier never clears the cancel token, see tm_cancel_reset()
+ */
+static int
+tmc_start(tmc_ctx_t *ctx, const char *src, const char *dst, int flags,
+    int nthreads)
+{
+	int	err = 0;
+
+	if (tm_cancelled())
+		return (EINTR);
+
+	if (nthreads <= 0)
+		nthreads = TM_COPY_DEFAULT_THREADS;
+	nthreads = MIN(nthreads, TM_COPY_MAX_THREADS);
+
+	bzero(ctx, sizeof (tmc_ctx_t));
+	ctx->src = src;
+	ctx->dst = dst;
+	ctx->flags = flags;
+	ctx->root = (geteuid() == 0);
+	(void) pthread_mutex_init(&ctx->lock, NULL);
+	(void) pthread_mutex_init(&ctx->meta_lock, NULL);
+	(void) pthread_cond_init(&ctx->cv_work, NULL);
+	(void) pthread_cond_init(&ctx->cv_space, NULL);
+
+	for (ctx->nthreads = 0; ctx->nthreads < nthreads; ctx->nthreads++)
+		if ((err = pthread_create(&ctx->tids[ctx->nthreads], NULL,
+		    tmc_worker, ctx)) != 0)
+			break;
+	if (ctx->nthreads == 0) {
+		tmc_free_ctx(ctx);
+		return (err);
+	}
+	return (0);
+}
+
+/*
+ * tmc_finish()
+ *	Waits for workers, creates deferred links, sets attributes of
+ *	directories and releases the context
+ *	returns final status of the copy
+ */
+static int
+tmc_finish(tmc_ctx_t *ctx, const char *what, int ret, uint_t *nerrors)
+{
+	int	i;
+
+	(void) pthread_mutex_lock(&ctx->lock);
+	ctx->done = B_TRUE;
+	(void) pthread_cond_broadcast(&ctx->cv_work);
+	(void) pthread_mutex_unlock(&ctx->lock);
+	for (i = 0; i < ctx->nthreads; i++)
+		(void) pthread_join(ctx->tids[i], NULL);
+
+	if (ret == 0 && !tm_cancelled()) {
+		tmc_make_links(ctx);
+		tmc_set_dir_attrs(ctx);
+	}
+	if (tm_cancelled())
+		ret = EINTR;
+
+	*nerrors = ctx->nerrors;
+	tmc_debug_print(LS_DBGLVL_INFO, "copy: %s done, %u errors\n", what,
+	    ctx->nerrors);
+	if (ctx->flags & TM_COPY_DEDUP)
+		tmc_debug_print(LS_DBGLVL_INFO, "copy: %s: %u files were "
+		    "unchanged\n", what, ctx->nunchanged);
+	tmc_free_ctx(ctx);
+	return (ret);
+}
+
+/*
+ * tm_copy_filelist()
+ *	Copies all pathnames listed in file from source to destination
+ *	directory. Pathnames are relative to both directories.
+ * Input:
+ *	src	 - source directory
+ *	dst	 - destination directory
+ *	list	 - file with one pathname per line
+ *	flags	 - TM_COPY_UNCOND, TM_COPY_MTIME, TM_COPY_CLOBBER,
+ *		   TM_COPY_DEDUP
+ *	nthreads - number of workers copying regular files, 0 for default
+ *	nerrors	 - set to number of entries which couldn't be copied
+ * Returns:
+ *	0	- list processed, failures of individual entries are
+ *		  reported through nerrors and logged
+ *	EINTR	- the transfer was cancelled, see tm_cancel()
+ *	errno	- list couldn't be processed
+ */
+int
+tm_copy_filelist(const char *src, const char *dst, const char *list,
+    int flags, int nthreads, uint_t *nerrors)
+{
+	tmc_ctx_t	ctx;
+	char		line[MAXPATHLEN + 1];
+	char		spath[MAXPATHLEN];
+	struct stat	st;
+	char		*p;
+	FILE		*fp;
+	int		ret = 0;
+
+	*nerrors = 0;
+
+	if ((fp = fopen(list, "r")) == NULL) {
+		ret = errno;
+		tmc_debug_print(LS_DBGLVL_ERR, "copy: can't open %s: %s\n",
+		    list, strerror(ret));
+		return (ret);
+	}
+	if ((ret = tmc_start(&ctx, src, dst, flags, nthreads)) != 0) {
+		(void) fclose(fp);
+		return (ret);
+	}
+
+	tmc_debug_print(LS_DBGLVL_INFO, "copy: %s -> %s, list %s, "
+	    "%d threads\n", src, dst, list, ctx.nthreads);
+
+	while (fgets(line, sizeof (line), fp) != NULL) {
+		if (tm_cancelled()) {
+			ret = EINTR;
+			break;
+		}
+		if ((p = strchr(line, '\n')) != NULL)
+			*p = '\0';
+		if (line[0] == '\0')
+			continue;
+
+		tmc_path(spath, src, line);
+		if (lstat(spath, &st) != 0) {
+			tmc_error(&ctx, line, "stat", errno);
+			continue;
+		}
+		if ((ret = tmc_copy_entry(&ctx, line, &st, NULL)) != 0)
+			break;
+	}
+
+	(void) fclose(fp);
+	return (tmc_finish(&ctx, list, ret, nerrors));
+}
+
+/*
+ * tm_copy_tree()
+ *	Copies directory tree from source to destination directory. The
+ *	tree is walked by multiple threads and entries are copied as they
+ *	are found, so no file list has to be built up front. Entries of
+ *	each directory are found in order of inode numbers, see tm_walk().
+ * Input:
+ *	src	 - source directory
+ *	dir	 - directory to copy, relative to src
+ *	dst	 - destination directory, dir is created relative to it
+ *	flags	 - TM_COPY_UNCOND, TM_COPY_MTIME, TM_COPY_CLOBBER,
+ *		   TM_COPY_DEDUP
+ *	nthreads - number of workers copying regular files, 0 for default
+ *	nerrors	 - set to number of entries which couldn't be copied
+ * Returns:
+ *	see tm_copy_filelist()
+ */
+int
+tm_copy_tree(const char *src, const char *dir, const char *dst, int flags,
+    int nthreads, uint_t *nerrors)
+{
+	tmc_ctx_t	ctx;
+	int		ret;
+
+	*nerrors = 0;
+
+	if ((ret = tmc_start(&ctx, src, dst, flags, nthreads)) != 0)
+		return (ret);
+
+	tmc_debug_print(LS_DBGLVL_INFO, "copy: %s/%s -> %s, %d threads\n",
+	    src, dir, dst, ctx.nthreads);
+
+	ret = tm_walk(src, dir, TM_WALK_DEFAULT_THREADS, tmc_walk_entry, &ctx);
+	return (tmc_finish(&ctx, dir, ret, nerrors));
+}
+
+/* manifest entry in the order it is copied */
+typedef struct tmc_order {
+	struct stat	st;
+	int		err;		/* lstat() failure, 0 if found */
+	uint64_t	idx;
+} tmc_order_t;
+
+static int
+tmc_order_cmp(const void *a, const void *b)
+{
+	const tmc_order_t	*oa = a;
+	const tmc_order_t	*ob = b;
+	ino_t			ia, ib;
+
+	ia = (oa->err == 0) ? oa->st.st_ino : (ino_t)-1;
+	ib = (ob->err == 0) ? ob->st.st_ino : (ino_t)-1;
+
+	return (ia < ib ? -1 : ia > ib);
+}
+
+/*
+ * tm_copy_manifest()
+ *	Copies all entries of image content manifest from source to
+ *	destination directory, like tm_copy_filelist() does for the
+ *	content list the manifest was generated from. The manifest is
+ *	written before the media is mastered and can't know where entries
+ *	end up, so every entry is still looked up in the source once, and
+ *	entries are copied in order of their inode numbers, which on hsfs
+ *	are extent locations. That keeps reads of optical and USB media
+ *	sequential, as with the sorted content list. Entries are copied
+ *	with the attributes found by that lookup. With TM_COPY_DEDUP,
+ *	SHA-1 recorded in the manifest is used to check whether existing
+ *	files in the destination need to be copied, so the source is only
+ *	read for files which changed. Hash of an entry whose size no
+ *	longer matches the manifest isn't trusted.
+ * Input:
+ *	src	 - source directory
+ *	dst	 - destination directory
+ *	manifest - image content manifest, see TM_manifest_open()
+ *	flags	 - TM_COPY_UNCOND, TM_COPY_MTIME, TM_COPY_CLOBBER,
+ *		   TM_COPY_DEDUP
+ *	nthreads - number of workers copying regular files, 0 for default
+ *	nerrors	 - set to number of entries which couldn't be copied
+ * Returns:
+ *	see tm_copy_filelist()
+ */
+int
+tm_copy_manifest(const char *src, const char *dst, const char *manifest,
+    int flags, int nthreads, uint_t *nerrors)
+{
+	tmc_ctx_t		ctx;
+	tm_manifest_t		m;
+	const tm_manifest_ent_t	*ent;
+	const uint8_t		*hash;
+	const char		*path;
+	char			spath[MAXPATHLEN];
+	tmc_order_t		*order, *op;
+	uint64_t		i, n;
+	int			ret;
+
+	*nerrors = 0;
+
+	if ((ret = TM_manifest_open(manifest, &m)) != 0) {
+		tmc_debug_print(LS_DBGLVL_ERR, "copy: can't open %s: %s\n",
+		    manifest, strerror(ret));
+		return (ret);
+	}
+	if ((order = calloc(m.hdr->nentries + 1,
+	    sizeof (tmc_order_t))) == NULL) {
+		TM_manifest_close(&m);
+		return (ENOMEM);
+	}
+	if ((ret = tmc_start(&ctx, src, dst, flags, nthreads)) != 0) {
+		free(order);
+		TM_manifest_close(&m);
+		return (ret);
+	}
+
+	tmc_debug_print(LS_DBGLVL_INFO, "copy: %s -> %s, manifest %s, "
+	    "%llu entries, %d threads\n", src, dst, manifest,
+	    (u_longlong_t)m.hdr->nentries, ctx.nthreads);
+
+	/*
+	 * Entries which can't be looked up now are reported when they are
+	 * copied, and sort last.
+	 */
+	for (i = 0; i < m.hdr->nentries; i++) {
+		if (tm_cancelled()) {
+			ret = EINTR;
+			break;
+		}
+		if ((path = TM_manifest_path(&m, i)) == NULL) {
+			tmc_debug_print(LS_DBGLVL_ERR, "copy: entry %llu of "
+			    "%s is invalid\n", (u_longlong_t)i, manifest);
+			ret = EINVAL;
+			break;
+		}
+		tmc_path(spath, src, path);
+		order[i].err = (lstat(spath, &order[i].st) == 0) ? 0 : errno;
+		order[i].idx = i;
+	}
+	n = (ret == 0) ? m.hdr->nentries : 0;
+	qsort(order, n, sizeof (tmc_order_t), tmc_order_cmp);
+
+	for (i = 0; i < n; i++) {
+		if (tm_cancelled()) {
+			ret = EINTR;
+			break;
+		}
+		op = &order[i];
+		path = TM_manifest_path(&m, op->idx);
+		if (op->err != 0) {
+			tmc_error(&ctx, path, "stat", op->err);
+			continue;
+		}
+		ent = &m.ents[op->idx];
+		hash = (S_ISREG(op->st.st_mode) &&
+		    op->st.st_size == ent->size) ? ent->hash : NULL;
+		if ((ret = tmc_copy_entry(&ctx, path, &op->st, hash)) != 0)
+			break;
+	}
+
+	/* hashes queued to workers point into the mapped manifest */
+	ret = tmc_finish(&ctx, manifest, ret, nerrors);
+	free(order);
+	TM_manifest_close(&m);
+	return (ret);
+}
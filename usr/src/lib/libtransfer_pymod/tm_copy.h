@@ -0,0 +1,61 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+#ifndef _TM_COPY_H
+#define	_TM_COPY_H
+
+/*
+ * Native file copier used by the TM_PERFORM_COPY transfer mechanism.
+ * It replaces "cpio -p" for file lists generated by the transfer module
+ * and copies whole directory trees while they are being walked.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+
+/* tm_copy_*() flags, the first three modeled after cpio(1) */
+#define	TM_COPY_UNCOND		0x01	/* -u, overwrite newer files */
+#define	TM_COPY_MTIME		0x02	/* -m, retain modification times */
+#define	TM_COPY_CLOBBER		0x04	/* always replace symbolic links */
+#define	TM_COPY_DEDUP		0x08	/* keep contents of unchanged files */
+
+#define	TM_COPY_MAX_THREADS	64
+#define	TM_COPY_DEFAULT_THREADS	8
+
+int	tm_copy_filelist(const char *src, const char *dst, const char *list,
+    int flags, int nthreads, uint_t *nerrors);
+int	tm_copy_tree(const char *src, const char *dir, const char *dst,
+    int flags, int nthreads, uint_t *nerrors);
+int	tm_copy_manifest(const char *src, const char *dst, const char *manifest,
+    int flags, int nthreads, uint_t *nerrors);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TM_COPY_H */
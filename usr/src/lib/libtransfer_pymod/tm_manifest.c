@@ -0,0 +1,415 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * Image content manifest.
+ *
+ * distro_const records every entry of the media content list together
+ * with its size, mode, ownership, hard link group and SHA-1 of its
+ * contents, so that the installer knows the pathnames, sizes and hashes
+ * of the transfer from a single mapping of the manifest. The manifest
+ * is written before the media is mastered and can't record extent
+ * locations, so the transfer still looks every entry up on the media
+ * once to order the reads. See transfermod.h for the layout.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sha1.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <libnvpair.h>
+
+#include <ls_api.h>
+#include "transfermod.h"
+#include "tm_manifest.h"
+
+#define	TRANSFER_ID		"TRANSFERMOD"
+
+#define	TMM_BUFSIZE		(128 * 1024)
+#define	TMM_CHUNK		4096
+#define	TMM_STRTAB_CHUNK	(1024 * 1024)
+#define	TMM_LINK_BUCKETS	4096
+
+/* first entry of a hard link group */
+typedef struct tmm_link {
+	struct tmm_link	*next;
+	dev_t		dev;
+	ino_t		ino;
+	uint32_t	group;
+} tmm_link_t;
+
+/*
+ * tmm_debug_print()
+ */
+static void
+tmm_debug_print(ls_dbglvl_t dbg_lvl, char *fmt, ...)
+{
+	va_list	ap;
+
+	va_start(ap, fmt);
+	ls_write_dbg_vmessage(TRANSFER_ID, dbg_lvl, fmt, ap);
+	va_end(ap);
+}
+
+/*
+ * tmm_hash_file()
+ *	Computes SHA-1 of file contents
+ *	returns 0 on success, errno on failure
+ */
+static int
+tmm_hash_file(const char *path, uint8_t *hash, char *buf)
+{
+	SHA1_CTX	ctx;
+	ssize_t		n;
+	int		fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return (errno);
+
+	SHA1Init(&ctx);
+	while ((n = read(fd, buf, TMM_BUFSIZE)) != 0) {
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			n = errno;
+			(void) close(fd);
+			return (n);
+		}
+		SHA1Update(&ctx, buf, n);
+	}
+	SHA1Final(hash, &ctx);
+	(void) close(fd);
+	return (0);
+}
+
+/*
+ * tmm_link_group()
+ *	Looks up hard link group of a file, creating new group with the
+ *	given entry index if the file wasn't seen yet
+ *	returns group number, 0 if the file is new or can't be tracked
+ */
+static uint32_t
+tmm_link_group(tmm_link_t **links, const struct stat *st, uint64_t idx)
+{
+	tmm_link_t	*lp;
+	uint_t		h;
+
+	h = (uint_t)((st->st_ino ^ st->st_dev) % TMM_LINK_BUCKETS);
+	for (lp = links[h]; lp != NULL; lp = lp->next)
+		if (lp->ino == st->st_ino && lp->dev == st->st_dev)
+			return (lp->group);
+
+	if ((lp = malloc(sizeof (tmm_link_t))) != NULL) {
+		lp->dev = st->st_dev;
+		lp->ino = st->st_ino;
+		lp->group = idx + 1;
+		lp->next = links[h];
+		links[h] = lp;
+	}
+	return (0);
+}
+
+static int
+tmm_write(int fd, const void *buf, size_t len)
+{
+	const char	*p = buf;
+	ssize_t		n;
+
+	while (len > 0) {
+		if ((n = write(fd, p, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return (errno);
+		}
+		p += n;
+		len -= n;
+	}
+	return (0);
+}
+
+/*
+ * tm_manifest_create()
+ *	Generates image content manifest for pathnames in content list
+ * Input:
+ *	root	   - root of the image the pathnames are relative to
+ *	list	   - content list, one pathname per line
+ *	image_size - size of installed image in KB, 0 if unknown
+ *	path	   - manifest to create, it is written under temporary
+ *		     name and renamed when complete
+ * Returns:
+ *	0 on success, errno on failure
+ */
+int
+tm_manifest_create(const char *root, const char *list, uint64_t image_size,
+    const char *path)
+{
+	tm_manifest_hdr_t	hdr;
+	tm_manifest_ent_t	*ents = NULL, *ep, *tmp;
+	tmm_link_t		*links[TMM_LINK_BUCKETS];
+	tmm_link_t		*lp;
+	char			line[MAXPATHLEN + 1], fpath[MAXPATHLEN];
+	char			tpath[MAXPATHLEN];
+	char			*strtab = NULL, *buf = NULL, *p;
+	size_t			nalloc = 0, salloc = 0, len;
+	struct stat		st;
+	FILE			*fp;
+	int			i, fd = -1, ret = 0;
+
+	bzero(&hdr, sizeof (hdr));
+	bzero(links, sizeof (links));
+
+	if ((fp = fopen(list, "r")) == NULL) {
+		ret = errno;
+		tmm_debug_print(LS_DBGLVL_ERR, "manifest: can't open %s: %s\n",
+		    list, strerror(ret));
+		return (ret);
+	}
+	if ((buf = malloc(TMM_BUFSIZE)) == NULL) {
+		ret = ENOMEM;
+		goto done;
+	}
+
+	while (fgets(line, sizeof (line), fp) != NULL) {
+		if ((p = strchr(line, '\n')) != NULL)
+			*p = '\0';
+		if (line[0] == '\0')
+			continue;
+
+		(void) snprintf(fpath, sizeof (fpath), "%s/%s", root, line);
+		if (lstat(fpath, &st) != 0) {
+			ret = errno;
+			tmm_debug_print(LS_DBGLVL_ERR, "manifest: can't stat "
+			    "%s: %s\n", fpath, strerror(ret));
+			goto done;
+		}
+
+		if (hdr.nentries == nalloc) {
+			if ((tmp = realloc(ents, (nalloc + TMM_CHUNK) *
+			    sizeof (tm_manifest_ent_t))) == NULL) {
+				ret = ENOMEM;
+				goto done;
+			}
+			ents = tmp;
+			nalloc += TMM_CHUNK;
+		}
+		len = strlen(line) + 1;
+		while (hdr.strtab_size + len > salloc) {
+			if ((p = realloc(strtab,
+			    salloc + TMM_STRTAB_CHUNK)) == NULL) {
+				ret = ENOMEM;
+				goto done;
+			}
+			strtab = p;
+			salloc += TMM_STRTAB_CHUNK;
+		}
+
+		ep = &ents[hdr.nentries];
+		bzero(ep, sizeof (tm_manifest_ent_t));
+		ep->path_off = hdr.strtab_size;
+		ep->mode = st.st_mode;
+		ep->uid = st.st_uid;
+		ep->gid = st.st_gid;
+		(void) memcpy(strtab + hdr.strtab_size, line, len);
+		hdr.strtab_size += len;
+
+		if (S_ISREG(st.st_mode)) {
+			ep->size = st.st_size;
+			if (st.st_nlink > 1)
+				ep->link_group = tmm_link_group(links, &st,
+				    hdr.nentries);
+
+			/* contents of the links are those of the first one */
+			if (ep->link_group != 0) {
+				(void) memcpy(ep->hash,
+				    ents[ep->link_group - 1].hash,
+				    TM_MANIFEST_HASH_LEN);
+			} else {
+				if (st.st_nlink > 1)
+					ep->link_group = hdr.nentries + 1;
+				hdr.content_size += st.st_size;
+				if ((ret = tmm_hash_file(fpath, ep->hash,
+				    buf)) != 0) {
+					tmm_debug_print(LS_DBGLVL_ERR,
+					    "manifest: can't read %s: %s\n",
+					    fpath, strerror(ret));
+					goto done;
+				}
+			}
+		}
+		hdr.nentries++;
+	}
+
+	hdr.magic = TM_MANIFEST_MAGIC;
+	hdr.version = TM_MANIFEST_VERSION;
+	hdr.image_size = image_size;
+	hdr.strtab_off = sizeof (hdr) +
+	    hdr.nentries * sizeof (tm_manifest_ent_t);
+
+	(void) snprintf(tpath, sizeof (tpath), "%s.tmp", path);
+	if ((fd = open(tpath, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+		ret = errno;
+		tmm_debug_print(LS_DBGLVL_ERR, "manifest: can't create %s: "
+		    "%s\n", tpath, strerror(ret));
+		goto done;
+	}
+	if ((ret = tmm_write(fd, &hdr, sizeof (hdr))) != 0 ||
+	    (ret = tmm_write(fd, ents,
+	    hdr.nentries * sizeof (tm_manifest_ent_t))) != 0 ||
+	    (ret = tmm_write(fd, strtab, hdr.strtab_size)) != 0 ||
+	    (ret = (fsync(fd) == 0 ? 0 : errno)) != 0) {
+		tmm_debug_print(LS_DBGLVL_ERR, "manifest: can't write %s: "
+		    "%s\n", tpath, strerror(ret));
+		goto done;
+	}
+	if (rename(tpath, path) != 0) {
+		ret = errno;
+		tmm_debug_print(LS_DBGLVL_ERR, "manifest: can't rename %s: "
+		    "%s\n", tpath, strerror(ret));
+		goto done;
+	}
+
+	tmm_debug_print(LS_DBGLVL_INFO, "manifest: %s created, %llu entries, "
+	    "%llu bytes\n", path, (u_longlong_t)hdr.nentries,
+	    (u_longlong_t)hdr.content_size);
+
+done:
+	if (fd >= 0) {
+		(void) close(fd);
+		if (ret != 0)
+			(void) unlink(tpath);
+	}
+	for (i = 0; i < TMM_LINK_BUCKETS; i++) {
+		while ((lp = links[i]) != NULL) {
+			links[i] = lp->next;
+			free(lp);
+		}
+	}
+	free(ents);
+	free(strtab);
+	free(buf);
+	(void) fclose(fp);
+	return (ret);
+}
+
+/*
+ * TM_manifest_open()
+ *	Maps image content manifest into memory and validates its layout
+ * Input:
+ *	path	 - manifest file
+ * Output:
+ *	manifest - mapped manifest, released by TM_manifest_close()
+ * Returns:
+ *	0	- success
+ *	EINVAL	- file is not a manifest this library understands
+ *	errno	- manifest couldn't be mapped
+ */
+int
+TM_manifest_open(const char *path, tm_manifest_t *manifest)
+{
+	const tm_manifest_hdr_t	*hdr;
+	struct stat		st;
+	void			*addr;
+	int			fd, ret;
+
+	bzero(manifest, sizeof (tm_manifest_t));
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return (errno);
+	if (fstat(fd, &st) != 0) {
+		ret = errno;
+		(void) close(fd);
+		return (ret);
+	}
+	if (st.st_size < (off_t)sizeof (tm_manifest_hdr_t)) {
+		(void) close(fd);
+		return (EINVAL);
+	}
+	addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	ret = errno;
+	(void) close(fd);
+	if (addr == MAP_FAILED)
+		return (ret);
+
+	/*
+	 * Sizes are checked one by one, so that none of the sums below
+	 * can overflow
+	 */
+	hdr = addr;
+	if (hdr->magic != TM_MANIFEST_MAGIC ||
+	    hdr->version != TM_MANIFEST_VERSION ||
+	    hdr->nentries > st.st_size / sizeof (tm_manifest_ent_t) ||
+	    hdr->strtab_off != sizeof (tm_manifest_hdr_t) +
+	    hdr->nentries * sizeof (tm_manifest_ent_t) ||
+	    hdr->strtab_size > st.st_size ||
+	    hdr->strtab_off + hdr->strtab_size > st.st_size ||
+	    (hdr->strtab_size != 0 && ((const char *)addr)[hdr->strtab_off +
+	    hdr->strtab_size - 1] != '\0')) {
+		tmm_debug_print(LS_DBGLVL_WARN, "manifest: %s is not valid\n",
+		    path);
+		(void) munmap(addr, st.st_size);
+		return (EINVAL);
+	}
+
+	manifest->addr = addr;
+	manifest->len = st.st_size;
+	manifest->hdr = hdr;
+	manifest->ents = (const tm_manifest_ent_t *)(hdr + 1);
+	manifest->strtab = (const char *)addr + hdr->strtab_off;
+	return (0);
+}
+
+/*
+ * TM_manifest_path()
+ *	Returns pathname of i-th entry of the manifest, NULL if the entry
+ *	is out of range or its pathname is corrupted
+ */
+const char *
+TM_manifest_path(const tm_manifest_t *manifest, uint64_t i)
+{
+	if (i >= manifest->hdr->nentries ||
+	    manifest->ents[i].path_off >= manifest->hdr->strtab_size)
+		return (NULL);
+	return (manifest->strtab + manifest->ents[i].path_off);
+}
+
+/*
+ * TM_manifest_close()
+ */
+void
+TM_manifest_close(tm_manifest_t *manifest)
+{
+	if (manifest->addr != NULL)
+		(void) munmap(manifest->addr, manifest->len);
+	bzero(manifest, sizeof (tm_manifest_t));
+}
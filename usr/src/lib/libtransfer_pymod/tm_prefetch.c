@@ -0,0 +1,307 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * Pipelined install.
+ *
+ * The installer prepares the target (partitions, root pool, boot
+ * environment) in one thread while another one runs the transfer. With
+ * TM_WAIT_TARGET, the transfer does all the work which only needs the
+ * source up front: file lists are built and source files are read, in
+ * the order they will be copied, so that they are in the page cache
+ * (and decompressed, on compressed lofi media) by the time the target
+ * is mounted. The transfer then waits for the target in
+ * tm_target_wait() and starts writing right away.
+ *
+ * Read ahead stops as soon as the target is ready, so that it doesn't
+ * compete with the copy, and once it read the given budget of bytes,
+ * which is kept well below physical memory, so that files read first
+ * aren't evicted by those read last.
+ *
+ * The target state is process wide like the cancel token. It is ready
+ * unless the installer sets it pending, so transfers not started by
+ * the installer never wait.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <libnvpair.h>
+
+#include <ls_api.h>
+#include "transfermod.h"
+#include "tm_cancel.h"
+#include "tm_prefetch.h"
+#include "tm_walk.h"
+
+#define	TRANSFER_ID		"TRANSFERMOD"
+
+#define	TMR_BUFSIZE		(32 * 1024)
+
+typedef struct tmr_ctx {
+	const char	*src;
+	uint64_t	budget;
+	uint64_t	nread;		/* protected by lock */
+	FILE		*fp;		/* list, protected by lock */
+	pthread_mutex_t	lock;
+} tmr_ctx_t;
+
+static pthread_mutex_t		tmr_lock = PTHREAD_MUTEX_INITIALIZER;
+static tm_target_state_t	tmr_state = TM_TARGET_READY;
+static int			tmr_pipe[2] = { -1, -1 };
+
+/*
+ * tmr_debug_print()
+ */
+static void
+tmr_debug_print(ls_dbglvl_t dbg_lvl, char *fmt, ...)
+{
+	va_list	ap;
+
+	va_start(ap, fmt);
+	ls_write_dbg_vmessage(TRANSFER_ID, dbg_lvl, fmt, ap);
+	va_end(ap);
+}
+
+/*
+ * TM_set_target_state()
+ *	Called by the installer: TM_TARGET_PENDING before it starts to
+ *	prepare the target, TM_TARGET_READY once the target is mounted,
+ *	TM_TARGET_FAILED if it couldn't be prepared. Transfer waiting in
+ *	tm_target_wait() is woken by the latter two.
+ */
+void
+TM_set_target_state(tm_target_state_t state)
+{
+	char	buf[64];
+
+	(void) pthread_mutex_lock(&tmr_lock);
+	if (tmr_pipe[0] < 0 && pipe(tmr_pipe) == 0) {
+		(void) fcntl(tmr_pipe[0], F_SETFL, O_NONBLOCK);
+		(void) fcntl(tmr_pipe[1], F_SETFL, O_NONBLOCK);
+		(void) fcntl(tmr_pipe[0], F_SETFD, FD_CLOEXEC);
+		(void) fcntl(tmr_pipe[1], F_SETFD, FD_CLOEXEC);
+	}
+	if (tmr_pipe[0] >= 0) {
+		if (state == TM_TARGET_PENDING) {
+			while (read(tmr_pipe[0], buf, sizeof (buf)) > 0)
+				;
+		} else if (tmr_state == TM_TARGET_PENDING) {
+			(void) write(tmr_pipe[1], "x", 1);
+		}
+	}
+	tmr_state = state;
+	(void) pthread_mutex_unlock(&tmr_lock);
+}
+
+/*
+ * tm_target_pending()
+ *	Returns B_TRUE while the target is being prepared
+ */
+boolean_t
+tm_target_pending(void)
+{
+	return (tmr_state == TM_TARGET_PENDING ? B_TRUE : B_FALSE);
+}
+
+/*
+ * tm_target_wait()
+ *	Waits until the target is prepared
+ * Returns:
+ *	0	- target is ready
+ *	EIO	- target couldn't be prepared
+ *	EINTR	- the transfer was cancelled
+ */
+int
+tm_target_wait(void)
+{
+	int	ret;
+
+	while (tmr_state == TM_TARGET_PENDING) {
+		ret = tm_cancel_wait(tmr_pipe[0], tmr_pipe[0] < 0 ? 1000 : -1);
+		if (ret == EINTR)
+			return (EINTR);
+		if (ret != 0 && ret != ETIMEDOUT)
+			(void) sleep(1);
+	}
+	return (tmr_state == TM_TARGET_READY ? 0 : EIO);
+}
+
+/*
+ * tmr_stop()
+ *	Returns B_TRUE once read ahead should stop
+ */
+static boolean_t
+tmr_stop(tmr_ctx_t *ctx)
+{
+	return (!tm_target_pending() || tm_cancelled() ||
+	    (ctx->budget != 0 && ctx->nread >= ctx->budget));
+}
+
+/*
+ * tmr_read_file()
+ *	Reads regular file so that its data end up in the page cache
+ */
+static void
+tmr_read_file(tmr_ctx_t *ctx, const char *path)
+{
+	char		buf[TMR_BUFSIZE];
+	uint64_t	n = 0;
+	ssize_t		len;
+	int		fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return;
+	while (!tmr_stop(ctx) && (len = read(fd, buf, sizeof (buf))) > 0) {
+		n += len;
+		if (n >= 64 * TMR_BUFSIZE) {
+			(void) pthread_mutex_lock(&ctx->lock);
+			ctx->nread += n;
+			(void) pthread_mutex_unlock(&ctx->lock);
+			n = 0;
+		}
+	}
+	(void) close(fd);
+
+	(void) pthread_mutex_lock(&ctx->lock);
+	ctx->nread += n;
+	(void) pthread_mutex_unlock(&ctx->lock);
+}
+
+/*
+ * tmr_walk_entry()
+ *	tm_walk() callback reading regular files found
+ */
+static int
+tmr_walk_entry(const char *path, const struct stat *st, void *arg)
+{
+	tmr_ctx_t	*ctx = arg;
+	char		spath[MAXPATHLEN];
+
+	if (tmr_stop(ctx))
+		return (EINTR);
+	if (S_ISREG(st->st_mode) && st->st_size > 0) {
+		(void) snprintf(spath, sizeof (spath), "%s/%s", ctx->src, path);
+		tmr_read_file(ctx, spath);
+	}
+	return (0);
+}
+
+/*
+ * tmr_list_worker()
+ *	Reads files named in the list until it is exhausted
+ */
+static void *
+tmr_list_worker(void *arg)
+{
+	tmr_ctx_t	*ctx = arg;
+	char		line[MAXPATHLEN + 1], spath[MAXPATHLEN];
+	struct stat	st;
+	char		*p;
+
+	while (!tmr_stop(ctx)) {
+		(void) pthread_mutex_lock(&ctx->lock);
+		p = fgets(line, sizeof (line), ctx->fp);
+		(void) pthread_mutex_unlock(&ctx->lock);
+		if (p == NULL)
+			break;
+		if ((p = strchr(line, '\n')) != NULL)
+			*p = '\0';
+
+		(void) snprintf(spath, sizeof (spath), "%s/%s", ctx->src, line);
+		if (lstat(spath, &st) == 0 && S_ISREG(st.st_mode) &&
+		    st.st_size > 0)
+			tmr_read_file(ctx, spath);
+	}
+	return (NULL);
+}
+
+/*
+ * tm_prefetch()
+ *	Reads source of the transfer ahead while the target is pending
+ * Input:
+ *	src	- source directory, or file to read if list and dir are
+ *		  both NULL
+ *	list	- file with pathnames relative to src, one per line
+ *	dir	- directory to walk, relative to src
+ *	budget	- bytes to read at most, 0 for no limit
+ * Output:
+ *	nread	- bytes read
+ * Returns:
+ *	0	- everything was read, or read ahead stopped
+ *	errno	- list couldn't be opened or directory walked
+ */
+int
+tm_prefetch(const char *src, const char *list, const char *dir,
+    uint64_t budget, uint64_t *nread)
+{
+	tmr_ctx_t	ctx;
+	pthread_t	tids[TM_PREFETCH_THREADS];
+	int		i, nthreads, ret = 0;
+
+	bzero(&ctx, sizeof (ctx));
+	ctx.src = src;
+	ctx.budget = budget;
+	(void) pthread_mutex_init(&ctx.lock, NULL);
+
+	if (dir != NULL) {
+		ret = tm_walk(src, dir, TM_PREFETCH_THREADS, tmr_walk_entry,
+		    &ctx);
+		if (ret == EINTR)
+			ret = 0;
+	} else if (list != NULL) {
+		if ((ctx.fp = fopen(list, "r")) == NULL) {
+			ret = errno;
+		} else {
+			for (nthreads = 0; nthreads < TM_PREFETCH_THREADS;
+			    nthreads++)
+				if (pthread_create(&tids[nthreads], NULL,
+				    tmr_list_worker, &ctx) != 0)
+					break;
+			if (nthreads == 0)
+				(void) tmr_list_worker(&ctx);
+			for (i = 0; i < nthreads; i++)
+				(void) pthread_join(tids[i], NULL);
+			(void) fclose(ctx.fp);
+		}
+	} else {
+		tmr_read_file(&ctx, src);
+	}
+
+	(void) pthread_mutex_destroy(&ctx.lock);
+	*nread = ctx.nread;
+	tmr_debug_print(LS_DBGLVL_INFO, "prefetch: %s%s%s: %llu bytes read "
+	    "ahead\n", src, dir != NULL ? "/" : "", dir != NULL ? dir : "",
+	    (u_longlong_t)ctx.nread);
+	return (ret);
+}
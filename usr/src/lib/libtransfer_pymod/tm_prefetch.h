@@ -0,0 +1,51 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+#ifndef _TM_PREFETCH_H
+#define	_TM_PREFETCH_H
+
+/*
+ * Read ahead of the source while the target of the transfer is being
+ * prepared, see TM_set_target_state()
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+
+#define	TM_PREFETCH_THREADS	4
+
+boolean_t	tm_target_pending(void);
+int		tm_target_wait(void);
+int		tm_prefetch(const char *src, const char *list, const char *dir,
+    uint64_t budget, uint64_t *nread);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TM_PREFETCH_H */
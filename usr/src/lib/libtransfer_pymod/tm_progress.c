@@ -0,0 +1,181 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * Transfer progress shared by the transfer engine and its consumers.
+ *
+ * The transfer module runs in the address space of the installer, so
+ * progress is kept in process wide counters. Copier threads only bump
+ * them atomically; throughput and estimated time to completion are
+ * computed when a consumer asks for the snapshot, so that the cost of
+ * publishing progress doesn't depend on how often it is read.
+ */
+
+#include <atomic.h>
+#include <pthread.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <libnvpair.h>
+
+#include "transfermod.h"
+#include "tm_progress.h"
+
+/* throughput is resampled at most once per second */
+#define	TMP_SAMPLE_NSEC		NANOSEC
+
+/* weight of the last sample in smoothed throughput, in percent */
+#define	TMP_SAMPLE_WEIGHT	30
+
+static pthread_mutex_t	tmp_lock = PTHREAD_MUTEX_INITIALIZER;
+static boolean_t	tmp_active = B_FALSE;
+static uint64_t		tmp_bytes = 0;
+static uint64_t		tmp_files = 0;
+static uint64_t		tmp_total = 0;
+static char		tmp_path[TM_PROGRESS_PATH_LEN];
+
+/* last throughput sample */
+static hrtime_t		tmp_sample_time;
+static uint64_t		tmp_sample_bytes;
+static uint64_t		tmp_rate;
+
+/*
+ * tm_progress_start()
+ *	Resets counters at the beginning of a file transfer
+ * Input:
+ *	total - expected number of bytes to transfer, 0 if unknown
+ */
+void
+tm_progress_start(uint64_t total)
+{
+	(void) pthread_mutex_lock(&tmp_lock);
+	tmp_bytes = 0;
+	tmp_files = 0;
+	tmp_total = total;
+	tmp_path[0] = '\0';
+	tmp_sample_time = gethrtime();
+	tmp_sample_bytes = 0;
+	tmp_rate = 0;
+	tmp_active = B_TRUE;
+	(void) pthread_mutex_unlock(&tmp_lock);
+}
+
+/*
+ * tm_progress_end()
+ *	Marks the file transfer finished, counters keep their final values
+ */
+void
+tm_progress_end(void)
+{
+	(void) pthread_mutex_lock(&tmp_lock);
+	tmp_active = B_FALSE;
+	tmp_path[0] = '\0';
+	(void) pthread_mutex_unlock(&tmp_lock);
+}
+
+/*
+ * tm_progress_add()
+ *	Accounts transferred bytes and files, called by copier threads
+ */
+void
+tm_progress_add(uint64_t bytes, uint64_t files)
+{
+	if (bytes != 0)
+		atomic_add_64(&tmp_bytes, bytes);
+	if (files != 0)
+		atomic_add_64(&tmp_files, files);
+}
+
+/*
+ * tm_progress_set()
+ *	Sets number of transferred bytes, used when they are estimated
+ *	rather than counted
+ */
+void
+tm_progress_set(uint64_t bytes)
+{
+	(void) atomic_swap_64(&tmp_bytes, bytes);
+}
+
+/*
+ * tm_progress_path()
+ *	Records file being transferred. It is informational only, so if
+ *	another thread is updating it, this update is skipped rather than
+ *	waited for.
+ */
+void
+tm_progress_path(const char *path)
+{
+	if (pthread_mutex_trylock(&tmp_lock) != 0)
+		return;
+	(void) strlcpy(tmp_path, path, sizeof (tmp_path));
+	(void) pthread_mutex_unlock(&tmp_lock);
+}
+
+/*
+ * TM_get_progress()
+ *	Returns snapshot of the current file transfer. Throughput is
+ *	exponentially smoothed over one second samples, so that estimated
+ *	time to completion doesn't jump with every large file.
+ * Output:
+ *	progress - filled in snapshot
+ */
+void
+TM_get_progress(tm_progress_t *progress)
+{
+	hrtime_t	now;
+	uint64_t	rate;
+
+	bzero(progress, sizeof (tm_progress_t));
+
+	(void) pthread_mutex_lock(&tmp_lock);
+	progress->active = tmp_active;
+	progress->bytes_done = tmp_bytes;
+	progress->files_done = tmp_files;
+	progress->bytes_total = tmp_total;
+	(void) strlcpy(progress->path, tmp_path, sizeof (progress->path));
+
+	now = gethrtime();
+	if (tmp_active && now - tmp_sample_time >= TMP_SAMPLE_NSEC &&
+	    progress->bytes_done >= tmp_sample_bytes) {
+		rate = (progress->bytes_done - tmp_sample_bytes) *
+		    (double)NANOSEC / (now - tmp_sample_time);
+		if (tmp_rate == 0)
+			tmp_rate = rate;
+		else
+			tmp_rate = (rate * TMP_SAMPLE_WEIGHT +
+			    tmp_rate * (100 - TMP_SAMPLE_WEIGHT)) / 100;
+		tmp_sample_time = now;
+		tmp_sample_bytes = progress->bytes_done;
+	}
+	progress->throughput = tmp_rate;
+	(void) pthread_mutex_unlock(&tmp_lock);
+
+	if (progress->active && progress->throughput != 0 &&
+	    progress->bytes_total > progress->bytes_done)
+		progress->eta = (progress->bytes_total -
+		    progress->bytes_done) / progress->throughput;
+}
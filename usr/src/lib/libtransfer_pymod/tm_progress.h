@@ -0,0 +1,50 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+#ifndef _TM_PROGRESS_H
+#define	_TM_PROGRESS_H
+
+/*
+ * Producer side of the transfer progress published through
+ * TM_get_progress()
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+
+void	tm_progress_start(uint64_t total);
+void	tm_progress_end(void);
+void	tm_progress_add(uint64_t bytes, uint64_t files);
+void	tm_progress_set(uint64_t bytes);
+void	tm_progress_path(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TM_PROGRESS_H */
@@ -0,0 +1,441 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+
+/*
+ * Parallel file tree walker.
+ *
+ * Directories waiting to be read are kept on a shared stack, walker
+ * threads pop them, read them and push subdirectories back. Every entry
+ * is reported to the callback together with its lstat(2) data, so that
+ * consumers get size, inode and link count without looking the entry up
+ * again. A directory is reported before it is pushed, so the callback
+ * always sees a directory before any of its entries.
+ *
+ * Entries of each directory are reported in order of their inode numbers,
+ * which on hsfs are extent locations. Consumers reading files as they are
+ * reported, like the streaming copier, then read the media mostly
+ * sequentially instead of seeking back and forth in readdir order.
+ *
+ * The walk follows the rules the transfer module always used for its
+ * file lists: the top level directory itself is not reported, symbolic
+ * links are not followed and directories mounted from other file systems
+ * are reported, but not descended into.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <ls_api.h>
+#include "tm_walk.h"
+
+#define	TRANSFER_ID		"TRANSFERMOD"
+
+#define	TMW_MAX_THREADS		32
+#define	TMW_LIST_CHUNK		8192
+#define	TMW_DIR_CHUNK		256
+
+/* directory waiting to be read, path is relative to the root */
+typedef struct tmw_dir {
+	struct tmw_dir	*next;
+	char		*path;
+} tmw_dir_t;
+
+typedef struct tmw_ctx {
+	const char	*root;
+	dev_t		dev;
+	tm_walk_cb_t	cb;
+	void		*arg;
+
+	pthread_mutex_t	lock;
+	pthread_cond_t	cv;
+	tmw_dir_t	*stack;
+	int		nbusy;
+	int		ret;
+} tmw_ctx_t;
+
+/* entry of directory being read */
+typedef struct tmw_ent {
+	struct stat	st;
+	char		*name;
+} tmw_ent_t;
+
+/* state of tm_walk_list() */
+typedef struct tmw_list {
+	pthread_mutex_t	lock;
+	tm_walk_ent_t	*ents;
+	size_t		nents;
+	size_t		nalloc;
+} tmw_list_t;
+
+/*
+ * tmw_debug_print()
+ */
+static void
+tmw_debug_print(ls_dbglvl_t dbg_lvl, char *fmt, ...)
+{
+	va_list	ap;
+
+	va_start(ap, fmt);
+	ls_write_dbg_vmessage(TRANSFER_ID, dbg_lvl, fmt, ap);
+	va_end(ap);
+}
+
+/*
+ * tmw_stop()
+ *	Records the first failure, which makes all walker threads finish
+ */
+static void
+tmw_stop(tmw_ctx_t *ctx, int ret)
+{
+	(void) pthread_mutex_lock(&ctx->lock);
+	if (ctx->ret == 0)
+		ctx->ret = ret;
+	(void) pthread_cond_broadcast(&ctx->cv);
+	(void) pthread_mutex_unlock(&ctx->lock);
+}
+
+/*
+ * tmw_push()
+ *	Queues directory for reading
+ */
+static int
+tmw_push(tmw_ctx_t *ctx, const char *path)
+{
+	tmw_dir_t	*dp;
+
+	if ((dp = malloc(sizeof (tmw_dir_t))) == NULL)
+		return (ENOMEM);
+	if ((dp->path = strdup(path)) == NULL) {
+		free(dp);
+		return (ENOMEM);
+	}
+
+	(void) pthread_mutex_lock(&ctx->lock);
+	dp->next = ctx->stack;
+	ctx->stack = dp;
+	(void) pthread_cond_signal(&ctx->cv);
+	(void) pthread_mutex_unlock(&ctx->lock);
+	return (0);
+}
+
+static int
+tmw_ent_cmp(const void *a, const void *b)
+{
+	ino_t	ia = ((const tmw_ent_t *)a)->st.st_ino;
+	ino_t	ib = ((const tmw_ent_t *)b)->st.st_ino;
+
+	return (ia < ib ? -1 : ia > ib);
+}
+
+/*
+ * tmw_read_dir()
+ *	Reports all entries of one directory in order of inode numbers
+ *	and queues its subdirectories
+ */
+static void
+tmw_read_dir(tmw_ctx_t *ctx, const char *dir)
+{
+	char		dpath[MAXPATHLEN], path[MAXPATHLEN];
+	tmw_ent_t	*ents = NULL, *ep;
+	size_t		nents = 0, nalloc = 0, i;
+	struct dirent	*dp;
+	DIR		*dirp;
+	boolean_t	descend;
+	int		ret = 0;
+
+	(void) snprintf(dpath, sizeof (dpath), "%s/%s", ctx->root, dir);
+	if ((dirp = opendir(dpath)) == NULL) {
+		tmw_debug_print(LS_DBGLVL_WARN, "walk: can't read %s: %s\n",
+		    dpath, strerror(errno));
+		return;
+	}
+
+	while ((dp = readdir(dirp)) != NULL && ctx->ret == 0) {
+		if (strcmp(dp->d_name, ".") == 0 ||
+		    strcmp(dp->d_name, "..") == 0)
+			continue;
+
+		if (strlen(dir) + strlen(dp->d_name) + 1 >= sizeof (path)) {
+			tmw_debug_print(LS_DBGLVL_WARN, "walk: %s/%s: "
+			    "name too long\n", dir, dp->d_name);
+			continue;
+		}
+		if (nents == nalloc) {
+			if ((ep = realloc(ents, (nalloc + TMW_DIR_CHUNK) *
+			    sizeof (tmw_ent_t))) == NULL) {
+				ret = ENOMEM;
+				break;
+			}
+			ents = ep;
+			nalloc += TMW_DIR_CHUNK;
+		}
+		ep = &ents[nents];
+		if (fstatat(dirfd(dirp), dp->d_name, &ep->st,
+		    AT_SYMLINK_NOFOLLOW) != 0) {
+			tmw_debug_print(LS_DBGLVL_WARN, "walk: can't stat "
+			    "%s/%s: %s\n", dir, dp->d_name, strerror(errno));
+			continue;
+		}
+		if ((ep->name = strdup(dp->d_name)) == NULL) {
+			ret = ENOMEM;
+			break;
+		}
+		nents++;
+	}
+
+	(void) closedir(dirp);
+
+	if (nents > 1)
+		qsort(ents, nents, sizeof (tmw_ent_t), tmw_ent_cmp);
+
+	for (i = 0, ep = ents; i < nents && ret == 0 && ctx->ret == 0;
+	    i++, ep++) {
+		(void) snprintf(path, sizeof (path), "%s/%s", dir, ep->name);
+
+		/*
+		 * st describes the link itself, so symbolic link to
+		 * directory is reported as an entry which is not descended
+		 * into and is not subject to name matching of the callers.
+		 */
+		descend = S_ISDIR(ep->st.st_mode) && ep->st.st_dev == ctx->dev;
+
+		if ((ret = ctx->cb(path, &ep->st, ctx->arg)) != 0)
+			break;
+		if (descend)
+			ret = tmw_push(ctx, path);
+	}
+
+	if (ret != 0)
+		tmw_stop(ctx, ret);
+	for (i = 0; i < nents; i++)
+		free(ents[i].name);
+	free(ents);
+}
+
+static void *
+tmw_worker(void *arg)
+{
+	tmw_ctx_t	*ctx = arg;
+	tmw_dir_t	*dp;
+
+	(void) pthread_mutex_lock(&ctx->lock);
+	for (;;) {
+		while (ctx->stack == NULL && ctx->nbusy > 0 && ctx->ret == 0)
+			(void) pthread_cond_wait(&ctx->cv, &ctx->lock);
+
+		/*
+		 * Nothing left to read and nobody who could find more,
+		 * or the walk was stopped
+		 */
+		if (ctx->ret != 0 || (dp = ctx->stack) == NULL)
+			break;
+		ctx->stack = dp->next;
+		ctx->nbusy++;
+		(void) pthread_mutex_unlock(&ctx->lock);
+
+		tmw_read_dir(ctx, dp->path);
+		free(dp->path);
+		free(dp);
+
+		(void) pthread_mutex_lock(&ctx->lock);
+		if (--ctx->nbusy == 0 && ctx->stack == NULL)
+			(void) pthread_cond_broadcast(&ctx->cv);
+	}
+	(void) pthread_cond_broadcast(&ctx->cv);
+	(void) pthread_mutex_unlock(&ctx->lock);
+	return (NULL);
+}
+
+/*
+ * tm_walk()
+ *	Walks directory tree with multiple threads
+ * Input:
+ *	root	 - directory the reported paths are relative to
+ *	dir	 - directory to walk, relative to root
+ *	nthreads - number of walker threads, 0 for default
+ *	cb	 - invoked for every entry found, possibly concurrently
+ *	arg	 - passed to cb
+ * Returns:
+ *	0	- tree walked, unreadable entries are logged and skipped
+ *	errno	- walk couldn't be started
+ *	other	- non-zero value returned by cb
+ */
+int
+tm_walk(const char *root, const char *dir, int nthreads, tm_walk_cb_t cb,
+    void *arg)
+{
+	tmw_ctx_t	ctx;
+	pthread_t	tids[TMW_MAX_THREADS];
+	char		path[MAXPATHLEN];
+	struct stat	st;
+	tmw_dir_t	*dp;
+	int		i, nstarted, err = 0;
+
+	if (nthreads <= 0)
+		nthreads = TM_WALK_DEFAULT_THREADS;
+	nthreads = MIN(nthreads, TMW_MAX_THREADS);
+
+	(void) snprintf(path, sizeof (path), "%s/%s", root, dir);
+	if (stat(path, &st) != 0) {
+		err = errno;
+		tmw_debug_print(LS_DBGLVL_ERR, "walk: can't stat %s: %s\n",
+		    path, strerror(err));
+		return (err);
+	}
+
+	bzero(&ctx, sizeof (ctx));
+	ctx.root = root;
+	ctx.dev = st.st_dev;
+	ctx.cb = cb;
+	ctx.arg = arg;
+	(void) pthread_mutex_init(&ctx.lock, NULL);
+	(void) pthread_cond_init(&ctx.cv, NULL);
+
+	if ((err = tmw_push(&ctx, dir)) != 0)
+		goto done;
+
+	for (nstarted = 0; nstarted < nthreads; nstarted++)
+		if ((err = pthread_create(&tids[nstarted], NULL, tmw_worker,
+		    &ctx)) != 0)
+			break;
+	if (nstarted == 0)
+		goto done;
+	for (i = 0; i < nstarted; i++)
+		(void) pthread_join(tids[i], NULL);
+	err = ctx.ret;
+
+	tmw_debug_print(LS_DBGLVL_INFO, "walk: %s done with %d threads\n",
+	    path, nstarted);
+
+done:
+	while ((dp = ctx.stack) != NULL) {
+		ctx.stack = dp->next;
+		free(dp->path);
+		free(dp);
+	}
+	(void) pthread_mutex_destroy(&ctx.lock);
+	(void) pthread_cond_destroy(&ctx.cv);
+	return (err);
+}
+
+/*
+ * tmw_list_add()
+ *	tm_walk() callback collecting entries for tm_walk_list()
+ */
+static int
+tmw_list_add(const char *path, const struct stat *st, void *arg)
+{
+	tmw_list_t	*lp = arg;
+	tm_walk_ent_t	*ents;
+	char		*p;
+
+	if ((p = strdup(path)) == NULL)
+		return (ENOMEM);
+
+	(void) pthread_mutex_lock(&lp->lock);
+	if (lp->nents == lp->nalloc) {
+		if ((ents = realloc(lp->ents, (lp->nalloc + TMW_LIST_CHUNK) *
+		    sizeof (tm_walk_ent_t))) == NULL) {
+			(void) pthread_mutex_unlock(&lp->lock);
+			free(p);
+			return (ENOMEM);
+		}
+		lp->ents = ents;
+		lp->nalloc += TMW_LIST_CHUNK;
+	}
+	lp->ents[lp->nents].ino = st->st_ino;
+	lp->ents[lp->nents].path = p;
+	lp->nents++;
+	(void) pthread_mutex_unlock(&lp->lock);
+	return (0);
+}
+
+static int
+tmw_ino_cmp(const void *a, const void *b)
+{
+	ino_t	ia = ((const tm_walk_ent_t *)a)->ino;
+	ino_t	ib = ((const tm_walk_ent_t *)b)->ino;
+
+	return (ia < ib ? -1 : ia > ib);
+}
+
+/*
+ * tm_walk_list()
+ *	Walks directory tree and returns all entries sorted by inode number,
+ *	which keeps reads of the source sequential on media like hsfs
+ * Input:
+ *	root, dir, nthreads - see tm_walk()
+ * Output:
+ *	entsp	- array of entries, to be released with tm_walk_free_list()
+ *	nentsp	- number of entries
+ * Returns:
+ *	0 on success, errno on failure
+ */
+int
+tm_walk_list(const char *root, const char *dir, int nthreads,
+    tm_walk_ent_t **entsp, size_t *nentsp)
+{
+	tmw_list_t	list;
+	int		ret;
+
+	bzero(&list, sizeof (list));
+	(void) pthread_mutex_init(&list.lock, NULL);
+
+	ret = tm_walk(root, dir, nthreads, tmw_list_add, &list);
+	(void) pthread_mutex_destroy(&list.lock);
+	if (ret != 0) {
+		tm_walk_free_list(list.ents, list.nents);
+		return (ret);
+	}
+
+	qsort(list.ents, list.nents, sizeof (tm_walk_ent_t), tmw_ino_cmp);
+	*entsp = list.ents;
+	*nentsp = list.nents;
+	return (0);
+}
+
+/*
+ * tm_walk_free_list()
+ */
+void
+tm_walk_free_list(tm_walk_ent_t *ents, size_t nents)
+{
+	size_t	i;
+
+	for (i = 0; i < nents; i++)
+		free(ents[i].path);
+	free(ents);
+}
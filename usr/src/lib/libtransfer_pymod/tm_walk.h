@@ -0,0 +1,65 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+#ifndef _TM_WALK_H
+#define	_TM_WALK_H
+
+/*
+ * Parallel file tree walker used by the transfer module
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define	TM_WALK_DEFAULT_THREADS	4
+
+/*
+ * invoked for every entry found, concurrently from all walker threads.
+ * Non-zero return value stops the walk and is returned by tm_walk().
+ */
+typedef int (*tm_walk_cb_t)(const char *path, const struct stat *st,
+    void *arg);
+
+/* entry of list returned by tm_walk_list() */
+typedef struct tm_walk_ent {
+	ino_t		ino;
+	char		*path;
+} tm_walk_ent_t;
+
+int	tm_walk(const char *root, const char *dir, int nthreads,
+    tm_walk_cb_t cb, void *arg);
+int	tm_walk_list(const char *root, const char *dir, int nthreads,
+    tm_walk_ent_t **entsp, size_t *nentsp);
+void	tm_walk_free_list(tm_walk_ent_t *ents, size_t nents);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TM_WALK_H */
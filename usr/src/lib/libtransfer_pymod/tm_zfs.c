@@ -0,0 +1,346 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+/*
+ * ZFS image stream receiver.
+ *
+ * distro_const can put a "zfs send" stream of the root image on the
+ * media. Installing from it replaces per-file copying with sequential
+ * read of a single file: the stream is piped, decompressed if needed,
+ * into "zfs receive" of the root dataset of the freshly created boot
+ * environment. Bytes of the stream consumed are published through the
+ * transfer progress counters (tm_progress.c).
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <ls_api.h>
+#include "tm_cancel.h"
+#include "tm_progress.h"
+#include "tm_zfs.h"
+
+#define	TRANSFER_ID		"TRANSFERMOD"
+
+#define	TMZ_BUFSIZE		(1024 * 1024)
+#define	TMZ_ZFS			"/usr/sbin/zfs"
+#define	TMZ_GZIP		"/usr/bin/gzip"
+#define	TMZ_ERR_TEMPLATE	"/tmp/tm_zfs_recv.XXXXXX"
+
+/*
+ * tmz_debug_print()
+ */
+static void
+tmz_debug_print(ls_dbglvl_t dbg_lvl, char *fmt, ...)
+{
+	va_list	ap;
+
+	va_start(ap, fmt);
+	ls_write_dbg_vmessage(TRANSFER_ID, dbg_lvl, fmt, ap);
+	va_end(ap);
+}
+
+/*
+ * tmz_log_errors()
+ *	Logs error output of the receiving pipeline
+ */
+static void
+tmz_log_errors(const char *path)
+{
+	char	line[MAXPATHLEN];
+	FILE	*fp;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return;
+	while (fgets(line, sizeof (line), fp) != NULL)
+		tmz_debug_print(LS_DBGLVL_ERR, "zfs: %s", line);
+	(void) fclose(fp);
+}
+
+/*
+ * tmz_is_gzip()
+ *	Checks for gzip magic number at the beginning of the stream
+ */
+static boolean_t
+tmz_is_gzip(int fd)
+{
+	unsigned char	magic[2];
+	boolean_t	ret;
+
+	ret = (pread(fd, magic, sizeof (magic), 0) == sizeof (magic) &&
+	    magic[0] == 0x1f && magic[1] == 0x8b);
+	return (ret);
+}
+
+/*
+ * tmz_spawn()
+ *	Runs command with given standard input, output and error. Other
+ *	descriptors of the pipeline are close-on-exec, so that the reading
+ *	end sees end of file once the writer is done.
+ * Returns:
+ *	process id, -1 on failure with errno set
+ */
+static pid_t
+tmz_spawn(char *const argv[], int in, int out, int err)
+{
+	posix_spawn_file_actions_t	fa;
+	pid_t				pid;
+	int				ret;
+
+	if ((ret = posix_spawn_file_actions_init(&fa)) != 0) {
+		errno = ret;
+		return (-1);
+	}
+	if ((ret = posix_spawn_file_actions_adddup2(&fa, in, 0)) == 0 &&
+	    (ret = posix_spawn_file_actions_adddup2(&fa, out, 1)) == 0 &&
+	    (ret = posix_spawn_file_actions_adddup2(&fa, err, 2)) == 0)
+		ret = posix_spawn(&pid, argv[0], &fa, NULL, argv, NULL);
+	(void) posix_spawn_file_actions_destroy(&fa);
+
+	if (ret != 0) {
+		tmz_debug_print(LS_DBGLVL_ERR, "zfs: can't run %s: %s\n",
+		    argv[0], strerror(ret));
+		errno = ret;
+		return (-1);
+	}
+	return (pid);
+}
+
+/*
+ * tmz_wait()
+ *	Waits for command started by tmz_spawn()
+ * Returns:
+ *	B_TRUE if it exited with zero status
+ */
+static boolean_t
+tmz_wait(pid_t pid)
+{
+	int	status;
+
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR)
+			return (B_FALSE);
+	}
+	return (WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+/*
+ * tmz_pipe()
+ *	Creates pipe with close-on-exec descriptors
+ */
+static int
+tmz_pipe(int fds[2])
+{
+	if (pipe(fds) != 0)
+		return (errno);
+	(void) fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	(void) fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	return (0);
+}
+
+/*
+ * tmz_write()
+ *	Writes whole buffer to the pipeline
+ * Returns:
+ *	0 on success, errno on failure
+ */
+static int
+tmz_write(int fd, const char *buf, size_t len)
+{
+	ssize_t	n;
+
+	while (len > 0) {
+		if ((n = write(fd, buf, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return (errno);
+		}
+		buf += n;
+		len -= n;
+	}
+	return (0);
+}
+
+/*
+ * tm_zfs_receive()
+ *	Receives ZFS stream into existing dataset, replacing its contents.
+ *	The stream may be gzip compressed. It is received as snapshot
+ *	TM_ZFS_RECV_SNAPSHOT of the dataset, which is destroyed when done,
+ *	so that it doesn't hold on to blocks changed later. The dataset
+ *	has to be unmounted and is left unmounted, it is up to the caller
+ *	to mount it where needed.
+ *	Commands of the pipeline are run directly, not through the shell,
+ *	so neither the stream nor the dataset name are interpreted by it.
+ * Input:
+ *	stream	- file containing the stream
+ *	dataset	- dataset to receive the stream into
+ * Returns:
+ *	0	- stream received
+ *	EINTR	- the transfer was cancelled, nothing was received
+ *	EIO	- "zfs receive" failed, its output is logged
+ *	errno	- stream couldn't be read
+ */
+int
+tm_zfs_receive(const char *stream, const char *dataset)
+{
+	char	snap[MAXPATHLEN], errpath[] = TMZ_ERR_TEMPLATE;
+	char	*gzip_argv[] = { TMZ_GZIP, "-dc", NULL };
+	char	*recv_argv[] = { TMZ_ZFS, "receive", "-u", "-F", snap, NULL };
+	char	*destroy_argv[] = { TMZ_ZFS, "destroy", snap, NULL };
+	char	*buf = NULL;
+	ssize_t	n;
+	pid_t	gzip_pid = -1, recv_pid = -1, pid;
+	int	in[2] = { -1, -1 }, gz[2] = { -1, -1 };
+	int	fd, errfd = -1, nullfd = -1, ret = 0;
+	boolean_t	ok;
+
+	(void) snprintf(snap, sizeof (snap), "%s@%s", dataset,
+	    TM_ZFS_RECV_SNAPSHOT);
+
+	if ((fd = open(stream, O_RDONLY)) < 0) {
+		ret = errno;
+		tmz_debug_print(LS_DBGLVL_ERR, "zfs: can't open %s: %s\n",
+		    stream, strerror(ret));
+		return (ret);
+	}
+	if ((buf = malloc(TMZ_BUFSIZE)) == NULL) {
+		ret = ENOMEM;
+		goto done;
+	}
+	if ((errfd = mkstemp(errpath)) < 0 ||
+	    (nullfd = open("/dev/null", O_WRONLY)) < 0) {
+		ret = errno;
+		goto done;
+	}
+	(void) fcntl(errfd, F_SETFD, FD_CLOEXEC);
+	(void) fcntl(nullfd, F_SETFD, FD_CLOEXEC);
+
+	/* stream -> [gzip -dc ->] zfs receive */
+	if ((ret = tmz_pipe(in)) != 0)
+		goto done;
+	if (tmz_is_gzip(fd)) {
+		if ((ret = tmz_pipe(gz)) != 0)
+			goto done;
+		if ((gzip_pid = tmz_spawn(gzip_argv, in[0], gz[1],
+		    errfd)) < 0) {
+			ret = errno;
+			goto done;
+		}
+		(void) close(gz[1]);
+		gz[1] = -1;
+	}
+	tmz_debug_print(LS_DBGLVL_INFO, "zfs: %s%s receive -u -F %s < %s\n",
+	    gzip_pid != -1 ? TMZ_GZIP " -dc | " : "", TMZ_ZFS, snap, stream);
+	if ((recv_pid = tmz_spawn(recv_argv, gzip_pid != -1 ? gz[0] : in[0],
+	    nullfd, errfd)) < 0) {
+		ret = errno;
+		goto done;
+	}
+	(void) close(in[0]);
+	in[0] = -1;
+
+	tm_progress_path(dataset);
+	for (;;) {
+		if (tm_cancelled()) {
+			ret = EINTR;
+			break;
+		}
+		if ((n = read(fd, buf, TMZ_BUFSIZE)) < 0) {
+			if (errno == EINTR)
+				continue;
+			ret = errno;
+			tmz_debug_print(LS_DBGLVL_ERR, "zfs: read of %s "
+			    "failed: %s\n", stream, strerror(ret));
+			break;
+		}
+		if (n == 0)
+			break;
+
+		/*
+		 * Failed write means the receiving side is gone, its exit
+		 * status tells why
+		 */
+		if (tmz_write(in[1], buf, n) != 0)
+			break;
+		tm_progress_add(n, 0);
+	}
+
+done:
+	/*
+	 * If the stream was cut short, "zfs receive" fails and discards
+	 * what it received so far
+	 */
+	if (in[1] != -1)
+		(void) close(in[1]);
+	ok = B_TRUE;
+	if (gzip_pid != -1 && !tmz_wait(gzip_pid))
+		ok = B_FALSE;
+	if (recv_pid != -1 && !tmz_wait(recv_pid))
+		ok = B_FALSE;
+	if (ret == 0 && !ok) {
+		tmz_debug_print(LS_DBGLVL_ERR, "zfs: receive of %s into %s "
+		    "failed\n", stream, dataset);
+		tmz_log_errors(errpath);
+		ret = EIO;
+	}
+
+	if (ret == 0) {
+		(void) ftruncate(errfd, 0);
+		(void) lseek(errfd, 0, SEEK_SET);
+		if ((pid = tmz_spawn(destroy_argv, nullfd, nullfd,
+		    errfd)) < 0 || !tmz_wait(pid)) {
+			tmz_debug_print(LS_DBGLVL_WARN, "zfs: can't destroy "
+			    "%s\n", snap);
+			tmz_log_errors(errpath);
+		}
+		tmz_debug_print(LS_DBGLVL_INFO, "zfs: %s received into %s\n",
+		    stream, dataset);
+	}
+
+	if (in[0] != -1)
+		(void) close(in[0]);
+	if (gz[0] != -1)
+		(void) close(gz[0]);
+	if (gz[1] != -1)
+		(void) close(gz[1]);
+	if (nullfd != -1)
+		(void) close(nullfd);
+	if (errfd != -1) {
+		(void) close(errfd);
+		(void) unlink(errpath);
+	}
+	free(buf);
+	(void) close(fd);
+	return (ret);
+}
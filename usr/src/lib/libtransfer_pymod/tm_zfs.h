@@ -0,0 +1,47 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2010, Oracle and/or its affiliates. All rights reserved.
+ */
+
+#ifndef _TM_ZFS_H
+#define	_TM_ZFS_H
+
+/*
+ * Receiver of ZFS image streams used by the TM_PERFORM_ZFS_RECV transfer
+ * mechanism
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* snapshot the stream is received as, destroyed once received */
+#define	TM_ZFS_RECV_SNAPSHOT	"tm_image"
+
+int	tm_zfs_receive(const char *stream, const char *dataset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TM_ZFS_H */